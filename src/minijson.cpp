@@ -1,10 +1,37 @@
 #include "minijson.h"
 #include <string.h>
+#include <stddef.h>
+#include <float.h>
+#include <limits.h>
 #include <sstream>
 #include <cstdarg>
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <typeinfo>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#ifdef GetObject
+#undef GetObject
+#endif
+#else
+#include <sys/time.h>
+#endif // _WIN32
+
+#ifdef MINIJSON_WITH_ZLIB
+#include <zlib.h>
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+#include <zstd.h>
+#endif // MINIJSON_WITH_ZSTD
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MINIJSON_UTF8_SSSE3
+#include <tmmintrin.h>
+#endif
 
 #ifndef _WIN32
 #define MJSONvsprintf(str, size, format, args) vsnprintf(str, size, format, args)
@@ -47,7 +74,22 @@ CParseErrorException::CParseErrorException(const char* data, int position, const
 
     m_Message = std::string(buf);
 
-    size_t dataLen = strlen(data);
+    Locate(data, data ? strlen(data) : 0, position, &m_Line, &m_Column, &m_Surrounding);
+}
+CParseErrorException::CParseErrorException(const char* data, size_t length, int position, const std::string& message)
+    : CException(),
+      m_Position(position),
+      m_Line(-1),
+      m_Column(-1)
+{
+    m_Message = message;
+    Locate(data, length, position, &m_Line, &m_Column, &m_Surrounding);
+}
+void CParseErrorException::Locate(const char* data, size_t dataLen, int position, int* lineOut, int* columnOut, std::string* surroundingOut)
+{
+    *lineOut = -1;
+    *columnOut = -1;
+    surroundingOut->clear();
     if (position >= 0 && data && dataLen > (size_t)position)
     {
 
@@ -89,13 +131,14 @@ CParseErrorException::CParseErrorException(const char* data, int position, const
             }
         }
 
-        m_Line = line;
-        m_Column = (m_Position - currentStartOfLinePos + 1);
+        int column = (position - currentStartOfLinePos + 1);
+        *lineOut = line;
+        *columnOut = column;
 
         std::string markerLine;
-        if (m_Column > 0)
+        if (column > 0)
         {
-            markerLine = std::string(m_Column - 1, ' ');
+            markerLine = std::string(column - 1, ' ');
         }
         markerLine.push_back('^');
         markerLine.push_back('\n');
@@ -111,7 +154,7 @@ CParseErrorException::CParseErrorException(const char* data, int position, const
         }
         std::string prevAndCurrentText(data + surroundingStart, endPosOfLine - surroundingStart + 1);
         std::string nextText(data + endPosOfLine + 1, next2LinesEndPos - endPosOfLine);
-        m_Surrounding = prevAndCurrentText + markerLine + nextText;
+        *surroundingOut = prevAndCurrentText + markerLine + nextText;
     }
 }
 CParseErrorException::~CParseErrorException()
@@ -129,358 +172,823 @@ CIOException::CIOException(const char* txt, ...)
     m_Message = std::string(buf);
 }
 
-static std::string EscapeString(const std::string& str)
+// writes the escape sequence for c into buf (at least 7 bytes) and returns its length,
+// returns 0 if c does not need to be escaped
+static int EscapeChar(char c, char* buf)
 {
-    size_t escapeCount = 0;
-    for (std::string::size_type i = 0; i < str.length(); i++)
+    switch (c)
     {
-        char c = str[i];
-        if (c == '\b' ||
-            c == '\r' ||
-            c == '\n' ||
-            c == '\f' ||
-            c == '\t' ||
-            c == '\\' ||
-            c == '/' ||
-            c == '\"')
-        {
-            escapeCount++;
-        }
+    case '\b': buf[0] = '\\'; buf[1] = 'b'; return 2;
+    case '\r': buf[0] = '\\'; buf[1] = 'r'; return 2;
+    case '\n': buf[0] = '\\'; buf[1] = 'n'; return 2;
+    case '\f': buf[0] = '\\'; buf[1] = 'f'; return 2;
+    case '\t': buf[0] = '\\'; buf[1] = 't'; return 2;
+    case '\\': buf[0] = '\\'; buf[1] = '\\'; return 2;
+    case '/': buf[0] = '\\'; buf[1] = '/'; return 2;
+    case '\"': buf[0] = '\\'; buf[1] = '\"'; return 2;
+    default:
+        break;
+    }
+    if ((unsigned char)c < 0x20)
+    {
+        // remaining control characters are not allowed unescaped in json strings
+        static const char* hex = "0123456789abcdef";
+        buf[0] = '\\';
+        buf[1] = 'u';
+        buf[2] = '0';
+        buf[3] = '0';
+        buf[4] = hex[((unsigned char)c >> 4) & 0xf];
+        buf[5] = hex[(unsigned char)c & 0xf];
+        return 6;
     }
+    return 0;
+}
+
+static std::string EscapeString(const std::string& str)
+{
     std::string out;
-    out.reserve(str.length() + escapeCount);
+    out.reserve(str.length() + 8);
+    char buf[8];
     for (std::string::size_type i = 0; i < str.length(); i++)
     {
-        char c = str[i];
-        switch (c)
+        int len = EscapeChar(str[i], buf);
+        if (len == 0)
+        {
+            out += str[i];
+        }
+        else
         {
-        case '\b': out += "\\b"; break;
-        case '\r': out += "\\r"; break;
-        case '\n': out += "\\n"; break;
-        case '\f': out += "\\f"; break;
-        case '\t': out += "\\t"; break;
-        case '\\': out += "\\\\"; break;
-        case '/': out += "\\/"; break;
-        case '\"': out += "\\\""; break;
-        default: out += c;
+            out.append(buf, len);
         }
     }
     return out;
 }
 
-CEntity::CEntity()
+CAllocator::~CAllocator()
 {
 }
-CEntity::~CEntity()
+
+class CDefaultAllocator : public CAllocator
+{
+public:
+    virtual void* Allocate(size_t size) MINIJSON_OVERRIDE
+    {
+        return ::operator new(size);
+    }
+    virtual void Free(void* ptr, size_t size) MINIJSON_OVERRIDE
+    {
+        (void)size;
+        ::operator delete(ptr);
+    }
+};
+CAllocator& CAllocator::Default()
 {
+    static CDefaultAllocator allocator;
+    return allocator;
 }
-bool CEntity::IsObject() const
+
+CCountingAllocator::CCountingAllocator(CAllocator& parent)
+    : m_Parent(parent),
+      m_Limit(0),
+      m_BytesInUse(0),
+      m_PeakBytesInUse(0),
+      m_Allocations(0)
 {
-    return dynamic_cast<const CObject*>(this) != NULL;
 }
-bool CEntity::IsArray() const
+void* CCountingAllocator::Allocate(size_t size)
 {
-    return dynamic_cast<const CArray*>(this) != NULL;
+    if (m_Limit != 0 && (size > m_Limit || m_BytesInUse > m_Limit - size))
+    {
+        throw CException("Memory limit of %lu bytes exceeded", (unsigned long)m_Limit);
+    }
+    void* ptr = m_Parent.Allocate(size);
+    m_BytesInUse += size;
+    m_Allocations++;
+    if (m_BytesInUse > m_PeakBytesInUse)
+    {
+        m_PeakBytesInUse = m_BytesInUse;
+    }
+    return ptr;
 }
-bool CEntity::IsString() const
+void CCountingAllocator::Free(void* ptr, size_t size)
 {
-    return dynamic_cast<const CString*>(this) != NULL;
+    if (!ptr)
+    {
+        return;
+    }
+    m_Parent.Free(ptr, size);
+    m_BytesInUse -= size;
 }
-bool CEntity::IsNumber() const
+
+// alignment of all memory returned by the arena and pool allocators
+static const size_t ALLOCATOR_ALIGNMENT = 16;
+
+static size_t AlignSize(size_t size)
 {
-    return dynamic_cast<const CNumber*>(this) != NULL;
+    return (size + ALLOCATOR_ALIGNMENT - 1) & ~(ALLOCATOR_ALIGNMENT - 1);
 }
-bool CEntity::IsBoolean() const
+
+CArenaAllocator::CArenaAllocator(size_t blockSize, CAllocator& parent)
+    : m_Parent(parent),
+      m_BlockSize(std::max(blockSize, (size_t)1024)),
+      m_Blocks(NULL),
+      m_FreeBlocks(NULL),
+      m_Current(NULL),
+      m_End(NULL),
+      m_BytesReserved(0)
 {
-    return dynamic_cast<const CBoolean*>(this) != NULL;
 }
-bool CEntity::IsNull() const
+CArenaAllocator::~CArenaAllocator()
 {
-    return dynamic_cast<const CNull*>(this) != NULL;
+    Reset();
 }
-const CObject& CEntity::Object() const
+void* CArenaAllocator::Allocate(size_t size)
 {
-    const CObject* obj = dynamic_cast<const CObject*>(this);
-    if (!obj)
+    size = AlignSize(std::max(size, (size_t)1));
+    if ((size_t)(m_End - m_Current) < size)
     {
-        throw CException("Object() failed for non CObject entity");
+        // large allocations get a block of their own, the current block stays in use
+        size_t blockSize = size > m_BlockSize / 4 ? size : m_BlockSize;
+        size_t headerSize = AlignSize(sizeof(SBlock));
+        SBlock* block = NULL;
+        if (blockSize == m_BlockSize && m_FreeBlocks)
+        {
+            block = m_FreeBlocks;
+            m_FreeBlocks = block->m_Next;
+        }
+        else
+        {
+            block = (SBlock*)m_Parent.Allocate(headerSize + blockSize);
+            block->m_Size = headerSize + blockSize;
+            m_BytesReserved += block->m_Size;
+        }
+        block->m_Next = m_Blocks;
+        m_Blocks = block;
+        char* data = (char*)block + headerSize;
+        if (blockSize != m_BlockSize)
+        {
+            return data;
+        }
+        m_Current = data;
+        m_End = data + blockSize;
     }
-    return *obj;
+    void* ptr = m_Current;
+    m_Current += size;
+    return ptr;
 }
-CObject& CEntity::Object()
+void CArenaAllocator::Free(void* ptr, size_t size)
 {
-    CObject* obj = dynamic_cast<CObject*>(this);
-    if (!obj)
-    {
-        throw CException("Object() failed for non CObject entity");
-    }
-    return *obj;
+    // memory is released by Reset()
+    (void)ptr;
+    (void)size;
 }
-
-const CArray& CEntity::Array() const
+void CArenaAllocator::Reset()
 {
-    const CArray* arr = dynamic_cast<const CArray*>(this);
-    if (!arr)
+    Rewind();
+    while (m_FreeBlocks)
     {
-        throw CException("Array() failed for non CArray entity");
+        SBlock* next = m_FreeBlocks->m_Next;
+        m_Parent.Free(m_FreeBlocks, m_FreeBlocks->m_Size);
+        m_FreeBlocks = next;
     }
-    return *arr;
+    m_BytesReserved = 0;
 }
-CArray& CEntity::Array()
+void CArenaAllocator::Rewind()
 {
-    CArray* arr = dynamic_cast<CArray*>(this);
-    if (!arr)
+    size_t standardSize = AlignSize(sizeof(SBlock)) + m_BlockSize;
+    while (m_Blocks)
     {
-        throw CException("Array() failed for non CArray entity");
+        SBlock* next = m_Blocks->m_Next;
+        if (m_Blocks->m_Size == standardSize)
+        {
+            m_Blocks->m_Next = m_FreeBlocks;
+            m_FreeBlocks = m_Blocks;
+        }
+        else
+        {
+            m_BytesReserved -= m_Blocks->m_Size;
+            m_Parent.Free(m_Blocks, m_Blocks->m_Size);
+        }
+        m_Blocks = next;
     }
-    return *arr;
+    m_Current = NULL;
+    m_End = NULL;
 }
-const CString& CEntity::String() const
+
+static const size_t POOL_BLOCK_SIZE = 64 * 1024;
+
+CPoolAllocator::CPoolAllocator(CAllocator& parent)
+    : m_Parent(parent),
+      m_BytesReserved(0)
 {
-    const CString* str = dynamic_cast<const CString*>(this);
-    if (!str)
+    for (int i = 0; i < SIZE_CLASSES; i++)
     {
-        throw CException("String() failed for non CString entity");
+        m_FreeLists[i] = NULL;
     }
-    return *str;
 }
-CString& CEntity::String()
+CPoolAllocator::~CPoolAllocator()
 {
-    CString* str = dynamic_cast<CString*>(this);
-    if (!str)
+    for (size_t i = 0; i < m_Blocks.size(); i++)
     {
-        throw CException("String() failed for non CString entity");
+        m_Parent.Free(m_Blocks[i], POOL_BLOCK_SIZE);
     }
-    return *str;
 }
-const CNumber& CEntity::Number() const
+void* CPoolAllocator::Allocate(size_t size)
 {
-    const CNumber* number = dynamic_cast<const CNumber*>(this);
-    if (!number)
+    if (size == 0 || size > GRANULARITY * SIZE_CLASSES)
     {
-        throw CException("Number() failed for non CNumber entity");
+        return m_Parent.Allocate(size);
     }
-    return *number;
+    size_t sizeClass = (size - 1) / GRANULARITY;
+    void* ptr = m_FreeLists[sizeClass];
+    if (!ptr)
+    {
+        // split a new block into free entries of this size class
+        m_Blocks.reserve(m_Blocks.size() + 1);
+        char* block = (char*)m_Parent.Allocate(POOL_BLOCK_SIZE);
+        m_Blocks.push_back(block);
+        m_BytesReserved += POOL_BLOCK_SIZE;
+        size_t entrySize = (sizeClass + 1) * GRANULARITY;
+        for (size_t pos = 0; pos + entrySize <= POOL_BLOCK_SIZE; pos += entrySize)
+        {
+            *(void**)(block + pos) = m_FreeLists[sizeClass];
+            m_FreeLists[sizeClass] = block + pos;
+        }
+        ptr = m_FreeLists[sizeClass];
+    }
+    m_FreeLists[sizeClass] = *(void**)ptr;
+    return ptr;
 }
-CNumber& CEntity::Number()
+void CPoolAllocator::Free(void* ptr, size_t size)
 {
-    CNumber* number = dynamic_cast<CNumber*>(this);
-    if (!number)
+    if (!ptr)
     {
-        throw CException("Number() failed for non CNumber entity");
+        return;
     }
-    return *number;
+    if (size == 0 || size > GRANULARITY * SIZE_CLASSES)
+    {
+        m_Parent.Free(ptr, size);
+        return;
+    }
+    size_t sizeClass = (size - 1) / GRANULARITY;
+    *(void**)ptr = m_FreeLists[sizeClass];
+    m_FreeLists[sizeClass] = ptr;
 }
 
-const CBoolean& CEntity::Boolean() const
+// header in front of every entity, stores the allocator used for the entity.
+// the union keeps the entity aligned for all member types.
+union UEntityHeader
+{
+    CAllocator* m_Allocator;
+    double m_AlignDouble;
+    long long m_AlignLongLong;
+};
+
+static void* AllocateEntity(CAllocator& allocator, size_t size)
 {
-    const CBoolean* boolean = dynamic_cast<const CBoolean*>(this);
-    if (!boolean)
-    {
-        throw CException("Boolean() failed for non CBoolean entity");
-    }
-    return *boolean;
+    UEntityHeader* header = (UEntityHeader*)allocator.Allocate(sizeof(UEntityHeader) + size);
+    header->m_Allocator = &allocator;
+    return header + 1;
 }
-CBoolean& CEntity::Boolean()
+static void FreeEntity(void* ptr, size_t size)
 {
-    CBoolean* boolean = dynamic_cast<CBoolean*>(this);
-    if (!boolean)
-    {
-        throw CException("Boolean() failed for non CBoolean entity");
-    }
-    return *boolean;
+    UEntityHeader* header = (UEntityHeader*)ptr - 1;
+    header->m_Allocator->Free(header, sizeof(UEntityHeader) + size);
 }
-const CNull& CEntity::Null() const
+// creates an entity of type T using allocator (deleted as usual, see CEntity::operator delete())
+template <class T>
+static T* NewEntity(CAllocator& allocator)
 {
-    const CNull* null = dynamic_cast<const CNull*>(this);
-    if (!null)
+    void* ptr = AllocateEntity(allocator, sizeof(T));
+    try
     {
-        throw CException("Null() failed for non CNull entity");
+        return ::new (ptr) T();
     }
-    return *null;
-}
-CNull& CEntity::Null()
-{
-    CNull* null = dynamic_cast<CNull*>(this);
-    if (!null)
+    catch (...)
     {
-        throw CException("Null() failed for non CNull entity");
+        FreeEntity(ptr, sizeof(T));
+        throw;
     }
-    return *null;
 }
-const std::string& CEntity::ObjectMemberNameByIndex(int index) const
+// creates a CObject or CArray whose children are allocated from allocator as well
+template <class T>
+static T* NewContainer(CAllocator& allocator)
 {
-    if (!IsObject())
+    void* ptr = AllocateEntity(allocator, sizeof(T));
+    try
     {
-        throw CException("ObjectMemberNameByIndex() is only allowed for objects");
+        return ::new (ptr) T(allocator);
+    }
+    catch (...)
+    {
+        FreeEntity(ptr, sizeof(T));
+        throw;
     }
-    return Object().MemberNameByIndex(index);
 }
 
-int CEntity::Count() const
+void* CEntity::operator new(size_t size)
 {
-    throw CException("Count is not applicable for this type");
+    return AllocateEntity(CAllocator::Default(), size);
 }
-const std::string& CEntity::StringValue() const
+void CEntity::operator delete(void* ptr, size_t size)
 {
-    if (!IsString())
+    if (ptr)
     {
-        throw CException("Called StringValue for non string entity");
+        FreeEntity(ptr, size);
     }
-    return String().Value();
-}
-int CEntity::IntValue() const
-{
-    return atoi(Number().Value().c_str());
 }
-float CEntity::FloatValue() const
-{
-    return (float)DoubleValue();
-}
-double CEntity::DoubleValue() const
-{
-    return atof(Number().Value().c_str());
-}
-bool CEntity::BoolValue() const
+size_t CEntity::AllocationSize(size_t entitySize)
 {
-    return Boolean().Value();
+    return sizeof(UEntityHeader) + entitySize;
 }
 
-const CEntity& CEntity::operator[] (int idx) const
-{
-    if (IsArray())
+//
+// structural hashes (see CEntity::Hash())
+//
+static uint64_t MixHash(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+// FNV-1a
+static uint64_t HashBytes(const char* data, size_t length)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++)
     {
-        return Array().EntityAtIndex(idx);
+        h = (h ^ (unsigned char)data[i]) * 0x100000001b3ULL;
     }
-    else if (IsObject())
+    return h;
+}
+
+enum EHashSeed
+{
+    HASH_OBJECT = 1,
+    HASH_ARRAY,
+    HASH_STRING,
+    HASH_NUMBER,
+    HASH_BOOLEAN,
+    HASH_NULL
+};
+
+/**
+ * The value of a number as significant digits (in [m_Begin, m_End), without leading and trailing
+ * zeros, a '.' inside is skipped) times 10^m_Exponent, so different texts of the same value
+ * ("2", "2.0", "20e-1") have the same representation.
+ **/
+struct SDecimal
+{
+    const char* m_Begin;
+    const char* m_End;
+    long m_Exponent;
+    bool m_Negative;
+};
+
+// returns false if num is not a valid number
+static bool ParseDecimal(const char* num, size_t length, SDecimal& decimal)
+{
+    const char* p = num;
+    const char* end = p + length;
+    decimal.m_Negative = p < end && *p == '-';
+    if (decimal.m_Negative)
     {
-        return Object().EntityAtIndex(idx);
+        p++;
     }
-    else
+    const char* digits = p;
+    const char* point = NULL;
+    for (; p < end && ((*p >= '0' && *p <= '9') || (*p == '.' && !point)); p++)
     {
-        throw CException("operator[](int) is only allowed for arrays and objects");
+        if (*p == '.')
+        {
+            point = p;
+        }
     }
-}
-const CEntity& CEntity::operator[] (const char* key) const
-{
-    if (!IsObject())
+    const char* digitsEnd = p;
+    if (digitsEnd - digits == (point ? 1 : 0))
     {
-        throw CException("operator[](key) is only allowed for objects");
+        return false;
     }
-    const CEntity* ent = Object().GetEntity(key);
-    if (!ent)
+    long exponent = 0;
+    if (p < end && (*p == 'e' || *p == 'E'))
     {
-        // TODO: specialized CKeyNotFoundException? (provide key as argument)
-        throw CException("key '%s' not found in operator[]", key);
+        p++;
+        bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            p++;
+        }
+        if (p == end)
+        {
+            return false;
+        }
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (exponent < 100000000)
+            {
+                exponent = exponent * 10 + (*p - '0');
+            }
+        }
+        exponent = negative ? -exponent : exponent;
     }
-    return *ent;
-}
-const CEntity& CEntity::operator[] (const std::string& key) const
-{
-    if (!IsObject())
+    if (p != end)
     {
-        throw CException("operator[](key) is only allowed for objects");
+        return false;
     }
-    const CEntity* ent = Object().GetEntity(key);
-    if (!ent)
+    if (!point)
     {
-        // TODO: specialized CKeyNotFoundException? (provide key as argument)
-        throw CException("key '%s' not found in operator[]", key.c_str());
+        point = digitsEnd;
     }
-    return *ent;
-}
-
-CEntity& CEntity::operator[] (int idx)
-{
-    if (IsArray())
+    const char* first = digits;
+    while (first < digitsEnd && (*first == '0' || *first == '.'))
     {
-        return Array().EntityAtIndex(idx);
+        first++;
     }
-    else if (IsObject())
+    const char* last = digitsEnd;
+    while (last > first && (last[-1] == '0' || last[-1] == '.'))
     {
-        return Object().EntityAtIndex(idx);
+        last--;
     }
-    else
+    if (first == last)
     {
-        throw CException("operator[](int) is only allowed for arrays and objects");
+        // zero (of any sign)
+        decimal.m_Begin = decimal.m_End = first;
+        decimal.m_Exponent = 0;
+        decimal.m_Negative = false;
+        return true;
     }
+    decimal.m_Begin = first;
+    decimal.m_End = last;
+    // exponent of the last significant digit
+    decimal.m_Exponent = last <= point ? exponent + (long)(point - last) : exponent - (long)(last - point - 1);
+    return true;
 }
-CEntity& CEntity::operator[] (const char* key)
+
+// hash of a number (see CNumber::ComputeHash())
+static uint64_t HashNumber(const char* num, size_t length)
 {
-    if (!IsObject())
+    SDecimal decimal;
+    if (!ParseDecimal(num, length, decimal))
     {
-        throw CException("operator[](key) is only allowed for objects");
+        return MixHash(HashBytes(num, length) + HASH_NUMBER);
     }
-    CEntity* ent = Object().GetEntity(key);
-    if (!ent)
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char* p = decimal.m_Begin; p < decimal.m_End; p++)
     {
-        // TODO: specialized CKeyNotFoundException? (provide key as argument)
-        throw CException("key '%s' not found in operator[]", key);
+        if (*p != '.')
+        {
+            h = (h ^ (unsigned char)*p) * 0x100000001b3ULL;
+        }
     }
-    return *ent;
+    return MixHash(h ^ MixHash((uint64_t)decimal.m_Exponent * 2 + (decimal.m_Negative ? 1 : 0))) + HASH_NUMBER;
 }
-CEntity& CEntity::operator[] (const std::string& key)
+// numbers with the same decimal value (see CEntity::Equals())
+static bool NumbersEqual(const char* a, size_t lengthA, const char* b, size_t lengthB)
 {
-    if (!IsObject())
+    if (lengthA == lengthB && memcmp(a, b, lengthA) == 0)
     {
-        throw CException("operator[](key) is only allowed for objects");
+        return true;
     }
-    CEntity* ent = Object().GetEntity(key);
-    if (!ent)
+    SDecimal da;
+    SDecimal db;
+    if (!ParseDecimal(a, lengthA, da) || !ParseDecimal(b, lengthB, db) || da.m_Negative != db.m_Negative || da.m_Exponent != db.m_Exponent)
     {
-        // TODO: specialized CKeyNotFoundException? (provide key as argument)
-        throw CException("key '%s' not found in operator[]", key.c_str());
+        return false;
+    }
+    // compare the significant digits, skipping the '.'
+    const char* pa = da.m_Begin;
+    const char* pb = db.m_Begin;
+    for (;;)
+    {
+        pa += pa < da.m_End && *pa == '.' ? 1 : 0;
+        pb += pb < db.m_End && *pb == '.' ? 1 : 0;
+        if (pa == da.m_End || pb == db.m_End)
+        {
+            return pa == da.m_End && pb == db.m_End;
+        }
+        if (*pa++ != *pb++)
+        {
+            return false;
+        }
     }
-    return *ent;
 }
 
-CNumber::CNumber()
-{
-}
-CNumber::~CNumber()
-{
-}
+//
+// number conversion (CNumber::Value*(), packed arrays)
+//
 
-void CNumber::SetInt(int i)
+// buffer size for the text of any finite double (without exponent)
+static const size_t NUMBER_TEXT_SIZE = 352;
+
+// the powers of 10 that are exact doubles
+static const double s_PowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// integer text ('-' and digits, no leading zeros, not "-0") in the int64_t range
+static bool NumberToInt64(const char* str, size_t length, int64_t& value)
 {
-    char buf[256];
-#ifndef _WIN32
-    snprintf(buf, 255, "%d", i);
-#else // !_WIN32
-    sprintf_s(buf, 255, "%d", i);
-#endif // !_WIN32
-    buf[255] = 0;
-    m_Number = buf;
+    size_t i = 0;
+    bool negative = length > 0 && str[0] == '-';
+    if (negative)
+    {
+        i++;
+    }
+    if (i == length || (str[i] == '0' && (length - i > 1 || negative)))
+    {
+        return false;
+    }
+    // accumulated as a negative number, so the minimum fits as well
+    const int64_t minimum = -9223372036854775807LL - 1;
+    int64_t v = 0;
+    for (; i < length; i++)
+    {
+        int digit = str[i] - '0';
+        if (digit < 0 || digit > 9 || v < minimum / 10 || v * 10 < minimum + digit)
+        {
+            return false;
+        }
+        v = v * 10 - digit;
+    }
+    if (!negative && v == minimum)
+    {
+        return false;
+    }
+    value = negative ? v : -v;
+    return true;
 }
-void CNumber::SetFloat(float f)
+// converts a number (json syntax, exponents are accepted) to the nearest double, returns false if
+// str is no number or out of the double range. exact (if not NULL) is set if the number has at
+// most 15 significant digits (and a moderate exponent), i.e. the shortest text of value (see
+// FormatDouble()) has the same decimal value as str.
+static bool NumberToDouble(const char* str, size_t length, double& value, bool* exact = NULL)
 {
-    char buf[256];
-#ifndef _WIN32
-    snprintf(buf, 255, "%f", f);
-#else // !_WIN32
-    sprintf_s(buf, 255, "%f", f);
-#endif // !_WIN32
-    buf[255] = 0;
-    m_Number = buf;
+    if (exact)
+    {
+        *exact = false;
+    }
+    const char* p = str;
+    const char* end = str + length;
+    bool negative = p < end && *p == '-';
+    if (negative)
+    {
+        p++;
+    }
+    // up to 19 digits of the mantissa, exact if the mantissa is at most 2^53
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    const char* begin = p;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        digits += mantissa != 0 || *p != '0' ? 1 : 0;
+        mantissa = digits <= 19 ? mantissa * 10 + (*p - '0') : mantissa;
+        exponent += digits > 19 ? 1 : 0;
+    }
+    if (p == begin)
+    {
+        return false;
+    }
+    if (p < end && *p == '.')
+    {
+        begin = ++p;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            digits += mantissa != 0 || *p != '0' ? 1 : 0;
+            if (digits <= 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+        if (p == begin)
+        {
+            return false;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        p += p < end && (*p == '-' || *p == '+') ? 1 : 0;
+        begin = p;
+        int e = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            e = e < 100000 ? e * 10 + (*p - '0') : e;
+        }
+        if (p == begin)
+        {
+            return false;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    if (p != end)
+    {
+        return false;
+    }
+    if (digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // both operands are exact, i.e. the result is correctly rounded
+        value = exponent < 0 ? (double)mantissa / s_PowersOf10[-exponent] : (double)mantissa * s_PowersOf10[exponent];
+        value = negative ? -value : value;
+        if (exact)
+        {
+            *exact = digits <= 15;
+        }
+        return true;
+    }
+    std::stringstream stream(std::string(str, length));
+    stream >> value;
+    return !stream.fail();
+}
+static size_t FormatInt64(int64_t value, char* buffer)
+{
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    // the digits are written backwards, two at a time
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    while (v >= 100)
+    {
+        unsigned pair = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = pairs[pair + 1];
+        *--p = pairs[pair];
+    }
+    if (v >= 10)
+    {
+        *--p = pairs[v * 2 + 1];
+        *--p = pairs[v * 2];
+    }
+    else
+    {
+        *--p = (char)('0' + v);
+    }
+    size_t length = 0;
+    if (value < 0)
+    {
+        buffer[length++] = '-';
+    }
+    size_t count = digits + sizeof(digits) - p;
+    memcpy(buffer + length, p, count);
+    return length + count;
 }
-void CNumber::SetDouble(double d)
+// shortest text that reads back as the finite double value, without exponent (the parser does
+// not accept exponents). buffer must have NUMBER_TEXT_SIZE bytes, returns the length.
+static size_t FormatDouble(double value, char* buffer)
 {
-    char buf[256];
-#ifndef _WIN32
-    snprintf(buf, 255, "%f", d);
-#else // !_WIN32
-    sprintf_s(buf, 255, "%f", d);
-#endif // !_WIN32
-    buf[255] = 0;
-    m_Number = buf;
+    if (value > -9007199254740992.0 && value < 9007199254740992.0 && value != 0.0 && value == (double)(int64_t)value)
+    {
+        return FormatInt64((int64_t)value, buffer);
+    }
+    size_t length = 0;
+    if (value == 0.0)
+    {
+        if (1.0 / value < 0.0)
+        {
+            buffer[length++] = '-';
+        }
+        buffer[length++] = '0';
+        return length;
+    }
+    // value = m / 10^k with up to 15 digits: the division is exact, i.e. the parser reads the
+    // text back as value, and the smallest k is the shortest text
+    double magnitude = value < 0.0 ? -value : value;
+    for (int k = 1; k <= 22 && magnitude * s_PowersOf10[k] < 1e15; k++)
+    {
+        int64_t m = (int64_t)(magnitude * s_PowersOf10[k] + 0.5);
+        if ((double)m / s_PowersOf10[k] != magnitude)
+        {
+            continue;
+        }
+        char digits[24];
+        size_t count = FormatInt64(m, digits);
+        if (value < 0.0)
+        {
+            buffer[length++] = '-';
+        }
+        if (count <= (size_t)k)
+        {
+            buffer[length++] = '0';
+            buffer[length++] = '.';
+            for (size_t i = count; i < (size_t)k; i++)
+            {
+                buffer[length++] = '0';
+            }
+            memcpy(buffer + length, digits, count);
+            return length + count;
+        }
+        memcpy(buffer + length, digits, count - k);
+        length += count - k;
+        buffer[length++] = '.';
+        memcpy(buffer + length, digits + count - k, k);
+        return length + k;
+    }
+    for (int precision = 14; precision <= 16; precision++)
+    {
+        // d.ddd...e[+-]x, the digits are taken as they are (any locale)
+        char scientific[40];
+        snprintf(scientific, sizeof(scientific), "%.*e", precision, value);
+        char digits[20];
+        int count = 0;
+        const char* p = scientific;
+        for (; *p && *p != 'e' && *p != 'E'; p++)
+        {
+            if (*p >= '0' && *p <= '9')
+            {
+                digits[count++] = *p;
+            }
+        }
+        int exponent = *p ? atoi(p + 1) : 0;
+        while (count > 1 && digits[count - 1] == '0')
+        {
+            count--;
+        }
+        // the decimal point follows point digits
+        int point = exponent + 1;
+        length = 0;
+        if (scientific[0] == '-')
+        {
+            buffer[length++] = '-';
+        }
+        if (point <= 0)
+        {
+            buffer[length++] = '0';
+            buffer[length++] = '.';
+            for (int i = point; i < 0; i++)
+            {
+                buffer[length++] = '0';
+            }
+            memcpy(buffer + length, digits, count);
+            length += count;
+        }
+        else if (point >= count)
+        {
+            memcpy(buffer + length, digits, count);
+            length += count;
+            for (int i = count; i < point; i++)
+            {
+                buffer[length++] = '0';
+            }
+        }
+        else
+        {
+            memcpy(buffer + length, digits, point);
+            length += point;
+            buffer[length++] = '.';
+            memcpy(buffer + length, digits + point, count - point);
+            length += count - point;
+        }
+        double check;
+        if (NumberToDouble(buffer, length, check) && check == value)
+        {
+            break;
+        }
+    }
+    return length;
 }
-void CNumber::SetString(const std::string& num)
+// converts a number to a double that is written (see FormatDouble()) with the same decimal
+// value, returns false for other numbers
+static bool NumberToExactDouble(const char* str, size_t length, double& value)
 {
-    m_Number = num;
+    bool exact;
+    if (!NumberToDouble(str, length, value, &exact))
+    {
+        return false;
+    }
+    if (exact || length > 24)
+    {
+        return exact;
+    }
+    // e.g. 17 digits written by another shortest round trip formatter
+    char buffer[NUMBER_TEXT_SIZE];
+    size_t formatted = FormatDouble(value, buffer);
+    return NumbersEqual(buffer, formatted, str, length);
 }
-int CNumber::ValueInt() const
+// NumberToExactDouble() for the text of an integer
+static bool Int64ToExactDouble(int64_t i, double& value)
 {
-    std::stringstream stream(m_Number);
+    char buffer[NUMBER_TEXT_SIZE];
+    size_t length = FormatInt64(i, buffer);
+    return NumberToExactDouble(buffer, length, value);
+}
+// CNumber::ValueInt()
+static int NumberToInt(const char* str, size_t length)
+{
+    int64_t i;
+    if (NumberToInt64(str, length, i))
+    {
+        return i >= INT_MIN && i <= INT_MAX ? (int)i : 0;
+    }
+    std::stringstream stream(std::string(str, length));
     int v;
     stream >> v;
     if (stream.fail())
@@ -489,9 +997,10 @@ int CNumber::ValueInt() const
     }
     return v;
 }
-float CNumber::ValueFloat() const
+// CNumber::ValueFloat()
+static float NumberToFloat(const char* str, size_t length)
 {
-    std::stringstream stream(m_Number);
+    std::stringstream stream(std::string(str, length));
     float v;
     stream >> v;
     if (stream.fail())
@@ -500,1120 +1009,4864 @@ float CNumber::ValueFloat() const
     }
     return v;
 }
-double CNumber::ValueDouble() const
-{
-    std::stringstream stream(m_Number);
-    double v;
-    stream >> v;
-    if (stream.fail())
-    {
-        v = 0.0;
-    }
-    return v;
-}
 
-std::string CNumber::ToString(bool prettyPrint, const std::string& indentation, int level) const
+CEntity::CEntity()
+    : m_Link(0),
+      m_Hash(0)
 {
-    return m_Number;
 }
-
-CEntity* CNumber::Copy() const
+CEntity::CEntity(const CEntity& other)
+    : m_Link(0),
+      m_Hash(other.m_Hash)
 {
-    CNumber* copy = new CNumber();
-    copy->m_Number = m_Number;
-    return copy;
 }
-
-CString::CString()
+CEntity& CEntity::operator=(const CEntity& other)
 {
+    (void)other;
+    InvalidateHash();
+    return *this;
 }
-CString::~CString()
+CEntity::~CEntity()
 {
 }
-void CString::SetString(const char* str)
+uint64_t CEntity::Hash() const
 {
-    m_Value = std::string(str);
+    if (m_Hash == 0)
+    {
+        uint64_t h = ComputeHash();
+        m_Hash = h != 0 ? h : 1;
+    }
+    return m_Hash;
 }
-void CString::SetString(const std::string& str)
+bool CEntity::Equals(const CEntity& other) const
 {
-    m_Value = str;
+    if (this == &other)
+    {
+        return true;
+    }
+    if (typeid(*this) != typeid(other) || Hash() != other.Hash())
+    {
+        return false;
+    }
+    return EqualsSameType(other);
 }
-std::string CString::ToString(bool prettyPrint, const std::string& indentation, int level) const
+void CEntity::InvalidateHash()
 {
-    std::string s;
-    s += "\"";
-    s += EscapeString(m_Value);
-    s += "\"";
-    return s;
+    // a cached hash implies cached hashes of all children, so the parents of an entity without
+    // a cached hash have none either
+    for (CEntity* ent = this; ent && ent->m_Hash != 0; ent = ent->Parent())
+    {
+        ent->m_Hash = 0;
+    }
 }
-CEntity* CString::Copy() const
+void CEntity::Adopt(CEntity* child, bool invalidateHash)
 {
-    CString* copy = new CString();
-    copy->m_Value = m_Value;
-    return copy;
+    if (IsShared())
+    {
+        // a shared entity changes its representation only (see CArray::Unpack()), its children
+        // are immutable as well
+        child->m_Link = 3;
+        return;
+    }
+    child->SetParent(this);
+    if (invalidateHash)
+    {
+        InvalidateHash();
+    }
 }
-
-CArray::CArray()
+void CEntity::Disown(CEntity* child)
 {
+    child->SetParent(NULL);
+    InvalidateHash();
 }
-CArray::~CArray()
+void CEntity::CheckModifiable() const
 {
-    for (size_t i = 0; i < m_Values.size(); i++)
+    if (IsShared())
     {
-        delete m_Values[i];
+        throw CException("shared entities cannot be modified (see CEntity::Deduplicate())");
     }
 }
-
-void CArray::Remove(int index)
+CEntity* CEntity::Unshare(CEntity*& child, CAllocator& allocator)
 {
-    if (index < 0 ||
-        (size_t)index >= m_Values.size())
+    if (!child->IsShared() || IsShared())
     {
-        throw CException("index out of range");
+        return child;
     }
-    CEntity* ent = m_Values[(size_t)index];
-    delete ent;
-    m_Values.erase(m_Values.begin() + index);
+    if (child->References() == 1)
+    {
+        // the last reference: no copy needed (the children stay shared)
+        child->m_Link = (uintptr_t)this;
+        return child;
+    }
+    CEntity* copy = child->ShallowCopy(allocator);
+    copy->m_Link = (uintptr_t)this;
+    copy->m_Hash = child->m_Hash;
+    child->m_Link -= 2;
+    child = copy;
+    return copy;
 }
-
-CArray* CArray::AddArray()
+void CEntity::DeleteChild(CEntity* child)
 {
-    CArray* arr = new CArray();
-    m_Values.push_back(arr);
-    return arr;
+    if (child && child->IsShared() && child->References() > 1)
+    {
+        child->m_Link -= 2;
+    }
+    else
+    {
+        delete child;
+    }
 }
-CObject* CArray::AddObject()
+CEntity* CEntity::Share(CEntity* ent)
 {
-    CObject* arr = new CObject();
-    m_Values.push_back(arr);
-    return arr;
+    ent->m_Link += 2;
+    return ent;
 }
-
-CNumber* CArray::AddInt(int value)
+CEntity* CEntity::Copy() const
 {
-    CNumber* num = new CNumber();
-    num->SetInt(value);
-    m_Values.push_back(num);
-    return num;
+    return Copy(CAllocator::Default());
 }
-CNumber* CArray::AddFloat(float value)
+bool CEntity::IsObject() const
 {
-    CNumber* num = new CNumber();
-    num->SetFloat(value);
-    m_Values.push_back(num);
-    return num;
+    return dynamic_cast<const CObject*>(this) != NULL;
 }
-CNumber* CArray::AddDouble(double value)
+bool CEntity::IsArray() const
 {
-    CNumber* num = new CNumber();
-    num->SetDouble(value);
-    m_Values.push_back(num);
-    return num;
+    return dynamic_cast<const CArray*>(this) != NULL;
 }
-
-CString* CArray::AddString(const char* str)
+bool CEntity::IsString() const
 {
-    CString* s = new CString();
-    s->SetString(str);
-    m_Values.push_back(s);
-    return s;
+    return dynamic_cast<const CString*>(this) != NULL;
 }
-CString* CArray::AddString(const std::string& str)
+bool CEntity::IsNumber() const
 {
-    CString* s = new CString();
-    s->SetString(str);
-    m_Values.push_back(s);
-    return s;
+    return dynamic_cast<const CNumber*>(this) != NULL;
 }
-CBoolean* CArray::AddBool(bool value)
+bool CEntity::IsBoolean() const
 {
-    CBoolean* b = new CBoolean();
-    b->SetBool(value);
-    m_Values.push_back(b);
-    return b;
+    return dynamic_cast<const CBoolean*>(this) != NULL;
 }
-CNull* CArray::AddNull()
+bool CEntity::IsNull() const
 {
-    CNull* n = new CNull();
-    m_Values.push_back(n);
-    return n;
+    return dynamic_cast<const CNull*>(this) != NULL;
 }
-std::string CArray::ToString(bool prettyPrint, const std::string& indentation, int level) const
+const CObject& CEntity::Object() const
 {
-    std::string s;
-    s += "[";
-    for (size_t i = 0; i < m_Values.size(); i++)
+    const CObject* obj = dynamic_cast<const CObject*>(this);
+    if (!obj)
     {
-        if (i != 0)
-        {
-            s += ",";
-        }
-        s += m_Values.at(i)->ToString(prettyPrint, indentation, level+1);
+        throw CException("Object() failed for non CObject entity");
     }
-    s += "]";
-    return s;
+    return *obj;
 }
-const std::string& CArray::GetString(int index, const std::string& defaultValue) const
+CObject& CEntity::Object()
 {
-    if (index < 0 || index >= Count() || !m_Values[(size_t)index] || !m_Values[(size_t)index]->IsString())
+    CObject* obj = dynamic_cast<CObject*>(this);
+    if (!obj)
     {
-        return defaultValue;
+        throw CException("Object() failed for non CObject entity");
     }
-    return static_cast<CString*>(m_Values[index])->Value();
+    return *obj;
 }
-CNumber* CArray::GetNumber(int index) const
+
+const CArray& CEntity::Array() const
 {
-    if (index < 0 || index >= Count() || !m_Values[index] || !m_Values[index]->IsNumber())
+    const CArray* arr = dynamic_cast<const CArray*>(this);
+    if (!arr)
     {
-        return NULL;
+        throw CException("Array() failed for non CArray entity");
     }
-    return static_cast<CNumber*>(m_Values[index]);
+    return *arr;
 }
-int CArray::GetInt(int index, int defaultValue) const
+CArray& CEntity::Array()
 {
-    CNumber* number = GetNumber(index);
-    if (!number)
+    CArray* arr = dynamic_cast<CArray*>(this);
+    if (!arr)
     {
-        return defaultValue;
+        throw CException("Array() failed for non CArray entity");
     }
-    return number->ValueInt();
+    return *arr;
 }
-float CArray::GetFloat(int index, float defaultValue) const
+const CString& CEntity::String() const
 {
-    CNumber* number = GetNumber(index);
-    if (!number)
+    const CString* str = dynamic_cast<const CString*>(this);
+    if (!str)
     {
-        return defaultValue;
+        throw CException("String() failed for non CString entity");
     }
-    return number->ValueFloat();
+    return *str;
 }
-double CArray::GetDouble(int index, double defaultValue) const
+CString& CEntity::String()
 {
-    CNumber* number = GetNumber(index);
+    CString* str = dynamic_cast<CString*>(this);
+    if (!str)
+    {
+        throw CException("String() failed for non CString entity");
+    }
+    return *str;
+}
+const CNumber& CEntity::Number() const
+{
+    const CNumber* number = dynamic_cast<const CNumber*>(this);
     if (!number)
     {
-        return defaultValue;
+        throw CException("Number() failed for non CNumber entity");
     }
-    return number->ValueDouble();
+    return *number;
 }
-CArray* CArray::GetArray(int index) const
+CNumber& CEntity::Number()
 {
-    if (index < 0 || index >= Count())
+    CNumber* number = dynamic_cast<CNumber*>(this);
+    if (!number)
     {
-        return NULL;
+        throw CException("Number() failed for non CNumber entity");
     }
-    CEntity* e = m_Values[index];
-    if (e && e->IsArray())
+    return *number;
+}
+
+const CBoolean& CEntity::Boolean() const
+{
+    const CBoolean* boolean = dynamic_cast<const CBoolean*>(this);
+    if (!boolean)
     {
-        return static_cast<CArray*>(e);
+        throw CException("Boolean() failed for non CBoolean entity");
     }
-    return NULL;
+    return *boolean;
 }
-CObject* CArray::GetObject(int index) const
+CBoolean& CEntity::Boolean()
 {
-    if (index < 0 || index >= Count())
+    CBoolean* boolean = dynamic_cast<CBoolean*>(this);
+    if (!boolean)
     {
-        return NULL;
+        throw CException("Boolean() failed for non CBoolean entity");
     }
-    CEntity* e = m_Values[index];
-    if (e && e->IsObject())
+    return *boolean;
+}
+const CNull& CEntity::Null() const
+{
+    const CNull* null = dynamic_cast<const CNull*>(this);
+    if (!null)
     {
-        return static_cast<CObject*>(e);
+        throw CException("Null() failed for non CNull entity");
     }
-    return NULL;
+    return *null;
 }
-CBoolean* CArray::GetBoolean(int index) const
+CNull& CEntity::Null()
 {
-    if (index < 0 || index >= Count())
+    CNull* null = dynamic_cast<CNull*>(this);
+    if (!null)
     {
-        return NULL;
+        throw CException("Null() failed for non CNull entity");
     }
-    CEntity* e = m_Values[index];
-    if (e && e->IsBoolean())
+    return *null;
+}
+const std::string& CEntity::ObjectMemberNameByIndex(int index) const
+{
+    if (!IsObject())
     {
-        return static_cast<CBoolean*>(e);
+        throw CException("ObjectMemberNameByIndex() is only allowed for objects");
     }
-    return NULL;
+    return Object().MemberNameByIndex(index);
 }
-bool CArray::GetBool(int index, bool defaultValue) const
+
+int CEntity::Count() const
 {
-    CBoolean* b = GetBoolean(index);
-    if (!b)
+    throw CException("Count is not applicable for this type");
+}
+const std::string& CEntity::StringValue() const
+{
+    if (!IsString())
     {
-        return defaultValue;
+        throw CException("Called StringValue for non string entity");
     }
-    return b->Value();
+    return String().Value();
 }
-CNull* CArray::GetNull(int index) const
+int CEntity::IntValue() const
+{
+    return atoi(Number().Value().c_str());
+}
+float CEntity::FloatValue() const
+{
+    return (float)DoubleValue();
+}
+double CEntity::DoubleValue() const
+{
+    return atof(Number().Value().c_str());
+}
+bool CEntity::BoolValue() const
+{
+    return Boolean().Value();
+}
+
+const CEntity& CEntity::operator[] (int idx) const
 {
-    if (index < 0 || index >= Count())
+    if (IsArray())
     {
-        return NULL;
+        return Array().EntityAtIndex(idx);
     }
-    CEntity* e = m_Values[index];
-    if (e && e->IsNull())
+    else if (IsObject())
     {
-        return static_cast<CNull*>(e);
+        return Object().EntityAtIndex(idx);
+    }
+    else
+    {
+        throw CException("operator[](int) is only allowed for arrays and objects");
     }
-    return NULL;
 }
-CEntity& CArray::EntityAtIndex(int index)
+const CEntity& CEntity::operator[] (const char* key) const
 {
-    if (index < 0 || (size_t)index >= m_Values.size())
+    if (!IsObject())
     {
-        // TODO: specialized CIndexOutOfBoundsException?
-        throw CException("index %d out of bounds for EntityAtIndex()", index);
+        throw CException("operator[](key) is only allowed for objects");
     }
-    return *m_Values[index];
+    const CEntity* ent = Object().GetEntity(key);
+    if (!ent)
+    {
+        // TODO: specialized CKeyNotFoundException? (provide key as argument)
+        throw CException("key '%s' not found in operator[]", key);
+    }
+    return *ent;
 }
-const CEntity& CArray::EntityAtIndex(int index) const
+const CEntity& CEntity::operator[] (const std::string& key) const
 {
-    if (index < 0 || (size_t)index >= m_Values.size())
+    if (!IsObject())
     {
-        // TODO: specialized CIndexOutOfBoundsException?
-        throw CException("index %d out of bounds for EntityAtIndex()", index);
+        throw CException("operator[](key) is only allowed for objects");
     }
-    return *m_Values[index];
+    const CEntity* ent = Object().GetEntity(key);
+    if (!ent)
+    {
+        // TODO: specialized CKeyNotFoundException? (provide key as argument)
+        throw CException("key '%s' not found in operator[]", key.c_str());
+    }
+    return *ent;
 }
 
-CEntity* CArray::Copy() const
+CEntity& CEntity::operator[] (int idx)
 {
-    CArray* copy = new CArray();
-    copy->m_Values.resize(m_Values.size());
-    for (std::size_t i = 0; i < m_Values.size(); i++)
+    if (IsArray())
+    {
+        return Array().EntityAtIndex(idx);
+    }
+    else if (IsObject())
     {
-        CEntity* e = m_Values[i]->Copy();
-        copy->m_Values[i] = e;
+        return Object().EntityAtIndex(idx);
     }
-    return copy;
+    else
+    {
+        throw CException("operator[](int) is only allowed for arrays and objects");
+    }
+}
+CEntity& CEntity::operator[] (const char* key)
+{
+    if (!IsObject())
+    {
+        throw CException("operator[](key) is only allowed for objects");
+    }
+    CEntity* ent = Object().MutableEntity(key);
+    if (!ent)
+    {
+        // TODO: specialized CKeyNotFoundException? (provide key as argument)
+        throw CException("key '%s' not found in operator[]", key);
+    }
+    return *ent;
+}
+CEntity& CEntity::operator[] (const std::string& key)
+{
+    if (!IsObject())
+    {
+        throw CException("operator[](key) is only allowed for objects");
+    }
+    CEntity* ent = Object().MutableEntity(key);
+    if (!ent)
+    {
+        // TODO: specialized CKeyNotFoundException? (provide key as argument)
+        throw CException("key '%s' not found in operator[]", key.c_str());
+    }
+    return *ent;
 }
 
+CNumber::CNumber()
+{
+}
+CNumber::~CNumber()
+{
+}
 
-CObject::CObject()
+void CNumber::SetInt(int i)
 {
+    CheckModifiable();
+    char buf[256];
+#ifndef _WIN32
+    snprintf(buf, 255, "%d", i);
+#else // !_WIN32
+    sprintf_s(buf, 255, "%d", i);
+#endif // !_WIN32
+    buf[255] = 0;
+    m_Number = buf;
+    InvalidateHash();
 }
-CObject::~CObject()
+void CNumber::SetFloat(float f)
 {
-    std::map<std::string, CEntity*>::iterator it;
-    for (it = m_Values.begin(); it != m_Values.end(); ++it)
+    CheckModifiable();
+    char buf[256];
+#ifndef _WIN32
+    snprintf(buf, 255, "%f", f);
+#else // !_WIN32
+    sprintf_s(buf, 255, "%f", f);
+#endif // !_WIN32
+    buf[255] = 0;
+    m_Number = buf;
+    InvalidateHash();
+}
+void CNumber::SetDouble(double d)
+{
+    CheckModifiable();
+    char buf[256];
+#ifndef _WIN32
+    snprintf(buf, 255, "%f", d);
+#else // !_WIN32
+    sprintf_s(buf, 255, "%f", d);
+#endif // !_WIN32
+    buf[255] = 0;
+    m_Number = buf;
+    InvalidateHash();
+}
+void CNumber::SetString(const std::string& num)
+{
+    CheckModifiable();
+    m_Number = num;
+    InvalidateHash();
+}
+int CNumber::ValueInt() const
+{
+    return NumberToInt(m_Number.data(), m_Number.size());
+}
+float CNumber::ValueFloat() const
+{
+    return NumberToFloat(m_Number.data(), m_Number.size());
+}
+double CNumber::ValueDouble() const
+{
+    double v;
+    if (NumberToDouble(m_Number.data(), m_Number.size(), v))
+    {
+        return v;
+    }
+    // not a number (e.g. set by SetString()), the leading number if any
+    std::stringstream stream(m_Number);
+    stream >> v;
+    if (stream.fail())
+    {
+        v = 0.0;
+    }
+    return v;
+}
+
+std::string CNumber::ToString(bool prettyPrint, const std::string& indentation, int level) const
+{
+    return m_Number;
+}
+
+CEntity* CNumber::Copy(CAllocator& allocator) const
+{
+    CNumber* copy = NewEntity<CNumber>(allocator);
+    copy->m_Number = m_Number;
+    return copy;
+}
+void CNumber::Accept(CHandler& handler) const
+{
+    handler.Number(m_Number.data(), m_Number.size());
+}
+uint64_t CNumber::ComputeHash() const
+{
+    return HashNumber(m_Number.data(), m_Number.size());
+}
+bool CNumber::EqualsSameType(const CEntity& other) const
+{
+    const std::string& num = static_cast<const CNumber&>(other).m_Number;
+    return NumbersEqual(m_Number.data(), m_Number.size(), num.data(), num.size());
+}
+
+CString::CString()
+{
+}
+CString::~CString()
+{
+}
+void CString::SetString(const char* str)
+{
+    CheckModifiable();
+    m_Value = std::string(str);
+    InvalidateHash();
+}
+void CString::SetString(const std::string& str)
+{
+    CheckModifiable();
+    m_Value = str;
+    InvalidateHash();
+}
+std::string CString::ToString(bool prettyPrint, const std::string& indentation, int level) const
+{
+    std::string s;
+    s += "\"";
+    s += EscapeString(m_Value);
+    s += "\"";
+    return s;
+}
+CEntity* CString::Copy(CAllocator& allocator) const
+{
+    CString* copy = NewEntity<CString>(allocator);
+    copy->m_Value = m_Value;
+    return copy;
+}
+void CString::Accept(CHandler& handler) const
+{
+    handler.String(m_Value.data(), m_Value.size());
+}
+uint64_t CString::ComputeHash() const
+{
+    return MixHash(HashBytes(m_Value.data(), m_Value.size()) + HASH_STRING);
+}
+bool CString::EqualsSameType(const CEntity& other) const
+{
+    return m_Value == static_cast<const CString&>(other).m_Value;
+}
+
+CArray::CArray()
+    : m_Packed(NULL)
+{
+}
+CArray::CArray(CAllocator& allocator)
+    : m_Values(CStlAllocator<CEntity*>(allocator)),
+      m_Packed(NULL)
+{
+}
+CArray* CArray::Create(CAllocator& allocator)
+{
+    return NewContainer<CArray>(allocator);
+}
+CArray::~CArray()
+{
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        DeleteChild(m_Values[i]);
+    }
+    FreePacked();
+}
+
+void CArray::Remove(int index)
+{
+    CheckModifiable();
+    Unpack();
+    if (index < 0 ||
+        (size_t)index >= m_Values.size())
+    {
+        throw CException("index out of range");
+    }
+    CEntity* ent = m_Values[(size_t)index];
+    DeleteChild(ent);
+    m_Values.erase(m_Values.begin() + index);
+    InvalidateHash();
+}
+void CArray::Insert(int index, CEntity* ent)
+{
+    CheckModifiable();
+    Unpack();
+    if (index < 0 ||
+        (size_t)index > m_Values.size())
+    {
+        throw CException("index out of range");
+    }
+    m_Values.insert(m_Values.begin() + index, ent);
+    Adopt(ent);
+}
+CEntity* CArray::Detach(int index)
+{
+    CheckModifiable();
+    Unpack();
+    if (index < 0 ||
+        (size_t)index >= m_Values.size())
+    {
+        throw CException("index out of range");
+    }
+    CEntity* ent = Unshare(m_Values[(size_t)index], Allocator());
+    m_Values.erase(m_Values.begin() + index);
+    Disown(ent);
+    return ent;
+}
+
+CArray* CArray::AddArray()
+{
+    CheckModifiable();
+    Unpack();
+    CArray* arr = NewContainer<CArray>(Allocator());
+    m_Values.push_back(arr);
+    Adopt(arr);
+    return arr;
+}
+CObject* CArray::AddObject()
+{
+    CheckModifiable();
+    Unpack();
+    CObject* arr = NewContainer<CObject>(Allocator());
+    m_Values.push_back(arr);
+    Adopt(arr);
+    return arr;
+}
+
+CNumber* CArray::AddInt(int value)
+{
+    CheckModifiable();
+    Unpack();
+    CNumber* num = NewEntity<CNumber>(Allocator());
+    num->SetInt(value);
+    m_Values.push_back(num);
+    Adopt(num);
+    return num;
+}
+CNumber* CArray::AddFloat(float value)
+{
+    CheckModifiable();
+    Unpack();
+    CNumber* num = NewEntity<CNumber>(Allocator());
+    num->SetFloat(value);
+    m_Values.push_back(num);
+    Adopt(num);
+    return num;
+}
+CNumber* CArray::AddDouble(double value)
+{
+    CheckModifiable();
+    Unpack();
+    CNumber* num = NewEntity<CNumber>(Allocator());
+    num->SetDouble(value);
+    m_Values.push_back(num);
+    Adopt(num);
+    return num;
+}
+
+CString* CArray::AddString(const char* str)
+{
+    CheckModifiable();
+    Unpack();
+    CString* s = NewEntity<CString>(Allocator());
+    s->SetString(str);
+    m_Values.push_back(s);
+    Adopt(s);
+    return s;
+}
+CString* CArray::AddString(const std::string& str)
+{
+    CheckModifiable();
+    Unpack();
+    CString* s = NewEntity<CString>(Allocator());
+    s->SetString(str);
+    m_Values.push_back(s);
+    Adopt(s);
+    return s;
+}
+CBoolean* CArray::AddBool(bool value)
+{
+    CheckModifiable();
+    Unpack();
+    CBoolean* b = NewEntity<CBoolean>(Allocator());
+    b->SetBool(value);
+    m_Values.push_back(b);
+    Adopt(b);
+    return b;
+}
+CNull* CArray::AddNull()
+{
+    CheckModifiable();
+    Unpack();
+    CNull* n = NewEntity<CNull>(Allocator());
+    m_Values.push_back(n);
+    Adopt(n);
+    return n;
+}
+std::string CArray::ToString(bool prettyPrint, const std::string& indentation, int level) const
+{
+    std::string s;
+    s += "[";
+    if (m_Packed)
+    {
+        char buffer[NUMBER_TEXT_SIZE];
+        for (int i = 0; i < m_Packed->m_Count; i++)
+        {
+            if (i != 0)
+            {
+                s += ",";
+            }
+            const char* text;
+            size_t length;
+            NumberText(i, buffer, text, length);
+            s.append(text, length);
+        }
+    }
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        if (i != 0)
+        {
+            s += ",";
+        }
+        s += m_Values.at(i)->ToString(prettyPrint, indentation, level+1);
+    }
+    s += "]";
+    return s;
+}
+const std::string& CArray::GetString(int index, const std::string& defaultValue) const
+{
+    if (index < 0 || (size_t)index >= m_Values.size() || !m_Values[(size_t)index] || !m_Values[(size_t)index]->IsString())
+    {
+        return defaultValue;
+    }
+    return static_cast<CString*>(m_Values[index])->Value();
+}
+CNumber* CArray::GetNumber(int index) const
+{
+    const_cast<CArray*>(this)->Unpack();
+    if (index < 0 || index >= Count() || !m_Values[index] || !m_Values[index]->IsNumber())
+    {
+        return NULL;
+    }
+    return static_cast<CNumber*>(m_Values[index]);
+}
+int CArray::GetInt(int index, int defaultValue) const
+{
+    if (m_Packed)
+    {
+        if (index < 0 || index >= m_Packed->m_Count)
+        {
+            return defaultValue;
+        }
+        char buffer[NUMBER_TEXT_SIZE];
+        const char* text;
+        size_t length;
+        NumberText(index, buffer, text, length);
+        return NumberToInt(text, length);
+    }
+    CNumber* number = GetNumber(index);
+    if (!number)
+    {
+        return defaultValue;
+    }
+    return number->ValueInt();
+}
+float CArray::GetFloat(int index, float defaultValue) const
+{
+    if (m_Packed)
+    {
+        if (index < 0 || index >= m_Packed->m_Count)
+        {
+            return defaultValue;
+        }
+        if (m_Packed->m_Type == PACKED_INT64)
+        {
+            return (float)m_Packed->m_Int64s[index];
+        }
+        char buffer[NUMBER_TEXT_SIZE];
+        const char* text;
+        size_t length;
+        NumberText(index, buffer, text, length);
+        return NumberToFloat(text, length);
+    }
+    CNumber* number = GetNumber(index);
+    if (!number)
+    {
+        return defaultValue;
+    }
+    return number->ValueFloat();
+}
+double CArray::GetDouble(int index, double defaultValue) const
+{
+    if (m_Packed)
+    {
+        if (index < 0 || index >= m_Packed->m_Count)
+        {
+            return defaultValue;
+        }
+        return m_Packed->m_Type == PACKED_INT64 ? (double)m_Packed->m_Int64s[index] : m_Packed->m_Doubles[index];
+    }
+    CNumber* number = GetNumber(index);
+    if (!number)
+    {
+        return defaultValue;
+    }
+    return number->ValueDouble();
+}
+CArray* CArray::GetArray(int index) const
+{
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        return NULL;
+    }
+    CEntity* e = m_Values[index];
+    if (e && e->IsArray())
+    {
+        return static_cast<CArray*>(e);
+    }
+    return NULL;
+}
+CObject* CArray::GetObject(int index) const
+{
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        return NULL;
+    }
+    CEntity* e = m_Values[index];
+    if (e && e->IsObject())
+    {
+        return static_cast<CObject*>(e);
+    }
+    return NULL;
+}
+CBoolean* CArray::GetBoolean(int index) const
+{
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        return NULL;
+    }
+    CEntity* e = m_Values[index];
+    if (e && e->IsBoolean())
+    {
+        return static_cast<CBoolean*>(e);
+    }
+    return NULL;
+}
+bool CArray::GetBool(int index, bool defaultValue) const
+{
+    CBoolean* b = GetBoolean(index);
+    if (!b)
+    {
+        return defaultValue;
+    }
+    return b->Value();
+}
+CNull* CArray::GetNull(int index) const
+{
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        return NULL;
+    }
+    CEntity* e = m_Values[index];
+    if (e && e->IsNull())
+    {
+        return static_cast<CNull*>(e);
+    }
+    return NULL;
+}
+CEntity& CArray::EntityAtIndex(int index)
+{
+    Unpack();
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        // TODO: specialized CIndexOutOfBoundsException?
+        throw CException("index %d out of bounds for EntityAtIndex()", index);
+    }
+    return *Unshare(m_Values[index], Allocator());
+}
+const CEntity& CArray::EntityAtIndex(int index) const
+{
+    const_cast<CArray*>(this)->Unpack();
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        // TODO: specialized CIndexOutOfBoundsException?
+        throw CException("index %d out of bounds for EntityAtIndex()", index);
+    }
+    return *m_Values[index];
+}
+
+CEntity* CArray::Copy(CAllocator& allocator) const
+{
+    CArray* copy = NewContainer<CArray>(allocator);
+    try
+    {
+        if (m_Packed)
+        {
+            copy->AllocatePacked(m_Packed->m_Type, m_Packed->m_Count);
+            memcpy(copy->m_Packed->m_Int64s, m_Packed->m_Int64s, m_Packed->m_Count * sizeof(int64_t));
+        }
+        copy->m_Values.reserve(m_Values.size());
+        for (std::size_t i = 0; i < m_Values.size(); i++)
+        {
+            copy->m_Values.push_back(m_Values[i]->Copy(allocator));
+            copy->Adopt(copy->m_Values.back());
+        }
+    }
+    catch (...)
+    {
+        delete copy;
+        throw;
+    }
+    return copy;
+}
+CEntity* CArray::ShallowCopy(CAllocator& allocator) const
+{
+    // the elements of a shared array are shared
+    CArray* copy = NewContainer<CArray>(allocator);
+    try
+    {
+        if (m_Packed)
+        {
+            copy->AllocatePacked(m_Packed->m_Type, m_Packed->m_Count);
+            memcpy(copy->m_Packed->m_Int64s, m_Packed->m_Int64s, m_Packed->m_Count * sizeof(int64_t));
+        }
+        copy->m_Values.reserve(m_Values.size());
+    }
+    catch (...)
+    {
+        delete copy;
+        throw;
+    }
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        copy->m_Values.push_back(Share(m_Values[i]));
+    }
+    return copy;
+}
+void CArray::Accept(CHandler& handler) const
+{
+    handler.StartArray(Count());
+    if (m_Packed)
+    {
+        // formatted in chunks, one Numbers() call for many elements
+        char chunk[4096];
+        size_t used = 0;
+        int count = 0;
+        for (int i = 0; i < m_Packed->m_Count; i++)
+        {
+            if (used + 1 + NUMBER_TEXT_SIZE > sizeof(chunk))
+            {
+                handler.Numbers(chunk, used, count);
+                used = 0;
+                count = 0;
+            }
+            if (count > 0)
+            {
+                chunk[used++] = ',';
+            }
+            const char* text;
+            size_t length;
+            NumberText(i, chunk + used, text, length);
+            used += length;
+            count++;
+        }
+        if (count > 0)
+        {
+            handler.Numbers(chunk, used, count);
+        }
+    }
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        m_Values[i]->Accept(handler);
+    }
+    handler.EndArray();
+}
+uint64_t CArray::ComputeHash() const
+{
+    uint64_t h = MixHash(HASH_ARRAY);
+    if (m_Packed)
+    {
+        // the hashes the CNumber elements would have
+        char buffer[NUMBER_TEXT_SIZE];
+        for (int i = 0; i < m_Packed->m_Count; i++)
+        {
+            const char* text;
+            size_t length;
+            NumberText(i, buffer, text, length);
+            uint64_t element = HashNumber(text, length);
+            h = MixHash(h ^ (element != 0 ? element : 1));
+        }
+    }
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        h = MixHash(h ^ m_Values[i]->Hash());
+    }
+    return MixHash(h ^ (size_t)Count());
+}
+bool CArray::EqualsSameType(const CEntity& other) const
+{
+    const CArray& arr = static_cast<const CArray&>(other);
+    if (m_Packed || arr.m_Packed)
+    {
+        if (Count() != arr.Count())
+        {
+            return false;
+        }
+        if (PackedType() == arr.PackedType())
+        {
+            for (int i = 0; i < m_Packed->m_Count; i++)
+            {
+                if (m_Packed->m_Type == PACKED_INT64 ? m_Packed->m_Int64s[i] != arr.m_Packed->m_Int64s[i] : m_Packed->m_Doubles[i] != arr.m_Packed->m_Doubles[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        char buffer[NUMBER_TEXT_SIZE];
+        char otherBuffer[NUMBER_TEXT_SIZE];
+        for (int i = 0; i < Count(); i++)
+        {
+            const char* text;
+            size_t length;
+            const char* otherText;
+            size_t otherLength;
+            if (!NumberText(i, buffer, text, length) || !arr.NumberText(i, otherBuffer, otherText, otherLength) || !NumbersEqual(text, length, otherText, otherLength))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    const TValueVector& values = arr.m_Values;
+    if (m_Values.size() != values.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        if (!m_Values[i]->Equals(*values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CArray::Pack()
+{
+    if (m_Packed)
+    {
+        return true;
+    }
+    CheckModifiable();
+    if (m_Values.empty())
+    {
+        return false;
+    }
+    int count = (int)m_Values.size();
+    EPackedType type = PACKED_INT64;
+    for (int i = 0; i < count; i++)
+    {
+        const char* text;
+        size_t length;
+        int64_t i64;
+        double d;
+        if (!NumberText(i, NULL, text, length))
+        {
+            return false;
+        }
+        if (type == PACKED_INT64 && NumberToInt64(text, length, i64))
+        {
+            continue;
+        }
+        if (!NumberToExactDouble(text, length, d))
+        {
+            return false;
+        }
+        if (type == PACKED_INT64)
+        {
+            // the integers before must not change as doubles either
+            for (int j = 0; j < i; j++)
+            {
+                NumberText(j, NULL, text, length);
+                if (!NumberToExactDouble(text, length, d))
+                {
+                    return false;
+                }
+            }
+            type = PACKED_DOUBLE;
+        }
+    }
+    TValueVector values(m_Values.get_allocator());
+    values.swap(m_Values);
+    try
+    {
+        AllocatePacked(type, count);
+    }
+    catch (...)
+    {
+        values.swap(m_Values);
+        throw;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        const std::string& num = static_cast<const CNumber*>(values[i])->Value();
+        if (type == PACKED_INT64)
+        {
+            NumberToInt64(num.data(), num.size(), m_Packed->m_Int64s[i]);
+        }
+        else
+        {
+            NumberToDouble(num.data(), num.size(), m_Packed->m_Doubles[i]);
+        }
+        DeleteChild(values[i]);
+    }
+    InvalidateHash();
+    return true;
+}
+void CArray::Unpack()
+{
+    if (!m_Packed)
+    {
+        return;
+    }
+    TValueVector values(m_Values.get_allocator());
+    values.reserve(m_Packed->m_Count);
+    try
+    {
+        char buffer[NUMBER_TEXT_SIZE];
+        for (int i = 0; i < m_Packed->m_Count; i++)
+        {
+            const char* text;
+            size_t length;
+            NumberText(i, buffer, text, length);
+            CNumber* num = NewEntity<CNumber>(Allocator());
+            values.push_back(num);
+            num->SetString(std::string(text, length));
+        }
+    }
+    catch (...)
+    {
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            delete values[i];
+        }
+        throw;
+    }
+    FreePacked();
+    m_Values.swap(values);
+    // the value does not change, i.e. the cached hash is kept
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        Adopt(m_Values[i], false);
+    }
+}
+void CArray::AssignInt64s(const int64_t* values, int count)
+{
+    CheckModifiable();
+    CArray packed(Allocator());
+    if (count > 0)
+    {
+        packed.AllocatePacked(PACKED_INT64, count);
+        memcpy(packed.m_Packed->m_Int64s, values, count * sizeof(int64_t));
+    }
+    // the previous elements are deleted with packed
+    std::swap(m_Packed, packed.m_Packed);
+    m_Values.swap(packed.m_Values);
+    InvalidateHash();
+}
+void CArray::AssignDoubles(const double* values, int count)
+{
+    CheckModifiable();
+    CArray packed(Allocator());
+    if (count > 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            // (also false for NaN)
+            if (!(values[i] >= -DBL_MAX && values[i] <= DBL_MAX))
+            {
+                throw CException("AssignDoubles(): value %d is not finite", i);
+            }
+        }
+        packed.AllocatePacked(PACKED_DOUBLE, count);
+        memcpy(packed.m_Packed->m_Doubles, values, count * sizeof(double));
+    }
+    // the previous elements are deleted with packed
+    std::swap(m_Packed, packed.m_Packed);
+    m_Values.swap(packed.m_Values);
+    InvalidateHash();
+}
+bool CArray::CopyTo(double* values) const
+{
+    if (m_Packed)
+    {
+        if (m_Packed->m_Type == PACKED_DOUBLE)
+        {
+            memcpy(values, m_Packed->m_Doubles, m_Packed->m_Count * sizeof(double));
+        }
+        else
+        {
+            // (vectorized by the compiler)
+            const int64_t* int64s = m_Packed->m_Int64s;
+            for (int i = 0; i < m_Packed->m_Count; i++)
+            {
+                values[i] = (double)int64s[i];
+            }
+        }
+        return true;
+    }
+    for (size_t i = 0; i < m_Values.size(); i++)
+    {
+        const char* text;
+        size_t length;
+        if (!NumberText((int)i, NULL, text, length))
+        {
+            return false;
+        }
+        if (!NumberToDouble(text, length, values[i]))
+        {
+            values[i] = static_cast<const CNumber*>(m_Values[i])->ValueDouble();
+        }
+    }
+    return true;
+}
+bool CArray::CopyTo(int64_t* values) const
+{
+    if (PackedType() == PACKED_INT64)
+    {
+        memcpy(values, m_Packed->m_Int64s, m_Packed->m_Count * sizeof(int64_t));
+        return true;
+    }
+    for (int i = 0; i < Count(); i++)
+    {
+        double d;
+        if (m_Packed)
+        {
+            d = m_Packed->m_Doubles[i];
+        }
+        else
+        {
+            const char* text;
+            size_t length;
+            if (!NumberText(i, NULL, text, length))
+            {
+                return false;
+            }
+            if (NumberToInt64(text, length, values[i]))
+            {
+                continue;
+            }
+            if (!NumberToDouble(text, length, d))
+            {
+                return false;
+            }
+        }
+        if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || (double)(int64_t)d != d)
+        {
+            return false;
+        }
+        values[i] = (int64_t)d;
+    }
+    return true;
+}
+void CArray::AllocatePacked(EPackedType type, int count)
+{
+    m_Packed = (SPacked*)Allocator().Allocate(offsetof(SPacked, m_Int64s) + count * sizeof(int64_t));
+    m_Packed->m_Type = type;
+    m_Packed->m_Count = count;
+}
+void CArray::FreePacked()
+{
+    if (m_Packed)
+    {
+        Allocator().Free(m_Packed, offsetof(SPacked, m_Int64s) + m_Packed->m_Count * sizeof(int64_t));
+        m_Packed = NULL;
+    }
+}
+bool CArray::NumberText(int index, char* buffer, const char*& text, size_t& length) const
+{
+    if (m_Packed)
+    {
+        text = buffer;
+        length = m_Packed->m_Type == PACKED_INT64 ? FormatInt64(m_Packed->m_Int64s[index], buffer) : FormatDouble(m_Packed->m_Doubles[index], buffer);
+        return true;
+    }
+    const CEntity* ent = m_Values[index];
+    if (!ent->IsNumber())
+    {
+        return false;
+    }
+    const std::string& num = static_cast<const CNumber*>(ent)->Value();
+    text = num.data();
+    length = num.size();
+    return true;
+}
+const CEntity& CArray::CConstIterator::PackedElement() const
+{
+    if (m_Stashed != m_Index)
+    {
+        char buffer[NUMBER_TEXT_SIZE];
+        const char* text;
+        size_t length;
+        m_Array->NumberText(m_Index, buffer, text, length);
+        m_Number.m_Number.assign(text, length);
+        m_Number.InvalidateHash();
+        m_Stashed = m_Index;
+    }
+    return m_Number;
+}
+
+
+CObject::CObject()
+{
+}
+CObject::CObject(CAllocator& allocator)
+    : m_Values(std::less<std::string>(), CStlAllocator<TValueMap::value_type>(allocator)),
+      m_MemberNameByIndex(CStlAllocator<std::string>(allocator))
+{
+}
+CObject* CObject::Create(CAllocator& allocator)
+{
+    return NewContainer<CObject>(allocator);
+}
+CObject::~CObject()
+{
+    TValueMap::iterator it;
+    for (it = m_Values.begin(); it != m_Values.end(); ++it)
+    {
+        DeleteChild(it->second);
+    }
+}
+bool CObject::Contains(const char* name) const
+{
+    std::string s(name);
+    return m_Values.find(s) != m_Values.end();
+}
+CArray* CObject::AddArray(const char* name)
+{
+    CheckModifiable();
+    if (Contains(name))
+    {
+        return NULL;
+    }
+    CArray* arr = NewContainer<CArray>(Allocator());
+    m_Values[std::string(name)] = arr;
+    m_MemberNameByIndex.push_back(std::string(name));
+    Adopt(arr);
+    return arr;
+}
+CObject* CObject::AddObject(const char* name)
+{
+    CheckModifiable();
+    if (Contains(name))
+    {
+        return NULL;
+    }
+    CObject* obj = NewContainer<CObject>(Allocator());
+    m_Values[std::string(name)] = obj;
+    m_MemberNameByIndex.push_back(std::string(name));
+    Adopt(obj);
+    return obj;
+}
+CNumber* CObject::AddNumber(const char* name)
+{
+    CheckModifiable();
+    if (Contains(name))
+    {
+        return NULL;
+    }
+    CNumber* num = NewEntity<CNumber>(Allocator());
+    m_Values[std::string(name)] = num;
+    m_MemberNameByIndex.push_back(std::string(name));
+    Adopt(num);
+    return num;
+}
+
+CNumber* CObject::AddInt(const char* name, int i)
+{
+    CheckModifiable();
+    CNumber* num = AddNumber(name);
+    if (num)
+    {
+        num->SetInt(i);
+    }
+    return num;
+}
+CNumber* CObject::AddFloat(const char* name, float f)
+{
+    CheckModifiable();
+    CNumber* num = AddNumber(name);
+    if (num)
+    {
+        num->SetFloat(f);
+    }
+    return num;
+}
+CNumber* CObject::AddDouble(const char* name, double d)
+{
+    CheckModifiable();
+    CNumber* num = AddNumber(name);
+    if (num)
+    {
+        num->SetDouble(d);
+    }
+    return num;
+}
+CString* CObject::AddString(const char* name, const char* value)
+{
+    CheckModifiable();
+    if (Contains(name))
+    {
+        return NULL;
+    }
+    CString* s = NewEntity<CString>(Allocator());
+    if (value != NULL)
+    {
+        s->SetString(value);
+    }
+    m_Values[std::string(name)] = s;
+    m_MemberNameByIndex.push_back(std::string(name));
+    Adopt(s);
+    return s;
+}
+CBoolean* CObject::AddBoolean(const char* name, bool b)
+{
+    CheckModifiable();
+    if (Contains(name))
+    {
+        return NULL;
+    }
+    CBoolean* boolean = NewEntity<CBoolean>(Allocator());
+    boolean->SetBool(b);
+    m_Values[std::string(name)] = boolean;
+    m_MemberNameByIndex.push_back(std::string(name));
+    Adopt(boolean);
+    return boolean;
+}
+CNull* CObject::AddNull(const char* name)
+{
+    CheckModifiable();
+    if (Contains(name))
+    {
+        return NULL;
+    }
+    CNull* null = NewEntity<CNull>(Allocator());
+    m_Values[std::string(name)] = null;
+    m_MemberNameByIndex.push_back(std::string(name));
+    Adopt(null);
+    return null;
+}
+CNumber* CObject::SetInt(const char* name, int i)
+{
+    CheckModifiable();
+    CEntity* ent = MutableEntity(name);
+    if (!ent)
+    {
+        return AddInt(name, i);
+    }
+    if (!ent->IsNumber())
+    {
+        Remove(name);
+        return AddInt(name, i);
+    }
+    ent->Number().SetInt(i);
+    return &ent->Number();
+}
+CNumber* CObject::SetFloat(const char* name, float f)
+{
+    CheckModifiable();
+    CEntity* ent = MutableEntity(name);
+    if (!ent)
+    {
+        return AddFloat(name, f);
+    }
+    if (!ent->IsNumber())
+    {
+        Remove(name);
+        return AddFloat(name, f);
+    }
+    ent->Number().SetFloat(f);
+    return &ent->Number();
+}
+CNumber* CObject::SetDouble(const char* name, double d)
+{
+    CheckModifiable();
+    CEntity* ent = MutableEntity(name);
+    if (!ent)
+    {
+        return AddDouble(name, d);
+    }
+    if (!ent->IsNumber())
+    {
+        Remove(name);
+        return AddDouble(name, d);
+    }
+    ent->Number().SetDouble(d);
+    return &ent->Number();
+}
+CString* CObject::SetString(const char* name, const char* value)
+{
+    CheckModifiable();
+    CEntity* ent = MutableEntity(name);
+    if (!ent)
+    {
+        return AddString(name, value);
+    }
+    if (!ent->IsString())
+    {
+        Remove(name);
+        return AddString(name, value);
+    }
+    ent->String().SetString(value);
+    return &ent->String();
+}
+
+CBoolean* CObject::SetBoolean(const char* name, bool b)
+{
+    CheckModifiable();
+    CEntity* ent = MutableEntity(name);
+    if (!ent)
+    {
+        return AddBoolean(name, b);
+    }
+    if (!ent->IsBoolean())
+    {
+        Remove(name);
+        return AddBoolean(name, b);
+    }
+    ent->Boolean().SetBool(b);
+    return &ent->Boolean();
+}
+const std::string& CObject::MemberNameByIndex(int index) const
+{
+    if (index < 0 || (size_t)index >= m_Values.size())
+    {
+        // TODO: specialized CIndexOutOfBoundsException?
+        throw CException("index %d out of bounds for MemberNameByIndex()", index);
+    }
+    return m_MemberNameByIndex[index];
+}
+CEntity& CObject::EntityAtIndex(int idx)
+{
+    if (idx < 0 || (size_t)idx >= m_MemberNameByIndex.size())
+    {
+        // TODO: specialized CIndexOutOfBoundsException?
+        throw CException("index %d out of bounds for EntityAtIndex()", idx);
+    }
+    return *Unshare(m_Values[m_MemberNameByIndex[idx]], Allocator());
+}
+const CEntity& CObject::EntityAtIndex(int idx) const
+{
+    if (idx < 0 || (size_t)idx >= m_MemberNameByIndex.size())
+    {
+        // TODO: specialized CIndexOutOfBoundsException?
+        throw CException("index %d out of bounds for EntityAtIndex()", idx);
+    }
+    return *m_Values.find(m_MemberNameByIndex[idx])->second;
+}
+
+
+std::string CObject::ToString(bool prettyPrint, const std::string& indentation, int level) const
+{
+    std::string indent;
+    if (prettyPrint)
+    {
+        for (int i = 0; i < level; i++)
+        {
+            indent += indentation;
+        }
+    }
+
+    std::string s;
+    if (prettyPrint &&
+        level > 0)
+    {
+        s += "\n";
+    }
+    s += indent + "{";
+    if (prettyPrint)
+    {
+        s += "\n";
+    }
+    TValueMap::const_iterator it;
+    int i = 0;
+    for (it = m_Values.begin(); it != m_Values.end(); ++it)
+    {
+        if (i != 0)
+        {
+            s += ",";
+            if (prettyPrint)
+            {
+                s += "\n";
+            }
+        }
+        if (prettyPrint)
+        {
+            s += indent + indentation;
+        }
+        s += "\"";
+        s += EscapeString(it->first);
+        s += "\"";
+        s += ":";
+        s += it->second->ToString(prettyPrint, indentation, level+1);
+        i++;
+    }
+    if (prettyPrint)
+    {
+        s += "\n";
+    }
+    s += indent + "}";
+    return s;
+}
+const std::string& CObject::GetString(const std::string& name, const std::string& defaultValue) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second || !it->second->IsString())
+    {
+        return defaultValue;
+    }
+    return static_cast<CString*>(it->second)->Value();
+}
+CNumber* CObject::GetNumber(const std::string& name) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second || !it->second->IsNumber())
+    {
+        return NULL;
+    }
+    return static_cast<CNumber*>(it->second);
+}
+int CObject::GetInt(const std::string& name, int defaultValue) const
+{
+    CNumber* number = GetNumber(name);
+    if (!number)
+    {
+        return defaultValue;
+    }
+    return number->ValueInt();
+}
+float CObject::GetFloat(const std::string& name, float defaultValue) const
+{
+    CNumber* number = GetNumber(name);
+    if (!number)
+    {
+        return defaultValue;
+    }
+    return number->ValueFloat();
+}
+double CObject::GetDouble(const std::string& name, double defaultValue) const
+{
+    CNumber* number = GetNumber(name);
+    if (!number)
+    {
+        return defaultValue;
+    }
+    return number->ValueDouble();
+}
+CArray* CObject::GetArray(const std::string& name) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second || !it->second->IsArray())
+    {
+        return NULL;
+    }
+    return static_cast<CArray*>(it->second);
+}
+CObject* CObject::GetObject(const std::string& name) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second || !it->second->IsObject())
+    {
+        return NULL;
+    }
+    return static_cast<CObject*>(it->second);
+}
+CBoolean* CObject::GetBoolean(const std::string& name) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second || !it->second->IsBoolean())
+    {
+        return NULL;
+    }
+    return static_cast<CBoolean*>(it->second);
+}
+bool CObject::GetBool(const std::string& name, bool defaultValue) const
+{
+    CBoolean* b = GetBoolean(name);
+    if (!b)
+    {
+        return defaultValue;
+    }
+    return b->Value();
+}
+CNull* CObject::GetNull(const std::string& name) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second || !it->second->IsNull())
+    {
+        return NULL;
+    }
+    return static_cast<CNull*>(it->second);
+}
+CEntity* CObject::GetEntity(const std::string& name) const
+{
+    TValueMap::const_iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second)
+    {
+        return NULL;
+    }
+    return it->second;
+}
+CEntity* CObject::MutableEntity(const std::string& name)
+{
+    TValueMap::iterator it = m_Values.find(name);
+    if (it == m_Values.end() || !it->second)
+    {
+        return NULL;
+    }
+    return Unshare(it->second, Allocator());
+}
+bool CObject::Remove(const char* name)
+{
+    CheckModifiable();
+    std::string s(name);
+    TValueMap::iterator it = m_Values.find(s);
+    if (it == m_Values.end())
+    {
+        return false;
+    }
+    CEntity* ent = it->second;
+    m_Values.erase(it);
+
+    TNameVector::iterator it2 = std::find(m_MemberNameByIndex.begin(), m_MemberNameByIndex.end(), s);
+    m_MemberNameByIndex.erase(it2);
+    DeleteChild(ent);
+    InvalidateHash();
+    return true;
+}
+bool CObject::Insert(const char* name, CEntity* ent, int index)
+{
+    CheckModifiable();
+    std::string s(name);
+    if (index > (int)m_MemberNameByIndex.size())
+    {
+        throw CException("index %d out of bounds for Insert()", index);
+    }
+    TValueMap::iterator it = m_Values.lower_bound(s);
+    if (it != m_Values.end() && it->first == s)
+    {
+        return false;
+    }
+    it = m_Values.insert(it, TValueMap::value_type(s, ent));
+    try
+    {
+        if (index < 0)
+        {
+            m_MemberNameByIndex.push_back(s);
+        }
+        else
+        {
+            m_MemberNameByIndex.insert(m_MemberNameByIndex.begin() + index, s);
+        }
+    }
+    catch (...)
+    {
+        m_Values.erase(it);
+        throw;
+    }
+    Adopt(ent);
+    return true;
+}
+CEntity* CObject::Detach(const char* name, int* index)
+{
+    CheckModifiable();
+    std::string s(name);
+    TValueMap::iterator it = m_Values.find(s);
+    if (it == m_Values.end())
+    {
+        return NULL;
+    }
+    CEntity* ent = Unshare(it->second, Allocator());
+    m_Values.erase(it);
+
+    TNameVector::iterator it2 = std::find(m_MemberNameByIndex.begin(), m_MemberNameByIndex.end(), s);
+    if (index)
+    {
+        *index = (int)(it2 - m_MemberNameByIndex.begin());
+    }
+    m_MemberNameByIndex.erase(it2);
+    Disown(ent);
+    return ent;
+}
+CEntity* CObject::Copy(CAllocator& allocator) const
+{
+    CObject* copy = NewContainer<CObject>(allocator);
+    try
+    {
+        for (TValueMap::const_iterator it = m_Values.begin(); it != m_Values.end(); ++it)
+        {
+            CEntity*& child = copy->m_Values.insert(copy->m_Values.end(), TValueMap::value_type(it->first, NULL))->second;
+            child = it->second->Copy(allocator);
+            copy->Adopt(child);
+        }
+        copy->m_MemberNameByIndex.assign(m_MemberNameByIndex.begin(), m_MemberNameByIndex.end());
+    }
+    catch (...)
+    {
+        delete copy;
+        throw;
+    }
+    return copy;
+}
+CEntity* CObject::ShallowCopy(CAllocator& allocator) const
+{
+    // the members of a shared object are shared
+    CObject* copy = NewContainer<CObject>(allocator);
+    try
+    {
+        for (TValueMap::const_iterator it = m_Values.begin(); it != m_Values.end(); ++it)
+        {
+            copy->m_Values.insert(copy->m_Values.end(), TValueMap::value_type(it->first, it->second));
+            Share(it->second);
+        }
+        copy->m_MemberNameByIndex.assign(m_MemberNameByIndex.begin(), m_MemberNameByIndex.end());
+    }
+    catch (...)
+    {
+        delete copy;
+        throw;
+    }
+    return copy;
+}
+void CObject::Accept(CHandler& handler) const
+{
+    handler.StartObject((int)m_Values.size());
+    for (TValueMap::const_iterator it = m_Values.begin(); it != m_Values.end(); ++it)
+    {
+        handler.Key(it->first.data(), it->first.size());
+        it->second->Accept(handler);
+    }
+    handler.EndObject();
+}
+uint64_t CObject::ComputeHash() const
+{
+    // sum of the member hashes, independent of the member order
+    uint64_t h = MixHash(HASH_OBJECT);
+    for (TValueMap::const_iterator it = m_Values.begin(); it != m_Values.end(); ++it)
+    {
+        h += MixHash(HashBytes(it->first.data(), it->first.size()) ^ it->second->Hash());
+    }
+    return MixHash(h ^ m_Values.size());
+}
+bool CObject::EqualsSameType(const CEntity& other) const
+{
+    // both maps are sorted by name
+    const TValueMap& values = static_cast<const CObject&>(other).m_Values;
+    if (m_Values.size() != values.size())
+    {
+        return false;
+    }
+    for (TValueMap::const_iterator it = m_Values.begin(), it2 = values.begin(); it != m_Values.end(); ++it, ++it2)
+    {
+        if (it->first != it2->first || !it->second->Equals(*it2->second))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+void CObject::MergeFrom(const CObject& obj, bool overwrite)
+{
+    CheckModifiable();
+    for (TValueMap::const_iterator it = obj.m_Values.begin(); it != obj.m_Values.end(); ++it)
+    {
+        const std::string& key = it->first;
+        bool exists = Contains(key.c_str());
+        if (exists && !overwrite)
+        {
+            continue;
+        }
+        // NOTE: the copy is made first, as it may throw (e.g. if the allocator limit is reached),
+        //       this object stays unmodified in that case
+        CEntity* copy = it->second->Copy(Allocator());
+        if (exists)
+        {
+            DeleteChild(m_Values[key]);
+        }
+        else
+        {
+            m_MemberNameByIndex.push_back(key);
+        }
+        m_Values[key] = copy;
+        Adopt(copy);
+    }
+}
+
+
+CBoolean::CBoolean()
+    : m_Value(false)
+{
+}
+CBoolean::~CBoolean()
+{
+}
+void CBoolean::SetBool(bool b)
+{
+    CheckModifiable();
+    m_Value = b;
+    InvalidateHash();
+}
+std::string CBoolean::ToString(bool prettyPrint, const std::string& indentation, int level) const
+{
+    return m_Value ? std::string("true") : std::string("false");
+}
+CEntity* CBoolean::Copy(CAllocator& allocator) const
+{
+    CBoolean* copy = NewEntity<CBoolean>(allocator);
+    copy->m_Value = m_Value;
+    return copy;
+}
+void CBoolean::Accept(CHandler& handler) const
+{
+    handler.Boolean(m_Value);
+}
+uint64_t CBoolean::ComputeHash() const
+{
+    return MixHash(HASH_BOOLEAN * 2 + (m_Value ? 1 : 0));
+}
+bool CBoolean::EqualsSameType(const CEntity& other) const
+{
+    return m_Value == static_cast<const CBoolean&>(other).m_Value;
+}
+
+CNull::CNull()
+{
+}
+CNull::~CNull()
+{
+}
+std::string CNull::ToString(bool prettyPrint, const std::string& indentation, int level) const
+{
+    return std::string("null");
+}
+CEntity* CNull::Copy(CAllocator& allocator) const
+{
+    return NewEntity<CNull>(allocator);
+}
+void CNull::Accept(CHandler& handler) const
+{
+    handler.Null();
+}
+uint64_t CNull::ComputeHash() const
+{
+    return MixHash(HASH_NULL);
+}
+bool CNull::EqualsSameType(const CEntity& other) const
+{
+    (void)other;
+    return true;
+}
+
+// heap memory of the character data of s (0 if it is stored in s itself)
+static size_t StringHeapBytes(const std::string& s)
+{
+    uintptr_t data = (uintptr_t)s.data();
+    uintptr_t object = (uintptr_t)&s;
+    return data >= object && data < object + sizeof(s) ? 0 : s.capacity() + 1;
+}
+
+/**
+ * Hash-consing table of shared objects and arrays, see CEntity::Deduplicate() and
+ * CParser::SetDeduplicate(). The table holds a reference to each of its entities, so they stay
+ * valid while the table exists.
+ **/
+class CInternTable
+{
+public:
+    CInternTable();
+    ~CInternTable();
+
+    // returns the shared entity identical to ent (a complete object or array, its object/array
+    // children are interned already) and releases ent, or shares and registers ent.
+    // ent is unchanged if an exception is thrown.
+    CEntity* Intern(CEntity* ent);
+    // interns the object/array members or elements of container recursively
+    void InternChildren(CEntity& container);
+
+    size_t SharedSubtrees() const { return m_SharedSubtrees; }
+    size_t SavedBytes() const { return m_SavedBytes; }
+
+private:
+    CInternTable(const CInternTable&);
+    CInternTable& operator=(const CInternTable&);
+
+    void InternChild(CEntity*& child);
+    void Grow();
+    static bool Identical(const CEntity& a, const CEntity& b);
+    static bool IdenticalChild(const CEntity* a, const CEntity* b);
+    // approximate memory released by deleting ent
+    static size_t OwnedBytes(const CEntity& ent);
+
+    std::vector<CEntity*> m_Slots; // open addressing by hash, the size is a power of 2
+    size_t m_Count;
+    size_t m_SharedSubtrees;
+    size_t m_SavedBytes;
+};
+
+CInternTable::CInternTable()
+    : m_Count(0),
+      m_SharedSubtrees(0),
+      m_SavedBytes(0)
+{
+}
+CInternTable::~CInternTable()
+{
+    for (size_t i = 0; i < m_Slots.size(); i++)
+    {
+        if (m_Slots[i])
+        {
+            CEntity::DeleteChild(m_Slots[i]);
+        }
+    }
+}
+CEntity* CInternTable::Intern(CEntity* ent)
+{
+    if ((m_Count + 1) * 2 > m_Slots.size())
+    {
+        Grow();
+    }
+    uint64_t hash = ent->Hash();
+    size_t mask = m_Slots.size() - 1;
+    size_t i = (size_t)hash & mask;
+    for (; m_Slots[i]; i = (i + 1) & mask)
+    {
+        CEntity* shared = m_Slots[i];
+        if (shared == ent)
+        {
+            return ent;
+        }
+        if (shared->m_Hash == hash && Identical(*shared, *ent))
+        {
+            if (!ent->IsShared())
+            {
+                m_SavedBytes += OwnedBytes(*ent);
+            }
+            m_SharedSubtrees++;
+            CEntity::DeleteChild(ent);
+            return CEntity::Share(shared);
+        }
+    }
+    if (!ent->IsShared())
+    {
+        // the children of a shared container are immutable as well (the object/array children
+        // are shared already)
+        if (CObject* obj = dynamic_cast<CObject*>(ent))
+        {
+            for (CObject::TValueMap::iterator it = obj->m_Values.begin(); it != obj->m_Values.end(); ++it)
+            {
+                if (!it->second->IsShared())
+                {
+                    it->second->m_Link = 3;
+                }
+            }
+        }
+        else
+        {
+            CArray* arr = static_cast<CArray*>(ent);
+            for (size_t j = 0; j < arr->m_Values.size(); j++)
+            {
+                if (!arr->m_Values[j]->IsShared())
+                {
+                    arr->m_Values[j]->m_Link = 3;
+                }
+            }
+        }
+        ent->m_Link = 3; // one reference: the parent
+    }
+    m_Slots[i] = CEntity::Share(ent);
+    m_Count++;
+    return ent;
+}
+void CInternTable::InternChildren(CEntity& container)
+{
+    if (CObject* obj = dynamic_cast<CObject*>(&container))
+    {
+        for (CObject::TValueMap::iterator it = obj->m_Values.begin(); it != obj->m_Values.end(); ++it)
+        {
+            InternChild(it->second);
+        }
+    }
+    else if (CArray* arr = dynamic_cast<CArray*>(&container))
+    {
+        for (size_t i = 0; i < arr->m_Values.size(); i++)
+        {
+            InternChild(arr->m_Values[i]);
+        }
+    }
+}
+void CInternTable::InternChild(CEntity*& child)
+{
+    if (!child->IsObject() && !child->IsArray())
+    {
+        return;
+    }
+    if (!child->IsShared())
+    {
+        InternChildren(*child);
+    }
+    child = Intern(child);
+}
+void CInternTable::Grow()
+{
+    std::vector<CEntity*> slots(std::max(m_Slots.size() * 2, (size_t)64), (CEntity*)NULL);
+    size_t mask = slots.size() - 1;
+    for (size_t i = 0; i < m_Slots.size(); i++)
+    {
+        if (m_Slots[i])
+        {
+            size_t j = (size_t)m_Slots[i]->m_Hash & mask;
+            while (slots[j])
+            {
+                j = (j + 1) & mask;
+            }
+            slots[j] = m_Slots[i];
+        }
+    }
+    m_Slots.swap(slots);
+}
+bool CInternTable::Identical(const CEntity& a, const CEntity& b)
+{
+    if (typeid(a) != typeid(b))
+    {
+        return false;
+    }
+    if (const CObject* obj = dynamic_cast<const CObject*>(&a))
+    {
+        // same member order implies the same names, so both maps list the same names
+        const CObject& other = static_cast<const CObject&>(b);
+        if (obj->m_MemberNameByIndex != other.m_MemberNameByIndex)
+        {
+            return false;
+        }
+        for (CObject::TValueMap::const_iterator it = obj->m_Values.begin(), it2 = other.m_Values.begin(); it != obj->m_Values.end(); ++it, ++it2)
+        {
+            if (!IdenticalChild(it->second, it2->second))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (const CArray* arr = dynamic_cast<const CArray*>(&a))
+    {
+        const CArray& other = static_cast<const CArray&>(b);
+        if (arr->m_Packed || other.m_Packed)
+        {
+            // the same values written the same way
+            return arr->PackedType() == other.PackedType() && arr->Count() == other.Count() &&
+                   memcmp(arr->m_Packed->m_Int64s, other.m_Packed->m_Int64s, arr->Count() * sizeof(int64_t)) == 0;
+        }
+        if (arr->m_Values.size() != other.m_Values.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < arr->m_Values.size(); i++)
+        {
+            if (!IdenticalChild(arr->m_Values[i], other.m_Values[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (a.IsString())
+    {
+        return a.String().Value() == b.String().Value();
+    }
+    if (a.IsNumber())
+    {
+        // the text, not the value: shared entities are written as they were parsed
+        return a.Number().Value() == b.Number().Value();
+    }
+    if (a.IsBoolean())
+    {
+        return a.Boolean().Value() == b.Boolean().Value();
+    }
+    return true;
+}
+bool CInternTable::IdenticalChild(const CEntity* a, const CEntity* b)
+{
+    // identical object/array children are interned, i.e. the same entity
+    if (a == b)
+    {
+        return true;
+    }
+    if (a->IsObject() || a->IsArray())
+    {
+        return false;
+    }
+    return Identical(*a, *b);
+}
+size_t CInternTable::OwnedBytes(const CEntity& ent)
+{
+    if (ent.IsShared())
+    {
+        return 0;
+    }
+    if (const CObject* obj = dynamic_cast<const CObject*>(&ent))
+    {
+        // red-black tree node: color, 3 pointers and the value
+        const size_t nodeSize = 4 * sizeof(void*) + sizeof(CObject::TValueMap::value_type);
+        size_t bytes = CEntity::AllocationSize(sizeof(CObject)) + obj->m_MemberNameByIndex.capacity() * sizeof(std::string);
+        for (CObject::TValueMap::const_iterator it = obj->m_Values.begin(); it != obj->m_Values.end(); ++it)
+        {
+            // the name is stored twice (map key and member order)
+            bytes += nodeSize + 2 * StringHeapBytes(it->first) + OwnedBytes(*it->second);
+        }
+        return bytes;
+    }
+    if (const CArray* arr = dynamic_cast<const CArray*>(&ent))
+    {
+        size_t bytes = CEntity::AllocationSize(sizeof(CArray)) + arr->m_Values.capacity() * sizeof(CEntity*);
+        if (arr->m_Packed)
+        {
+            bytes += offsetof(CArray::SPacked, m_Int64s) + arr->Count() * sizeof(int64_t);
+        }
+        for (size_t i = 0; i < arr->m_Values.size(); i++)
+        {
+            bytes += OwnedBytes(*arr->m_Values[i]);
+        }
+        return bytes;
+    }
+    if (ent.IsString())
+    {
+        return CEntity::AllocationSize(sizeof(CString)) + StringHeapBytes(ent.String().Value());
+    }
+    if (ent.IsNumber())
+    {
+        return CEntity::AllocationSize(sizeof(CNumber)) + StringHeapBytes(ent.Number().Value());
+    }
+    return CEntity::AllocationSize(ent.IsBoolean() ? sizeof(CBoolean) : sizeof(CNull));
+}
+
+size_t CEntity::Deduplicate()
+{
+    CheckModifiable();
+    CInternTable table;
+    table.InternChildren(*this);
+    return table.SavedBytes();
+}
+
+
+#ifndef MINIJSON_NO_PARSE_STATS
+#define MINIJSON_STATS(statement) if (m_Stats) { statement; }
+#else
+#define MINIJSON_STATS(statement)
+#endif // MINIJSON_NO_PARSE_STATS
+
+// wall clock time in seconds (arbitrary start), for CParseStats
+static double GetSeconds()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif // _WIN32
+}
+
+CParseStats::CParseStats()
+{
+    Reset();
+}
+void CParseStats::Reset()
+{
+    m_Bytes = 0;
+    m_Objects = 0;
+    m_Arrays = 0;
+    m_Strings = 0;
+    m_Keys = 0;
+    m_Numbers = 0;
+    m_Booleans = 0;
+    m_Nulls = 0;
+    m_MaxDepth = 0;
+    m_StringBytes = 0;
+    m_Escapes = 0;
+    m_Allocations = 0;
+    m_SharedSubtrees = 0;
+    m_DeduplicatedBytes = 0;
+    m_PackedArrays = 0;
+    m_ParseSeconds = 0.0;
+    m_TeardownSeconds = 0.0;
+}
+
+CParseResult::CParseResult()
+    : m_Error(PARSE_OK),
+      m_Position(0),
+      m_Text(NULL),
+      m_Length(0)
+{
+}
+const char* CParseResult::ErrorString(EParseError error)
+{
+    switch (error)
+    {
+    case PARSE_OK: return "No error";
+    case PARSE_ERROR_EMPTY_INPUT: return "Empty input";
+    case PARSE_ERROR_SYNTAX: return "Syntax error";
+    case PARSE_ERROR_UNTERMINATED_STRING: return "Closing \" not found";
+    case PARSE_ERROR_INVALID_ESCAPE: return "Invalid escape sequence";
+    case PARSE_ERROR_INVALID_UTF8: return "Invalid UTF-8";
+    case PARSE_ERROR_EXPECTED_VALUE: return "Syntax error: Expected value";
+    case PARSE_ERROR_EXPECTED_KEY: return "Syntax error: Expected '\"'";
+    case PARSE_ERROR_EXPECTED_COLON: return "Syntax error: Expected ':'";
+    case PARSE_ERROR_EXPECTED_ARRAY_END: return "Syntax error: Expected ']'";
+    case PARSE_ERROR_EXPECTED_OBJECT_END: return "Syntax error: Expected '}'";
+    case PARSE_ERROR_EXTRA_BYTES: return "Extra bytes at end of json";
+    case PARSE_ERROR_ALLOCATION_FAILED: return "Allocation failed";
+    case PARSE_ERROR_DEPTH_EXCEEDED: return "Maximum nesting depth exceeded";
+    }
+    return "Unknown error";
+}
+std::string CParseResult::Message() const
+{
+    std::string msg = ErrorString(m_Error);
+    switch (m_Error)
+    {
+    case PARSE_ERROR_EXPECTED_VALUE:
+    case PARSE_ERROR_EXPECTED_KEY:
+    case PARSE_ERROR_EXPECTED_COLON:
+    case PARSE_ERROR_EXPECTED_ARRAY_END:
+    case PARSE_ERROR_EXPECTED_OBJECT_END:
+        {
+            char buf[64];
+#ifndef _WIN32
+            snprintf(buf, sizeof(buf), " at or after position %d", m_Position);
+#else // !_WIN32
+            sprintf_s(buf, sizeof(buf), " at or after position %d", m_Position);
+#endif // !_WIN32
+            msg += buf;
+        }
+        break;
+    default:
+        break;
+    }
+    return msg;
+}
+int CParseResult::Line() const
+{
+    int line, column;
+    std::string surrounding;
+    CParseErrorException::Locate(m_Text, m_Length, m_Position, &line, &column, &surrounding);
+    return line;
+}
+int CParseResult::Column() const
+{
+    int line, column;
+    std::string surrounding;
+    CParseErrorException::Locate(m_Text, m_Length, m_Position, &line, &column, &surrounding);
+    return column;
+}
+std::string CParseResult::Surrounding() const
+{
+    int line, column;
+    std::string surrounding;
+    CParseErrorException::Locate(m_Text, m_Length, m_Position, &line, &column, &surrounding);
+    return surrounding;
+}
+void CParseResult::Throw() const
+{
+    if (m_Error != PARSE_OK)
+    {
+        throw CParseErrorException(m_Text, m_Length, m_Position, Message());
+    }
+}
+
+CParser::CParser()
+    : m_Position(0),
+      m_Length(0),
+      m_Text(NULL),
+      m_Error(PARSE_OK),
+      m_ErrorPosition(0),
+      m_CheckUTF8(true),
+      m_Stats(NULL),
+      m_Allocator(&CAllocator::Default()),
+      m_Deduplicate(false),
+      m_InternTable(NULL),
+      m_PackNumbers(false),
+      m_MaxDepth(512)
+{
+}
+void CParser::SetAllocator(CAllocator* allocator)
+{
+    m_Allocator = allocator ? allocator : &CAllocator::Default();
+}
+CParser::~CParser()
+{
+}
+void CParser::ReleaseBuffers(size_t keepBytes)
+{
+    if (m_Scratch.capacity() > keepBytes)
+    {
+        std::string().swap(m_Scratch);
+    }
+    if (m_ValueStack.capacity() * sizeof(CEntity*) > keepBytes)
+    {
+        std::vector<CEntity*>().swap(m_ValueStack);
+    }
+    if (m_NameStack.capacity() * sizeof(const std::string*) > keepBytes)
+    {
+        std::vector<const std::string*>().swap(m_NameStack);
+    }
+    if (m_PackedInt64s.capacity() * sizeof(int64_t) > keepBytes)
+    {
+        std::vector<int64_t>().swap(m_PackedInt64s);
+    }
+    if (m_PackedDoubles.capacity() * sizeof(double) > keepBytes)
+    {
+        std::vector<double>().swap(m_PackedDoubles);
+    }
+    if (m_Frames.capacity() * sizeof(SFrame) > keepBytes)
+    {
+        std::vector<SFrame>().swap(m_Frames);
+    }
+}
+void CParser::DiscardValues(size_t base)
+{
+    for (size_t i = base; i < m_ValueStack.size(); i++)
+    {
+        CEntity::DeleteChild(m_ValueStack[i]);
+    }
+    m_ValueStack.resize(base);
+}
+void CParser::Delete(CEntity* ent)
+{
+#ifndef MINIJSON_NO_PARSE_STATS
+    if (m_Stats)
+    {
+        double start = GetSeconds();
+        delete ent;
+        m_Stats->m_TeardownSeconds += GetSeconds() - start;
+        return;
+    }
+#endif // MINIJSON_NO_PARSE_STATS
+    delete ent;
+}
+void CParser::SkipWhitespaces()
+{
+    while ( m_Position < m_Length &&
+           (m_Text[m_Position] == ' ' ||
+            m_Text[m_Position] == '\t' ||
+            m_Text[m_Position] == '\r' ||
+            m_Text[m_Position] == '\n'))
+    {
+        m_Position++;
+    }
+}
+bool CParser::TryToConsume(const char* txt)
+{
+    int storedPos = m_Position;
+    int i = 0;
+    bool found = false;
+    while (m_Position < m_Length)
+    {
+        char c = m_Text[m_Position];
+        if (c != txt[i])
+        {
+            break;
+        }
+        m_Position++;
+        i++;
+        if (txt[i] == 0)
+        {
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+    {
+        m_Position = storedPos;
+    }
+    return found;
+}
+bool CParser::Consume(const char* txt, EParseError error)
+{
+    if (!TryToConsume(txt))
+    {
+        SetError(error, m_Position);
+        return false;
+    }
+    return true;
+}
+void CParser::SetError(EParseError error, int position)
+{
+    if (m_Error == PARSE_OK) // the first error is the relevant one
+    {
+        m_Error = error;
+        m_ErrorPosition = position;
+    }
+}
+
+static int WriteUTF8Chars(char* buf, unsigned int c)
+{
+    if (c < 128)
+    {
+        buf[0] = c;
+        return 1;
+    }
+    else if (c < 2048)
+    {
+        buf[0] = 0xc0 | ((c >> 6) & 0xff);
+        buf[1] = 0x80 | (c & 63);
+        return 2;
+    }
+    else if (c < 65536)
+    {
+        buf[0] = 0xe0 | ((c >> 12) & 0xff);
+        buf[1] = 0x80 | ((c >> 6)  & 63);
+        buf[2] = 0x80 | (c & 63);
+        return 3;
+    }
+    else
+    {
+        buf[0] = 0xf0 | ((c >> 18) & 0xff);
+        buf[1] = 0x80 | ((c >> 12) & 63);
+        buf[2] = 0x80 | ((c >> 6)  & 63);
+        buf[3] = 0x80 | (c & 63);
+        return 4;
+    }
+}
+
+// returns the value of 4 hex digits, -1 if invalid
+static int ParseHex4(const char* txt)
+{
+    int value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = txt[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+        {
+            value |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            value |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            value |= c - 'A' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return value;
+}
+
+// returns the offset of the first invalid UTF-8 sequence in data, length if there is none
+static size_t FindInvalidUTF8(const unsigned char* data, size_t length)
+{
+    size_t i = 0;
+    while (i < length)
+    {
+        // skip ASCII 8 bytes at a time
+        while (i + 8 <= length)
+        {
+            unsigned int a, b;
+            memcpy(&a, data + i, 4);
+            memcpy(&b, data + i + 4, 4);
+            if ((a | b) & 0x80808080)
+            {
+                break;
+            }
+            i += 8;
+        }
+        if (i == length)
+        {
+            break;
+        }
+        unsigned char c = data[i];
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+        // RFC 3629: number of continuation bytes and the valid range of the second byte
+        size_t count;
+        unsigned char low = 0x80;
+        unsigned char high = 0xbf;
+        if (c >= 0xc2 && c <= 0xdf)
+        {
+            count = 1;
+        }
+        else if (c >= 0xe0 && c <= 0xef)
+        {
+            count = 2;
+            if (c == 0xe0)
+            {
+                low = 0xa0; // overlong
+            }
+            else if (c == 0xed)
+            {
+                high = 0x9f; // surrogates
+            }
+        }
+        else if (c >= 0xf0 && c <= 0xf4)
+        {
+            count = 3;
+            if (c == 0xf0)
+            {
+                low = 0x90; // overlong
+            }
+            else if (c == 0xf4)
+            {
+                high = 0x8f; // above U+10FFFF
+            }
+        }
+        else
+        {
+            return i;
+        }
+        if (i + count >= length || data[i + 1] < low || data[i + 1] > high)
+        {
+            return i;
+        }
+        for (size_t k = 2; k <= count; k++)
+        {
+            if (data[i + k] < 0x80 || data[i + k] > 0xbf)
+            {
+                return i;
+            }
+        }
+        i += count + 1;
+    }
+    return length;
+}
+
+#ifdef MINIJSON_UTF8_SSSE3
+/**
+ * Vectorized UTF-8 validation with nibble lookup tables (Keiser, Lemire: "Validating UTF-8 In
+ * Less Than One Instruction Per Byte"), 16 bytes per step. Returns false for invalid input,
+ * the position is determined by FindInvalidUTF8().
+ **/
+__attribute__((target("ssse3")))
+static bool IsValidUTF8SSSE3(const unsigned char* data, size_t length)
+{
+    const char TOO_SHORT = 1 << 0;      // lead byte not followed by a continuation byte
+    const char TOO_LONG = 1 << 1;       // continuation byte without a lead byte
+    const char OVERLONG_3 = 1 << 2;
+    const char TOO_LARGE = 1 << 3;
+    const char SURROGATE = 1 << 4;
+    const char OVERLONG_2 = 1 << 5;
+    const char TOO_LARGE_1000 = 1 << 6;
+    const char OVERLONG_4 = 1 << 6;
+    const char TWO_CONTS = (char)(1 << 7); // two continuation bytes, checked separately
+    const char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    const __m128i byte1High = _mm_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m128i byte1Low = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m128i byte2High = _mm_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    // bytes >= these values in the last 3 positions start a sequence that continues in the
+    // next block
+    const __m128i incompleteMax = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+    const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+
+    __m128i error = _mm_setzero_si128();
+    __m128i prev = _mm_setzero_si128();
+    __m128i prevIncomplete = _mm_setzero_si128();
+    size_t pos = 0;
+    while (pos < length)
+    {
+        __m128i input;
+        if (pos + 16 <= length)
+        {
+            input = _mm_loadu_si128((const __m128i*)(data + pos));
+        }
+        else
+        {
+            // zero padding: a sequence cut off by the end of data is reported as TOO_SHORT
+            unsigned char block[16] = { 0 };
+            memcpy(block, data + pos, length - pos);
+            input = _mm_loadu_si128((const __m128i*)block);
+        }
+        pos += 16;
+        if (_mm_movemask_epi8(input) == 0)
+        {
+            // ASCII only: valid unless the previous block ended with an incomplete sequence
+            error = _mm_or_si128(error, prevIncomplete);
+            prevIncomplete = _mm_setzero_si128();
+            prev = input;
+            continue;
+        }
+        __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+        __m128i specialCases = _mm_and_si128(
+            _mm_and_si128(
+                _mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibbleMask)),
+                _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, nibbleMask))),
+            _mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibbleMask)));
+        // third and fourth bytes of 3/4 byte sequences must be continuation bytes
+        __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+        __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+        __m128i isThirdByte = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xe0 - 0x80)));
+        __m128i isFourthByte = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xf0 - 0x80)));
+        __m128i must23 = _mm_and_si128(_mm_or_si128(isThirdByte, isFourthByte), _mm_set1_epi8((char)0x80));
+        error = _mm_or_si128(error, _mm_xor_si128(must23, specialCases));
+        prevIncomplete = _mm_subs_epu8(input, incompleteMax);
+        prev = input;
+    }
+    error = _mm_or_si128(error, prevIncomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xffff;
+}
+#endif // MINIJSON_UTF8_SSSE3
+
+bool CParser::IsValidUTF8(const char* data, size_t length, size_t* invalidPosition)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+#ifdef MINIJSON_UTF8_SSSE3
+    static const bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+    if (hasSSSE3 && IsValidUTF8SSSE3(bytes, length))
+    {
+        return true;
+    }
+#endif // MINIJSON_UTF8_SSSE3
+    size_t pos = FindInvalidUTF8(bytes, length);
+    if (pos == length)
+    {
+        return true;
+    }
+    if (invalidPosition)
+    {
+        *invalidPosition = pos;
+    }
+    return false;
+}
+
+// NOTE: the opening " has to be consumed by the caller
+bool CParser::ParseStringLiteral(std::string* str)
+{
+    if (str)
+    {
+        str->clear();
+    }
+    int origPos = m_Position;
+    size_t decodedLength = 0;
+    while (true)
+    {
+        // plain characters are copied at once
+        int runStart = m_Position;
+        while (m_Position < m_Length && m_Text[m_Position] != '\"' && m_Text[m_Position] != '\\')
+        {
+            m_Position++;
+        }
+        if (str)
+        {
+            str->append(m_Text + runStart, m_Position - runStart);
+        }
+        decodedLength += m_Position - runStart;
+        if (m_Position + 1 >= m_Length && (m_Position == m_Length || m_Text[m_Position] == '\\'))
+        {
+            SetError(PARSE_ERROR_UNTERMINATED_STRING, origPos);
+            return false;
+        }
+        if (m_Text[m_Position] == '\"')
+        {
+            break;
+        }
+
+        // escape sequence
+        int escapePos = m_Position;
+        m_Position++;
+        char c = m_Text[m_Position];
+        MINIJSON_STATS(m_Stats->m_Escapes++);
+        switch (c)
+        {
+        case 'b': c = '\b'; break;
+        case 'r': c = '\r'; break;
+        case 'n': c = '\n'; break;
+        case 'f': c = '\f'; break;
+        case 't': c = '\t'; break;
+        case '\\': c = '\\'; break;
+        case '/': c = '/'; break;
+        case '\"': c = '\"'; break;
+        case 'u':
+            {
+                int code = m_Position + 5 <= m_Length ? ParseHex4(&m_Text[m_Position + 1]) : -1;
+                int consumed = 5;
+                if (code >= 0xd800 && code <= 0xdbff)
+                {
+                    // high surrogate, the low surrogate has to follow as \uXXXX
+                    int low = -1;
+                    if (m_Position + 11 <= m_Length && m_Text[m_Position + 5] == '\\' && m_Text[m_Position + 6] == 'u')
+                    {
+                        low = ParseHex4(&m_Text[m_Position + 7]);
+                    }
+                    code = low >= 0xdc00 && low <= 0xdfff ? 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00) : -1;
+                    consumed = 11;
+                }
+                else if (code >= 0xdc00 && code <= 0xdfff)
+                {
+                    code = -1; // unpaired low surrogate
+                }
+                if (code < 0)
+                {
+                    SetError(PARSE_ERROR_INVALID_ESCAPE, escapePos);
+                    return false;
+                }
+                char utf8Buf[4];
+                int len = WriteUTF8Chars(utf8Buf, (unsigned int)code);
+                if (str)
+                {
+                    str->append(utf8Buf, len);
+                }
+                decodedLength += len;
+                m_Position += consumed;
+            }
+            continue;
+        default:
+            SetError(PARSE_ERROR_INVALID_ESCAPE, escapePos);
+            return false;
+        }
+        if (str)
+        {
+            *str += c;
+        }
+        decodedLength++;
+        m_Position++;
+    }
+    m_Position++;
+    MINIJSON_STATS(m_Stats->m_StringBytes += decodedLength);
+    return true;
+}
+bool CParser::SkipNumber()
+{
+    int origPos = m_Position;
+    while (m_Position < m_Length)
+    {
+        char c = m_Text[m_Position];
+        if ((c < '0' || c > '9') && c != '.' && (c != '-' || m_Position != origPos))
+        {
+            break;
+        }
+        m_Position++;
+    }
+    if (m_Position == origPos)
+    {
+        SetError(PARSE_ERROR_EXPECTED_VALUE, origPos);
+        return false;
+    }
+    return true;
+}
+CEntity* CParser::Intern(CEntity* ent)
+{
+    if (!m_InternTable || !ent)
+    {
+        return ent;
+    }
+    try
+    {
+        return m_InternTable->Intern(ent);
+    }
+    catch (...) // allocation failed
+    {
+        delete ent;
+        throw;
+    }
+}
+CEntity* CParser::ParseContainer(bool isObject)
+{
+    m_Frames.clear();
+    try
+    {
+        CArray* packed = NULL;
+        if (!OpenContainer(isObject, packed))
+        {
+            return NULL;
+        }
+        if (packed)
+        {
+            return packed; // the toplevel value is not interned
+        }
+        while (1)
+        {
+            SFrame& frame = m_Frames.back();
+            CEntity* value = NULL;
+            SkipWhitespaces();
+            if (TryToConsume(frame.m_IsObject ? "}" : "]"))
+            {
+                value = CloseContainer();
+                if (m_Frames.empty())
+                {
+                    return value;
+                }
+                value = Intern(value);
+            }
+            else
+            {
+                if (frame.m_IsObject)
+                {
+                    if (!Consume("\"", PARSE_ERROR_EXPECTED_KEY) || !ParseStringLiteral(&m_Scratch))
+                    {
+                        break;
+                    }
+                    MINIJSON_STATS(m_Stats->m_Keys++; m_Stats->m_Allocations++);
+                    SkipWhitespaces();
+                    if (!Consume(":", PARSE_ERROR_EXPECTED_COLON))
+                    {
+                        break;
+                    }
+                    SkipWhitespaces();
+
+                    CObject* obj = static_cast<CObject*>(frame.m_Container);
+                    CObject::TValueMap::iterator it = obj->m_Values.lower_bound(m_Scratch);
+                    if (it == obj->m_Values.end() || it->first != m_Scratch)
+                    {
+#if __cplusplus > 199711L
+                        it = obj->m_Values.emplace_hint(it, m_Scratch, (CEntity*)NULL); // no temporary copy of the key
+#else
+                        it = obj->m_Values.insert(it, CObject::TValueMap::value_type(m_Scratch, (CEntity*)NULL));
+#endif
+                        m_NameStack.push_back(&it->first);
+                    }
+                    frame.m_Member = it;
+                }
+                else
+                {
+                    // NOTE: the slot is added first, so the value is owned by the stack even if
+                    //       parsing fails later on
+                    m_ValueStack.push_back(NULL);
+                }
+
+                char c = m_Position < m_Length ? m_Text[m_Position] : 0;
+                if (c == '[' || c == '{')
+                {
+                    m_Position++;
+                    if (!OpenContainer(c == '{', packed))
+                    {
+                        break;
+                    }
+                    if (!packed)
+                    {
+                        continue; // the elements/members of the new container follow
+                    }
+                    value = Intern(packed);
+                }
+                else if (TryToConsume("\""))
+                {
+                    value = ParseString();
+                }
+                else if (TryToConsume("true"))
+                {
+                    CBoolean* b = NewEntity<CBoolean>(*m_Allocator);
+                    b->SetBool(true);
+                    value = b;
+                    MINIJSON_STATS(m_Stats->m_Booleans++; m_Stats->m_Allocations++);
+                }
+                else if (TryToConsume("false"))
+                {
+                    CBoolean* b = NewEntity<CBoolean>(*m_Allocator);
+                    b->SetBool(false);
+                    value = b;
+                    MINIJSON_STATS(m_Stats->m_Booleans++; m_Stats->m_Allocations++);
+                }
+                else if (TryToConsume("null"))
+                {
+                    value = NewEntity<CNull>(*m_Allocator);
+                    MINIJSON_STATS(m_Stats->m_Nulls++; m_Stats->m_Allocations++);
+                }
+                else
+                {
+                    value = ParseNumber();
+                }
+                if (!value)
+                {
+                    break;
+                }
+            }
+
+            // value is complete: ',' or the end of the container has to follow, the end
+            // completes the container, which is a value of its parent in turn
+            while (1)
+            {
+                AddToContainer(value);
+                SkipWhitespaces();
+                if (TryToConsume(","))
+                {
+                    break;
+                }
+                if (m_Frames.back().m_IsObject ? !Consume("}", PARSE_ERROR_EXPECTED_OBJECT_END) : !Consume("]", PARSE_ERROR_EXPECTED_ARRAY_END))
+                {
+                    break;
+                }
+                value = CloseContainer();
+                if (m_Frames.empty())
+                {
+                    return value;
+                }
+                value = Intern(value);
+            }
+            if (m_Error != PARSE_OK)
+            {
+                break;
+            }
+        }
+    }
+    catch (...) // allocation failed
+    {
+        DiscardFrames();
+        throw;
+    }
+    DiscardFrames();
+    return NULL;
+}
+bool CParser::OpenContainer(bool isObject, CArray*& packed)
+{
+    packed = NULL;
+    if ((int)m_Frames.size() >= m_MaxDepth)
+    {
+        SetError(PARSE_ERROR_DEPTH_EXCEEDED, m_Position - 1);
+        return false;
+    }
+    if (!isObject && m_PackNumbers)
+    {
+        packed = ParsePackedArray();
+        if (packed)
+        {
+            return true;
+        }
+    }
+    SFrame frame;
+    frame.m_IsObject = isObject;
+    if (isObject)
+    {
+        // the member names are collected on the stack (as pointers to the keys of the map), so
+        // the name vector is allocated with its final size
+        frame.m_Container = NewContainer<CObject>(*m_Allocator);
+        frame.m_Base = m_NameStack.size();
+        MINIJSON_STATS(m_Stats->m_Objects++; m_Stats->m_Allocations++);
+    }
+    else
+    {
+        // the values are collected on the stack, so the array is allocated with its final size
+        frame.m_Container = NewContainer<CArray>(*m_Allocator);
+        frame.m_Base = m_ValueStack.size();
+        MINIJSON_STATS(m_Stats->m_Arrays++; m_Stats->m_Allocations++);
+    }
+    try
+    {
+        m_Frames.push_back(frame);
+    }
+    catch (...)
+    {
+        delete frame.m_Container;
+        throw;
+    }
+    MINIJSON_STATS(m_Stats->m_MaxDepth = std::max(m_Stats->m_MaxDepth, (int)m_Frames.size()));
+    return true;
+}
+CEntity* CParser::CloseContainer()
+{
+    SFrame& frame = m_Frames.back();
+    if (frame.m_IsObject)
+    {
+        CObject* obj = static_cast<CObject*>(frame.m_Container);
+        obj->m_MemberNameByIndex.reserve(m_NameStack.size() - frame.m_Base);
+        for (size_t i = frame.m_Base; i < m_NameStack.size(); i++)
+        {
+            obj->m_MemberNameByIndex.push_back(*m_NameStack[i]);
+        }
+        m_NameStack.resize(frame.m_Base);
+    }
+    else
+    {
+        CArray* arr = static_cast<CArray*>(frame.m_Container);
+        arr->m_Values.assign(m_ValueStack.begin() + frame.m_Base, m_ValueStack.end());
+        m_ValueStack.resize(frame.m_Base);
+        for (size_t i = 0; i < arr->m_Values.size(); i++)
+        {
+            arr->m_Values[i]->SetParent(arr);
+        }
+    }
+    CEntity* container = frame.m_Container;
+    m_Frames.pop_back();
+    return container;
+}
+void CParser::AddToContainer(CEntity* value)
+{
+    SFrame& frame = m_Frames.back();
+    if (frame.m_IsObject)
+    {
+        CEntity::DeleteChild(frame.m_Member->second); // duplicate key: last one wins
+        frame.m_Member->second = value;
+        value->SetParent(frame.m_Container);
+    }
+    else
+    {
+        m_ValueStack.back() = value;
+    }
+}
+void CParser::DiscardFrames()
+{
+    while (!m_Frames.empty())
+    {
+        SFrame& frame = m_Frames.back();
+        if (frame.m_IsObject)
+        {
+            m_NameStack.resize(frame.m_Base);
+        }
+        else
+        {
+            DiscardValues(frame.m_Base);
+        }
+        delete frame.m_Container;
+        m_Frames.pop_back();
+    }
+}
+CArray* CParser::ParsePackedArray()
+{
+    int start = m_Position;
+    m_PackedInt64s.clear();
+    m_PackedDoubles.clear();
+    bool integers = true;
+    while (1)
+    {
+        SkipWhitespaces();
+        if (m_Position >= m_Length || (m_Text[m_Position] != '-' && (m_Text[m_Position] < '0' || m_Text[m_Position] > '9')))
+        {
+            // not a number (or an empty array): parsed as usual
+            m_Position = start;
+            return NULL;
+        }
+        int begin = m_Position;
+        SkipNumber();
+        const char* text = m_Text + begin;
+        size_t length = m_Position - begin;
+        int64_t i;
+        double d;
+        if (integers && NumberToInt64(text, length, i))
+        {
+            m_PackedInt64s.push_back(i);
+        }
+        else if (NumberToExactDouble(text, length, d))
+        {
+            if (integers)
+            {
+                // the integers before must not change as doubles either
+                integers = false;
+                m_PackedDoubles.resize(m_PackedInt64s.size());
+                for (size_t j = 0; j < m_PackedInt64s.size(); j++)
+                {
+                    if (!Int64ToExactDouble(m_PackedInt64s[j], m_PackedDoubles[j]))
+                    {
+                        m_Position = start;
+                        return NULL;
+                    }
+                }
+            }
+            m_PackedDoubles.push_back(d);
+        }
+        else
+        {
+            // invalid, or the value would change
+            m_Position = start;
+            return NULL;
+        }
+        SkipWhitespaces();
+        if (TryToConsume("]"))
+        {
+            break;
+        }
+        if (!TryToConsume(","))
+        {
+            m_Position = start;
+            return NULL;
+        }
+    }
+    CArray* arr = NewContainer<CArray>(*m_Allocator);
+    int count = (int)(integers ? m_PackedInt64s.size() : m_PackedDoubles.size());
+    try
+    {
+        arr->AllocatePacked(integers ? PACKED_INT64 : PACKED_DOUBLE, count);
+    }
+    catch (...)
+    {
+        delete arr;
+        throw;
+    }
+    if (integers)
+    {
+        memcpy(arr->m_Packed->m_Int64s, &m_PackedInt64s[0], count * sizeof(int64_t));
+    }
+    else
+    {
+        memcpy(arr->m_Packed->m_Doubles, &m_PackedDoubles[0], count * sizeof(double));
+    }
+    MINIJSON_STATS(m_Stats->m_Arrays++; m_Stats->m_PackedArrays++; m_Stats->m_Numbers += count; m_Stats->m_Allocations += 2; m_Stats->m_MaxDepth = std::max(m_Stats->m_MaxDepth, (int)m_Frames.size() + 1));
+    return arr;
+}
+CNumber* CParser::ParseNumber()
+{
+    int start = m_Position;
+    if (!SkipNumber())
+    {
+        return NULL;
+    }
+    CNumber* num = NewEntity<CNumber>(*m_Allocator);
+    MINIJSON_STATS(m_Stats->m_Numbers++; m_Stats->m_Allocations += 2);
+    num->m_Number.assign(m_Text + start, m_Position - start);
+    return num;
+}
+CString* CParser::ParseString()
+{
+    if (!ParseStringLiteral(&m_Scratch))
+    {
+        return NULL;
+    }
+    CString* s = NewEntity<CString>(*m_Allocator);
+    s->SetString(m_Scratch);
+    MINIJSON_STATS(m_Stats->m_Strings++; m_Stats->m_Allocations += 2);
+    return s;
+}
+
+bool CParser::ValidateContainer(bool isObject)
+{
+    m_Frames.clear();
+    SFrame frame;
+    frame.m_Container = NULL;
+    frame.m_Base = 0;
+    while (1)
+    {
+        // isObject: a container has been opened
+        if ((int)m_Frames.size() >= m_MaxDepth)
+        {
+            SetError(PARSE_ERROR_DEPTH_EXCEEDED, m_Position - 1);
+            return false;
+        }
+        frame.m_IsObject = isObject;
+        m_Frames.push_back(frame);
+        MINIJSON_STATS((isObject ? m_Stats->m_Objects : m_Stats->m_Arrays)++; m_Stats->m_MaxDepth = std::max(m_Stats->m_MaxDepth, (int)m_Frames.size()));
+
+        // the values of the container up to the next nested one
+        while (1)
+        {
+            isObject = m_Frames.back().m_IsObject;
+            SkipWhitespaces();
+            if (!TryToConsume(isObject ? "}" : "]"))
+            {
+                if (isObject)
+                {
+                    if (!Consume("\"", PARSE_ERROR_EXPECTED_KEY) || !ParseStringLiteral(NULL))
+                    {
+                        return false;
+                    }
+                    MINIJSON_STATS(m_Stats->m_Keys++);
+                    SkipWhitespaces();
+                    if (!Consume(":", PARSE_ERROR_EXPECTED_COLON))
+                    {
+                        return false;
+                    }
+                    SkipWhitespaces();
+                }
+                char c = m_Position < m_Length ? m_Text[m_Position] : 0;
+                if (c == '[' || c == '{')
+                {
+                    m_Position++;
+                    isObject = c == '{';
+                    break;
+                }
+                else if (TryToConsume("\""))
+                {
+                    MINIJSON_STATS(m_Stats->m_Strings++);
+                    if (!ParseStringLiteral(NULL))
+                    {
+                        return false;
+                    }
+                }
+                else if (TryToConsume("true") || TryToConsume("false"))
+                {
+                    MINIJSON_STATS(m_Stats->m_Booleans++);
+                }
+                else if (TryToConsume("null"))
+                {
+                    MINIJSON_STATS(m_Stats->m_Nulls++);
+                }
+                else
+                {
+                    MINIJSON_STATS(m_Stats->m_Numbers++);
+                    if (!SkipNumber())
+                    {
+                        return false;
+                    }
+                }
+                SkipWhitespaces();
+                if (TryToConsume(","))
+                {
+                    continue;
+                }
+                if (isObject ? !Consume("}", PARSE_ERROR_EXPECTED_OBJECT_END) : !Consume("]", PARSE_ERROR_EXPECTED_ARRAY_END))
+                {
+                    return false;
+                }
+            }
+
+            // the end of the container has been consumed, it is a value of its parent
+            while (1)
+            {
+                m_Frames.pop_back();
+                if (m_Frames.empty())
+                {
+                    return true;
+                }
+                SkipWhitespaces();
+                if (TryToConsume(","))
+                {
+                    break;
+                }
+                if (m_Frames.back().m_IsObject ? !Consume("}", PARSE_ERROR_EXPECTED_OBJECT_END) : !Consume("]", PARSE_ERROR_EXPECTED_ARRAY_END))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+}
+
+CEntity* CParser::Parse(const char* txt, int length)
+{
+    CEntity* root = NULL;
+#ifndef MINIJSON_NO_PARSE_STATS
+    if (m_Stats)
+    {
+        double start = GetSeconds();
+        try
+        {
+            root = ParseText(txt, length);
+        }
+        catch (...)
+        {
+            m_Stats->m_ParseSeconds += GetSeconds() - start;
+            throw;
+        }
+        m_Stats->m_ParseSeconds += GetSeconds() - start;
+    }
+    else
+#endif // MINIJSON_NO_PARSE_STATS
     {
-        delete it->second;
+        root = ParseText(txt, length);
     }
-}
-bool CObject::Contains(const char* name) const
-{
-    std::string s(name);
-    return m_Values.find(s) != m_Values.end();
-}
-CArray* CObject::AddArray(const char* name)
-{
-    if (Contains(name))
+    if (!root)
     {
-        return NULL;
+        CParseResult result;
+        result.m_Error = m_Error;
+        result.m_Position = m_ErrorPosition;
+        result.m_Text = m_Text;
+        result.m_Length = m_Length;
+        result.Throw();
     }
-    CArray* arr = new CArray();
-    m_Values[std::string(name)] = arr;
-    m_MemberNameByIndex.push_back(std::string(name));
-    return arr;
+    return root;
 }
-CObject* CObject::AddObject(const char* name)
+CEntity* CParser::TryParse(const char* txt, int length, CParseResult& result) MINIJSON_NOEXCEPT
 {
-    if (Contains(name))
+    result = CParseResult();
+    CEntity* root = NULL;
+#ifndef MINIJSON_NO_PARSE_STATS
+    double start = m_Stats ? GetSeconds() : 0.0;
+#endif // MINIJSON_NO_PARSE_STATS
+    try
     {
-        return NULL;
+        root = ParseText(txt, length);
+        if (!root)
+        {
+            result.m_Error = m_Error;
+            result.m_Position = m_ErrorPosition;
+        }
     }
-    CObject* obj = new CObject();
-    m_Values[std::string(name)] = obj;
-    m_MemberNameByIndex.push_back(std::string(name));
-    return obj;
-}
-CNumber* CObject::AddNumber(const char* name)
-{
-    if (Contains(name))
+    catch (...)
     {
-        return NULL;
+        result.m_Error = PARSE_ERROR_ALLOCATION_FAILED;
+        result.m_Position = m_Position;
     }
-    CNumber* num = new CNumber();
-    m_Values[std::string(name)] = num;
-    m_MemberNameByIndex.push_back(std::string(name));
-    return num;
-}
-
-CNumber* CObject::AddInt(const char* name, int i)
-{
-    CNumber* num = AddNumber(name);
-    if (num)
+#ifndef MINIJSON_NO_PARSE_STATS
+    if (m_Stats)
     {
-        num->SetInt(i);
+        m_Stats->m_ParseSeconds += GetSeconds() - start;
     }
-    return num;
+#endif // MINIJSON_NO_PARSE_STATS
+    result.m_Text = m_Text;
+    result.m_Length = m_Length;
+    return root;
 }
-CNumber* CObject::AddFloat(const char* name, float f)
+bool CParser::Validate(const char* txt, int length, CParseResult& result) MINIJSON_NOEXCEPT
 {
-    CNumber* num = AddNumber(name);
-    if (num)
+    result = CParseResult();
+#ifndef MINIJSON_NO_PARSE_STATS
+    double start = m_Stats ? GetSeconds() : 0.0;
+#endif // MINIJSON_NO_PARSE_STATS
+    bool valid = BeginText(txt, length);
+    if (valid)
     {
-        num->SetFloat(f);
+        try
+        {
+            if (TryToConsume("["))
+            {
+                valid = ValidateContainer(false);
+            }
+            else if (TryToConsume("{"))
+            {
+                valid = ValidateContainer(true);
+            }
+            else
+            {
+                SetError(PARSE_ERROR_SYNTAX, m_Position);
+                valid = false;
+            }
+        }
+        catch (...) // growing the stack of open containers failed
+        {
+            SetError(PARSE_ERROR_ALLOCATION_FAILED, m_Position);
+            valid = false;
+        }
     }
-    return num;
-}
-CNumber* CObject::AddDouble(const char* name, double d)
-{
-    CNumber* num = AddNumber(name);
-    if (num)
+    valid = valid && EndText();
+#ifndef MINIJSON_NO_PARSE_STATS
+    if (m_Stats)
     {
-        num->SetDouble(d);
+        m_Stats->m_ParseSeconds += GetSeconds() - start;
     }
-    return num;
+#endif // MINIJSON_NO_PARSE_STATS
+    result.m_Error = m_Error;
+    result.m_Position = m_ErrorPosition;
+    result.m_Text = m_Text;
+    result.m_Length = m_Length;
+    return valid;
 }
-CString* CObject::AddString(const char* name, const char* value)
+// sets up the parse state, false for empty or invalid UTF-8 input
+bool CParser::BeginText(const char* txt, int length)
 {
-    if (Contains(name))
+    m_Text = txt;
+    m_Position = 0;
+    m_Error = PARSE_OK;
+    m_ErrorPosition = 0;
+    if (length < 0)
     {
-        return NULL;
+        m_Length = (int)strlen(txt);
     }
-    CString* s = new CString();
-    if (value != NULL)
+    else
     {
-        s->SetString(value);
+        m_Length = length;
     }
-    m_Values[std::string(name)] = s;
-    m_MemberNameByIndex.push_back(std::string(name));
-    return s;
-}
-CBoolean* CObject::AddBoolean(const char* name, bool b)
-{
-    if (Contains(name))
+    MINIJSON_STATS(m_Stats->m_Bytes += m_Length);
+    size_t invalidPosition;
+    if (m_CheckUTF8 && !IsValidUTF8(m_Text, m_Length, &invalidPosition))
     {
-        return NULL;
+        SetError(PARSE_ERROR_INVALID_UTF8, (int)invalidPosition);
+        return false;
     }
-    CBoolean* boolean = new CBoolean();
-    boolean->SetBool(b);
-    m_Values[std::string(name)] = boolean;
-    m_MemberNameByIndex.push_back(std::string(name));
-    return boolean;
+    SkipWhitespaces();
+    if (m_Position == m_Length)
+    {
+        SetError(PARSE_ERROR_EMPTY_INPUT, m_Position);
+        return false;
+    }
+    return true;
 }
-CNull* CObject::AddNull(const char* name)
+// false if there is anything but whitespace after the toplevel value
+bool CParser::EndText()
 {
-    if (Contains(name))
+    SkipWhitespaces();
+    if (m_Position != m_Length)
     {
-        return NULL;
+        SetError(PARSE_ERROR_EXTRA_BYTES, m_Position);
+        return false;
     }
-    CNull* null = new CNull();
-    m_Values[std::string(name)] = null;
-    m_MemberNameByIndex.push_back(std::string(name));
-    return null;
+    return true;
 }
-CNumber* CObject::SetInt(const char* name, int i)
+CEntity* CParser::ParseText(const char* txt, int length)
 {
-    CEntity* ent = GetEntity(name);
-    if (!ent)
+    if (!m_Deduplicate)
     {
-        return AddInt(name, i);
+        return ParseRoot(txt, length);
     }
-    if (!ent->IsNumber())
+    CInternTable table;
+    m_InternTable = &table;
+    CEntity* root;
+    try
     {
-        Remove(name);
-        return AddInt(name, i);
+        root = ParseRoot(txt, length);
     }
-    ent->Number().SetInt(i);
-    return &ent->Number();
+    catch (...)
+    {
+        m_InternTable = NULL;
+        throw;
+    }
+    m_InternTable = NULL;
+    MINIJSON_STATS(m_Stats->m_SharedSubtrees += table.SharedSubtrees(); m_Stats->m_DeduplicatedBytes += table.SavedBytes());
+    return root;
 }
-CNumber* CObject::SetFloat(const char* name, float f)
+CEntity* CParser::ParseRoot(const char* txt, int length)
 {
-    CEntity* ent = GetEntity(name);
-    if (!ent)
+    if (!BeginText(txt, length))
     {
-        return AddFloat(name, f);
+        return NULL;
     }
-    if (!ent->IsNumber())
+    CEntity* root = NULL;
+    if (TryToConsume("["))
     {
-        Remove(name);
-        return AddFloat(name, f);
+        root = ParseContainer(false);
     }
-    ent->Number().SetFloat(f);
-    return &ent->Number();
-}
-CNumber* CObject::SetDouble(const char* name, double d)
-{
-    CEntity* ent = GetEntity(name);
-    if (!ent)
+    else if (TryToConsume("{"))
     {
-        return AddDouble(name, d);
+        root = ParseContainer(true);
     }
-    if (!ent->IsNumber())
+    else
     {
-        Remove(name);
-        return AddDouble(name, d);
+        SetError(PARSE_ERROR_SYNTAX, m_Position);
+        return NULL;
     }
-    ent->Number().SetDouble(d);
-    return &ent->Number();
+    if (root && !EndText())
+    {
+        delete root;
+        return NULL;
+    }
+    return root;
 }
-CString* CObject::SetString(const char* name, const char* value)
+CEntity* CParser::ParseFromFile(const char* path, CAllocator* allocator)
 {
-    CEntity* ent = GetEntity(name);
-    if (!ent)
+    struct SFileCloser
     {
-        return AddString(name, value);
+        FILE* m_File;
+        SFileCloser(FILE* f)
+        {
+            m_File = f;
+        }
+        ~SFileCloser()
+        {
+            fclose(m_File);
+        }
+    };
+
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        throw CIOException("Failed to open file %s", path);
     }
-    if (!ent->IsString())
+
+    SFileCloser file(f); // close the file when leaving this method
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    CFileInputStream fileStream(f);
+    CDecompressingInputStream stream(fileStream);
+    stream.Read(NULL, 0); // detects the compression
+    if (stream.Compression() != COMPRESSION_NONE || size > 0x7fffffff)
     {
-        Remove(name);
-        return AddString(name, value);
+        // the entities are built while decompressing the file in chunks, i.e. the decompressed
+        // text is not held in memory
+        CDomBuilder builder;
+        builder.SetAllocator(allocator);
+        CStreamParser streamParser;
+        streamParser.Parse(stream, builder);
+        return builder.Release();
     }
-    ent->String().SetString(value);
-    return &ent->String();
-}
 
-CBoolean* CObject::SetBoolean(const char* name, bool b)
-{
-    CEntity* ent = GetEntity(name);
-    if (!ent)
+    // uncompressed: read the file in chunks
+    CParser parser;
+    parser.SetAllocator(allocator);
+    std::vector<char, CStlAllocator<char> > buf(size > 0 ? (size_t)size + 1 : 4096, 0, CStlAllocator<char>(parser.Allocator()));
+    size_t used = 0;
+    while (true)
     {
-        return AddBoolean(name, b);
+        if (used == buf.size())
+        {
+            buf.resize(buf.size() * 2);
+        }
+        size_t rd = stream.Read(&buf[used], buf.size() - used);
+        if (rd == 0)
+        {
+            break;
+        }
+        used += rd;
     }
-    if (!ent->IsBoolean())
+    if (used > 0x7fffffff)
     {
-        Remove(name);
-        return AddBoolean(name, b);
+        throw CIOException("File %s too large (%lu bytes)", path, (unsigned long)used);
     }
-    ent->Boolean().SetBool(b);
-    return &ent->Boolean();
+    buf.resize(used + 1);
+    buf[used] = 0; // error reporting in CParseErrorException requires a null-terminated text
+    return parser.Parse(&buf[0], (int)used);
 }
-const std::string& CObject::MemberNameByIndex(int index) const
+CEntity* CParser::ParseFromFile(const std::string& path, CAllocator* allocator)
 {
-    if (index < 0 || (size_t)index >= m_Values.size())
-    {
-        // TODO: specialized CIndexOutOfBoundsException?
-        throw CException("index %d out of bounds for MemberNameByIndex()", index);
-    }
-    return m_MemberNameByIndex[index];
+    return CParser::ParseFromFile(path.c_str(), allocator);
 }
-CEntity& CObject::EntityAtIndex(int idx)
+
+CHandler::~CHandler()
 {
-    if (idx < 0 || (size_t)idx >= m_MemberNameByIndex.size())
+}
+void CHandler::Numbers(const char* text, size_t length, int count)
+{
+    (void)count;
+    const char* end = text + length;
+    while (text < end)
     {
-        // TODO: specialized CIndexOutOfBoundsException?
-        throw CException("index %d out of bounds for EntityAtIndex()", idx);
+        const char* comma = (const char*)memchr(text, ',', end - text);
+        if (!comma)
+        {
+            comma = end;
+        }
+        Number(text, comma - text);
+        text = comma + 1;
     }
-    return *m_Values[m_MemberNameByIndex[idx]];
 }
-const CEntity& CObject::EntityAtIndex(int idx) const
+
+CDomBuilder::CDomBuilder()
+    : m_Allocator(&CAllocator::Default()),
+      m_Root(NULL),
+      m_HasKey(false)
 {
-    if (idx < 0 || (size_t)idx >= m_MemberNameByIndex.size())
+}
+CDomBuilder::~CDomBuilder()
+{
+    delete m_Root;
+}
+void CDomBuilder::SetAllocator(CAllocator* allocator)
+{
+    m_Allocator = allocator ? allocator : &CAllocator::Default();
+}
+CEntity* CDomBuilder::Release()
+{
+    if (!IsComplete())
     {
-        // TODO: specialized CIndexOutOfBoundsException?
-        throw CException("index %d out of bounds for EntityAtIndex()", idx);
+        throw CException("Release() called before a complete value was received");
     }
-    std::string key = m_MemberNameByIndex[idx];
-    return *m_Values.find(key)->second;
+    CEntity* root = m_Root;
+    m_Root = NULL;
+    return root;
 }
-
-
-std::string CObject::ToString(bool prettyPrint, const std::string& indentation, int level) const
+void CDomBuilder::AddEntity(CEntity* ent)
 {
-    std::string indent;
-    if (prettyPrint)
+    if (m_Stack.empty())
     {
-        for (int i = 0; i < level; i++)
+        if (m_Root)
         {
-            indent += indentation;
+            delete ent;
+            throw CException("Multiple toplevel values");
         }
+        m_Root = ent;
+        return;
     }
-
-    std::string s;
-    if (prettyPrint &&
-        level > 0)
-    {
-        s += "\n";
-    }
-    s += indent + "{";
-    if (prettyPrint)
+    CEntity* parent = m_Stack.back();
+    ent->SetParent(parent);
+    CArray* arr = dynamic_cast<CArray*>(parent);
+    if (arr)
     {
-        s += "\n";
+        arr->m_Values.push_back(ent);
+        return;
     }
-    std::map<std::string, CEntity*>::const_iterator it;
-    int i = 0;
-    for (it = m_Values.begin(); it != m_Values.end(); ++it)
+    CObject* obj = static_cast<CObject*>(parent);
+    if (!m_HasKey)
     {
-        if (i != 0)
-        {
-            s += ",";
-            if (prettyPrint)
-            {
-                s += "\n";
-            }
-        }
-        s += indent + indentation + "\"";
-        s += EscapeString(it->first);
-        s += "\"";
-        s += ":";
-        s += it->second->ToString(prettyPrint, indentation, level+1);
-        i++;
+        delete ent;
+        throw CException("Object member without key");
     }
-    if (prettyPrint)
+    m_HasKey = false;
+    CObject::TValueMap::iterator it = obj->m_Values.find(m_Key);
+    if (it != obj->m_Values.end())
     {
-        s += "\n";
+        // duplicate key: last one wins
+        delete it->second;
+        it->second = ent;
+        return;
     }
-    s += indent + "}";
-    return s;
+    obj->m_Values[m_Key] = ent;
+    obj->m_MemberNameByIndex.push_back(m_Key);
 }
-const std::string& CObject::GetString(const std::string& name, const std::string& defaultValue) const
+void CDomBuilder::StartObject(int sizeHint)
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second || !it->second->IsString())
+    (void)sizeHint;
+    CObject* obj = NewContainer<CObject>(*m_Allocator);
+    AddEntity(obj);
+    m_Stack.push_back(obj);
+}
+void CDomBuilder::Key(const char* str, size_t length)
+{
+    if (m_Stack.empty() || m_HasKey || !m_Stack.back()->IsObject())
     {
-        return defaultValue;
+        throw CException("Unexpected object key");
     }
-    return static_cast<CString*>(it->second)->Value();
+    m_Key.assign(str, length);
+    m_HasKey = true;
 }
-CNumber* CObject::GetNumber(const std::string& name) const
+void CDomBuilder::EndObject()
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second || !it->second->IsNumber())
+    if (m_Stack.empty() || m_HasKey || !m_Stack.back()->IsObject())
     {
-        return NULL;
+        throw CException("Unexpected end of object");
     }
-    return static_cast<CNumber*>(it->second);
+    m_Stack.pop_back();
 }
-int CObject::GetInt(const std::string& name, int defaultValue) const
+void CDomBuilder::StartArray(int sizeHint)
 {
-    CNumber* number = GetNumber(name);
-    if (!number)
+    CArray* arr = NewContainer<CArray>(*m_Allocator);
+    AddEntity(arr);
+    if (sizeHint > 0)
     {
-        return defaultValue;
+        arr->m_Values.reserve((size_t)sizeHint);
     }
-    return number->ValueInt();
+    m_Stack.push_back(arr);
 }
-float CObject::GetFloat(const std::string& name, float defaultValue) const
+void CDomBuilder::EndArray()
 {
-    CNumber* number = GetNumber(name);
-    if (!number)
+    if (m_Stack.empty() || !m_Stack.back()->IsArray())
     {
-        return defaultValue;
+        throw CException("Unexpected end of array");
     }
-    return number->ValueFloat();
+    m_Stack.pop_back();
 }
-double CObject::GetDouble(const std::string& name, double defaultValue) const
+void CDomBuilder::String(const char* str, size_t length)
 {
-    CNumber* number = GetNumber(name);
-    if (!number)
+    CString* s = NewEntity<CString>(*m_Allocator);
+    s->m_Value.assign(str, length);
+    AddEntity(s);
+}
+void CDomBuilder::Number(const char* str, size_t length)
+{
+    CNumber* num = NewEntity<CNumber>(*m_Allocator);
+    num->m_Number.assign(str, length);
+    AddEntity(num);
+}
+void CDomBuilder::Boolean(bool b)
+{
+    CBoolean* boolean = NewEntity<CBoolean>(*m_Allocator);
+    boolean->m_Value = b;
+    AddEntity(boolean);
+}
+void CDomBuilder::Null()
+{
+    AddEntity(NewEntity<CNull>(*m_Allocator));
+}
+
+COutputStream::~COutputStream()
+{
+}
+void COutputStream::Flush()
+{
+}
+
+CStringOutputStream::CStringOutputStream(std::string& str)
+    : m_String(str)
+{
+}
+void CStringOutputStream::Write(const char* data, size_t length)
+{
+    m_String.append(data, length);
+}
+
+CFileOutputStream::CFileOutputStream(FILE* file)
+    : m_File(file),
+      m_Buffer(64 * 1024),
+      m_Used(0)
+{
+}
+CFileOutputStream::~CFileOutputStream()
+{
+    // NOTE: no exceptions from the destructor, call Flush() to get notified about errors
+    if (m_Used > 0)
     {
-        return defaultValue;
+        fwrite(&m_Buffer[0], 1, m_Used, m_File);
     }
-    return number->ValueDouble();
 }
-CArray* CObject::GetArray(const std::string& name) const
+void CFileOutputStream::Write(const char* data, size_t length)
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second || !it->second->IsArray())
+    if (m_Used + length > m_Buffer.size())
     {
-        return NULL;
+        Flush();
+        if (length > m_Buffer.size())
+        {
+            if (fwrite(data, 1, length, m_File) != length)
+            {
+                throw CIOException("Failed to write all bytes to file");
+            }
+            return;
+        }
     }
-    return static_cast<CArray*>(it->second);
+    memcpy(&m_Buffer[m_Used], data, length);
+    m_Used += length;
 }
-CObject* CObject::GetObject(const std::string& name) const
+void CFileOutputStream::Flush()
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second || !it->second->IsObject())
+    if (m_Used > 0)
     {
-        return NULL;
+        size_t wr = fwrite(&m_Buffer[0], 1, m_Used, m_File);
+        size_t used = m_Used;
+        m_Used = 0;
+        if (wr != used)
+        {
+            throw CIOException("Failed to write all bytes to file");
+        }
     }
-    return static_cast<CObject*>(it->second);
 }
-CBoolean* CObject::GetBoolean(const std::string& name) const
+
+CInputStream::~CInputStream()
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second || !it->second->IsBoolean())
+}
+
+CFileInputStream::CFileInputStream(FILE* file)
+    : m_File(file)
+{
+}
+size_t CFileInputStream::Read(char* data, size_t length)
+{
+    size_t rd = fread(data, 1, length, m_File);
+    if (rd < length && ferror(m_File))
     {
-        return NULL;
+        throw CIOException("Failed to read from file");
     }
-    return static_cast<CBoolean*>(it->second);
+    return rd;
 }
-bool CObject::GetBool(const std::string& name, bool defaultValue) const
+
+CMemoryInputStream::CMemoryInputStream(const void* data, size_t length)
+    : m_Data((const char*)data),
+      m_Length(length),
+      m_Position(0)
 {
-    CBoolean* b = GetBoolean(name);
-    if (!b)
+}
+size_t CMemoryInputStream::Read(char* data, size_t length)
+{
+    size_t rd = std::min(length, m_Length - m_Position);
+    memcpy(data, m_Data + m_Position, rd);
+    m_Position += rd;
+    return rd;
+}
+
+// size of the chunks read from/written to the underlying stream by the (de)compressing streams
+static const size_t COMPRESSION_CHUNK_SIZE = 64 * 1024;
+
+CDecompressingInputStream::CDecompressingInputStream(CInputStream& stream, ECompression compression)
+    : m_Stream(stream),
+      m_Compression(compression),
+      m_Initialized(false),
+      m_EndOfInput(false),
+      m_Finished(false),
+      m_Input(COMPRESSION_CHUNK_SIZE),
+      m_InputPos(0),
+      m_InputEnd(0),
+      m_State(NULL)
+{
+    if (compression != COMPRESSION_AUTO && !IsSupported(compression))
     {
-        return defaultValue;
+        throw CException("Compression %d is not supported by this build of minijson", (int)compression);
     }
-    return b->Value();
 }
-CNull* CObject::GetNull(const std::string& name) const
+CDecompressingInputStream::~CDecompressingInputStream()
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second || !it->second->IsNull())
+#ifdef MINIJSON_WITH_ZLIB
+    if (m_State && m_Compression == COMPRESSION_GZIP)
     {
-        return NULL;
+        z_stream* z = (z_stream*)m_State;
+        inflateEnd(z);
+        delete z;
     }
-    return static_cast<CNull*>(it->second);
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+    if (m_State && m_Compression == COMPRESSION_ZSTD)
+    {
+        ZSTD_freeDStream((ZSTD_DStream*)m_State);
+    }
+#endif // MINIJSON_WITH_ZSTD
 }
-CEntity* CObject::GetEntity(const std::string& name) const
+bool CDecompressingInputStream::IsSupported(ECompression compression)
 {
-    std::map<std::string, CEntity*>::const_iterator it = m_Values.find(name);
-    if (it == m_Values.end() || !it->second)
+    switch (compression)
     {
-        return NULL;
+    case COMPRESSION_NONE:
+    case COMPRESSION_AUTO:
+        return true;
+#ifdef MINIJSON_WITH_ZLIB
+    case COMPRESSION_GZIP:
+        return true;
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+    case COMPRESSION_ZSTD:
+        return true;
+#endif // MINIJSON_WITH_ZSTD
+    default:
+        return false;
     }
-    return it->second;
 }
-bool CObject::Remove(const char* name)
+// moves remaining input to the front of the buffer and reads the next chunk.
+// returns false if no more input is available.
+bool CDecompressingInputStream::FillInput()
 {
-    std::string s(name);
-    std::map<std::string, CEntity*>::iterator it = m_Values.find(s);
-    if (it == m_Values.end())
+    if (m_InputPos > 0)
+    {
+        memmove(&m_Input[0], &m_Input[m_InputPos], m_InputEnd - m_InputPos);
+        m_InputEnd -= m_InputPos;
+        m_InputPos = 0;
+    }
+    if (m_EndOfInput || m_InputEnd == m_Input.size())
     {
         return false;
     }
-    CEntity* ent = it->second;
-    m_Values.erase(it);
-
-    std::vector<std::string>::iterator it2 = std::find(m_MemberNameByIndex.begin(), m_MemberNameByIndex.end(), s);
-    m_MemberNameByIndex.erase(it2);
-    delete ent;
+    size_t rd = m_Stream.Read(&m_Input[m_InputEnd], m_Input.size() - m_InputEnd);
+    if (rd == 0)
+    {
+        m_EndOfInput = true;
+        return false;
+    }
+    m_InputEnd += rd;
     return true;
 }
-CEntity* CObject::Copy() const
+void CDecompressingInputStream::Init()
 {
-    CObject* copy = new CObject();
-    for (std::map<std::string, CEntity*>::const_iterator it = m_Values.begin(); it != m_Values.end(); ++it)
+    m_Initialized = true;
+    if (m_Compression == COMPRESSION_AUTO)
+    {
+        while (m_InputEnd < 4 && FillInput())
+        {
+        }
+        const unsigned char* magic = (const unsigned char*)&m_Input[0];
+        m_Compression = COMPRESSION_NONE;
+        if (m_InputEnd >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        {
+            m_Compression = COMPRESSION_GZIP;
+        }
+        else if (m_InputEnd >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        {
+            m_Compression = COMPRESSION_ZSTD;
+        }
+        if (!IsSupported(m_Compression))
+        {
+            throw CIOException("Input is %s compressed, but minijson was built without %s support",
+                               m_Compression == COMPRESSION_GZIP ? "gzip" : "zstd",
+                               m_Compression == COMPRESSION_GZIP ? "zlib" : "zstd");
+        }
+    }
+#ifdef MINIJSON_WITH_ZLIB
+    if (m_Compression == COMPRESSION_GZIP)
     {
-        CEntity* e = it->second->Copy();
-        copy->m_Values[it->first] = e;
+        z_stream* z = new z_stream();
+        memset(z, 0, sizeof(z_stream));
+        if (inflateInit2(z, 15 + 32) != Z_OK) // 15 + 32: max window size, gzip or zlib header
+        {
+            delete z;
+            throw CException("Failed to initialize zlib");
+        }
+        m_State = z;
     }
-    copy->m_MemberNameByIndex = m_MemberNameByIndex;
-    return copy;
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+    if (m_Compression == COMPRESSION_ZSTD)
+    {
+        ZSTD_DStream* ds = ZSTD_createDStream();
+        if (!ds || ZSTD_isError(ZSTD_initDStream(ds)))
+        {
+            ZSTD_freeDStream(ds);
+            throw CException("Failed to initialize zstd");
+        }
+        m_State = ds;
+    }
+#endif // MINIJSON_WITH_ZSTD
 }
-void CObject::MergeFrom(const CObject& obj, bool overwrite)
+size_t CDecompressingInputStream::Read(char* data, size_t length)
 {
-    for (std::map<std::string, CEntity*>::const_iterator it = obj.m_Values.begin(); it != obj.m_Values.end(); ++it)
+    if (!m_Initialized)
     {
-        const std::string& key = it->first;
-        if (Contains(key.c_str()))
+        Init();
+    }
+    if (m_Finished || length == 0)
+    {
+        return 0;
+    }
+    if (m_Compression == COMPRESSION_NONE)
+    {
+        if (m_InputPos < m_InputEnd)
         {
-            if (!overwrite)
+            size_t rd = std::min(length, m_InputEnd - m_InputPos);
+            memcpy(data, &m_Input[m_InputPos], rd);
+            m_InputPos += rd;
+            return rd;
+        }
+        return m_Stream.Read(data, length);
+    }
+    while (true)
+    {
+        if (m_InputPos == m_InputEnd && !FillInput() && m_InputPos == m_InputEnd)
+        {
+            // NOTE: a complete stream sets m_Finished below, running out of input here means that
+            //       the compressed data is truncated
+            throw CIOException("Unexpected end of compressed data");
+        }
+        size_t produced = 0;
+        bool endOfFrame = false;
+#ifdef MINIJSON_WITH_ZLIB
+        if (m_Compression == COMPRESSION_GZIP)
+        {
+            z_stream* z = (z_stream*)m_State;
+            z->next_in = (Bytef*)&m_Input[m_InputPos];
+            z->avail_in = (uInt)(m_InputEnd - m_InputPos);
+            z->next_out = (Bytef*)data;
+            z->avail_out = (uInt)std::min(length, (size_t)0x40000000);
+            int ret = inflate(z, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
             {
-                continue;
+                throw CIOException("Corrupt gzip data (zlib error %d)", ret);
+            }
+            m_InputPos = m_InputEnd - z->avail_in;
+            produced = (size_t)((char*)z->next_out - data);
+            if (ret == Z_STREAM_END)
+            {
+                endOfFrame = true;
+                inflateReset(z);
             }
-            delete m_Values[key];
         }
-        else
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+        if (m_Compression == COMPRESSION_ZSTD)
         {
-            m_MemberNameByIndex.push_back(key);
+            ZSTD_inBuffer in = { &m_Input[m_InputPos], m_InputEnd - m_InputPos, 0 };
+            ZSTD_outBuffer out = { data, length, 0 };
+            size_t ret = ZSTD_decompressStream((ZSTD_DStream*)m_State, &out, &in);
+            if (ZSTD_isError(ret))
+            {
+                throw CIOException("Corrupt zstd data (%s)", ZSTD_getErrorName(ret));
+            }
+            m_InputPos += in.pos;
+            produced = out.pos;
+            endOfFrame = ret == 0;
+        }
+#endif // MINIJSON_WITH_ZSTD
+        if (endOfFrame && m_InputPos == m_InputEnd && !FillInput() && m_InputPos == m_InputEnd)
+        {
+            // no further gzip members/zstd frames
+            m_Finished = true;
+        }
+        if (produced > 0 || m_Finished)
+        {
+            return produced;
         }
-        m_Values[key] = it->second->Copy();
     }
 }
 
-
-CBoolean::CBoolean()
-    : m_Value(false)
-{
-}
-CBoolean::~CBoolean()
-{
-}
-void CBoolean::SetBool(bool b)
-{
-    m_Value = b;
-}
-std::string CBoolean::ToString(bool prettyPrint, const std::string& indentation, int level) const
-{
-    return m_Value ? std::string("true") : std::string("false");
+CStreamParser::CStreamParser(size_t bufferSize)
+    : m_Stream(NULL),
+      m_Buffer(std::max(bufferSize, (size_t)64)),
+      m_Position(0),
+      m_End(0),
+      m_Offset(0),
+      m_EndOfInput(false),
+      m_CheckUTF8(true),
+      m_DocumentSequence(false),
+      m_MaxDepth(512)
+{
+}
+// reads the next chunk into the buffer (which has to be consumed completely), false at the end
+// of the input
+bool CStreamParser::Fill()
+{
+    m_Offset += m_End;
+    m_Position = 0;
+    m_End = 0;
+    if (!m_EndOfInput)
+    {
+        m_End = m_Stream->Read(&m_Buffer[0], m_Buffer.size());
+        m_EndOfInput = m_End == 0;
+    }
+    return m_End > 0;
 }
-CEntity* CBoolean::Copy() const
+// makes sure count bytes (at most 64) are in the buffer after m_Position, false if the input
+// ends before
+bool CStreamParser::EnsureAvailable(size_t count)
 {
-    CBoolean* copy = new CBoolean();
-    copy->m_Value = m_Value;
-    return copy;
+    if (m_End - m_Position >= count)
+    {
+        return true;
+    }
+    memmove(&m_Buffer[0], &m_Buffer[m_Position], m_End - m_Position);
+    m_Offset += m_Position;
+    m_End -= m_Position;
+    m_Position = 0;
+    while (m_End < count && !m_EndOfInput)
+    {
+        size_t rd = m_Stream->Read(&m_Buffer[m_End], m_Buffer.size() - m_End);
+        m_EndOfInput = rd == 0;
+        m_End += rd;
+    }
+    return m_End >= count;
 }
-
-CNull::CNull()
+// returns the next character that is not a whitespace (without consuming it), -1 at the end of
+// the input
+int CStreamParser::SkipWhitespaces()
 {
+    while (true)
+    {
+        while (m_Position < m_End)
+        {
+            char c = m_Buffer[m_Position];
+            if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            {
+                return (unsigned char)c;
+            }
+            m_Position++;
+        }
+        if (!Fill())
+        {
+            return -1;
+        }
+    }
 }
-CNull::~CNull()
+bool CStreamParser::TryToConsume(const char* txt)
 {
+    size_t length = strlen(txt);
+    if (!EnsureAvailable(length) || memcmp(&m_Buffer[m_Position], txt, length) != 0)
+    {
+        return false;
+    }
+    m_Position += length;
+    return true;
 }
-std::string CNull::ToString(bool prettyPrint, const std::string& indentation, int level) const
+void CStreamParser::Fail(EParseError error, unsigned long long position)
 {
-    return std::string("null");
+    char buf[64];
+#ifndef _WIN32
+    snprintf(buf, sizeof(buf), " at or after position %llu", position);
+#else // !_WIN32
+    sprintf_s(buf, sizeof(buf), " at or after position %llu", position);
+#endif // !_WIN32
+    int pos = position <= (unsigned long long)INT_MAX ? (int)position : -1;
+    throw CParseErrorException(NULL, 0, pos, std::string(CParseResult::ErrorString(error)) + buf);
 }
-CEntity* CNull::Copy() const
+void CStreamParser::ParseStringLiteral(const char** str, size_t* length)
 {
-    return new CNull();
-}
-
+    unsigned long long origPos = BytesRead();
+    m_Token.clear();
+    bool direct = true; // no escapes and not split by a read: the data is passed from the buffer
+    size_t runStart = m_Position;
+    while (true)
+    {
+        while (m_Position < m_End && m_Buffer[m_Position] != '\"' && m_Buffer[m_Position] != '\\')
+        {
+            m_Position++;
+        }
+        if (m_Position == m_End)
+        {
+            m_Token.append(&m_Buffer[runStart], m_Position - runStart);
+            direct = false;
+            if (!Fill())
+            {
+                Fail(PARSE_ERROR_UNTERMINATED_STRING, origPos);
+            }
+            runStart = m_Position;
+            continue;
+        }
+        if (m_Buffer[m_Position] == '\"')
+        {
+            break;
+        }
 
-CParser::CParser()
-{
-}
-CParser::~CParser()
-{
-}
-void CParser::SkipWhitespaces()
-{
-    while ( m_Position < m_Length &&
-           (m_Text[m_Position] == ' ' ||
-            m_Text[m_Position] == '\t' ||
-            m_Text[m_Position] == '\r' ||
-            m_Text[m_Position] == '\n'))
+        // escape sequence
+        m_Token.append(&m_Buffer[runStart], m_Position - runStart);
+        direct = false;
+        unsigned long long escapePos = BytesRead();
+        if (!EnsureAvailable(2))
+        {
+            Fail(PARSE_ERROR_UNTERMINATED_STRING, origPos);
+        }
+        char c = m_Buffer[m_Position + 1];
+        switch (c)
+        {
+        case 'b': c = '\b'; break;
+        case 'r': c = '\r'; break;
+        case 'n': c = '\n'; break;
+        case 'f': c = '\f'; break;
+        case 't': c = '\t'; break;
+        case '\\': c = '\\'; break;
+        case '/': c = '/'; break;
+        case '\"': c = '\"'; break;
+        case 'u':
+            {
+                int code = EnsureAvailable(6) ? ParseHex4(&m_Buffer[m_Position + 2]) : -1;
+                size_t consumed = 6;
+                if (code >= 0xd800 && code <= 0xdbff)
+                {
+                    // high surrogate, the low surrogate has to follow as \uXXXX
+                    int low = -1;
+                    if (EnsureAvailable(12) && m_Buffer[m_Position + 6] == '\\' && m_Buffer[m_Position + 7] == 'u')
+                    {
+                        low = ParseHex4(&m_Buffer[m_Position + 8]);
+                    }
+                    code = low >= 0xdc00 && low <= 0xdfff ? 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00) : -1;
+                    consumed = 12;
+                }
+                else if (code >= 0xdc00 && code <= 0xdfff)
+                {
+                    code = -1; // unpaired low surrogate
+                }
+                if (code < 0)
+                {
+                    Fail(PARSE_ERROR_INVALID_ESCAPE, escapePos);
+                }
+                char utf8Buf[4];
+                int len = WriteUTF8Chars(utf8Buf, (unsigned int)code);
+                m_Token.append(utf8Buf, len);
+                m_Position += consumed;
+                runStart = m_Position;
+            }
+            continue;
+        default:
+            Fail(PARSE_ERROR_INVALID_ESCAPE, escapePos);
+        }
+        m_Token += c;
+        m_Position += 2;
+        runStart = m_Position;
+    }
+    if (direct)
     {
-        m_Position++;
+        *str = &m_Buffer[runStart];
+        *length = m_Position - runStart;
+    }
+    else
+    {
+        m_Token.append(&m_Buffer[runStart], m_Position - runStart);
+        *str = m_Token.data();
+        *length = m_Token.size();
+    }
+    m_Position++;
+    size_t invalidPosition;
+    if (m_CheckUTF8 && !CParser::IsValidUTF8(*str, *length, &invalidPosition))
+    {
+        // NOTE: exact for strings without escape sequences
+        Fail(PARSE_ERROR_INVALID_UTF8, origPos + invalidPosition);
     }
 }
-bool CParser::TryToConsume(const char* txt)
+void CStreamParser::ParseLiteralOrNumber(CHandler& handler)
 {
-    int storedPos = m_Position;
-    int i = 0;
-    bool found = false;
-    while (m_Position < m_Length)
+    if (TryToConsume("true"))
     {
-        char c = m_Text[m_Position];
-        if (c != txt[i])
+        handler.Boolean(true);
+        return;
+    }
+    if (TryToConsume("false"))
+    {
+        handler.Boolean(false);
+        return;
+    }
+    if (TryToConsume("null"))
+    {
+        handler.Null();
+        return;
+    }
+    unsigned long long origPos = BytesRead();
+    m_Token.clear();
+    size_t start = m_Position;
+    while (true)
+    {
+        while (m_Position < m_End)
         {
-            break;
+            char c = m_Buffer[m_Position];
+            if ((c < '0' || c > '9') && c != '.' && (c != '-' || BytesRead() != origPos))
+            {
+                break;
+            }
+            m_Position++;
         }
-        m_Position++;
-        i++;
-        if (txt[i] == 0)
+        if (m_Position < m_End || m_EndOfInput)
         {
-            found = true;
             break;
         }
+        m_Token.append(&m_Buffer[start], m_Position - start);
+        Fill();
+        start = m_Position;
     }
-    if (!found)
+    if (BytesRead() == origPos)
     {
-        m_Position = storedPos;
+        Fail(PARSE_ERROR_EXPECTED_VALUE, origPos);
     }
-    return found;
-}
-void CParser::ConsumeOrDie(const char* txt)
-{
-    int origPos = m_Position;
-    bool b = TryToConsume(txt);
-    if (!b)
+    if (m_Token.empty())
+    {
+        handler.Number(&m_Buffer[start], m_Position - start);
+    }
+    else
     {
-        throw CParseErrorException(m_Text, origPos, "Syntax error: Expected '%s' at or after position %d", txt, origPos);
+        m_Token.append(&m_Buffer[start], m_Position - start);
+        handler.Number(m_Token.data(), m_Token.size());
     }
 }
-
-static int WriteUTF8Chars(char* buf, short unsigned int c)
+void CStreamParser::Parse(CInputStream& stream, CHandler& handler)
 {
-    if (c < 128)
+    m_Stream = &stream;
+    m_Position = 0;
+    m_End = 0;
+    m_Offset = 0;
+    m_EndOfInput = false;
+    m_Stack.clear();
+
+    enum EState
     {
-        buf[0] = c;
-        return 1;
-    }
-    else if (c < 2048)
+        STATE_VALUE,      // a value has to follow
+        STATE_MEMBER,     // a key or the end of the object has to follow
+        STATE_AFTER_VALUE // a separator or the end of the container has to follow
+    };
+    EState state = STATE_VALUE;
+    int c = SkipWhitespaces();
+    if (c < 0)
     {
-        buf[0] = 0xc0 | ((c >> 6) & 0xff);
-        buf[1] = 0x80 | (c & 63);
-        return 2;
+        if (m_DocumentSequence)
+        {
+            return;
+        }
+        Fail(PARSE_ERROR_EMPTY_INPUT, BytesRead());
     }
-    else
+    if (c != '{' && c != '[')
     {
-        buf[0] = 0xe0 | ((c >> 12) & 0xff);
-        buf[1] = 0x80 | ((c >> 6)  & 63);
-        buf[2] = 0x80 | (c & 63);
-        return 3;
+        Fail(PARSE_ERROR_SYNTAX, BytesRead()); // the toplevel value has to be an object or array
     }
-}
-
-// NOTE: does NOT support empty strings, caller needs to check that!
-std::string CParser::ParseStringLiteral()
-{
-    std::string str;
-    str.reserve(1024);
-
-    TryToConsume("\""); // NOTE: required because caller *may* have consumed this already, but does not have to. NOTE that due to this, we cannot support empty strings (this call would consume the closing \")
-    int origPos = m_Position;
-    char c = m_Text[m_Position];
-    while (c != '\"')
+    while (true)
     {
-        if (m_Position == m_Length)
+        if (state == STATE_VALUE)
         {
-            throw CParseErrorException(m_Text, origPos, "Closing \" not found");
+            state = STATE_AFTER_VALUE;
+            if ((c == '{' || c == '[') && (int)m_Stack.size() >= m_MaxDepth)
+            {
+                Fail(PARSE_ERROR_DEPTH_EXCEEDED, BytesRead());
+            }
+            if (c == '{')
+            {
+                m_Position++;
+                handler.StartObject(-1);
+                m_Stack.push_back('{');
+                state = STATE_MEMBER;
+            }
+            else if (c == '[')
+            {
+                m_Position++;
+                handler.StartArray(-1);
+                m_Stack.push_back('[');
+                c = SkipWhitespaces();
+                if (c != ']')
+                {
+                    state = STATE_VALUE;
+                    continue;
+                }
+            }
+            else if (c == '\"')
+            {
+                m_Position++;
+                const char* str = NULL;
+                size_t length = 0;
+                ParseStringLiteral(&str, &length);
+                handler.String(str, length);
+            }
+            else
+            {
+                ParseLiteralOrNumber(handler);
+            }
         }
-        if (c == '\\' &&
-            m_Position+1 < m_Length)
+        if (state == STATE_MEMBER)
         {
-            m_Position++;
-            c = m_Text[m_Position];
-            switch (c)
-            {
-            case 'b': c = '\b'; break;
-            case 'r': c = '\r'; break;
-            case 'n': c = '\n'; break;
-            case 'f': c = '\f'; break;
-            case 't': c = '\t'; break;
-            case '\\': c = '\\'; break;
-            case '/': c = '/'; break;
-            case '\"': c = '\"'; break;
-            case 'u':
+            c = SkipWhitespaces();
+            if (c != '}')
+            {
+                if (c != '\"')
                 {
-                    m_Position++;
-                    if (m_Position + 4 > m_Length)
-                    {
-                        throw CParseErrorException(m_Text, origPos, "Invalid \\u escaping");
-                    }
-                    char buf[5];
-                    memcpy(buf, &m_Text[m_Position], 4);
-                    buf[4] = 0;
-                    int utf8Char = (int)strtol(buf, NULL, 16);
-                    char utf8Buf[16];
-                    int len = WriteUTF8Chars(utf8Buf, utf8Char);
-                    for (int i = 0; i < len-1; i++)
-                    {
-                        str += utf8Buf[i];
-                    }
-                    c = utf8Buf[len-1];
-                    m_Position += 3;
+                    Fail(PARSE_ERROR_EXPECTED_KEY, BytesRead());
+                }
+                m_Position++;
+                const char* str = NULL;
+                size_t length = 0;
+                ParseStringLiteral(&str, &length);
+                handler.Key(str, length);
+                if (SkipWhitespaces() != ':')
+                {
+                    Fail(PARSE_ERROR_EXPECTED_COLON, BytesRead());
                 }
+                m_Position++;
+                c = SkipWhitespaces();
+                state = STATE_VALUE;
+                continue;
+            }
+            state = STATE_AFTER_VALUE;
+        }
+
+        // STATE_AFTER_VALUE
+        if (m_Stack.empty())
+        {
+            c = SkipWhitespaces();
+            if (c < 0)
+            {
                 break;
             }
+            if (!m_DocumentSequence)
+            {
+                Fail(PARSE_ERROR_EXTRA_BYTES, BytesRead());
+            }
+            if (c != '{' && c != '[')
+            {
+                Fail(PARSE_ERROR_SYNTAX, BytesRead());
+            }
+            state = STATE_VALUE;
+            continue;
         }
-        str += c;
-        m_Position++;
-        if (m_Position == m_Length)
+        bool isObject = m_Stack.back() == '{';
+        c = SkipWhitespaces();
+        if (c == ',')
         {
-            throw CParseErrorException(m_Text, origPos, "Closing \" not found");
+            m_Position++;
+            // NOTE: like CParser, a trailing comma is accepted
+            c = SkipWhitespaces();
+            if (c != (isObject ? '}' : ']'))
+            {
+                state = isObject ? STATE_MEMBER : STATE_VALUE;
+                continue;
+            }
         }
-        c = m_Text[m_Position];
-    }
-    m_Position++;
-    return str;
-}
-CEntity* CParser::ParseValue()
-{
-    CEntity* data = NULL;
-    if (TryToConsume("\""))
-    {
-        if (TryToConsume("\""))
+        if (c != (isObject ? '}' : ']'))
+        {
+            Fail(isObject ? PARSE_ERROR_EXPECTED_OBJECT_END : PARSE_ERROR_EXPECTED_ARRAY_END, BytesRead());
+        }
+        m_Position++;
+        m_Stack.pop_back();
+        if (isObject)
         {
-            // special case: empty string
-            CString* s = new CString();
-            s->SetString(std::string());
-            data = s;
+            handler.EndObject();
         }
         else
         {
-            data = ParseString();
+            handler.EndArray();
         }
     }
-    else if (TryToConsume("["))
+}
+
+CCompressingOutputStream::CCompressingOutputStream(COutputStream& stream, ECompression compression, int level)
+    : m_Stream(stream),
+      m_Compression(compression),
+      m_Finished(false),
+      m_Output(COMPRESSION_CHUNK_SIZE),
+      m_State(NULL)
+{
+    if (compression == COMPRESSION_AUTO || !IsSupported(compression))
     {
-        data = ParseArray();
+        throw CException("Compression %d is not supported by this build of minijson", (int)compression);
     }
-    else if (TryToConsume("{"))
+    (void)level;
+#ifdef MINIJSON_WITH_ZLIB
+    if (m_Compression == COMPRESSION_GZIP)
     {
-        data = ParseObject();
+        z_stream* z = new z_stream();
+        memset(z, 0, sizeof(z_stream));
+        // 15 + 16: max window size, gzip header
+        if (deflateInit2(z, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            delete z;
+            throw CException("Failed to initialize zlib");
+        }
+        m_State = z;
     }
-    else if (TryToConsume("true"))
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+    if (m_Compression == COMPRESSION_ZSTD)
     {
-        CBoolean* b = new CBoolean();
-        b->SetBool(true);
-        data = b;
+        ZSTD_CStream* cs = ZSTD_createCStream();
+        if (!cs || ZSTD_isError(ZSTD_initCStream(cs, level < 0 ? 3 : level)))
+        {
+            ZSTD_freeCStream(cs);
+            throw CException("Failed to initialize zstd");
+        }
+        m_State = cs;
     }
-    else if (TryToConsume("false"))
+#endif // MINIJSON_WITH_ZSTD
+}
+CCompressingOutputStream::~CCompressingOutputStream()
+{
+    // NOTE: no exceptions from the destructor, data is only complete after Finish()
+#ifdef MINIJSON_WITH_ZLIB
+    if (m_State && m_Compression == COMPRESSION_GZIP)
     {
-        CBoolean* b = new CBoolean();
-        b->SetBool(false);
-        data = b;
+        z_stream* z = (z_stream*)m_State;
+        deflateEnd(z);
+        delete z;
     }
-    else if (TryToConsume("null"))
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+    if (m_State && m_Compression == COMPRESSION_ZSTD)
     {
-        data = new CNull();
+        ZSTD_freeCStream((ZSTD_CStream*)m_State);
     }
-    else
+#endif // MINIJSON_WITH_ZSTD
+}
+bool CCompressingOutputStream::IsSupported(ECompression compression)
+{
+    return compression != COMPRESSION_AUTO && CDecompressingInputStream::IsSupported(compression);
+}
+ECompression CCompressingOutputStream::FromFileName(const char* path)
+{
+    size_t len = strlen(path);
+    if (len >= 3 && strcmp(path + len - 3, ".gz") == 0)
+    {
+        return COMPRESSION_GZIP;
+    }
+    if (len >= 4 && strcmp(path + len - 4, ".zst") == 0)
     {
-        data = ParseNumber();
+        return COMPRESSION_ZSTD;
     }
-    return data;
+    return COMPRESSION_NONE;
 }
-
-CArray* CParser::ParseArray()
+void CCompressingOutputStream::Compress(const char* data, size_t length, bool finish)
 {
-    CArray* arr = new CArray();
-    while (1)
+    if (m_Finished)
     {
-        SkipWhitespaces();
-        if (TryToConsume("]"))
+        throw CException("Write to finished compressed stream");
+    }
+#ifdef MINIJSON_WITH_ZLIB
+    if (m_Compression == COMPRESSION_GZIP)
+    {
+        z_stream* z = (z_stream*)m_State;
+        z->next_in = (Bytef*)data;
+        z->avail_in = (uInt)length;
+        int ret;
+        do
         {
-            break;
-        }
-        CEntity* ent = ParseValue();
-        arr->m_Values.push_back(ent);
-
-        SkipWhitespaces();
-        if (!TryToConsume(","))
+            z->next_out = (Bytef*)&m_Output[0];
+            z->avail_out = (uInt)m_Output.size();
+            ret = deflate(z, finish ? Z_FINISH : Z_NO_FLUSH);
+            if (ret == Z_STREAM_ERROR)
+            {
+                throw CException("zlib compression failed");
+            }
+            size_t produced = m_Output.size() - z->avail_out;
+            if (produced > 0)
+            {
+                m_Stream.Write(&m_Output[0], produced);
+            }
+        } while (z->avail_out == 0 || (finish && ret != Z_STREAM_END));
+    }
+#endif // MINIJSON_WITH_ZLIB
+#ifdef MINIJSON_WITH_ZSTD
+    if (m_Compression == COMPRESSION_ZSTD)
+    {
+        ZSTD_CStream* cs = (ZSTD_CStream*)m_State;
+        ZSTD_inBuffer in = { data, length, 0 };
+        while (true)
         {
-            ConsumeOrDie("]");
-            break;
+            ZSTD_outBuffer out = { &m_Output[0], m_Output.size(), 0 };
+            size_t ret = finish ? ZSTD_endStream(cs, &out) : ZSTD_compressStream(cs, &out, &in);
+            if (ZSTD_isError(ret))
+            {
+                throw CException("zstd compression failed (%s)", ZSTD_getErrorName(ret));
+            }
+            if (out.pos > 0)
+            {
+                m_Stream.Write(&m_Output[0], out.pos);
+            }
+            if (finish ? ret == 0 : in.pos == in.size)
+            {
+                break;
+            }
         }
     }
-    return arr;
+#endif // MINIJSON_WITH_ZSTD
+    (void)data;
+    (void)length;
+    if (finish)
+    {
+        m_Finished = true;
+    }
 }
-CObject* CParser::ParseObject()
+void CCompressingOutputStream::Write(const char* data, size_t length)
 {
-    CObject* obj = new CObject();
-    while (1)
+    if (length > 0)
     {
-        SkipWhitespaces();
-        if (TryToConsume("}"))
-        {
-            break;
-        }
-
-        std::string key = ParseStringLiteral();
-        SkipWhitespaces();
-        ConsumeOrDie(":");
-        SkipWhitespaces();
-        CEntity* ent = ParseValue();
-
-        obj->m_Values[key] = ent;
-        obj->m_MemberNameByIndex.push_back(key);
+        Compress(data, length, false);
+    }
+}
+void CCompressingOutputStream::Flush()
+{
+    m_Stream.Flush();
+}
+void CCompressingOutputStream::Finish()
+{
+    Compress(NULL, 0, true);
+    m_Stream.Flush();
+}
 
-        SkipWhitespaces();
-        if (!TryToConsume(","))
+CStreamWriter::CStreamWriter(COutputStream& stream, bool prettyPrint, const std::string& indentation, int level)
+    : m_Stream(stream),
+      m_PrettyPrint(prettyPrint),
+      m_Indentation(indentation),
+      m_Level(level)
+{
+}
+void CStreamWriter::WriteIndent(int level)
+{
+    if (!m_PrettyPrint)
+    {
+        return;
+    }
+    for (int i = 0; i < level; i++)
+    {
+        m_Stream.Write(m_Indentation.data(), m_Indentation.size());
+    }
+}
+void CStreamWriter::WriteEscaped(const char* str, size_t length)
+{
+    char buf[8];
+    size_t runStart = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        int len = EscapeChar(str[i], buf);
+        if (len > 0)
         {
-            ConsumeOrDie("}");
-            break;
+            m_Stream.Write(str + runStart, i - runStart);
+            m_Stream.Write(buf, (size_t)len);
+            runStart = i + 1;
         }
     }
-    return obj;
+    m_Stream.Write(str + runStart, length - runStart);
 }
-CNumber* CParser::ParseNumber()
+void CStreamWriter::AppendString(std::string& out, const char* str, size_t length)
 {
-    CNumber* num = new CNumber();
-    std::string str;
-    str.reserve(32);
-    while (m_Position < m_Length)
+    out += '\"';
+    char buf[8];
+    size_t runStart = 0;
+    for (size_t i = 0; i < length; i++)
     {
-        char c = m_Text[m_Position];
-        if ((c < '0' || c > '9') && c != '.' && (c != '-' || !str.empty()))
+        int len = EscapeChar(str[i], buf);
+        if (len > 0)
         {
-            break;
+            out.append(str + runStart, i - runStart);
+            out.append(buf, (size_t)len);
+            runStart = i + 1;
         }
-        str += c;
-        m_Position++;
     }
-    num->m_Number = str;
-    return num;
+    out.append(str + runStart, length - runStart);
+    out += '\"';
 }
-
-
-// NOTE: does NOT support empty strings, caller needs to check that!
-CString* CParser::ParseString()
+void CStreamWriter::AppendInt64(std::string& out, int64_t value)
 {
-    std::string str = ParseStringLiteral();
-    CString* s = new CString();
-    s->SetString(str);
-    return s;
+    char buffer[24];
+    out.append(buffer, FormatInt64(value, buffer));
 }
-
-CEntity* CParser::Parse(const char* txt, int length)
+void CStreamWriter::AppendDouble(std::string& out, double value)
 {
-    m_Text = txt;
-    m_Position = 0;
-    if (length < 0)
+    // (also false for NaN)
+    if (!(value >= -DBL_MAX && value <= DBL_MAX))
     {
-        m_Length = (int)strlen(txt);
+        throw CException("AppendDouble(): value %f is not finite", value);
     }
-    else
+    char buffer[NUMBER_TEXT_SIZE];
+    out.append(buffer, FormatDouble(value, buffer));
+}
+// writes the separator required before a value (array elements only, object members are
+// separated in Key())
+void CStreamWriter::BeginValue()
+{
+    if (m_Stack.empty())
     {
-        m_Length = length;
+        return;
     }
-    CEntity* root = NULL;
-    SkipWhitespaces();
-    if (m_Position == m_Length)
+    SFrame& frame = m_Stack.back();
+    if (!frame.m_IsObject)
     {
-        throw CParseErrorException(m_Text, m_Position, "Empty input");
+        if (frame.m_Count > 0)
+        {
+            m_Stream.Write(",", 1);
+        }
+        frame.m_Count++;
     }
-    if (TryToConsume("["))
+}
+void CStreamWriter::StartObject(int sizeHint)
+{
+    (void)sizeHint;
+    BeginValue();
+    int level = m_Level + (int)m_Stack.size();
+    if (m_PrettyPrint && level > 0)
     {
-        root = ParseArray();
+        m_Stream.Write("\n", 1);
     }
-    else if (TryToConsume("{"))
+    WriteIndent(level);
+    m_Stream.Write("{", 1);
+    if (m_PrettyPrint)
     {
-        root = ParseObject();
+        m_Stream.Write("\n", 1);
     }
-    else
+    SFrame frame;
+    frame.m_IsObject = true;
+    frame.m_Count = 0;
+    m_Stack.push_back(frame);
+}
+void CStreamWriter::Key(const char* str, size_t length)
+{
+    SFrame& frame = m_Stack.back();
+    if (frame.m_Count > 0)
     {
-        delete root;
-        throw CParseErrorException(m_Text, m_Position, "Syntax error");
+        m_Stream.Write(",", 1);
+        if (m_PrettyPrint)
+        {
+            m_Stream.Write("\n", 1);
+        }
     }
-    SkipWhitespaces();
-    if (m_Position != m_Length)
+    frame.m_Count++;
+    WriteIndent(m_Level + (int)m_Stack.size());
+    m_Stream.Write("\"", 1);
+    WriteEscaped(str, length);
+    m_Stream.Write("\":", 2);
+}
+void CStreamWriter::EndObject()
+{
+    m_Stack.pop_back();
+    if (m_PrettyPrint)
     {
-        throw CParseErrorException(m_Text, m_Position, "Extra bytes at end of json");
+        m_Stream.Write("\n", 1);
     }
-    return root;
+    WriteIndent(m_Level + (int)m_Stack.size());
+    m_Stream.Write("}", 1);
 }
-CEntity* CParser::ParseFromFile(const char* path)
+void CStreamWriter::StartArray(int sizeHint)
 {
-    struct SFileCloser
+    (void)sizeHint;
+    BeginValue();
+    m_Stream.Write("[", 1);
+    SFrame frame;
+    frame.m_IsObject = false;
+    frame.m_Count = 0;
+    m_Stack.push_back(frame);
+}
+void CStreamWriter::EndArray()
+{
+    m_Stack.pop_back();
+    m_Stream.Write("]", 1);
+}
+void CStreamWriter::String(const char* str, size_t length)
+{
+    BeginValue();
+    m_Stream.Write("\"", 1);
+    WriteEscaped(str, length);
+    m_Stream.Write("\"", 1);
+}
+void CStreamWriter::Number(const char* str, size_t length)
+{
+    BeginValue();
+    m_Stream.Write(str, length);
+}
+void CStreamWriter::Numbers(const char* text, size_t length, int count)
+{
+    BeginValue();
+    m_Stream.Write(text, length);
+    if (!m_Stack.empty())
     {
-        FILE* m_File;
-        SFileCloser(FILE* f)
-        {
-            m_File = f;
-        }
-        ~SFileCloser()
-        {
-            fclose(m_File);
-        }
-    };
-
-    FILE* f = fopen(path, "rb");
-    if (!f)
+        m_Stack.back().m_Count += count - 1;
+    }
+}
+void CStreamWriter::Boolean(bool b)
+{
+    BeginValue();
+    if (b)
     {
-        throw CIOException("Failed to open file %s", path);
+        m_Stream.Write("true", 4);
     }
-
-    SFileCloser file(f); // close the file when leaving this method
-
-    fseek(f, 0, SEEK_END);
-    int size = (int)ftell(f);
-    fseek(f, 0, SEEK_SET);
-    char* buf = (char*)malloc(size);
-    int rd = (int)fread(buf, 1, size, f);
-    if (rd != size)
+    else
     {
-        free(buf);
-        throw CIOException("Failed to read %d bytes from file (read=%d)", size, rd);
+        m_Stream.Write("false", 5);
     }
-    CEntity* ent = ParseString(buf, (int)size);
-    free(buf);
-    return ent;
 }
-CEntity* CParser::ParseFromFile(const std::string& path)
+void CStreamWriter::Null()
 {
-    return CParser::ParseFromFile(path.c_str());
+    BeginValue();
+    m_Stream.Write("null", 4);
 }
+
 CWriter::CWriter(bool prettyPrint, const std::string& indentation, int level)
-: m_PrettyPrint(true),
+: m_PrettyPrint(prettyPrint),
   m_Indentation(indentation),
-  m_Level(level)
+  m_Level(level),
+  m_Compression(COMPRESSION_AUTO),
+  m_CompressionLevel(-1)
+{
+}
+CWriter::~CWriter()
+{
+}
+void CWriter::SetCompression(ECompression compression, int level)
+{
+    m_Compression = compression;
+    m_CompressionLevel = level;
+}
+void CWriter::Write(COutputStream& stream, const CEntity& ent)
 {
+    CStreamWriter writer(stream, m_PrettyPrint, m_Indentation, m_Level);
+    ent.Accept(writer);
+    stream.Flush();
 }
 void CWriter::WriteToFile(FILE* f, const CEntity& ent)
 {
-    std::string json = ent.ToString(m_PrettyPrint, m_Indentation, m_Level);
-    size_t wr = fwrite(json.c_str(), 1, json.length(), f);
-    fclose(f);
-    if (wr != json.length())
+    // no file name available, COMPRESSION_AUTO writes uncompressed data
+    WriteToFile(f, ent, m_Compression == COMPRESSION_AUTO ? COMPRESSION_NONE : m_Compression);
+}
+void CWriter::WriteToFile(FILE* f, const CEntity& ent, ECompression compression)
+{
+    try
+    {
+        CFileOutputStream stream(f);
+        if (compression == COMPRESSION_NONE)
+        {
+            Write(stream, ent);
+        }
+        else
+        {
+            CCompressingOutputStream compressed(stream, compression, m_CompressionLevel);
+            Write(compressed, ent);
+            compressed.Finish();
+        }
+    }
+    catch (...)
     {
-        throw CIOException("Failed to write all bytes to file");
+        fclose(f);
+        throw;
     }
+    fclose(f);
 }
 void CWriter::WriteToFile(const char* path, const CEntity& ent)
 {
+    ECompression compression = m_Compression;
+    if (compression == COMPRESSION_AUTO)
+    {
+        compression = CCompressingOutputStream::FromFileName(path);
+        if (!CCompressingOutputStream::IsSupported(compression))
+        {
+            compression = COMPRESSION_NONE;
+        }
+    }
+    else if (compression != COMPRESSION_NONE && !CCompressingOutputStream::IsSupported(compression))
+    {
+        throw CException("Compression %d is not supported by this build of minijson", (int)compression);
+    }
     FILE* f = fopen(path, "wb");
     if (!f)
     {
         throw CIOException("Failed to open file for writing");
     }
-    WriteToFile(f, ent);
+    WriteToFile(f, ent, compression);
 }
 void CWriter::WriteToFile(const std::string& path, const CEntity& ent)
 {
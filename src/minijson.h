@@ -3,6 +3,11 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <iterator>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
 
 #ifdef _WIN32
 #ifndef __attribute__
@@ -11,8 +16,10 @@
 #endif // _WIN32
 #if __cplusplus > 199711L
 #define MINIJSON_OVERRIDE override
+#define MINIJSON_NOEXCEPT noexcept
 #else
 #define MINIJSON_OVERRIDE
+#define MINIJSON_NOEXCEPT
 #endif
 
 #ifdef _WIN32
@@ -30,6 +37,9 @@ class CNumber;
 class CString;
 class CBoolean;
 class CNull;
+class CHandler;
+class CAllocator;
+class CInternTable;
 
 class CException
 {
@@ -49,8 +59,14 @@ class CParseErrorException : public CException
 {
 public:
     CParseErrorException(const char* data, int position, const char* txt, ...) __attribute__((format(printf, 4, 5)));
+    // data does not need to be null-terminated
+    CParseErrorException(const char* data, size_t length, int position, const std::string& message);
     virtual ~CParseErrorException();
 
+    // computes line, column (both 1-based) and surrounding text of position in data (if
+    // position is in data, otherwise line/column are -1 and surrounding is empty).
+    static void Locate(const char* data, size_t length, int position, int* line, int* column, std::string* surrounding);
+
     int Position() const { return m_Position; }
     int Line() const { return m_Line; }
     int Column() const { return m_Column; }
@@ -68,6 +84,170 @@ public:
     CIOException(const char* txt, ...) __attribute__((format(printf, 2, 3)));
 };
 
+/**
+ * Memory source for entities and their containers.
+ *
+ * All CEntity nodes are allocated from an allocator (CAllocator::Default() unless specified),
+ * children added to an object or array (Add*(), Set*(), parsing, copying) use the allocator of
+ * their parent. An allocator must outlive all entities allocated from it.
+ *
+ * NOTE: the character data of strings, keys and numbers is stored in std::string members (which
+ *       are part of the public API) and is therefore allocated by std::allocator.
+ **/
+class CAllocator
+{
+public:
+    virtual ~CAllocator();
+
+    // returns memory for size bytes (aligned for any entity), throws on failure
+    virtual void* Allocate(size_t size) = 0;
+    // releases memory returned by Allocate(), size is the size that was requested
+    virtual void Free(void* ptr, size_t size) = 0;
+
+    // uses global operator new/delete
+    static CAllocator& Default();
+};
+
+/**
+ * Allocator counting the memory requested from another allocator, with an optional limit
+ * (e.g. a per request memory budget). Not thread safe.
+ **/
+class CCountingAllocator : public CAllocator
+{
+public:
+    CCountingAllocator(CAllocator& parent = CAllocator::Default());
+
+    virtual void* Allocate(size_t size) MINIJSON_OVERRIDE;
+    virtual void Free(void* ptr, size_t size) MINIJSON_OVERRIDE;
+
+    // Allocate() throws a CException if more than limit bytes would be in use, 0 for no limit
+    void SetLimit(size_t limit) { m_Limit = limit; }
+
+    size_t BytesInUse() const { return m_BytesInUse; }
+    size_t PeakBytesInUse() const { return m_PeakBytesInUse; }
+    size_t Allocations() const { return m_Allocations; } // total number of Allocate() calls
+    void ResetPeak() { m_PeakBytesInUse = m_BytesInUse; }
+
+private:
+    CAllocator& m_Parent;
+    size_t m_Limit;
+    size_t m_BytesInUse;
+    size_t m_PeakBytesInUse;
+    size_t m_Allocations;
+};
+
+/**
+ * Arena (bump pointer) allocator: memory is taken from large blocks and Free() does nothing, all
+ * memory is released at once by Reset() or the destructor. Fastest choice for documents that are
+ * parsed, used and deleted as a whole. Not thread safe.
+ *
+ * NOTE: entities must still be deleted (before Reset()) to release their string data.
+ **/
+class CArenaAllocator : public CAllocator
+{
+public:
+    CArenaAllocator(size_t blockSize = 64 * 1024, CAllocator& parent = CAllocator::Default());
+    virtual ~CArenaAllocator();
+
+    virtual void* Allocate(size_t size) MINIJSON_OVERRIDE;
+    virtual void Free(void* ptr, size_t size) MINIJSON_OVERRIDE;
+
+    void Reset();
+    // like Reset(), but keeps the blocks of the standard size for the following allocations
+    // (e.g. an arena that is used for one batch of documents after the other)
+    void Rewind();
+    size_t BytesReserved() const { return m_BytesReserved; } // memory taken from the parent
+
+private:
+    CArenaAllocator(const CArenaAllocator&);
+    CArenaAllocator& operator=(const CArenaAllocator&);
+
+    struct SBlock
+    {
+        SBlock* m_Next;
+        size_t m_Size;
+    };
+    CAllocator& m_Parent;
+    size_t m_BlockSize;
+    SBlock* m_Blocks;
+    SBlock* m_FreeBlocks; // standard size blocks kept by Rewind()
+    char* m_Current;
+    char* m_End;
+    size_t m_BytesReserved;
+};
+
+/**
+ * Pooling allocator: small allocations are served from per size class free lists (filled from
+ * 64KB blocks), larger ones are passed to the parent. Freed memory is reused for allocations of
+ * the same size class, it is returned to the parent by the destructor only. Not thread safe.
+ **/
+class CPoolAllocator : public CAllocator
+{
+public:
+    CPoolAllocator(CAllocator& parent = CAllocator::Default());
+    virtual ~CPoolAllocator();
+
+    virtual void* Allocate(size_t size) MINIJSON_OVERRIDE;
+    virtual void Free(void* ptr, size_t size) MINIJSON_OVERRIDE;
+
+    size_t BytesReserved() const { return m_BytesReserved; } // memory taken from the parent
+
+private:
+    CPoolAllocator(const CPoolAllocator&);
+    CPoolAllocator& operator=(const CPoolAllocator&);
+
+    enum
+    {
+        GRANULARITY = 16,
+        SIZE_CLASSES = 16 // pooled sizes: up to GRANULARITY * SIZE_CLASSES bytes
+    };
+    CAllocator& m_Parent;
+    void* m_FreeLists[SIZE_CLASSES];
+    std::vector<void*> m_Blocks;
+    size_t m_BytesReserved;
+};
+
+/**
+ * Adapter to use a CAllocator with STL containers.
+ **/
+template <class T>
+class CStlAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    template <class U> struct rebind
+    {
+        typedef CStlAllocator<U> other;
+    };
+
+    CStlAllocator() : m_Allocator(&CAllocator::Default()) {}
+    CStlAllocator(CAllocator& allocator) : m_Allocator(&allocator) {}
+    template <class U> CStlAllocator(const CStlAllocator<U>& other) : m_Allocator(&other.Allocator()) {}
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+    pointer allocate(size_type n, const void* hint = 0) { (void)hint; return static_cast<pointer>(m_Allocator->Allocate(n * sizeof(T))); }
+    void deallocate(pointer p, size_type n) { m_Allocator->Free(p, n * sizeof(T)); }
+    size_type max_size() const { return ((size_type)-1) / sizeof(T); }
+    void construct(pointer p, const T& value) { ::new ((void*)p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+
+    CAllocator& Allocator() const { return *m_Allocator; }
+
+private:
+    CAllocator* m_Allocator;
+};
+template <class T, class U>
+inline bool operator==(const CStlAllocator<T>& a, const CStlAllocator<U>& b) { return &a.Allocator() == &b.Allocator(); }
+template <class T, class U>
+inline bool operator!=(const CStlAllocator<T>& a, const CStlAllocator<U>& b) { return &a.Allocator() != &b.Allocator(); }
+
 class CEntity
 {
 public:
@@ -117,20 +297,116 @@ public:
     CEntity& operator[] (const std::string& key);
 
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const = 0;
-    virtual CEntity* Copy() const = 0;
+    // deep copy, allocated from CAllocator::Default() or allocator
+    CEntity* Copy() const;
+    virtual CEntity* Copy(CAllocator& allocator) const = 0;
+
+    // entities remember the allocator they were allocated from (in a small header in front of
+    // the entity), so they can be deleted as usual. plain new uses CAllocator::Default().
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+    // number of bytes requested from the allocator for an entity of entitySize bytes (sizeof())
+    static size_t AllocationSize(size_t entitySize);
+
+    // emit this entity (and all children) as events to the handler.
+    // object members are emitted in the same (sorted) order as ToString() uses.
+    virtual void Accept(CHandler& handler) const = 0;
+
+    // structural hash of this entity and its children: equal entities (see Equals()) have equal
+    // hashes, the hash of an object does not depend on the order of its members.
+    // The hash is computed on first use and cached in every entity of the tree, a modification
+    // clears the cache of the modified entity and its parents only, i.e. after a small change
+    // only the path to the root is hashed again.
+    // NOTE: the first Hash() (or Equals()) after a modification writes the cache, it must not
+    //       run concurrently with other calls on the same tree.
+    uint64_t Hash() const;
+    // structural equality: same type, strings with the same value, numbers with the same decimal
+    // value ("2", "2.0" and "20e-1" are equal), objects with equal members (in any order) and
+    // arrays with equal elements (in order). Entities with different hashes are rejected without
+    // visiting their children.
+    bool Equals(const CEntity& other) const;
+    // the object or array this entity is a member/element of, NULL for a toplevel or shared
+    // entity
+    CEntity* Parent() const { return IsShared() ? NULL : (CEntity*)m_Link; }
+
+    // hash-consing: replaces identical object/array subtrees (same values and member order,
+    // numbers with the same text) below this entity by one shared instance (see IsShared()).
+    // Returns the approximate number of bytes freed. See also CParser::SetDeduplicate().
+    size_t Deduplicate();
+    // shared entities (see Deduplicate()) are immutable, their modifying functions throw a
+    // CException. Non-const access to a member/element of a container that is not shared
+    // (operator[], EntityAtIndex(), CObject::MutableEntity(), CObject::Set*(), Detach())
+    // replaces a shared child by an unshared copy first (copy-on-write), e.g.
+    //   doc["address"]["city"].String().SetString("Berlin");
+    // modifies doc only. NOTE: the Get*() functions return shared children as they are.
+    bool IsShared() const { return (m_Link & 1) != 0; }
+
 protected:
+    CEntity(const CEntity& other);
+    CEntity& operator=(const CEntity& other);
+
+    // clears the cached hash of this entity and its parents, called on every modification
+    void InvalidateHash();
+    // makes this entity the parent of child (a new member/element), invalidateHash false if the
+    // value of this entity does not change (e.g. CArray::Unpack() replacing its representation)
+    void Adopt(CEntity* child, bool invalidateHash = true);
+    // child is no longer a member/element of this entity
+    void Disown(CEntity* child);
+    // throws if this entity is shared, called first by every modifying function
+    void CheckModifiable() const;
+    // copy-on-write: replaces child (a shared member/element of this entity, unless this entity
+    // is shared itself) by an unshared copy, returns child
+    CEntity* Unshare(CEntity*& child, CAllocator& allocator);
+    // copy for Unshare(): containers share the children of this entity
+    virtual CEntity* ShallowCopy(CAllocator& allocator) const { return Copy(allocator); }
+    // deletes child (may be NULL) or, if it is shared, drops one reference
+    static void DeleteChild(CEntity* child);
+    // adds a reference to the shared entity ent
+    static CEntity* Share(CEntity* ent);
+    virtual uint64_t ComputeHash() const = 0;
+    // other has the same type as this entity
+    virtual bool EqualsSameType(const CEntity& other) const = 0;
+
     static std::string s_EmptyString;
 
+private:
+    void SetParent(CEntity* parent)
+    {
+        if (!IsShared())
+        {
+            m_Link = (uintptr_t)parent;
+        }
+    }
+    size_t References() const { return (size_t)(m_Link >> 1); } // of a shared entity
+
+    uintptr_t m_Link; // parent, or (references << 1) | 1 for a shared entity
+    mutable uint64_t m_Hash; // 0: not computed
+    friend class CParser;
+    friend class CDomBuilder;
+    friend class CInternTable;
 };
 
 class CObject : public CEntity
 {
 public:
     CObject();
+    // members are allocated from allocator
+    explicit CObject(CAllocator& allocator);
     virtual ~CObject();
 
+    // creates a heap allocated object using allocator (for itself and its members)
+    static CObject* Create(CAllocator& allocator);
+    CAllocator& Allocator() const { return m_Values.get_allocator().Allocator(); }
+
     virtual bool Contains(const char* name) const MINIJSON_OVERRIDE;
     bool Remove(const char* name);
+    // adds ent (which must not be a member/element of another container) as member name and takes
+    // ownership. index: position in the member order (see MemberNameByIndex()), -1 appends.
+    // returns false (the caller keeps ownership) if name already exists.
+    bool Insert(const char* name, CEntity* ent, int index = -1);
+    // removes member name without deleting it, the caller takes ownership. returns NULL if name
+    // does not exist, index (optional) receives its position in the member order.
+    CEntity* Detach(const char* name, int* index = NULL);
 
 
     CArray* AddArray(const char* name);
@@ -168,6 +444,9 @@ public:
     bool GetBool(const std::string& name, bool defaultValue = false) const;
     CNull* GetNull(const std::string& name) const;
     CEntity* GetEntity(const std::string& name) const;
+    // GetEntity() for modifications: a shared member is replaced by an unshared copy first (see
+    // CEntity::IsShared())
+    CEntity* MutableEntity(const std::string& name);
 
     const std::string& MemberNameByIndex(int index) const;
 
@@ -175,24 +454,75 @@ public:
     CEntity& EntityAtIndex(int idx);
     const CEntity& EntityAtIndex(int idx) const;
 
+    // forward iterators over the members as (name, value) pairs, in the order of the names like
+    // ToString() and Accept() (not in the member order of MemberNameByIndex()), e.g.
+    //   for (CObject::const_iterator it = obj.begin(); it != obj.end(); ++it)
+    //       Use(it->first, *it->second);
+    // or range-for over const CObject::TMember&. They walk the members directly, i.e. without
+    // lookups or allocations. Like EntityAtIndex(), a non-const iterator replaces a shared
+    // member by an unshared copy when it is dereferenced (see CEntity::IsShared()). Adding
+    // members keeps iterators valid, removing a member invalidates the iterators to it.
+    typedef std::pair<const std::string, CEntity*> TMember;
+    class CIterator;
+    class CConstIterator;
+    typedef CIterator iterator;
+    typedef CConstIterator const_iterator;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const MINIJSON_OVERRIDE;
-    virtual CEntity* Copy() const MINIJSON_OVERRIDE;
+    using CEntity::Copy;
+    virtual CEntity* Copy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+    virtual void Accept(CHandler& handler) const MINIJSON_OVERRIDE;
     void MergeFrom(const CObject& obj, bool overwrite);
 
+protected:
+    virtual uint64_t ComputeHash() const MINIJSON_OVERRIDE;
+    virtual bool EqualsSameType(const CEntity& other) const MINIJSON_OVERRIDE;
+    virtual CEntity* ShallowCopy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+
 private:
-    std::map<std::string, CEntity*> m_Values;
-    std::vector<std::string> m_MemberNameByIndex;
+    typedef std::map<std::string, CEntity*, std::less<std::string>, CStlAllocator<std::pair<const std::string, CEntity*> > > TValueMap;
+    typedef std::vector<std::string, CStlAllocator<std::string> > TNameVector;
+    TValueMap m_Values;
+    TNameVector m_MemberNameByIndex;
     friend class CParser;
+    friend class CDomBuilder;
+    friend class CInternTable;
+    friend class CParallelWriter;
+
+};
 
+/**
+ * Storage of the elements of a CArray, see CArray::Pack().
+ **/
+enum EPackedType
+{
+    PACKED_NONE,   // the elements are entities
+    PACKED_INT64,  // integers in the int64_t range
+    PACKED_DOUBLE  // any numbers, as doubles
 };
 
 class CArray : public CEntity
 {
 public:
     CArray();
+    // elements are allocated from allocator
+    explicit CArray(CAllocator& allocator);
     virtual ~CArray();
 
+    // creates a heap allocated array using allocator (for itself and its elements)
+    static CArray* Create(CAllocator& allocator);
+    CAllocator& Allocator() const { return m_Values.get_allocator().Allocator(); }
+
     void Remove(int index);
+    // inserts ent (which must not be a member/element of another container) before element index
+    // (Count() appends) and takes ownership
+    void Insert(int index, CEntity* ent);
+    // removes element index without deleting it, the caller takes ownership
+    CEntity* Detach(int index);
 
     CArray* AddArray();
     CObject* AddObject();
@@ -216,16 +546,190 @@ public:
     CNull* GetNull(int index) const;
 
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const MINIJSON_OVERRIDE;
-    virtual CEntity* Copy() const MINIJSON_OVERRIDE;
+    using CEntity::Copy;
+    virtual CEntity* Copy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+    virtual void Accept(CHandler& handler) const MINIJSON_OVERRIDE;
 
-    virtual int Count() const MINIJSON_OVERRIDE{ return (int)m_Values.size(); }
+    virtual int Count() const MINIJSON_OVERRIDE{ return m_Packed ? m_Packed->m_Count : (int)m_Values.size(); }
     CEntity& EntityAtIndex(int index);
     const CEntity& EntityAtIndex(int index) const;
+
+    // forward iterators over the elements (CEntity&), e.g. for range-for and the standard
+    // algorithms. They walk the elements directly, i.e. without bounds checks or allocations.
+    // Like EntityAtIndex(), the non-const begin() and end() unpack a packed array first and a
+    // non-const iterator replaces a shared element by an unshared copy when it is dereferenced
+    // (see CEntity::IsShared()). The const ones leave a packed array as it is (so they can be
+    // used by many threads at once) and read the packed buffer: the element is a CNumber held
+    // by the iterator, valid until the iterator is incremented or destroyed (its Parent() is
+    // NULL). Any modification of the array invalidates its iterators.
+    class CIterator;
+    class CConstIterator;
+    typedef CIterator iterator;
+    typedef CConstIterator const_iterator;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Packed arrays: the numbers of an array of numbers only can be stored as one contiguous
+    // int64_t or double buffer instead of CNumber entities (8 instead of ~70 bytes per element),
+    // see also CParser::SetPackNumbers(). Count(), GetInt()/GetFloat()/GetDouble(), CopyTo(),
+    // ToString(), Accept(), Copy(), Hash() and Equals() use the buffer, any other access to the
+    // elements (EntityAtIndex(), operator[], GetNumber(), modifications) unpacks the array first,
+    // i.e. creates the CNumber elements.
+    // Arrays are packed only if the values do not change: PACKED_INT64 for integers in the
+    // int64_t range, PACKED_DOUBLE for numbers whose double is written (in the shortest form
+    // that reads back as the same double) with the same decimal value, e.g. "1.50" as "1.5",
+    // which holds for all numbers with up to 15 significant digits.
+    // NOTE: const functions unpack as well, they must not run concurrently with other calls on
+    //       a packed array that is unpacked by them (like the first Hash()).
+    EPackedType PackedType() const { return m_Packed ? m_Packed->m_Type : PACKED_NONE; }
+    bool IsPacked() const { return m_Packed != NULL; }
+    // the packed values (Count() entries), NULL unless the array has the packed type
+    const int64_t* PackedInt64s() const { return PackedType() == PACKED_INT64 ? m_Packed->m_Int64s : NULL; }
+    const double* PackedDoubles() const { return PackedType() == PACKED_DOUBLE ? m_Packed->m_Doubles : NULL; }
+    // packs the elements (see above), returns false and leaves the array unchanged if it is
+    // empty or an element is not a number or cannot be packed
+    bool Pack();
+    // creates the CNumber elements of a packed array
+    void Unpack();
+    // replaces all elements by count packed values (an empty array for count 0). Throws a
+    // CException for values that are not finite.
+    void AssignInt64s(const int64_t* values, int count);
+    void AssignDoubles(const double* values, int count);
+    // copies all elements (Count() values, converted like GetDouble()) to values, returns false
+    // if an element is not a number
+    bool CopyTo(double* values) const;
+    // like CopyTo(double*), but returns false for numbers that are not integers in the int64_t
+    // range as well
+    bool CopyTo(int64_t* values) const;
+
+protected:
+    virtual uint64_t ComputeHash() const MINIJSON_OVERRIDE;
+    virtual bool EqualsSameType(const CEntity& other) const MINIJSON_OVERRIDE;
+    virtual CEntity* ShallowCopy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+
 private:
-    std::vector<CEntity*> m_Values;
+    struct SPacked
+    {
+        EPackedType m_Type;
+        int m_Count;
+        union
+        {
+            int64_t m_Int64s[1]; // m_Count values
+            double m_Doubles[1];
+        };
+    };
+    // allocates m_Packed for count values (not initialized), the array must be empty
+    void AllocatePacked(EPackedType type, int count);
+    void FreePacked();
+    // the text of element index (a number), in buffer (see NUMBER_TEXT_SIZE in minijson.cpp)
+    // if the array is packed. Returns false if the element is not a number.
+    bool NumberText(int index, char* buffer, const char*& text, size_t& length) const;
+
+    typedef std::vector<CEntity*, CStlAllocator<CEntity*> > TValueVector;
+    TValueVector m_Values;
+    SPacked* m_Packed; // NULL: the elements are in m_Values
     friend class CParser;
+    friend class CDomBuilder;
+    friend class CInternTable;
+};
+
+class CObject::CIterator
+{
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef TMember value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const TMember* pointer;
+    typedef const TMember& reference;
+
+    CIterator() : m_Object(NULL) {}
+
+    reference operator*() const
+    {
+        m_Object->Unshare(m_Position->second, m_Object->Allocator());
+        return *m_Position;
+    }
+    pointer operator->() const { return &**this; }
+    CIterator& operator++() { ++m_Position; return *this; }
+    CIterator operator++(int) { CIterator it = *this; ++m_Position; return it; }
+    bool operator==(const CIterator& other) const { return m_Position == other.m_Position; }
+    bool operator!=(const CIterator& other) const { return m_Position != other.m_Position; }
+
+private:
+    friend class CObject;
+    friend class CConstIterator;
+
+    CIterator(CObject* object, TValueMap::iterator position) : m_Object(object), m_Position(position) {}
+
+    CObject* m_Object;
+    TValueMap::iterator m_Position;
+};
+
+class CObject::CConstIterator
+{
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef TMember value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const TMember* pointer;
+    typedef const TMember& reference;
+
+    CConstIterator() {}
+    CConstIterator(const CIterator& it) : m_Position(it.m_Position) {}
+
+    reference operator*() const { return *m_Position; }
+    pointer operator->() const { return &*m_Position; }
+    CConstIterator& operator++() { ++m_Position; return *this; }
+    CConstIterator operator++(int) { CConstIterator it = *this; ++m_Position; return it; }
+    bool operator==(const CConstIterator& other) const { return m_Position == other.m_Position; }
+    bool operator!=(const CConstIterator& other) const { return m_Position != other.m_Position; }
+
+private:
+    friend class CObject;
+
+    explicit CConstIterator(TValueMap::const_iterator position) : m_Position(position) {}
+
+    TValueMap::const_iterator m_Position;
+};
+
+inline CObject::iterator CObject::begin() { return iterator(this, m_Values.begin()); }
+inline CObject::iterator CObject::end() { return iterator(this, m_Values.end()); }
+inline CObject::const_iterator CObject::begin() const { return const_iterator(m_Values.begin()); }
+inline CObject::const_iterator CObject::end() const { return const_iterator(m_Values.end()); }
+
+class CArray::CIterator
+{
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef CEntity value_type;
+    typedef ptrdiff_t difference_type;
+    typedef CEntity* pointer;
+    typedef CEntity& reference;
+
+    CIterator() : m_Array(NULL) {}
+
+    reference operator*() const { return *m_Array->Unshare(*m_Position, m_Array->Allocator()); }
+    pointer operator->() const { return &**this; }
+    CIterator& operator++() { ++m_Position; return *this; }
+    CIterator operator++(int) { CIterator it = *this; ++m_Position; return it; }
+    bool operator==(const CIterator& other) const { return m_Position == other.m_Position; }
+    bool operator!=(const CIterator& other) const { return m_Position != other.m_Position; }
+
+private:
+    friend class CArray;
+    friend class CConstIterator;
+
+    CIterator(CArray* array, TValueVector::iterator position) : m_Array(array), m_Position(position) {}
+
+    CArray* m_Array;
+    TValueVector::iterator m_Position;
 };
 
+inline CArray::iterator CArray::begin() { Unpack(); return iterator(this, m_Values.begin()); }
+inline CArray::iterator CArray::end() { Unpack(); return iterator(this, m_Values.end()); }
+
 class CString : public CEntity
 {
 public:
@@ -236,13 +740,20 @@ public:
     void SetString(const std::string& str);
 
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const MINIJSON_OVERRIDE;
-    virtual CEntity* Copy() const MINIJSON_OVERRIDE;
+    using CEntity::Copy;
+    virtual CEntity* Copy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+    virtual void Accept(CHandler& handler) const MINIJSON_OVERRIDE;
 
     const std::string& Value() const { return m_Value; }
 
+protected:
+    virtual uint64_t ComputeHash() const MINIJSON_OVERRIDE;
+    virtual bool EqualsSameType(const CEntity& other) const MINIJSON_OVERRIDE;
+
 private:
     std::string m_Value;
     friend class CParser;
+    friend class CDomBuilder;
 };
 
 class CNumber : public CEntity
@@ -257,17 +768,84 @@ public:
     void SetString(const std::string& num);
 
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const MINIJSON_OVERRIDE;
-    virtual CEntity* Copy() const MINIJSON_OVERRIDE;
+    using CEntity::Copy;
+    virtual CEntity* Copy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+    virtual void Accept(CHandler& handler) const MINIJSON_OVERRIDE;
 
     const std::string& Value() const { return m_Number; }
     int ValueInt() const;
     float ValueFloat() const;
     double ValueDouble() const;
+protected:
+    virtual uint64_t ComputeHash() const MINIJSON_OVERRIDE;
+    virtual bool EqualsSameType(const CEntity& other) const MINIJSON_OVERRIDE;
+
 private:
     std::string m_Number;
     friend class CParser;
+    friend class CDomBuilder;
+    friend class CArray::CConstIterator;
 };
 
+class CArray::CConstIterator
+{
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef CEntity value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const CEntity* pointer;
+    typedef const CEntity& reference;
+
+    CConstIterator() : m_Array(NULL), m_Index(0), m_Stashed(-1) {}
+    CConstIterator(const CIterator& it) : m_Array(it.m_Array), m_Position(it.m_Position), m_Index(0), m_Stashed(-1) {}
+    // (the element of a packed array is not copied)
+    CConstIterator(const CConstIterator& other) : m_Array(other.m_Array), m_Position(other.m_Position), m_Index(other.m_Index), m_Stashed(-1) {}
+    CConstIterator& operator=(const CConstIterator& other)
+    {
+        m_Array = other.m_Array;
+        m_Position = other.m_Position;
+        m_Index = other.m_Index;
+        m_Stashed = -1;
+        return *this;
+    }
+
+    reference operator*() const { return m_Array->m_Packed ? PackedElement() : **m_Position; }
+    pointer operator->() const { return &**this; }
+    CConstIterator& operator++() { Next(); return *this; }
+    CConstIterator operator++(int) { CConstIterator it = *this; Next(); return it; }
+    bool operator==(const CConstIterator& other) const { return m_Position == other.m_Position && m_Index == other.m_Index; }
+    bool operator!=(const CConstIterator& other) const { return !(*this == other); }
+
+private:
+    friend class CArray;
+
+    // index: the element of a packed array (the elements of m_Values otherwise)
+    CConstIterator(const CArray* array, TValueVector::const_iterator position, int index) : m_Array(array), m_Position(position), m_Index(index), m_Stashed(-1) {}
+
+    void Next()
+    {
+        if (m_Array->m_Packed)
+        {
+            m_Index++;
+        }
+        else
+        {
+            ++m_Position;
+        }
+    }
+    // formats element m_Index of the packed array into m_Number
+    const CEntity& PackedElement() const;
+
+    const CArray* m_Array;
+    TValueVector::const_iterator m_Position;
+    int m_Index;
+    mutable int m_Stashed; // element in m_Number, -1: none
+    mutable CNumber m_Number;
+};
+
+inline CArray::const_iterator CArray::begin() const { return const_iterator(this, m_Values.begin(), 0); }
+inline CArray::const_iterator CArray::end() const { return const_iterator(this, m_Values.end(), m_Packed ? m_Packed->m_Count : 0); }
+
 class CBoolean : public CEntity
 {
 public:
@@ -277,12 +855,19 @@ public:
     void SetBool(bool b);
 
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const MINIJSON_OVERRIDE;
-    virtual CEntity* Copy() const MINIJSON_OVERRIDE;
+    using CEntity::Copy;
+    virtual CEntity* Copy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+    virtual void Accept(CHandler& handler) const MINIJSON_OVERRIDE;
 
     bool Value() const { return m_Value; }
+protected:
+    virtual uint64_t ComputeHash() const MINIJSON_OVERRIDE;
+    virtual bool EqualsSameType(const CEntity& other) const MINIJSON_OVERRIDE;
+
 private:
     bool m_Value;
     friend class CParser;
+    friend class CDomBuilder;
 };
 
 class CNull : public CEntity
@@ -292,10 +877,105 @@ public:
     virtual ~CNull();
 
     virtual std::string ToString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const MINIJSON_OVERRIDE;
-    virtual CEntity* Copy() const MINIJSON_OVERRIDE;
+    using CEntity::Copy;
+    virtual CEntity* Copy(CAllocator& allocator) const MINIJSON_OVERRIDE;
+    virtual void Accept(CHandler& handler) const MINIJSON_OVERRIDE;
+
+protected:
+    virtual uint64_t ComputeHash() const MINIJSON_OVERRIDE;
+    virtual bool EqualsSameType(const CEntity& other) const MINIJSON_OVERRIDE;
+
+private:
+    friend class CParser;
+    friend class CDomBuilder;
+};
+
+/**
+ * Statistics of one or more parse runs, see CParser::SetStats().
+ * Values accumulate over all parses until Reset() is called.
+ *
+ * Collecting statistics is opt-in: without a CParseStats object the parser only checks a null
+ * pointer, if minijson.cpp is compiled with MINIJSON_NO_PARSE_STATS the statistics code is
+ * removed entirely (and all values stay 0).
+ **/
+class CParseStats
+{
+public:
+    CParseStats();
+
+    void Reset();
+
+    size_t m_Bytes;          // input bytes
+    size_t m_Objects;
+    size_t m_Arrays;
+    size_t m_Strings;        // string values (not object keys)
+    size_t m_Keys;
+    size_t m_Numbers;
+    size_t m_Booleans;
+    size_t m_Nulls;
+    int m_MaxDepth;          // maximum nesting of objects/arrays, 1 for a flat toplevel container
+    size_t m_StringBytes;    // decoded bytes of string values and keys
+    size_t m_Escapes;        // decoded escape sequences in strings and keys
+    size_t m_Allocations;    // entities and string buffers allocated by the parser (allocations
+                             // inside of std::string/std::map/std::vector are not included)
+    size_t m_SharedSubtrees;    // duplicate objects/arrays replaced by a shared one, see
+    size_t m_DeduplicatedBytes; // CParser::SetDeduplicate() (approximate bytes freed)
+    size_t m_PackedArrays;   // CParser::SetPackNumbers()
+    double m_ParseSeconds;
+    double m_TeardownSeconds; // time spent in CParser::Delete()
+};
+
+enum EParseError
+{
+    PARSE_OK = 0,
+    PARSE_ERROR_EMPTY_INPUT,
+    PARSE_ERROR_SYNTAX,                // toplevel value is neither an object nor an array
+    PARSE_ERROR_UNTERMINATED_STRING,   // position: start of the string
+    PARSE_ERROR_INVALID_ESCAPE,        // unknown escape, invalid \u digits or unpaired surrogate
+    PARSE_ERROR_INVALID_UTF8,          // position: first byte of the invalid sequence
+    PARSE_ERROR_EXPECTED_VALUE,
+    PARSE_ERROR_EXPECTED_KEY,          // object keys must be strings
+    PARSE_ERROR_EXPECTED_COLON,
+    PARSE_ERROR_EXPECTED_ARRAY_END,    // ',' or ']' expected
+    PARSE_ERROR_EXPECTED_OBJECT_END,   // ',' or '}' expected
+    PARSE_ERROR_EXTRA_BYTES,
+    PARSE_ERROR_ALLOCATION_FAILED,     // the allocator threw an exception
+    PARSE_ERROR_DEPTH_EXCEEDED         // position: the '[' or '{' beyond the maximum depth
+};
+
+/**
+ * Result of CParser::TryParse() and CParser::Validate(): error code and byte offset only.
+ *
+ * Line, column and surrounding text are computed on request (from the parsed text, which must
+ * still be valid at that time), so rejecting invalid input is cheap.
+ **/
+class CParseResult
+{
+public:
+    CParseResult();
+
+    bool Ok() const { return m_Error == PARSE_OK; }
+    EParseError Error() const { return m_Error; }
+    int Position() const { return m_Position; }
+
+    // short static description of the error code
+    static const char* ErrorString(EParseError error);
+    // message as used by CParseErrorException
+    std::string Message() const;
+    int Line() const;
+    int Column() const;
+    std::string Surrounding() const;
+
+    // throws the CParseErrorException the throwing Parse() would have thrown (if not Ok())
+    void Throw() const;
 
 private:
     friend class CParser;
+
+    EParseError m_Error;
+    int m_Position;
+    const char* m_Text;
+    size_t m_Length;
 };
 
 class CParser
@@ -304,9 +984,64 @@ public:
     CParser();
     virtual ~CParser();
 
+    // throws CParseErrorException for invalid input
     CEntity* Parse(const char* txt, int length = -1);
     CEntity* Parse(const std::string& txt) { return Parse(txt.c_str(), (int) txt.size()); }
 
+    // non-throwing variant: returns NULL and fills result for invalid input (or if the
+    // allocator fails). result refers to txt (see CParseResult), i.e. txt must not be a
+    // temporary if the location of an error is needed.
+    CEntity* TryParse(const char* txt, int length, CParseResult& result) MINIJSON_NOEXCEPT;
+    CEntity* TryParse(const char* txt, CParseResult& result) MINIJSON_NOEXCEPT { return TryParse(txt, -1, result); }
+    CEntity* TryParse(const std::string& txt, CParseResult& result) MINIJSON_NOEXCEPT { return TryParse(txt.c_str(), (int) txt.size(), result); }
+
+    // validate-only: checks txt exactly like Parse() would, but without creating any entities
+    // (and without allocations, except for growing the reused stack of open containers).
+    // Statistics are collected, if enabled.
+    bool Validate(const char* txt, int length, CParseResult& result) MINIJSON_NOEXCEPT;
+    bool Validate(const char* txt, CParseResult& result) MINIJSON_NOEXCEPT { return Validate(txt, -1, result); }
+    bool Validate(const std::string& txt, CParseResult& result) MINIJSON_NOEXCEPT { return Validate(txt.c_str(), (int) txt.size(), result); }
+
+    // the input is checked to be valid UTF-8 (default: true). Disable for legacy input in
+    // other 8 bit encodings (the bytes are passed through unchanged in that case).
+    void SetCheckUTF8(bool check) { m_CheckUTF8 = check; }
+    bool CheckUTF8() const { return m_CheckUTF8; }
+
+    // returns true if data is valid UTF-8 (no overlong forms, surrogates or code points above
+    // U+10FFFF), otherwise invalidPosition (if not NULL) receives the offset of the first
+    // invalid sequence. Uses SSSE3 if the cpu supports it (gcc/clang on x86).
+    static bool IsValidUTF8(const char* data, size_t length, size_t* invalidPosition = NULL);
+
+    // identical objects/arrays below the toplevel value are shared while parsing (default:
+    // false), see CEntity::Deduplicate(). The duplicates are freed as soon as they are complete,
+    // so the peak memory use is reduced as well.
+    void SetDeduplicate(bool deduplicate) { m_Deduplicate = deduplicate; }
+    bool Deduplicate() const { return m_Deduplicate; }
+
+    // arrays of numbers only are stored packed (default: false), see CArray::Pack(). Parsing
+    // them takes no allocations per element.
+    // NOTE: the number text is not kept, packed numbers are written in their shortest form
+    //       ("1.50" as "1.5", "00012" as "12", "1.0" as "1"), i.e. ToString() and the writers
+    //       produce different (equal by CEntity::Equals()) text than for a normal parse. Writing
+    //       packed doubles is slower than writing the text of CNumber elements, as they are
+    //       formatted (about 0.7x the speed of the normal writer for typical measurements).
+    void SetPackNumbers(bool pack) { m_PackNumbers = pack; }
+    bool PackNumbers() const { return m_PackNumbers; }
+
+    // maximum nesting depth of objects/arrays (default: 512, the toplevel value has depth 1),
+    // deeper input fails with PARSE_ERROR_DEPTH_EXCEEDED. The parser itself does not recurse,
+    // but deleting, writing and comparing entities does, i.e. the limit protects those as well.
+    void SetMaxDepth(int depth) { m_MaxDepth = depth; }
+    int MaxDepth() const { return m_MaxDepth; }
+
+    // statistics are collected into stats (if not NULL) by all following Parse() calls.
+    // stats must stay valid while this parser is in use.
+    void SetStats(CParseStats* stats) { m_Stats = stats; }
+    CParseStats* Stats() const { return m_Stats; }
+
+    // deletes an entity returned by Parse(), the time is recorded in the statistics (if any)
+    void Delete(CEntity* ent);
+
     // static convenience functions
     static CEntity* ParseString(const char* txt, int length = -1)
     {
@@ -319,37 +1054,438 @@ public:
         return p.Parse(txt);
     }
 
-    static CEntity* ParseFromFile(const char* path);
-    static CEntity* ParseFromFile(const std::string& path);
+    // gzip and zstd compressed files are decompressed transparently (if supported by this build).
+    // They are parsed by a CStreamParser while decompressing (as are files above 2 GB), so only
+    // the entities are held in memory, parse errors have no surrounding text in that case.
+    // allocator (if not NULL) is used for the file data and the entities.
+    static CEntity* ParseFromFile(const char* path, CAllocator* allocator = NULL);
+    static CEntity* ParseFromFile(const std::string& path, CAllocator* allocator = NULL);
+
+    // entities created by all following Parse() calls are allocated from allocator (NULL for
+    // CAllocator::Default()). allocator must outlive the parsed entities.
+    void SetAllocator(CAllocator* allocator);
+    CAllocator& Allocator() const { return *m_Allocator; }
+
+    // A parser keeps its buffers between Parse() calls, i.e. reusing one parser for many
+    // documents avoids all allocations except the ones of the resulting entities (see also
+    // CParserPool). Frees the buffers if they are larger than keepBytes.
+    void ReleaseBuffers(size_t keepBytes = 0);
 
 private:
+    // all parse functions return NULL/false and set m_Error for invalid input, exceptions are
+    // thrown by the allocator only
+    CEntity* ParseText(const char* txt, int length);
+    CEntity* ParseRoot(const char* txt, int length);
+    bool BeginText(const char* txt, int length);
+    bool EndText();
+    void SetError(EParseError error, int position);
     void SkipWhitespaces();
     bool TryToConsume(const char* txt);
-    void ConsumeOrDie(const char* txt);
-    std::string ParseStringLiteral();
-    CEntity* ParseValue();
-    CArray* ParseArray();
-    CObject* ParseObject();
+    bool Consume(const char* txt, EParseError error);
+    // str may be NULL (validate only)
+    bool ParseStringLiteral(std::string* str);
+    bool SkipNumber();
+    // parses the elements/members of the toplevel container (its '[' or '{' is consumed) and of
+    // all nested containers with m_Frames as stack, returns the complete container
+    CEntity* ParseContainer(bool isObject);
+    // pushes the frame of a container whose '[' or '{' has just been consumed. Returns false
+    // beyond the maximum depth. A packed array is complete at once: it is returned in packed and
+    // no frame is pushed.
+    bool OpenContainer(bool isObject, CArray*& packed);
+    // creates the elements/member order of the container of the top frame (its end has been
+    // consumed) and pops the frame
+    CEntity* CloseContainer();
+    // stores value as the current element/member of the container of the top frame
+    void AddToContainer(CEntity* value);
+    // deletes the containers of all open frames (after an error)
+    void DiscardFrames();
+    // an array of numbers only as a packed array, NULL (at the starting position) for any
+    // other array
+    CArray* ParsePackedArray();
+    // the shared entity identical to the object/array ent while deduplicating, otherwise ent
+    CEntity* Intern(CEntity* ent);
     CNumber* ParseNumber();
     CString* ParseString();
+    // validate-only counterpart of ParseContainer()
+    bool ValidateContainer(bool isObject);
+    // deletes the values on m_ValueStack above base
+    void DiscardValues(size_t base);
 
     int m_Position;
     int m_Length;
     const char* m_Text;
+    EParseError m_Error;
+    int m_ErrorPosition;
+    bool m_CheckUTF8;
+    std::string m_Scratch; // decoded string literal, reused by all strings and keys
+    std::vector<CEntity*> m_ValueStack;        // values of the open arrays
+    std::vector<const std::string*> m_NameStack; // member names of the open objects
+    CParseStats* m_Stats;
+    CAllocator* m_Allocator;
+    bool m_Deduplicate;
+    CInternTable* m_InternTable; // while parsing with m_Deduplicate
+    bool m_PackNumbers;
+    std::vector<int64_t> m_PackedInt64s; // values of the current packed array
+    std::vector<double> m_PackedDoubles;
+
+    struct SFrame
+    {
+        CEntity* m_Container;  // owned until it is complete, NULL while validating
+        size_t m_Base;         // arrays: of m_ValueStack, objects: of m_NameStack
+        bool m_IsObject;
+        CObject::TValueMap::iterator m_Member; // objects: the member whose value is parsed
+    };
+    std::vector<SFrame> m_Frames; // open containers, the toplevel one first
+    int m_MaxDepth;
+};
+
+/**
+ * Receiver of json events (SAX style).
+ *
+ * Readers (e.g. CCborReader, CMsgPackReader) emit events into a handler, writers (CStreamWriter,
+ * CCborWriter, ...) and the CDomBuilder consume them. This allows converting between formats
+ * without an intermediate CEntity tree or text representation.
+ *
+ * sizeHint is the number of members/elements of the container, or -1 if not known in advance.
+ * Strings, keys and numbers are passed as (not null-terminated) utf8 data, numbers in json
+ * text representation.
+ **/
+class CHandler
+{
+public:
+    virtual ~CHandler();
+
+    virtual void StartObject(int sizeHint) = 0;
+    virtual void Key(const char* str, size_t length) = 0;
+    virtual void EndObject() = 0;
+    virtual void StartArray(int sizeHint) = 0;
+    virtual void EndArray() = 0;
+    virtual void String(const char* str, size_t length) = 0;
+    virtual void Number(const char* str, size_t length) = 0;
+    virtual void Boolean(bool b) = 0;
+    virtual void Null() = 0;
+    // count consecutive elements of a packed array (see CArray::IsPacked()) at once, the numbers
+    // in text are separated by ','. The default implementation calls Number() for each.
+    virtual void Numbers(const char* text, size_t length, int count);
 };
+
+/**
+ * Builds a CEntity tree from handler events.
+ **/
+class CDomBuilder : public CHandler
+{
+public:
+    CDomBuilder();
+    virtual ~CDomBuilder();
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void EndObject() MINIJSON_OVERRIDE;
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void EndArray() MINIJSON_OVERRIDE;
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE;
+    virtual void Null() MINIJSON_OVERRIDE;
+
+    // true once a complete toplevel value has been received
+    bool IsComplete() const { return m_Root != NULL && m_Stack.empty(); }
+
+    // returns the root entity and transfers ownership to the caller.
+    CEntity* Release();
+
+    // entities are allocated from allocator (NULL for CAllocator::Default())
+    void SetAllocator(CAllocator* allocator);
+
+private:
+    void AddEntity(CEntity* ent);
+
+    CAllocator* m_Allocator;
+    CEntity* m_Root;
+    std::vector<CEntity*> m_Stack;
+    std::string m_Key;
+    bool m_HasKey;
+};
+
+enum ECompression
+{
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP, // requires minijson.cpp to be built with MINIJSON_WITH_ZLIB (and linked to zlib)
+    COMPRESSION_ZSTD, // requires minijson.cpp to be built with MINIJSON_WITH_ZSTD (and linked to libzstd)
+    COMPRESSION_AUTO  // input: detected from the data, output: selected by file extension (.gz, .zst)
+};
+
+class CInputStream
+{
+public:
+    virtual ~CInputStream();
+
+    // reads up to length bytes into data, returns the number of bytes read (0 at end of stream)
+    virtual size_t Read(char* data, size_t length) = 0;
+};
+
+/**
+ * Input from a FILE. The file is NOT closed by this class.
+ **/
+class CFileInputStream : public CInputStream
+{
+public:
+    CFileInputStream(FILE* file);
+
+    virtual size_t Read(char* data, size_t length) MINIJSON_OVERRIDE;
+
+private:
+    FILE* m_File;
+};
+
+class CMemoryInputStream : public CInputStream
+{
+public:
+    CMemoryInputStream(const void* data, size_t length);
+
+    virtual size_t Read(char* data, size_t length) MINIJSON_OVERRIDE;
+
+private:
+    const char* m_Data;
+    size_t m_Length;
+    size_t m_Position;
+};
+
+/**
+ * Decompresses gzip or zstd data from another stream in bounded chunks.
+ * With COMPRESSION_AUTO the format is detected from the magic bytes, uncompressed data is passed
+ * through unmodified. Concatenated gzip members/zstd frames are decompressed as one stream.
+ **/
+class CDecompressingInputStream : public CInputStream
+{
+public:
+    CDecompressingInputStream(CInputStream& stream, ECompression compression = COMPRESSION_AUTO);
+    virtual ~CDecompressingInputStream();
+
+    virtual size_t Read(char* data, size_t length) MINIJSON_OVERRIDE;
+
+    // the compression of the stream (detected with the first Read() for COMPRESSION_AUTO)
+    ECompression Compression() const { return m_Compression; }
+
+    // true if support for the compression was compiled in
+    static bool IsSupported(ECompression compression);
+
+private:
+    CDecompressingInputStream(const CDecompressingInputStream&);
+    CDecompressingInputStream& operator=(const CDecompressingInputStream&);
+
+    void Init();
+    bool FillInput();
+
+    CInputStream& m_Stream;
+    ECompression m_Compression;
+    bool m_Initialized;
+    bool m_EndOfInput;
+    bool m_Finished;
+    std::vector<char> m_Input;
+    size_t m_InputPos;
+    size_t m_InputEnd;
+    void* m_State;
+};
+
+/**
+ * Incremental (SAX style) parser: reads json text from a stream in chunks and emits it to a
+ * handler in input order, i.e. object members are not sorted and duplicate keys are passed on.
+ * No entities are created, the memory used does not depend on the size of the document but only
+ * on the longest string/number and the nesting depth. E.g. with a CStreamWriter as handler,
+ * documents of any size can be reformatted. The input is checked exactly like CParser does.
+ **/
+class CStreamParser
+{
+public:
+    CStreamParser(size_t bufferSize = 64 * 1024);
+
+    // throws CParseErrorException for invalid input (the events for the input before the error
+    // have been emitted at that point). There is no surrounding text, the exception position is
+    // -1 if the position does not fit into an int (the message contains the full position).
+    void Parse(CInputStream& stream, CHandler& handler);
+
+    // see CParser::SetCheckUTF8()
+    void SetCheckUTF8(bool check) { m_CheckUTF8 = check; }
+    bool CheckUTF8() const { return m_CheckUTF8; }
+
+    // accept a sequence of toplevel values separated by whitespace, e.g. NDJSON (default: false).
+    // The handler receives the values one after the other, empty input is valid.
+    void SetDocumentSequence(bool sequence) { m_DocumentSequence = sequence; }
+    bool DocumentSequence() const { return m_DocumentSequence; }
+
+    // see CParser::SetMaxDepth()
+    void SetMaxDepth(int depth) { m_MaxDepth = depth; }
+    int MaxDepth() const { return m_MaxDepth; }
+
+    // number of bytes consumed by the last Parse()
+    unsigned long long BytesRead() const { return m_Offset + m_Position; }
+
+private:
+    bool Fill();
+    bool EnsureAvailable(size_t count);
+    int SkipWhitespaces();
+    void Fail(EParseError error, unsigned long long position);
+    // the opening " has to be consumed, the result is valid until the next read
+    void ParseStringLiteral(const char** str, size_t* length);
+    void ParseLiteralOrNumber(CHandler& handler);
+    bool TryToConsume(const char* txt);
+
+    CInputStream* m_Stream;
+    std::vector<char> m_Buffer;
+    size_t m_Position;          // in m_Buffer
+    size_t m_End;               // end of the data in m_Buffer
+    unsigned long long m_Offset; // stream position of m_Buffer[0]
+    bool m_EndOfInput;
+    bool m_CheckUTF8;
+    bool m_DocumentSequence;
+    int m_MaxDepth;
+    std::string m_Token;        // strings/numbers that do not fit into the buffer, decoded strings
+    std::vector<char> m_Stack;  // open containers ('{' or '[')
+};
+
+class COutputStream
+{
+public:
+    virtual ~COutputStream();
+
+    virtual void Write(const char* data, size_t length) = 0;
+    virtual void Flush();
+};
+
+class CStringOutputStream : public COutputStream
+{
+public:
+    CStringOutputStream(std::string& str);
+
+    virtual void Write(const char* data, size_t length) MINIJSON_OVERRIDE;
+
+private:
+    std::string& m_String;
+};
+
+/**
+ * Buffered output to a FILE. The file is NOT closed by this class.
+ **/
+class CFileOutputStream : public COutputStream
+{
+public:
+    CFileOutputStream(FILE* file);
+    virtual ~CFileOutputStream();
+
+    virtual void Write(const char* data, size_t length) MINIJSON_OVERRIDE;
+    virtual void Flush() MINIJSON_OVERRIDE;
+
+private:
+    FILE* m_File;
+    std::vector<char> m_Buffer;
+    size_t m_Used;
+};
+
+/**
+ * Compresses all data written to it with gzip or zstd and writes it to another stream in bounded
+ * chunks. Finish() must be called to complete the compressed stream.
+ **/
+class CCompressingOutputStream : public COutputStream
+{
+public:
+    // level: compression level, -1 for the default of the compression library
+    CCompressingOutputStream(COutputStream& stream, ECompression compression, int level = -1);
+    virtual ~CCompressingOutputStream();
+
+    virtual void Write(const char* data, size_t length) MINIJSON_OVERRIDE;
+    // flushes the underlying stream only, use Finish() to complete the compressed data
+    virtual void Flush() MINIJSON_OVERRIDE;
+    void Finish();
+
+    // true if support for the compression was compiled in
+    static bool IsSupported(ECompression compression);
+    // COMPRESSION_GZIP for *.gz, COMPRESSION_ZSTD for *.zst, COMPRESSION_NONE otherwise
+    static ECompression FromFileName(const char* path);
+
+private:
+    CCompressingOutputStream(const CCompressingOutputStream&);
+    CCompressingOutputStream& operator=(const CCompressingOutputStream&);
+
+    void Compress(const char* data, size_t length, bool finish);
+
+    COutputStream& m_Stream;
+    ECompression m_Compression;
+    bool m_Finished;
+    std::vector<char> m_Output;
+    void* m_State;
+};
+
+/**
+ * Handler writing json text to an output stream, using the same format as CEntity::ToString().
+ **/
+class CStreamWriter : public CHandler
+{
+public:
+    CStreamWriter(COutputStream& stream, bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0);
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void EndObject() MINIJSON_OVERRIDE;
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void EndArray() MINIJSON_OVERRIDE;
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE;
+    virtual void Null() MINIJSON_OVERRIDE;
+    virtual void Numbers(const char* text, size_t length, int count) MINIJSON_OVERRIDE;
+
+    // append the json text of a value to out, like the writer does: str as quoted and escaped
+    // string, numbers in the shortest form that reads back as the same value (without exponent).
+    // AppendDouble() throws a CException for values that are not finite.
+    static void AppendString(std::string& out, const char* str, size_t length);
+    static void AppendInt64(std::string& out, int64_t value);
+    static void AppendDouble(std::string& out, double value);
+
+private:
+    friend class CParallelWriter;
+
+    struct SFrame
+    {
+        bool m_IsObject;
+        int m_Count;
+    };
+    void BeginValue();
+    void WriteIndent(int level);
+    void WriteEscaped(const char* str, size_t length);
+
+    COutputStream& m_Stream;
+    bool m_PrettyPrint;
+    std::string m_Indentation;
+    int m_Level;
+    std::vector<SFrame> m_Stack;
+};
+
 class CWriter
 {
 public:
     CWriter(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0);
+    virtual ~CWriter();
 
+    // compression used by WriteToFile(), default is COMPRESSION_AUTO (by file extension, files
+    // are written uncompressed if the compression is not supported by this build).
+    // level: compression level, -1 for the default of the compression library.
+    void SetCompression(ECompression compression, int level = -1);
+
+    virtual void Write(COutputStream& stream, const CEntity& ent);
     void WriteToFile(FILE* file, const CEntity& ent);
     void WriteToFile(const char* path, const CEntity& ent);
     void WriteToFile(const std::string& path, const CEntity& ent);
 
-private:
+protected:
     bool m_PrettyPrint;
     std::string m_Indentation;
     int m_Level;
+    ECompression m_Compression;
+    int m_CompressionLevel;
+
+private:
+    void WriteToFile(FILE* file, const CEntity& ent, ECompression compression);
 };
 
 } // minijson
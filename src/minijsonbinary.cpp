@@ -0,0 +1,1020 @@
+#include "minijsonbinary.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef _WIN32
+#define MJSONsnprintf snprintf
+#else // !_WIN32
+#define MJSONsnprintf sprintf_s
+#endif // !_WIN32
+
+namespace minijson {
+
+// maximum nesting depth accepted by the binary readers (protects the stack from hostile input)
+static const int MAX_DEPTH = 512;
+
+/**
+ * Parses the json text representation of an integer.
+ * Returns false if str is not a plain integer or if its magnitude does not fit into 64 bits.
+ **/
+static bool ParseInteger(const char* str, size_t length, bool& negative, uint64_t& magnitude)
+{
+    size_t i = 0;
+    negative = false;
+    magnitude = 0;
+    if (i < length && str[i] == '-')
+    {
+        negative = true;
+        i++;
+    }
+    if (i == length)
+    {
+        return false;
+    }
+    for (; i < length; i++)
+    {
+        char c = str[i];
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        uint64_t digit = (uint64_t)(c - '0');
+        if (magnitude > (UINT64_MAX - digit) / 10)
+        {
+            return false;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
+    return true;
+}
+
+static double ParseDouble(const char* str, size_t length)
+{
+    char buf[64];
+    if (length < sizeof(buf))
+    {
+        memcpy(buf, str, length);
+        buf[length] = 0;
+        return strtod(buf, NULL);
+    }
+    std::string s(str, length);
+    return strtod(s.c_str(), NULL);
+}
+
+static bool IsFinite(double d)
+{
+    return d == d && d - d == 0.0;
+}
+
+static void Base64UrlEncode(const uint8_t* data, size_t length, std::string& out)
+{
+    static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    out.clear();
+    out.reserve((length + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < length; i += 3)
+    {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        out += chars[(v >> 18) & 63];
+        out += chars[(v >> 12) & 63];
+        out += chars[(v >> 6) & 63];
+        out += chars[v & 63];
+    }
+    if (i + 1 == length)
+    {
+        uint32_t v = (uint32_t)data[i] << 16;
+        out += chars[(v >> 18) & 63];
+        out += chars[(v >> 12) & 63];
+    }
+    else if (i + 2 == length)
+    {
+        uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8);
+        out += chars[(v >> 18) & 63];
+        out += chars[(v >> 12) & 63];
+        out += chars[(v >> 6) & 63];
+    }
+}
+
+static uint64_t ReadBigEndian(const uint8_t* p, size_t bytes)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void WriteBigEndian(uint8_t* p, uint64_t v, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        p[bytes - 1 - i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static double DoubleFromBits(uint64_t bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+static float FloatFromBits(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static double HalfToDouble(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0)
+    {
+        value = ldexp((double)mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = ldexp((double)(mantissa + 1024), exponent - 25);
+    }
+    else
+    {
+        value = mantissa == 0 ? HUGE_VAL : DoubleFromBits(0x7ff8000000000000ULL);
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+// emits a number (or null for nan/inf, which cannot be represented in json)
+static void EmitDouble(CHandler& handler, double d, bool isKey)
+{
+    if (!IsFinite(d))
+    {
+        if (isKey)
+        {
+            handler.Key("null", 4);
+        }
+        else
+        {
+            handler.Null();
+        }
+        return;
+    }
+    // without exponent, the parser does not accept exponents
+    std::string text;
+    CStreamWriter::AppendDouble(text, d);
+    if (isKey)
+    {
+        handler.Key(text.data(), text.size());
+    }
+    else
+    {
+        handler.Number(text.data(), text.size());
+    }
+}
+
+static void EmitInteger(CHandler& handler, bool negative, uint64_t magnitude, bool isKey)
+{
+    // NOTE: negative CBOR integers can have a magnitude of up to 2^64 (-1 - (2^64-1)),
+    //       hence negative values are passed as magnitude-1.
+    char buf[32];
+    int len;
+    if (negative)
+    {
+        if (magnitude == UINT64_MAX)
+        {
+            len = MJSONsnprintf(buf, sizeof(buf), "-18446744073709551616");
+        }
+        else
+        {
+            len = MJSONsnprintf(buf, sizeof(buf), "-%llu", (unsigned long long)(magnitude + 1));
+        }
+    }
+    else
+    {
+        len = MJSONsnprintf(buf, sizeof(buf), "%llu", (unsigned long long)magnitude);
+    }
+    if (isKey)
+    {
+        handler.Key(buf, (size_t)len);
+    }
+    else
+    {
+        handler.Number(buf, (size_t)len);
+    }
+}
+
+static void EmitString(CHandler& handler, const char* str, size_t length, bool isKey)
+{
+    if (isKey)
+    {
+        handler.Key(str, length);
+    }
+    else
+    {
+        handler.String(str, length);
+    }
+}
+
+static void EmitLiteral(CHandler& handler, const char* text, bool isKey)
+{
+    if (isKey)
+    {
+        handler.Key(text, strlen(text));
+    }
+    else if (text[0] == 't')
+    {
+        handler.Boolean(true);
+    }
+    else if (text[0] == 'f')
+    {
+        handler.Boolean(false);
+    }
+    else
+    {
+        handler.Null();
+    }
+}
+
+
+CCborWriter::CCborWriter(COutputStream& stream)
+    : m_Stream(stream)
+{
+}
+void CCborWriter::WriteHead(uint8_t majorType, uint64_t value)
+{
+    uint8_t buf[9];
+    size_t len;
+    if (value < 24)
+    {
+        buf[0] = (uint8_t)((majorType << 5) | value);
+        len = 1;
+    }
+    else if (value <= 0xff)
+    {
+        buf[0] = (uint8_t)((majorType << 5) | 24);
+        buf[1] = (uint8_t)value;
+        len = 2;
+    }
+    else if (value <= 0xffff)
+    {
+        buf[0] = (uint8_t)((majorType << 5) | 25);
+        WriteBigEndian(buf + 1, value, 2);
+        len = 3;
+    }
+    else if (value <= 0xffffffffULL)
+    {
+        buf[0] = (uint8_t)((majorType << 5) | 26);
+        WriteBigEndian(buf + 1, value, 4);
+        len = 5;
+    }
+    else
+    {
+        buf[0] = (uint8_t)((majorType << 5) | 27);
+        WriteBigEndian(buf + 1, value, 8);
+        len = 9;
+    }
+    m_Stream.Write((const char*)buf, len);
+}
+void CCborWriter::StartObject(int sizeHint)
+{
+    if (sizeHint >= 0)
+    {
+        WriteHead(5, (uint64_t)sizeHint);
+        m_Indefinite.push_back(false);
+    }
+    else
+    {
+        m_Stream.Write("\xbf", 1);
+        m_Indefinite.push_back(true);
+    }
+}
+void CCborWriter::Key(const char* str, size_t length)
+{
+    String(str, length);
+}
+void CCborWriter::EndObject()
+{
+    EndArray();
+}
+void CCborWriter::StartArray(int sizeHint)
+{
+    if (sizeHint >= 0)
+    {
+        WriteHead(4, (uint64_t)sizeHint);
+        m_Indefinite.push_back(false);
+    }
+    else
+    {
+        m_Stream.Write("\x9f", 1);
+        m_Indefinite.push_back(true);
+    }
+}
+void CCborWriter::EndArray()
+{
+    if (m_Indefinite.back())
+    {
+        m_Stream.Write("\xff", 1);
+    }
+    m_Indefinite.pop_back();
+}
+void CCborWriter::String(const char* str, size_t length)
+{
+    WriteHead(3, (uint64_t)length);
+    m_Stream.Write(str, length);
+}
+void CCborWriter::Number(const char* str, size_t length)
+{
+    bool negative;
+    uint64_t magnitude;
+    if (ParseInteger(str, length, negative, magnitude))
+    {
+        if (!negative || magnitude == 0)
+        {
+            WriteHead(0, magnitude);
+        }
+        else
+        {
+            WriteHead(1, magnitude - 1);
+        }
+        return;
+    }
+    double d = ParseDouble(str, length);
+    float f = (float)d;
+    uint8_t buf[9];
+    if ((double)f == d)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        buf[0] = 0xfa;
+        WriteBigEndian(buf + 1, bits, 4);
+        m_Stream.Write((const char*)buf, 5);
+    }
+    else
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        buf[0] = 0xfb;
+        WriteBigEndian(buf + 1, bits, 8);
+        m_Stream.Write((const char*)buf, 9);
+    }
+}
+void CCborWriter::Boolean(bool b)
+{
+    m_Stream.Write(b ? "\xf5" : "\xf4", 1);
+}
+void CCborWriter::Null()
+{
+    m_Stream.Write("\xf6", 1);
+}
+std::string CCborWriter::Encode(const CEntity& ent)
+{
+    std::string out;
+    CStringOutputStream stream(out);
+    CCborWriter writer(stream);
+    ent.Accept(writer);
+    return out;
+}
+
+
+CCborReader::CCborReader()
+    : m_Data(NULL),
+      m_Length(0),
+      m_Position(0),
+      m_Handler(NULL)
+{
+}
+void CCborReader::Require(size_t count)
+{
+    if (m_Length - m_Position < count)
+    {
+        throw CParseErrorException(NULL, (int)m_Position, "Unexpected end of CBOR data at position %d", (int)m_Position);
+    }
+}
+uint64_t CCborReader::ReadArgument(uint8_t info)
+{
+    if (info < 24)
+    {
+        return info;
+    }
+    size_t bytes;
+    switch (info)
+    {
+    case 24: bytes = 1; break;
+    case 25: bytes = 2; break;
+    case 26: bytes = 4; break;
+    case 27: bytes = 8; break;
+    default:
+        throw CParseErrorException(NULL, (int)m_Position, "Invalid CBOR additional information %d at position %d", (int)info, (int)m_Position);
+    }
+    Require(bytes);
+    uint64_t v = ReadBigEndian(m_Data + m_Position, bytes);
+    m_Position += bytes;
+    return v;
+}
+void CCborReader::ParseItem(int depth, bool isKey)
+{
+    if (depth > MAX_DEPTH)
+    {
+        throw CParseErrorException(NULL, (int)m_Position, "Maximum nesting depth exceeded at position %d", (int)m_Position);
+    }
+    Require(1);
+    uint8_t initial = m_Data[m_Position++];
+    uint8_t majorType = initial >> 5;
+    uint8_t info = initial & 0x1f;
+    CHandler& handler = *m_Handler;
+
+    switch (majorType)
+    {
+    case 0:
+        EmitInteger(handler, false, ReadArgument(info), isKey);
+        break;
+    case 1:
+        EmitInteger(handler, true, ReadArgument(info), isKey);
+        break;
+    case 2:
+    case 3:
+        {
+            std::string chunks;
+            const char* str;
+            size_t length;
+            if (info == 31)
+            {
+                // indefinite length string: sequence of definite length chunks of the same type
+                while (true)
+                {
+                    Require(1);
+                    if (m_Data[m_Position] == 0xff)
+                    {
+                        m_Position++;
+                        break;
+                    }
+                    uint8_t chunkHead = m_Data[m_Position++];
+                    if ((chunkHead >> 5) != majorType || (chunkHead & 0x1f) == 31)
+                    {
+                        throw CParseErrorException(NULL, (int)m_Position - 1, "Invalid CBOR string chunk at position %d", (int)m_Position - 1);
+                    }
+                    uint64_t chunkLength = ReadArgument(chunkHead & 0x1f);
+                    Require((size_t)chunkLength);
+                    chunks.append((const char*)m_Data + m_Position, (size_t)chunkLength);
+                    m_Position += (size_t)chunkLength;
+                }
+                str = chunks.data();
+                length = chunks.size();
+            }
+            else
+            {
+                uint64_t l = ReadArgument(info);
+                if (l > m_Length - m_Position)
+                {
+                    Require(m_Length - m_Position + 1);
+                }
+                str = (const char*)m_Data + m_Position;
+                length = (size_t)l;
+                m_Position += length;
+            }
+            if (majorType == 2)
+            {
+                Base64UrlEncode((const uint8_t*)str, length, m_Scratch);
+                str = m_Scratch.data();
+                length = m_Scratch.size();
+            }
+            EmitString(handler, str, length, isKey);
+        }
+        break;
+    case 4:
+    case 5:
+        {
+            if (isKey)
+            {
+                throw CParseErrorException(NULL, (int)m_Position - 1, "Unsupported CBOR map key type at position %d", (int)m_Position - 1);
+            }
+            bool isObject = majorType == 5;
+            if (info == 31)
+            {
+                isObject ? handler.StartObject(-1) : handler.StartArray(-1);
+                while (true)
+                {
+                    Require(1);
+                    if (m_Data[m_Position] == 0xff)
+                    {
+                        m_Position++;
+                        break;
+                    }
+                    if (isObject)
+                    {
+                        ParseItem(depth + 1, true);
+                    }
+                    ParseItem(depth + 1, false);
+                }
+            }
+            else
+            {
+                uint64_t count = ReadArgument(info);
+                // every element requires at least one byte, don't trust larger counts
+                if (count > m_Length - m_Position)
+                {
+                    Require(m_Length - m_Position + 1);
+                }
+                isObject ? handler.StartObject((int)count) : handler.StartArray((int)count);
+                for (uint64_t i = 0; i < count; i++)
+                {
+                    if (isObject)
+                    {
+                        ParseItem(depth + 1, true);
+                    }
+                    ParseItem(depth + 1, false);
+                }
+            }
+            isObject ? handler.EndObject() : handler.EndArray();
+        }
+        break;
+    case 6:
+        // tag: emit the tagged item only
+        ReadArgument(info);
+        ParseItem(depth + 1, isKey);
+        break;
+    case 7:
+        switch (info)
+        {
+        case 20: EmitLiteral(handler, "false", isKey); break;
+        case 21: EmitLiteral(handler, "true", isKey); break;
+        case 25:
+            Require(2);
+            EmitDouble(handler, HalfToDouble((uint16_t)ReadBigEndian(m_Data + m_Position, 2)), isKey);
+            m_Position += 2;
+            break;
+        case 26:
+            Require(4);
+            EmitDouble(handler, FloatFromBits((uint32_t)ReadBigEndian(m_Data + m_Position, 4)), isKey);
+            m_Position += 4;
+            break;
+        case 27:
+            Require(8);
+            EmitDouble(handler, DoubleFromBits(ReadBigEndian(m_Data + m_Position, 8)), isKey);
+            m_Position += 8;
+            break;
+        case 28:
+        case 29:
+        case 30:
+        case 31:
+            throw CParseErrorException(NULL, (int)m_Position - 1, "Unexpected CBOR simple value %d at position %d", (int)info, (int)m_Position - 1);
+        default:
+            // null, undefined and unassigned simple values
+            if (info == 24)
+            {
+                Require(1);
+                m_Position++;
+            }
+            EmitLiteral(handler, "null", isKey);
+            break;
+        }
+        break;
+    }
+}
+void CCborReader::Parse(const void* data, size_t length, CHandler& handler)
+{
+    m_Data = (const uint8_t*)data;
+    m_Length = length;
+    m_Position = 0;
+    m_Handler = &handler;
+    if (m_Length == 0)
+    {
+        throw CParseErrorException(NULL, 0, "Empty input");
+    }
+    ParseItem(0, false);
+    if (m_Position != m_Length)
+    {
+        throw CParseErrorException(NULL, (int)m_Position, "Extra bytes at end of CBOR data");
+    }
+}
+CEntity* CCborReader::Parse(const void* data, size_t length)
+{
+    CDomBuilder builder;
+    Parse(data, length, builder);
+    return builder.Release();
+}
+
+
+CMsgPackWriter::CMsgPackWriter(COutputStream& stream)
+    : m_Stream(stream)
+{
+}
+void CMsgPackWriter::Write(const void* data, size_t length)
+{
+    if (!m_Buffers.empty())
+    {
+        m_Buffers.back().append((const char*)data, length);
+    }
+    else
+    {
+        m_Stream.Write((const char*)data, length);
+    }
+}
+// counts array elements of buffered containers (object members are counted in Key())
+void CMsgPackWriter::CountValue()
+{
+    if (!m_Stack.empty() && !m_Stack.back().m_IsObject && m_Stack.back().m_Buffered)
+    {
+        m_Stack.back().m_Count++;
+    }
+}
+void CMsgPackWriter::WriteContainerHead(bool isObject, uint32_t count)
+{
+    uint8_t buf[5];
+    if (count <= 15)
+    {
+        buf[0] = (uint8_t)((isObject ? 0x80 : 0x90) | count);
+        Write(buf, 1);
+    }
+    else if (count <= 0xffff)
+    {
+        buf[0] = isObject ? 0xde : 0xdc;
+        WriteBigEndian(buf + 1, count, 2);
+        Write(buf, 3);
+    }
+    else
+    {
+        buf[0] = isObject ? 0xdf : 0xdd;
+        WriteBigEndian(buf + 1, count, 4);
+        Write(buf, 5);
+    }
+}
+void CMsgPackWriter::StartContainer(bool isObject, int sizeHint)
+{
+    CountValue();
+    SFrame frame;
+    frame.m_IsObject = isObject;
+    frame.m_Buffered = sizeHint < 0;
+    frame.m_Count = 0;
+    if (frame.m_Buffered)
+    {
+        m_Buffers.push_back(std::string());
+    }
+    else
+    {
+        WriteContainerHead(isObject, (uint32_t)sizeHint);
+    }
+    m_Stack.push_back(frame);
+}
+void CMsgPackWriter::EndContainer()
+{
+    SFrame frame = m_Stack.back();
+    m_Stack.pop_back();
+    if (frame.m_Buffered)
+    {
+        std::string content;
+        content.swap(m_Buffers.back());
+        m_Buffers.pop_back();
+        WriteContainerHead(frame.m_IsObject, frame.m_Count);
+        Write(content.data(), content.size());
+    }
+}
+void CMsgPackWriter::StartObject(int sizeHint)
+{
+    StartContainer(true, sizeHint);
+}
+void CMsgPackWriter::Key(const char* str, size_t length)
+{
+    if (m_Stack.back().m_Buffered)
+    {
+        m_Stack.back().m_Count++;
+    }
+    WriteString(str, length);
+}
+void CMsgPackWriter::EndObject()
+{
+    EndContainer();
+}
+void CMsgPackWriter::StartArray(int sizeHint)
+{
+    StartContainer(false, sizeHint);
+}
+void CMsgPackWriter::EndArray()
+{
+    EndContainer();
+}
+void CMsgPackWriter::String(const char* str, size_t length)
+{
+    CountValue();
+    WriteString(str, length);
+}
+void CMsgPackWriter::WriteString(const char* str, size_t length)
+{
+    uint8_t buf[5];
+    if (length <= 31)
+    {
+        buf[0] = (uint8_t)(0xa0 | length);
+        Write(buf, 1);
+    }
+    else if (length <= 0xff)
+    {
+        buf[0] = 0xd9;
+        buf[1] = (uint8_t)length;
+        Write(buf, 2);
+    }
+    else if (length <= 0xffff)
+    {
+        buf[0] = 0xda;
+        WriteBigEndian(buf + 1, length, 2);
+        Write(buf, 3);
+    }
+    else
+    {
+        buf[0] = 0xdb;
+        WriteBigEndian(buf + 1, length, 4);
+        Write(buf, 5);
+    }
+    Write(str, length);
+}
+void CMsgPackWriter::Number(const char* str, size_t length)
+{
+    CountValue();
+    uint8_t buf[9];
+    bool negative;
+    uint64_t magnitude;
+    if (ParseInteger(str, length, negative, magnitude) &&
+        (!negative || magnitude <= 0x8000000000000000ULL))
+    {
+        if (!negative || magnitude == 0)
+        {
+            if (magnitude <= 0x7f)
+            {
+                buf[0] = (uint8_t)magnitude;
+                Write(buf, 1);
+            }
+            else if (magnitude <= 0xff)
+            {
+                buf[0] = 0xcc;
+                buf[1] = (uint8_t)magnitude;
+                Write(buf, 2);
+            }
+            else if (magnitude <= 0xffff)
+            {
+                buf[0] = 0xcd;
+                WriteBigEndian(buf + 1, magnitude, 2);
+                Write(buf, 3);
+            }
+            else if (magnitude <= 0xffffffffULL)
+            {
+                buf[0] = 0xce;
+                WriteBigEndian(buf + 1, magnitude, 4);
+                Write(buf, 5);
+            }
+            else
+            {
+                buf[0] = 0xcf;
+                WriteBigEndian(buf + 1, magnitude, 8);
+                Write(buf, 9);
+            }
+        }
+        else
+        {
+            uint64_t v = ~magnitude + 1; // two's complement of -magnitude
+            if (magnitude <= 32)
+            {
+                buf[0] = (uint8_t)v;
+                Write(buf, 1);
+            }
+            else if (magnitude <= 0x80)
+            {
+                buf[0] = 0xd0;
+                buf[1] = (uint8_t)v;
+                Write(buf, 2);
+            }
+            else if (magnitude <= 0x8000)
+            {
+                buf[0] = 0xd1;
+                WriteBigEndian(buf + 1, v, 2);
+                Write(buf, 3);
+            }
+            else if (magnitude <= 0x80000000ULL)
+            {
+                buf[0] = 0xd2;
+                WriteBigEndian(buf + 1, v, 4);
+                Write(buf, 5);
+            }
+            else
+            {
+                buf[0] = 0xd3;
+                WriteBigEndian(buf + 1, v, 8);
+                Write(buf, 9);
+            }
+        }
+        return;
+    }
+    double d = ParseDouble(str, length);
+    float f = (float)d;
+    if ((double)f == d)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        buf[0] = 0xca;
+        WriteBigEndian(buf + 1, bits, 4);
+        Write(buf, 5);
+    }
+    else
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        buf[0] = 0xcb;
+        WriteBigEndian(buf + 1, bits, 8);
+        Write(buf, 9);
+    }
+}
+void CMsgPackWriter::Boolean(bool b)
+{
+    CountValue();
+    uint8_t c = b ? 0xc3 : 0xc2;
+    Write(&c, 1);
+}
+void CMsgPackWriter::Null()
+{
+    CountValue();
+    uint8_t c = 0xc0;
+    Write(&c, 1);
+}
+std::string CMsgPackWriter::Encode(const CEntity& ent)
+{
+    std::string out;
+    CStringOutputStream stream(out);
+    CMsgPackWriter writer(stream);
+    ent.Accept(writer);
+    return out;
+}
+
+
+CMsgPackReader::CMsgPackReader()
+    : m_Data(NULL),
+      m_Length(0),
+      m_Position(0),
+      m_Handler(NULL)
+{
+}
+void CMsgPackReader::Require(size_t count)
+{
+    if (m_Length - m_Position < count)
+    {
+        throw CParseErrorException(NULL, (int)m_Position, "Unexpected end of MessagePack data at position %d", (int)m_Position);
+    }
+}
+uint64_t CMsgPackReader::ReadUInt(size_t bytes)
+{
+    Require(bytes);
+    uint64_t v = ReadBigEndian(m_Data + m_Position, bytes);
+    m_Position += bytes;
+    return v;
+}
+void CMsgPackReader::ParseItem(int depth, bool isKey)
+{
+    if (depth > MAX_DEPTH)
+    {
+        throw CParseErrorException(NULL, (int)m_Position, "Maximum nesting depth exceeded at position %d", (int)m_Position);
+    }
+    Require(1);
+    int itemPos = (int)m_Position;
+    uint8_t c = m_Data[m_Position++];
+    CHandler& handler = *m_Handler;
+
+    uint64_t length = 0;
+    bool isObject = false;
+    bool isBinary = false;
+    if (c <= 0x7f)
+    {
+        EmitInteger(handler, false, c, isKey);
+        return;
+    }
+    else if (c >= 0xe0)
+    {
+        EmitInteger(handler, true, (uint64_t)(0xff - c), isKey);
+        return;
+    }
+    else if (c <= 0x8f || (c >= 0xde && c <= 0xdf))
+    {
+        isObject = true;
+        length = c <= 0x8f ? (uint64_t)(c & 0x0f) : ReadUInt(c == 0xde ? 2 : 4);
+    }
+    else if (c <= 0x9f || (c >= 0xdc && c <= 0xdd))
+    {
+        length = c <= 0x9f ? (uint64_t)(c & 0x0f) : ReadUInt(c == 0xdc ? 2 : 4);
+    }
+    else
+    {
+        switch (c)
+        {
+        case 0xc0: EmitLiteral(handler, "null", isKey); return;
+        case 0xc2: EmitLiteral(handler, "false", isKey); return;
+        case 0xc3: EmitLiteral(handler, "true", isKey); return;
+        case 0xc4: length = ReadUInt(1); isBinary = true; break;
+        case 0xc5: length = ReadUInt(2); isBinary = true; break;
+        case 0xc6: length = ReadUInt(4); isBinary = true; break;
+        case 0xc7: length = ReadUInt(1) + 1; isBinary = true; break; // ext: type byte + data
+        case 0xc8: length = ReadUInt(2) + 1; isBinary = true; break;
+        case 0xc9: length = ReadUInt(4) + 1; isBinary = true; break;
+        case 0xca: EmitDouble(handler, FloatFromBits((uint32_t)ReadUInt(4)), isKey); return;
+        case 0xcb: EmitDouble(handler, DoubleFromBits(ReadUInt(8)), isKey); return;
+        case 0xcc: EmitInteger(handler, false, ReadUInt(1), isKey); return;
+        case 0xcd: EmitInteger(handler, false, ReadUInt(2), isKey); return;
+        case 0xce: EmitInteger(handler, false, ReadUInt(4), isKey); return;
+        case 0xcf: EmitInteger(handler, false, ReadUInt(8), isKey); return;
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3:
+            {
+                size_t bytes = (size_t)1 << (c - 0xd0);
+                uint64_t v = ReadUInt(bytes);
+                uint64_t signBit = (uint64_t)1 << (bytes * 8 - 1);
+                if (v & signBit)
+                {
+                    // sign extend, then pass -1-v as magnitude (see EmitInteger)
+                    uint64_t extended = bytes == 8 ? v : (v | ~((signBit << 1) - 1));
+                    EmitInteger(handler, true, ~extended, isKey);
+                }
+                else
+                {
+                    EmitInteger(handler, false, v, isKey);
+                }
+            }
+            return;
+        case 0xd4: length = 2; isBinary = true; break; // fixext: type byte + data
+        case 0xd5: length = 3; isBinary = true; break;
+        case 0xd6: length = 5; isBinary = true; break;
+        case 0xd7: length = 9; isBinary = true; break;
+        case 0xd8: length = 17; isBinary = true; break;
+        case 0xd9: length = ReadUInt(1); break;
+        case 0xda: length = ReadUInt(2); break;
+        case 0xdb: length = ReadUInt(4); break;
+        default:
+            if (c >= 0xa0 && c <= 0xbf)
+            {
+                length = c & 0x1f;
+                break;
+            }
+            throw CParseErrorException(NULL, itemPos, "Invalid MessagePack type byte 0x%02x at position %d", (int)c, itemPos);
+        }
+        // strings, binary and ext data
+        Require((size_t)length);
+        const char* str = (const char*)m_Data + m_Position;
+        m_Position += (size_t)length;
+        if (isBinary)
+        {
+            Base64UrlEncode((const uint8_t*)str, (size_t)length, m_Scratch);
+            EmitString(handler, m_Scratch.data(), m_Scratch.size(), isKey);
+        }
+        else
+        {
+            EmitString(handler, str, (size_t)length, isKey);
+        }
+        return;
+    }
+
+    // arrays and maps
+    if (isKey)
+    {
+        throw CParseErrorException(NULL, itemPos, "Unsupported MessagePack map key type at position %d", itemPos);
+    }
+    // every element requires at least one byte, don't trust larger counts
+    if (length > m_Length - m_Position)
+    {
+        Require(m_Length - m_Position + 1);
+    }
+    isObject ? handler.StartObject((int)length) : handler.StartArray((int)length);
+    for (uint64_t i = 0; i < length; i++)
+    {
+        if (isObject)
+        {
+            ParseItem(depth + 1, true);
+        }
+        ParseItem(depth + 1, false);
+    }
+    isObject ? handler.EndObject() : handler.EndArray();
+}
+void CMsgPackReader::Parse(const void* data, size_t length, CHandler& handler)
+{
+    m_Data = (const uint8_t*)data;
+    m_Length = length;
+    m_Position = 0;
+    m_Handler = &handler;
+    if (m_Length == 0)
+    {
+        throw CParseErrorException(NULL, 0, "Empty input");
+    }
+    ParseItem(0, false);
+    if (m_Position != m_Length)
+    {
+        throw CParseErrorException(NULL, (int)m_Position, "Extra bytes at end of MessagePack data");
+    }
+}
+CEntity* CMsgPackReader::Parse(const void* data, size_t length)
+{
+    CDomBuilder builder;
+    Parse(data, length, builder);
+    return builder.Release();
+}
+
+} // minijson
@@ -0,0 +1,158 @@
+#ifndef MINIJSONBINARY_H
+#define MINIJSONBINARY_H
+#include "minijson.h"
+#include <stdint.h>
+
+// optional binary encodings of the json data model:
+//   CBOR (RFC 8949) and MessagePack (https://msgpack.org/)
+// readers emit CHandler events, writers are CHandler implementations, so any combination of
+// CEntity trees, json text writers and binary readers/writers can be connected directly.
+
+namespace minijson {
+
+/**
+ * Writes CBOR to an output stream.
+ *
+ * Containers with a known size (sizeHint >= 0) are written with definite length, others
+ * using indefinite length encoding. Integers are written as CBOR integers if they fit into 64
+ * bits, all other numbers as float32 (if lossless) or float64.
+ **/
+class CCborWriter : public CHandler
+{
+public:
+    CCborWriter(COutputStream& stream);
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void EndObject() MINIJSON_OVERRIDE;
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void EndArray() MINIJSON_OVERRIDE;
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE;
+    virtual void Null() MINIJSON_OVERRIDE;
+
+    // static convenience function
+    static std::string Encode(const CEntity& ent);
+
+private:
+    void WriteHead(uint8_t majorType, uint64_t value);
+
+    COutputStream& m_Stream;
+    std::vector<bool> m_Indefinite;
+};
+
+/**
+ * Decodes a single CBOR data item into handler events.
+ *
+ * Byte strings are emitted as base64url strings, undefined as null. Tags are skipped (the
+ * tagged item itself is emitted), non-string map keys are converted to their json text.
+ **/
+class CCborReader
+{
+public:
+    CCborReader();
+
+    void Parse(const void* data, size_t length, CHandler& handler);
+    CEntity* Parse(const void* data, size_t length);
+    CEntity* Parse(const std::string& data) { return Parse(data.data(), data.size()); }
+
+    // static convenience function
+    static CEntity* Decode(const std::string& data)
+    {
+        CCborReader r;
+        return r.Parse(data);
+    }
+
+private:
+    void ParseItem(int depth, bool isKey);
+    uint64_t ReadArgument(uint8_t info);
+    void Require(size_t count);
+
+    const uint8_t* m_Data;
+    size_t m_Length;
+    size_t m_Position;
+    CHandler* m_Handler;
+    std::string m_Scratch;
+};
+
+/**
+ * Writes MessagePack to an output stream.
+ *
+ * MessagePack requires the size of containers in advance, containers with unknown size
+ * (sizeHint < 0) are therefore buffered in memory until they are complete.
+ **/
+class CMsgPackWriter : public CHandler
+{
+public:
+    CMsgPackWriter(COutputStream& stream);
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void EndObject() MINIJSON_OVERRIDE;
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void EndArray() MINIJSON_OVERRIDE;
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE;
+    virtual void Null() MINIJSON_OVERRIDE;
+
+    // static convenience function
+    static std::string Encode(const CEntity& ent);
+
+private:
+    struct SFrame
+    {
+        bool m_IsObject;
+        bool m_Buffered;
+        uint32_t m_Count;
+    };
+    void CountValue();
+    void Write(const void* data, size_t length);
+    void WriteString(const char* str, size_t length);
+    void WriteContainerHead(bool isObject, uint32_t count);
+    void StartContainer(bool isObject, int sizeHint);
+    void EndContainer();
+
+    COutputStream& m_Stream;
+    std::vector<SFrame> m_Stack;
+    std::vector<std::string> m_Buffers;
+};
+
+/**
+ * Decodes a single MessagePack object into handler events.
+ *
+ * bin and ext data is emitted as base64url strings, non-string map keys are converted to
+ * their json text.
+ **/
+class CMsgPackReader
+{
+public:
+    CMsgPackReader();
+
+    void Parse(const void* data, size_t length, CHandler& handler);
+    CEntity* Parse(const void* data, size_t length);
+    CEntity* Parse(const std::string& data) { return Parse(data.data(), data.size()); }
+
+    // static convenience function
+    static CEntity* Decode(const std::string& data)
+    {
+        CMsgPackReader r;
+        return r.Parse(data);
+    }
+
+private:
+    void ParseItem(int depth, bool isKey);
+    uint64_t ReadUInt(size_t bytes);
+    void Require(size_t count);
+
+    const uint8_t* m_Data;
+    size_t m_Length;
+    size_t m_Position;
+    CHandler* m_Handler;
+    std::string m_Scratch;
+};
+
+} // minijson
+
+#endif
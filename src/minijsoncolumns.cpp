@@ -0,0 +1,474 @@
+#include "minijsoncolumns.h"
+#include <stdlib.h>
+#include <map>
+
+namespace minijson {
+
+static const char* TypeName(EColumnType type)
+{
+    switch (type)
+    {
+    case COLUMN_INT64: return "an integer";
+    case COLUMN_DOUBLE: return "a number";
+    case COLUMN_BOOL: return "a boolean";
+    case COLUMN_STRING: return "a string";
+    }
+    return "?";
+}
+
+/**
+ * Parses an integer (optional '-' and digits only), returns false for other numbers and on
+ * overflow.
+ **/
+static bool ParseInt64(const char* str, size_t length, int64_t& value)
+{
+    size_t i = 0;
+    bool negative = length > 0 && str[0] == '-';
+    if (negative)
+    {
+        i++;
+    }
+    if (i == length)
+    {
+        return false;
+    }
+    // accumulated as a negative number, so the minimum fits as well
+    const int64_t minimum = -9223372036854775807LL - 1;
+    const int64_t limit = minimum / 10;
+    int64_t v = 0;
+    for (; i < length; i++)
+    {
+        int digit = str[i] - '0';
+        if (digit < 0 || digit > 9 || v < limit || v * 10 < minimum + digit)
+        {
+            return false;
+        }
+        v = v * 10 - digit;
+    }
+    if (!negative && v == minimum)
+    {
+        return false;
+    }
+    value = negative ? v : -v;
+    return true;
+}
+
+CColumn::CColumn(const std::string& key, EColumnType type)
+    : m_Key(key),
+      m_Type(type),
+      m_Rows(0),
+      m_NullCount(0)
+{
+    if (m_Type == COLUMN_STRING)
+    {
+        m_Offsets.push_back(0);
+    }
+}
+
+std::string CColumn::StringAt(size_t row) const
+{
+    if (m_Type != COLUMN_STRING || row >= m_Rows)
+    {
+        return std::string();
+    }
+    return m_Chars.substr((size_t)m_Offsets[row], (size_t)(m_Offsets[row + 1] - m_Offsets[row]));
+}
+
+void CColumn::AddRow()
+{
+    switch (m_Type)
+    {
+    case COLUMN_INT64: m_Int64s.push_back(0); break;
+    case COLUMN_DOUBLE: m_Doubles.push_back(0.0); break;
+    case COLUMN_BOOL: m_Bools.push_back(0); break;
+    case COLUMN_STRING: m_Offsets.push_back(m_Chars.size()); break;
+    }
+    if (m_Rows % 8 == 0)
+    {
+        m_Validity.push_back(0);
+    }
+    m_Rows++;
+    m_NullCount++;
+}
+void CColumn::SetValid()
+{
+    size_t row = m_Rows - 1;
+    uint8_t bit = (uint8_t)(1 << (row % 8));
+    if (!(m_Validity[row / 8] & bit))
+    {
+        m_Validity[row / 8] |= bit;
+        m_NullCount--;
+    }
+}
+void CColumn::SetNumber(const char* str, size_t length)
+{
+    if (m_Type == COLUMN_INT64)
+    {
+        if (!ParseInt64(str, length, m_Int64s.back()))
+        {
+            Fail();
+        }
+    }
+    else if (m_Type == COLUMN_DOUBLE)
+    {
+        m_Scratch.assign(str, length);
+        m_Doubles.back() = strtod(m_Scratch.c_str(), NULL);
+    }
+    else
+    {
+        Fail();
+    }
+    SetValid();
+}
+void CColumn::SetString(const char* str, size_t length)
+{
+    if (m_Type != COLUMN_STRING)
+    {
+        Fail();
+    }
+    m_Chars.resize((size_t)m_Offsets[m_Rows - 1]);
+    m_Chars.append(str, length);
+    m_Offsets.back() = m_Chars.size();
+    SetValid();
+}
+void CColumn::SetBool(bool b)
+{
+    if (m_Type != COLUMN_BOOL)
+    {
+        Fail();
+    }
+    m_Bools.back() = b ? 1 : 0;
+    SetValid();
+}
+void CColumn::SetNull()
+{
+    // only needed if the record has the member twice
+    size_t row = m_Rows - 1;
+    uint8_t bit = (uint8_t)(1 << (row % 8));
+    if (m_Validity[row / 8] & bit)
+    {
+        size_t rows = m_Rows;
+        Truncate(rows - 1);
+        AddRow();
+    }
+}
+void CColumn::Fail() const
+{
+    throw CException("column '%s': the value of row %lu is not %s", m_Key.c_str(), (unsigned long)(m_Rows - 1), TypeName(m_Type));
+}
+void CColumn::Truncate(size_t rows)
+{
+    if (rows >= m_Rows)
+    {
+        return;
+    }
+    switch (m_Type)
+    {
+    case COLUMN_INT64: m_Int64s.resize(rows); break;
+    case COLUMN_DOUBLE: m_Doubles.resize(rows); break;
+    case COLUMN_BOOL: m_Bools.resize(rows); break;
+    case COLUMN_STRING:
+        m_Offsets.resize(rows + 1);
+        m_Chars.resize((size_t)m_Offsets.back());
+        break;
+    }
+    m_Validity.resize((rows + 7) / 8);
+    if (rows % 8)
+    {
+        m_Validity.back() &= (uint8_t)((1 << (rows % 8)) - 1);
+    }
+    m_Rows = rows;
+    m_NullCount = rows;
+    for (size_t i = 0; i < m_Validity.size(); i++)
+    {
+        for (uint8_t bits = m_Validity[i]; bits; bits &= (uint8_t)(bits - 1))
+        {
+            m_NullCount--;
+        }
+    }
+}
+
+/**
+ * Handler that fills the columns of a table from the events of a CStreamParser, see
+ * CColumnTable::Extract(CInputStream&).
+ **/
+class CColumnHandler : public CHandler
+{
+public:
+    CColumnHandler(CColumnTable& table);
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void EndObject() MINIJSON_OVERRIDE;
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void EndArray() MINIJSON_OVERRIDE;
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE;
+    virtual void Null() MINIJSON_OVERRIDE;
+
+private:
+    // returns the column a scalar value at the current position belongs to, NULL if it is
+    // ignored. Throws if the value is not a member of a record.
+    CColumn* Target();
+    // a container starts at the current position
+    void Nested();
+
+    CColumnTable& m_Table;
+    std::map<std::string, CColumn*> m_Columns;
+    std::string m_Key;
+    CColumn* m_Column;    // column of the current member of the record, NULL: ignored
+    int m_Depth;          // open containers
+    int m_RecordDepth;    // m_Depth inside the current record, 0: not in a record
+    bool m_ToplevelArray; // the records are the elements of a toplevel array
+};
+
+CColumnHandler::CColumnHandler(CColumnTable& table)
+    : m_Table(table),
+      m_Column(NULL),
+      m_Depth(0),
+      m_RecordDepth(0),
+      m_ToplevelArray(false)
+{
+    for (size_t i = 0; i < table.m_Columns.size(); i++)
+    {
+        m_Columns[table.m_Columns[i]->m_Key] = table.m_Columns[i];
+    }
+}
+CColumn* CColumnHandler::Target()
+{
+    if (m_RecordDepth == 0)
+    {
+        throw CException("record %lu is not an object", (unsigned long)m_Table.m_Rows);
+    }
+    return m_Depth == m_RecordDepth ? m_Column : NULL;
+}
+void CColumnHandler::Nested()
+{
+    CColumn* column = Target();
+    if (column)
+    {
+        column->Fail();
+    }
+}
+void CColumnHandler::StartObject(int sizeHint)
+{
+    (void)sizeHint;
+    if (m_RecordDepth == 0 && m_Depth == (m_ToplevelArray ? 1 : 0))
+    {
+        m_Table.AddRow();
+        m_RecordDepth = m_Depth + 1;
+        m_Column = NULL;
+    }
+    else
+    {
+        Nested();
+    }
+    m_Depth++;
+}
+void CColumnHandler::Key(const char* str, size_t length)
+{
+    if (m_Depth == m_RecordDepth)
+    {
+        m_Key.assign(str, length);
+        std::map<std::string, CColumn*>::const_iterator it = m_Columns.find(m_Key);
+        m_Column = it != m_Columns.end() ? it->second : NULL;
+    }
+}
+void CColumnHandler::EndObject()
+{
+    if (m_Depth == m_RecordDepth)
+    {
+        m_RecordDepth = 0;
+    }
+    m_Depth--;
+}
+void CColumnHandler::StartArray(int sizeHint)
+{
+    (void)sizeHint;
+    if (m_Depth == 0)
+    {
+        m_ToplevelArray = true;
+    }
+    else
+    {
+        Nested();
+    }
+    m_Depth++;
+}
+void CColumnHandler::EndArray()
+{
+    m_Depth--;
+    if (m_Depth == 0)
+    {
+        m_ToplevelArray = false;
+    }
+}
+void CColumnHandler::String(const char* str, size_t length)
+{
+    if (CColumn* column = Target())
+    {
+        column->SetString(str, length);
+    }
+}
+void CColumnHandler::Number(const char* str, size_t length)
+{
+    if (CColumn* column = Target())
+    {
+        column->SetNumber(str, length);
+    }
+}
+void CColumnHandler::Boolean(bool b)
+{
+    if (CColumn* column = Target())
+    {
+        column->SetBool(b);
+    }
+}
+void CColumnHandler::Null()
+{
+    if (CColumn* column = Target())
+    {
+        column->SetNull();
+    }
+}
+
+CColumnTable::CColumnTable()
+    : m_Rows(0)
+{
+}
+CColumnTable::~CColumnTable()
+{
+    for (size_t i = 0; i < m_Columns.size(); i++)
+    {
+        delete m_Columns[i];
+    }
+}
+
+const CColumn& CColumnTable::AddColumn(const std::string& key, EColumnType type)
+{
+    if (Column(key))
+    {
+        throw CException("column '%s' already exists", key.c_str());
+    }
+    CColumn* column = new CColumn(key, type);
+    try
+    {
+        for (size_t i = 0; i < m_Rows; i++)
+        {
+            column->AddRow();
+        }
+        m_Columns.push_back(column);
+    }
+    catch (...)
+    {
+        delete column;
+        throw;
+    }
+    return *column;
+}
+const CColumn* CColumnTable::Column(const std::string& key) const
+{
+    for (size_t i = 0; i < m_Columns.size(); i++)
+    {
+        if (m_Columns[i]->m_Key == key)
+        {
+            return m_Columns[i];
+        }
+    }
+    return NULL;
+}
+
+void CColumnTable::Clear()
+{
+    Truncate(0);
+}
+void CColumnTable::AddRow()
+{
+    for (size_t i = 0; i < m_Columns.size(); i++)
+    {
+        m_Columns[i]->AddRow();
+    }
+    m_Rows++;
+}
+void CColumnTable::Truncate(size_t rows)
+{
+    for (size_t i = 0; i < m_Columns.size(); i++)
+    {
+        m_Columns[i]->Truncate(rows);
+    }
+    m_Rows = rows;
+}
+
+void CColumnTable::Extract(const CArray& records)
+{
+    size_t rows = m_Rows;
+    try
+    {
+        for (int i = 0; i < records.Count(); i++)
+        {
+            const CEntity& record = records.EntityAtIndex(i);
+            if (!record.IsObject())
+            {
+                throw CException("record %lu is not an object", (unsigned long)m_Rows);
+            }
+            AddRow();
+            const CObject& obj = record.Object();
+            for (size_t c = 0; c < m_Columns.size(); c++)
+            {
+                CColumn& column = *m_Columns[c];
+                const CEntity* ent = obj.GetEntity(column.m_Key);
+                if (!ent)
+                {
+                    continue;
+                }
+                if (ent->IsNumber())
+                {
+                    const std::string& num = ent->Number().Value();
+                    column.SetNumber(num.data(), num.size());
+                }
+                else if (ent->IsString())
+                {
+                    const std::string& str = ent->String().Value();
+                    column.SetString(str.data(), str.size());
+                }
+                else if (ent->IsBoolean())
+                {
+                    column.SetBool(ent->Boolean().Value());
+                }
+                else if (!ent->IsNull())
+                {
+                    column.Fail();
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        Truncate(rows);
+        throw;
+    }
+}
+void CColumnTable::Extract(CInputStream& stream)
+{
+    size_t rows = m_Rows;
+    try
+    {
+        CColumnHandler handler(*this);
+        CStreamParser parser;
+        parser.SetDocumentSequence(true);
+        parser.Parse(stream, handler);
+    }
+    catch (...)
+    {
+        Truncate(rows);
+        throw;
+    }
+}
+void CColumnTable::Extract(const char* txt, size_t length)
+{
+    CMemoryInputStream stream(txt, length);
+    Extract(stream);
+}
+
+} // minijson
@@ -0,0 +1,132 @@
+#ifndef MINIJSONCOLUMNS_H
+#define MINIJSONCOLUMNS_H
+#include "minijson.h"
+#include <stdint.h>
+#include <vector>
+
+// optional add-on: columnar (struct of arrays) extraction of arrays of flat records.
+
+namespace minijson {
+
+enum EColumnType
+{
+    COLUMN_INT64,  // integer numbers (no fraction or exponent)
+    COLUMN_DOUBLE, // any number
+    COLUMN_BOOL,
+    COLUMN_STRING
+};
+
+/**
+ * Values of one member of all records of a CColumnTable, in a contiguous buffer of the column
+ * type. Missing members and nulls are null rows: the value is 0 (empty string) and the bit of
+ * the row in the validity bitmap is cleared.
+ **/
+class CColumn
+{
+public:
+    const std::string& Key() const { return m_Key; }
+    EColumnType Type() const { return m_Type; }
+    size_t Rows() const { return m_Rows; }
+
+    // values, one per row (for the column type only, NULL otherwise)
+    const int64_t* Int64s() const { return m_Int64s.empty() ? NULL : &m_Int64s[0]; }
+    const double* Doubles() const { return m_Doubles.empty() ? NULL : &m_Doubles[0]; }
+    const uint8_t* Bools() const { return m_Bools.empty() ? NULL : &m_Bools[0]; } // 0 or 1
+    // COLUMN_STRING: row i is the utf8 data Chars()[Offsets()[i]] .. Chars()[Offsets()[i + 1]]
+    // (not null-terminated), Offsets() has Rows() + 1 entries.
+    const uint64_t* Offsets() const { return m_Offsets.empty() ? NULL : &m_Offsets[0]; }
+    const char* Chars() const { return m_Chars.data(); }
+    std::string StringAt(size_t row) const;
+
+    // bit (row % 8) of byte (row / 8) is set if the row has a value (Arrow layout)
+    const uint8_t* Validity() const { return m_Validity.empty() ? NULL : &m_Validity[0]; }
+    bool IsValid(size_t row) const { return (m_Validity[row / 8] >> (row % 8)) & 1; }
+    size_t NullCount() const { return m_NullCount; }
+
+private:
+    friend class CColumnTable;
+    friend class CColumnHandler;
+
+    CColumn(const std::string& key, EColumnType type);
+
+    // appends a null row
+    void AddRow();
+    // value of the last row (replaces an earlier value of the row)
+    void SetNumber(const char* str, size_t length);
+    void SetString(const char* str, size_t length);
+    void SetBool(bool b);
+    void SetNull();
+    void SetValid();
+    // throws the CException for a value of the wrong type in the last row
+    void Fail() const;
+    // removes the rows from rows on
+    void Truncate(size_t rows);
+
+    std::string m_Key;
+    EColumnType m_Type;
+    size_t m_Rows;
+    size_t m_NullCount;
+    std::vector<int64_t> m_Int64s;
+    std::vector<double> m_Doubles;
+    std::vector<uint8_t> m_Bools;
+    std::vector<uint64_t> m_Offsets;
+    std::string m_Chars;
+    std::vector<uint8_t> m_Validity;
+    std::string m_Scratch; // null-terminated number text
+};
+
+/**
+ * Extracts the members of arrays of flat objects (records) into typed columns in one pass:
+ *
+ *   CColumnTable table;
+ *   const CColumn& price = table.AddColumn("price", COLUMN_DOUBLE);
+ *   table.AddColumn("ts", COLUMN_INT64);
+ *   table.Extract(records);             // a CArray, or json text without building a document
+ *   const double* prices = price.Doubles();
+ *
+ * Every record becomes one row of all columns, members without a column are ignored. A value
+ * of the wrong type (e.g. a string for a COLUMN_DOUBLE column, a fraction for COLUMN_INT64, an
+ * object or array for any column) is an error: Extract() throws a CException and the table keeps
+ * the rows it had before.
+ **/
+class CColumnTable
+{
+public:
+    CColumnTable();
+    ~CColumnTable();
+
+    // adds a column for the member key, the returned column stays valid as long as the table.
+    // Columns added to a table with rows start with null rows.
+    const CColumn& AddColumn(const std::string& key, EColumnType type);
+    int ColumnCount() const { return (int)m_Columns.size(); }
+    const CColumn& Column(int index) const { return *m_Columns[index]; }
+    // NULL if there is no column for key
+    const CColumn* Column(const std::string& key) const;
+
+    size_t Rows() const { return m_Rows; }
+    // removes all rows (the columns are kept)
+    void Clear();
+
+    // appends a row for each element of records, which must be objects
+    void Extract(const CArray& records);
+    // appends the records of json text: an array of objects, or a sequence of objects (NDJSON).
+    // The text is read with a CStreamParser, i.e. no entities are created.
+    void Extract(CInputStream& stream);
+    void Extract(const char* txt, size_t length);
+
+private:
+    CColumnTable(const CColumnTable&);
+    CColumnTable& operator=(const CColumnTable&);
+
+    friend class CColumnHandler;
+
+    void AddRow();
+    void Truncate(size_t rows);
+
+    std::vector<CColumn*> m_Columns;
+    size_t m_Rows;
+};
+
+} // minijson
+
+#endif
@@ -0,0 +1,222 @@
+#include "minijsonindex.h"
+#include <stdint.h>
+
+namespace minijson {
+
+/**
+ * Splits a key path into member names/array indexes: a JSON Pointer if path starts with '/',
+ * a dotted path otherwise. "" has no segments.
+ **/
+static void ParseKeyPath(const std::string& path, std::vector<std::string>& segments)
+{
+    segments.clear();
+    if (path.empty())
+    {
+        return;
+    }
+    if (path[0] != '/')
+    {
+        segments.push_back(std::string());
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            if (path[i] == '.')
+            {
+                segments.push_back(std::string());
+            }
+            else
+            {
+                segments.back() += path[i];
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        char c = path[i];
+        if (c == '/')
+        {
+            segments.push_back(std::string());
+        }
+        else if (c == '~')
+        {
+            char next = i + 1 < path.size() ? path[i + 1] : 0;
+            if (next != '0' && next != '1')
+            {
+                throw CException("invalid escape sequence in key path '%s'", path.c_str());
+            }
+            segments.back() += next == '0' ? '~' : '/';
+            i++;
+        }
+        else
+        {
+            segments.back() += c;
+        }
+    }
+}
+
+/**
+ * Array index of a path segment, -1 if it is not a number.
+ **/
+static int ParseIndex(const std::string& segment)
+{
+    if (segment.empty() || segment.size() > 9)
+    {
+        return -1;
+    }
+    int index = 0;
+    for (size_t i = 0; i < segment.size(); i++)
+    {
+        if (segment[i] < '0' || segment[i] > '9')
+        {
+            return -1;
+        }
+        index = index * 10 + (segment[i] - '0');
+    }
+    return index;
+}
+
+CIndex::CIndex(CArray& array, const std::string& keyPath, EIndexType type)
+    : m_Array(array),
+      m_Type(type),
+      m_Count(0),
+      m_ArrayHash(0)
+{
+    ParseKeyPath(keyPath, m_Path);
+    Build();
+}
+
+void CIndex::Update()
+{
+    if (m_ArrayHash != 0 && m_Array.Hash() == m_ArrayHash)
+    {
+        return;
+    }
+    Build();
+}
+
+void CIndex::Build()
+{
+    m_ArrayHash = 0;
+    m_Count = 0;
+    // hashes all elements (and keys), modified elements only if the array was indexed before
+    uint64_t arrayHash = m_Array.Hash();
+    const CArray& array = m_Array;
+    size_t size = 16;
+    while (size < 2 * (size_t)array.Count())
+    {
+        size *= 2;
+    }
+    SEntry empty = { 0, -1 };
+    m_Slots.assign(size, empty);
+    size_t mask = size - 1;
+    for (int i = 0; i < array.Count(); i++)
+    {
+        const CEntity* key = Key(array.EntityAtIndex(i));
+        if (!key)
+        {
+            continue;
+        }
+        uint64_t hash = key->Hash();
+        size_t slot = Slot(hash);
+        for (; m_Slots[slot].m_Position >= 0; slot = (slot + 1) & mask)
+        {
+            if (m_Type == INDEX_UNIQUE && m_Slots[slot].m_Hash == hash && Key(array.EntityAtIndex(m_Slots[slot].m_Position))->Equals(*key))
+            {
+                int first = m_Slots[slot].m_Position;
+                m_Slots.assign(size, empty);
+                m_Count = 0;
+                throw CException("duplicate key %s at elements %d and %d", key->ToString(false).c_str(), first, i);
+            }
+        }
+        m_Slots[slot].m_Hash = hash;
+        m_Slots[slot].m_Position = i;
+        m_Count++;
+    }
+    m_ArrayHash = arrayHash;
+}
+
+const CEntity* CIndex::Key(const CEntity& element) const
+{
+    const CEntity* ent = &element;
+    for (size_t i = 0; i < m_Path.size() && ent; i++)
+    {
+        if (ent->IsObject())
+        {
+            ent = ent->Object().GetEntity(m_Path[i]);
+        }
+        else if (ent->IsArray())
+        {
+            int index = ParseIndex(m_Path[i]);
+            ent = index >= 0 && index < ent->Count() ? &ent->Array().EntityAtIndex(index) : NULL;
+        }
+        else
+        {
+            ent = NULL;
+        }
+    }
+    return ent;
+}
+
+int CIndex::FindPosition(const CEntity& key)
+{
+    Update();
+    const CArray& array = m_Array;
+    uint64_t hash = key.Hash();
+    size_t mask = m_Slots.size() - 1;
+    for (size_t slot = Slot(hash); m_Slots[slot].m_Position >= 0; slot = (slot + 1) & mask)
+    {
+        const SEntry& entry = m_Slots[slot];
+        if (entry.m_Hash == hash && Key(array.EntityAtIndex(entry.m_Position))->Equals(key))
+        {
+            return entry.m_Position;
+        }
+    }
+    return -1;
+}
+CEntity* CIndex::Find(const CEntity& key)
+{
+    int position = FindPosition(key);
+    return position >= 0 ? &m_Array.EntityAtIndex(position) : NULL;
+}
+CEntity* CIndex::Find(const std::string& key)
+{
+    CString str;
+    str.SetString(key);
+    return Find(str);
+}
+CEntity* CIndex::Find(int key)
+{
+    CNumber num;
+    num.SetInt(key);
+    return Find(num);
+}
+
+void CIndex::FindAll(const CEntity& key, std::vector<CEntity*>& elements)
+{
+    Update();
+    uint64_t hash = key.Hash();
+    size_t mask = m_Slots.size() - 1;
+    // the entries of one key are in array order along the probe sequence
+    for (size_t slot = Slot(hash); m_Slots[slot].m_Position >= 0; slot = (slot + 1) & mask)
+    {
+        const SEntry& entry = m_Slots[slot];
+        if (entry.m_Hash == hash && Key(static_cast<const CArray&>(m_Array).EntityAtIndex(entry.m_Position))->Equals(key))
+        {
+            elements.push_back(&m_Array.EntityAtIndex(entry.m_Position));
+        }
+    }
+}
+void CIndex::FindAll(const std::string& key, std::vector<CEntity*>& elements)
+{
+    CString str;
+    str.SetString(key);
+    FindAll(str, elements);
+}
+void CIndex::FindAll(int key, std::vector<CEntity*>& elements)
+{
+    CNumber num;
+    num.SetInt(key);
+    FindAll(num, elements);
+}
+
+} // minijson
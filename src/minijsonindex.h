@@ -0,0 +1,90 @@
+#ifndef MINIJSONINDEX_H
+#define MINIJSONINDEX_H
+#include "minijson.h"
+#include <vector>
+
+// optional add-on: hash indexes over the elements of arrays.
+
+namespace minijson {
+
+enum EIndexType
+{
+    INDEX_UNIQUE, // duplicate keys are an error
+    INDEX_MULTI   // any number of elements per key
+};
+
+/**
+ * Hash index over the elements of an array by the value at a key path, e.g.
+ *
+ *   CIndex index(users, "id");
+ *   CEntity* user = index.Find("u123");
+ *
+ * The key path is a dotted path ("address.zip") or a JSON Pointer ("/address/zip"), numeric
+ * segments also select array elements, the empty path indexes the elements themselves. Keys
+ * match like CEntity::Equals(), i.e. Find(5) finds "id": 5.0 as well. Elements without a value
+ * at the key path are not indexed.
+ *
+ * The index remembers the structural hash of the array (see CEntity::Hash()) and is rebuilt by
+ * the first lookup after the array or one of its elements was modified (Add*(), Remove(),
+ * SetString(), ...), i.e. it is always consistent with the array. As long as the array is not
+ * modified a lookup costs one hash table probe, the first lookup after a modification hashes
+ * the modified elements and rebuilds the index.
+ *
+ * The array must outlive the index. An index is not thread safe (lookups may rebuild it).
+ * NOTE: like CDiff, modifications that keep the 64 bit hash of the array (extremely unlikely
+ *       for anything but a hash collision) are not detected.
+ **/
+class CIndex
+{
+public:
+    // throws a CException for an invalid key path and (INDEX_UNIQUE) duplicate keys
+    CIndex(CArray& array, const std::string& keyPath, EIndexType type = INDEX_UNIQUE);
+
+    // the lookups call Update() first, i.e. for INDEX_UNIQUE they throw a CException as long
+    // as a modification of the array left duplicate keys (each lookup rebuilds and throws
+    // again until the duplicate is removed)
+
+    // the element with key (INDEX_MULTI: the first one), NULL if there is none
+    CEntity* Find(const CEntity& key);
+    CEntity* Find(const std::string& key);
+    CEntity* Find(const char* key) { return Find(std::string(key)); }
+    CEntity* Find(int key);
+    // position of the element with key in the array (INDEX_MULTI: the first one), -1 if none
+    int FindPosition(const CEntity& key);
+    // appends the elements with key to elements, in array order
+    void FindAll(const CEntity& key, std::vector<CEntity*>& elements);
+    void FindAll(const std::string& key, std::vector<CEntity*>& elements);
+    void FindAll(int key, std::vector<CEntity*>& elements);
+
+    // rebuilds the index if the array was modified, throws a CException for duplicate keys
+    // (INDEX_UNIQUE), the index is empty in that case
+    void Update();
+    // number of indexed elements (as of the last Update())
+    int Count() const { return m_Count; }
+
+    CArray& Array() const { return m_Array; }
+    EIndexType Type() const { return m_Type; }
+
+private:
+    struct SEntry
+    {
+        uint64_t m_Hash;  // hash of the key
+        int m_Position;   // -1: empty slot
+    };
+
+    void Build();
+    const CEntity* Key(const CEntity& element) const;
+    // first slot of the probe sequence of hash
+    size_t Slot(uint64_t hash) const { return (size_t)hash & (m_Slots.size() - 1); }
+
+    CArray& m_Array;
+    EIndexType m_Type;
+    std::vector<std::string> m_Path;
+    std::vector<SEntry> m_Slots; // open addressing, the size is a power of 2
+    int m_Count;
+    uint64_t m_ArrayHash;         // hash of the array the index was built for, 0: none
+};
+
+} // minijson
+
+#endif
@@ -0,0 +1,540 @@
+#include "minijsonparallel.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
+namespace minijson {
+
+// pool and index of the current thread while it executes tasks, nested Run() calls are executed
+// sequentially
+static thread_local CThreadPool* t_Pool = nullptr;
+static thread_local size_t t_Thread = 0;
+
+/**
+ * Indices not yet taken by a thread. The owner takes indices from the front, other threads
+ * steal the back half if their own range is exhausted.
+ **/
+struct alignas(64) SRange
+{
+    std::mutex m_Mutex;
+    size_t m_Begin;
+    size_t m_End;
+};
+
+/**
+ * Sets t_Pool and t_Thread for the lifetime of the object.
+ **/
+class CCurrentThread
+{
+public:
+    CCurrentThread(CThreadPool* pool, size_t thread)
+        : m_Pool(t_Pool),
+          m_Thread(t_Thread)
+    {
+        t_Pool = pool;
+        t_Thread = thread;
+    }
+    ~CCurrentThread()
+    {
+        t_Pool = m_Pool;
+        t_Thread = m_Thread;
+    }
+
+private:
+    CThreadPool* m_Pool;
+    size_t m_Thread;
+};
+
+struct CThreadPool::SJob
+{
+    SJob(size_t count, size_t threads, const std::function<void(size_t, size_t)>& task)
+        : m_Ranges(threads),
+          m_Task(task),
+          m_Failed(false)
+    {
+        // contiguous ranges, so every thread starts with neighbouring inputs
+        for (size_t i = 0; i < threads; i++)
+        {
+            m_Ranges[i].m_Begin = count * i / threads;
+            m_Ranges[i].m_End = count * (i + 1) / threads;
+        }
+    }
+
+    bool Next(size_t thread, size_t& index);
+    bool Steal(size_t thread);
+
+    std::vector<SRange> m_Ranges;
+    const std::function<void(size_t, size_t)>& m_Task;
+    std::atomic<bool> m_Failed;
+    std::mutex m_ErrorMutex;
+    std::exception_ptr m_Error;
+};
+
+bool CThreadPool::SJob::Next(size_t thread, size_t& index)
+{
+    SRange& range = m_Ranges[thread];
+    do
+    {
+        std::lock_guard<std::mutex> lock(range.m_Mutex);
+        if (range.m_Begin < range.m_End)
+        {
+            index = range.m_Begin++;
+            return true;
+        }
+    } while (Steal(thread));
+    return false;
+}
+// moves the back half of another thread's range to the own (empty) range, false if all ranges
+// are empty
+bool CThreadPool::SJob::Steal(size_t thread)
+{
+    for (size_t i = 1; i < m_Ranges.size(); i++)
+    {
+        SRange& victim = m_Ranges[(thread + i) % m_Ranges.size()];
+        size_t begin = 0;
+        size_t end = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim.m_Mutex);
+            if (victim.m_Begin >= victim.m_End)
+            {
+                continue;
+            }
+            begin = victim.m_Begin + (victim.m_End - victim.m_Begin) / 2;
+            end = victim.m_End;
+            victim.m_End = begin;
+        }
+        SRange& own = m_Ranges[thread];
+        std::lock_guard<std::mutex> lock(own.m_Mutex);
+        own.m_Begin = begin;
+        own.m_End = end;
+        return true;
+    }
+    return false;
+}
+
+CThreadPool::CThreadPool(size_t threads)
+    : m_Job(nullptr),
+      m_Generation(0),
+      m_Busy(0),
+      m_Stop(false)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 1; i < threads; i++)
+    {
+        m_Workers.push_back(std::thread(&CThreadPool::WorkerMain, this, i));
+    }
+}
+CThreadPool::~CThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_WakeUp.notify_all();
+    for (size_t i = 0; i < m_Workers.size(); i++)
+    {
+        m_Workers[i].join();
+    }
+}
+void CThreadPool::WorkerMain(size_t thread)
+{
+    CCurrentThread current(this, thread);
+    unsigned long long seen = 0;
+    while (true)
+    {
+        SJob* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeUp.wait(lock, [&]() { return m_Stop || m_Generation != seen; });
+            if (m_Stop)
+            {
+                return;
+            }
+            seen = m_Generation;
+            job = m_Job;
+            if (!job)
+            {
+                continue; // the job was completed before this thread woke up
+            }
+            m_Busy++;
+        }
+        Work(*job, thread);
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Busy--;
+        }
+        m_Done.notify_all();
+    }
+}
+void CThreadPool::Work(SJob& job, size_t thread)
+{
+    size_t index = 0;
+    while (!job.m_Failed && job.Next(thread, index))
+    {
+        try
+        {
+            job.m_Task(index, thread);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(job.m_ErrorMutex);
+            if (!job.m_Error)
+            {
+                job.m_Error = std::current_exception();
+            }
+            job.m_Failed = true;
+        }
+    }
+}
+void CThreadPool::Run(size_t count, const std::function<void(size_t index, size_t thread)>& task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (t_Pool == this)
+    {
+        // nested call: the calling thread keeps its index
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i, t_Thread);
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> runLock(m_RunMutex);
+    bool nested = t_Pool != nullptr; // within a task of another pool
+    CCurrentThread current(this, 0);
+    if (m_Workers.empty() || count == 1 || nested)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i, 0);
+        }
+        return;
+    }
+    SJob job(count, Threads(), task);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Job = &job;
+        m_Generation++;
+    }
+    m_WakeUp.notify_all();
+    Work(job, 0);
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [&]() { return m_Busy == 0; });
+        m_Job = nullptr;
+    }
+    if (job.m_Error)
+    {
+        std::rethrow_exception(job.m_Error);
+    }
+}
+
+struct CParallelWriter::SChild
+{
+    const std::string* m_Key; // NULL for array elements
+    const CEntity* m_Value;
+};
+
+/**
+ * Consecutive children of a container, serialized by one thread.
+ **/
+struct CParallelWriter::STask
+{
+    const std::vector<SChild>* m_Children;
+    size_t m_Begin;
+    size_t m_End;
+    std::vector<CStreamWriter::SFrame> m_Frames; // state of the writer before the first child
+    std::string m_Output;
+};
+
+/**
+ * The output as a sequence of text written by the planning thread (container brackets and keys
+ * of split containers) and task outputs.
+ **/
+struct CParallelWriter::SPlan
+{
+    static const size_t NO_TASK = (size_t)-1;
+
+    struct SSegment
+    {
+        std::string m_Text;
+        size_t m_Task; // written after m_Text, NO_TASK for the final segment
+    };
+
+    SPlan(bool prettyPrint, const std::string& indentation, int level)
+        : m_Stream(m_Text),
+          m_Writer(m_Stream, prettyPrint, indentation, level)
+    {
+    }
+
+    std::string m_Text;
+    CStringOutputStream m_Stream;
+    CStreamWriter m_Writer;
+    std::deque<std::vector<SChild> > m_Children; // children of all split containers
+    std::deque<STask> m_Tasks;
+    std::vector<SSegment> m_Segments;
+};
+
+CParallelWriter::CParallelWriter(CThreadPool& pool, bool prettyPrint, const std::string& indentation, int level)
+    : CWriter(prettyPrint, indentation, level),
+      m_Pool(pool),
+      m_ChunkSize(256 * 1024)
+{
+}
+size_t CParallelWriter::Weight(const CEntity& ent, size_t limit)
+{
+    size_t weight = 2;
+    if (ent.IsObject())
+    {
+        const CObject::TValueMap& values = ent.Object().m_Values;
+        for (CObject::TValueMap::const_iterator it = values.begin(); it != values.end() && weight <= limit; ++it)
+        {
+            weight += it->first.size() + 4 + Weight(*it->second, limit - weight);
+        }
+    }
+    else if (ent.IsArray() && ent.Array().IsPacked())
+    {
+        // (an estimate, without unpacking)
+        weight += (size_t)ent.Count() * 12;
+    }
+    else if (ent.IsArray())
+    {
+        const CArray& arr = ent.Array();
+        for (int i = 0; i < arr.Count() && weight <= limit; i++)
+        {
+            weight += 1 + Weight(arr.EntityAtIndex(i), limit - weight);
+        }
+    }
+    else if (ent.IsString())
+    {
+        weight += ent.StringValue().size();
+    }
+    else if (ent.IsNumber())
+    {
+        weight += ent.Number().Value().size();
+    }
+    else
+    {
+        weight += 3;
+    }
+    return weight;
+}
+void CParallelWriter::CollectChildren(const CEntity& container, std::vector<SChild>& children)
+{
+    if (container.IsObject())
+    {
+        const CObject::TValueMap& values = container.Object().m_Values;
+        children.reserve(values.size());
+        for (CObject::TValueMap::const_iterator it = values.begin(); it != values.end(); ++it)
+        {
+            SChild child = { &it->first, it->second };
+            children.push_back(child);
+        }
+    }
+    else
+    {
+        const CArray& arr = container.Array();
+        children.reserve(arr.Count());
+        for (int i = 0; i < arr.Count(); i++)
+        {
+            SChild child = { NULL, &arr.EntityAtIndex(i) };
+            children.push_back(child);
+        }
+    }
+}
+// writes the brackets of container and splits its children into tasks, large children are split
+// recursively
+void CParallelWriter::Expand(SPlan& plan, const CEntity& container)
+{
+    bool isObject = container.IsObject();
+    if (isObject)
+    {
+        plan.m_Writer.StartObject(container.Count());
+    }
+    else
+    {
+        plan.m_Writer.StartArray(container.Count());
+    }
+    plan.m_Children.push_back(std::vector<SChild>());
+    size_t childrenIndex = plan.m_Children.size() - 1;
+    std::vector<SChild>& children = plan.m_Children.back();
+    CollectChildren(container, children);
+
+    size_t begin = 0;
+    size_t weight = 0;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        const CEntity& child = *children[i].m_Value;
+        size_t childWeight = Weight(child, m_ChunkSize);
+        // (packed arrays are written as a whole)
+        if (childWeight > m_ChunkSize && (child.IsObject() || (child.IsArray() && !child.Array().IsPacked())))
+        {
+            AddTask(plan, childrenIndex, begin, i);
+            if (isObject)
+            {
+                plan.m_Writer.Key(children[i].m_Key->data(), children[i].m_Key->size());
+            }
+            Expand(plan, child);
+            begin = i + 1;
+            weight = 0;
+            continue;
+        }
+        weight += childWeight;
+        if (weight >= m_ChunkSize)
+        {
+            AddTask(plan, childrenIndex, begin, i + 1);
+            begin = i + 1;
+            weight = 0;
+        }
+    }
+    AddTask(plan, childrenIndex, begin, children.size());
+
+    if (isObject)
+    {
+        plan.m_Writer.EndObject();
+    }
+    else
+    {
+        plan.m_Writer.EndArray();
+    }
+}
+void CParallelWriter::AddTask(SPlan& plan, size_t children, size_t begin, size_t end)
+{
+    if (begin == end)
+    {
+        return;
+    }
+    STask task;
+    task.m_Children = &plan.m_Children[children];
+    task.m_Begin = begin;
+    task.m_End = end;
+    task.m_Frames = plan.m_Writer.m_Stack;
+    plan.m_Tasks.push_back(task);
+
+    SPlan::SSegment segment;
+    segment.m_Text.swap(plan.m_Text);
+    segment.m_Task = plan.m_Tasks.size() - 1;
+    plan.m_Segments.push_back(segment);
+
+    // the task writes all children up to end
+    plan.m_Writer.m_Stack.back().m_Count = (int)end;
+}
+void CParallelWriter::RunTask(STask& task)
+{
+    CStringOutputStream stream(task.m_Output);
+    CStreamWriter writer(stream, m_PrettyPrint, m_Indentation, m_Level);
+    writer.m_Stack = task.m_Frames;
+    const std::vector<SChild>& children = *task.m_Children;
+    for (size_t i = task.m_Begin; i < task.m_End; i++)
+    {
+        if (children[i].m_Key)
+        {
+            writer.Key(children[i].m_Key->data(), children[i].m_Key->size());
+        }
+        children[i].m_Value->Accept(writer);
+    }
+}
+void CParallelWriter::Write(COutputStream& stream, const CEntity& ent)
+{
+    if (m_Pool.Threads() == 1 || !(ent.IsObject() || (ent.IsArray() && !ent.Array().IsPacked())) || Weight(ent, m_ChunkSize) <= m_ChunkSize)
+    {
+        CWriter::Write(stream, ent);
+        return;
+    }
+
+    SPlan plan(m_PrettyPrint, m_Indentation, m_Level);
+    Expand(plan, ent);
+    SPlan::SSegment last;
+    last.m_Text.swap(plan.m_Text);
+    last.m_Task = SPlan::NO_TASK;
+    plan.m_Segments.push_back(last);
+
+    // the tasks are run in windows, so only a few task outputs are held in memory at a time
+    size_t window = 4 * m_Pool.Threads();
+    size_t segment = 0;
+    for (size_t first = 0; first < plan.m_Tasks.size(); first += window)
+    {
+        size_t count = std::min(window, plan.m_Tasks.size() - first);
+        m_Pool.Run(count, [&](size_t index, size_t) { RunTask(plan.m_Tasks[first + index]); });
+        for (; segment < plan.m_Segments.size() && plan.m_Segments[segment].m_Task < first + count; segment++)
+        {
+            std::string& output = plan.m_Tasks[plan.m_Segments[segment].m_Task].m_Output;
+            stream.Write(plan.m_Segments[segment].m_Text.data(), plan.m_Segments[segment].m_Text.size());
+            stream.Write(output.data(), output.size());
+            std::string().swap(output);
+        }
+    }
+    for (; segment < plan.m_Segments.size(); segment++)
+    {
+        stream.Write(plan.m_Segments[segment].m_Text.data(), plan.m_Segments[segment].m_Text.size());
+    }
+    stream.Flush();
+}
+
+/**
+ * Parser and arena of one thread of the pool.
+ **/
+struct CBatchParser::SThreadState
+{
+    SThreadState()
+    {
+        m_Parser.SetAllocator(&m_Arena);
+    }
+
+    CArenaAllocator m_Arena;
+    CParser m_Parser;
+};
+
+CBatchParser::CBatchParser(CThreadPool& pool)
+    : m_Pool(pool),
+      m_Errors(0),
+      m_CheckUTF8(true)
+{
+    for (size_t i = 0; i < pool.Threads(); i++)
+    {
+        m_Threads.push_back(std::unique_ptr<SThreadState>(new SThreadState()));
+    }
+}
+CBatchParser::~CBatchParser()
+{
+    Clear();
+}
+void CBatchParser::ParseBatch(const std::vector<std::string>& inputs)
+{
+    Clear();
+    m_Entities.assign(inputs.size(), nullptr);
+    m_Results.assign(inputs.size(), CParseResult());
+    for (size_t i = 0; i < m_Threads.size(); i++)
+    {
+        m_Threads[i]->m_Parser.SetCheckUTF8(m_CheckUTF8);
+    }
+    m_Pool.Run(inputs.size(), [&](size_t index, size_t thread) {
+        m_Entities[index] = m_Threads[thread]->m_Parser.TryParse(inputs[index], m_Results[index]);
+    });
+    for (size_t i = 0; i < m_Results.size(); i++)
+    {
+        if (!m_Results[i].Ok())
+        {
+            m_Errors++;
+        }
+    }
+}
+void CBatchParser::Clear()
+{
+    // deleting arena allocated entities only releases their string data
+    m_Pool.Run(m_Entities.size(), [&](size_t index, size_t) { delete m_Entities[index]; });
+    m_Entities.clear();
+    m_Results.clear();
+    m_Errors = 0;
+    for (size_t i = 0; i < m_Threads.size(); i++)
+    {
+        m_Threads[i]->m_Arena.Rewind();
+    }
+}
+
+} // minijson
@@ -0,0 +1,148 @@
+#ifndef MINIJSONPARALLEL_H
+#define MINIJSONPARALLEL_H
+#include "minijson.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// optional add-on (requires C++11): multi-threaded processing of large documents.
+
+namespace minijson {
+
+/**
+ * Fixed set of worker threads that execute indexed tasks.
+ **/
+class CThreadPool
+{
+public:
+    // threads: total number of threads used by Run() including the calling thread, 0 for
+    // std::thread::hardware_concurrency()
+    explicit CThreadPool(size_t threads = 0);
+    ~CThreadPool();
+
+    size_t Threads() const { return m_Workers.size() + 1; }
+
+    // runs task(index, thread) for every index in [0, count) and returns when all are done.
+    // thread (in [0, Threads())) identifies the executing thread, e.g. to use per-thread data,
+    // the calling thread participates as thread 0. Every thread starts with a contiguous range
+    // of indices and steals from the others when it is done (work stealing). If a task throws,
+    // the remaining tasks are skipped and the first exception is rethrown.
+    // Calls from within a task run sequentially on the calling thread, which keeps its thread
+    // index for tasks of the same pool.
+    void Run(size_t count, const std::function<void(size_t index, size_t thread)>& task);
+
+private:
+    struct SJob;
+
+    CThreadPool(const CThreadPool&);
+    CThreadPool& operator=(const CThreadPool&);
+
+    void WorkerMain(size_t thread);
+    static void Work(SJob& job, size_t thread);
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_RunMutex; // one Run() at a time
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::condition_variable m_Done;
+    SJob* m_Job;
+    unsigned long long m_Generation; // incremented for every job
+    size_t m_Busy;                   // workers working on m_Job
+    bool m_Stop;
+};
+
+/**
+ * CWriter that serializes large documents on a thread pool.
+ *
+ * Containers with a large output are split into tasks (consecutive members/elements of about
+ * SetChunkSize() bytes of output), which are serialized concurrently into separate buffers and
+ * written in order. The output is byte-identical to CWriter (and ToString()) with the same
+ * settings. Small documents are written by the calling thread only.
+ **/
+class CParallelWriter : public CWriter
+{
+public:
+    CParallelWriter(CThreadPool& pool, bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0);
+
+    // approximate output per task in bytes (default 256KB)
+    void SetChunkSize(size_t bytes) { m_ChunkSize = bytes > 0 ? bytes : 1; }
+    size_t ChunkSize() const { return m_ChunkSize; }
+
+    virtual void Write(COutputStream& stream, const CEntity& ent) MINIJSON_OVERRIDE;
+
+    struct SChild;
+    struct STask;
+    struct SPlan;
+
+private:
+    // approximate output size of ent, counting stops as soon as limit is exceeded
+    static size_t Weight(const CEntity& ent, size_t limit);
+    // members/elements of container in output order
+    static void CollectChildren(const CEntity& container, std::vector<SChild>& children);
+    void Expand(SPlan& plan, const CEntity& container);
+    void AddTask(SPlan& plan, size_t children, size_t begin, size_t end);
+    void RunTask(STask& task);
+
+    CThreadPool& m_Pool;
+    size_t m_ChunkSize;
+};
+
+/**
+ * Parses batches of (typically small) documents on a thread pool, e.g. messages taken from a
+ * queue:
+ *
+ *   CBatchParser batch(pool);
+ *   batch.ParseBatch(messages);
+ *   for (size_t i = 0; i < batch.Count(); i++)
+ *       if (batch.Entity(i)) ... else batch.Result(i).Message() ...
+ *
+ * Every thread of the pool uses its own parser and arena (see CArenaAllocator), both are kept
+ * for the following batches, i.e. parsing a batch allocates (almost) no memory besides the
+ * string data of the entities. The entities belong to the batch parser and stay valid until the
+ * next ParseBatch() or Clear() (use Copy() to keep one).
+ **/
+class CBatchParser
+{
+public:
+    explicit CBatchParser(CThreadPool& pool);
+    ~CBatchParser();
+
+    // see CParser::SetCheckUTF8()
+    void SetCheckUTF8(bool check) { m_CheckUTF8 = check; }
+    bool CheckUTF8() const { return m_CheckUTF8; }
+
+    // parses all inputs, the results are in input order. Invalid inputs do not affect the others,
+    // see Result(). inputs must stay valid while the results are used (for the error location).
+    void ParseBatch(const std::vector<std::string>& inputs);
+
+    size_t Count() const { return m_Entities.size(); }
+    // the parsed document, NULL if inputs[index] is invalid
+    CEntity* Entity(size_t index) const { return m_Entities[index]; }
+    const CParseResult& Result(size_t index) const { return m_Results[index]; }
+    // number of invalid inputs in the last batch
+    size_t Errors() const { return m_Errors; }
+
+    // deletes the entities of the last batch
+    void Clear();
+
+    struct SThreadState;
+
+private:
+    CBatchParser(const CBatchParser&);
+    CBatchParser& operator=(const CBatchParser&);
+
+    CThreadPool& m_Pool;
+    std::vector<std::unique_ptr<SThreadState> > m_Threads;
+    std::vector<CEntity*> m_Entities;
+    std::vector<CParseResult> m_Results;
+    size_t m_Errors;
+    bool m_CheckUTF8;
+};
+
+} // minijson
+
+#endif
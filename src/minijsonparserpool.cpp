@@ -0,0 +1,85 @@
+#include "minijsonparserpool.h"
+#include <vector>
+
+namespace minijson {
+
+/**
+ * Idle parsers of the current thread.
+ **/
+struct SIdleParsers
+{
+    ~SIdleParsers()
+    {
+        Clear();
+    }
+    void Clear()
+    {
+        for (size_t i = 0; i < m_Parsers.size(); i++)
+        {
+            delete m_Parsers[i];
+        }
+        m_Parsers.clear();
+    }
+    std::vector<CParser*> m_Parsers;
+};
+static thread_local SIdleParsers t_IdleParsers;
+
+const size_t CParserPool::MAX_IDLE_PARSERS;
+const size_t CParserPool::MAX_KEPT_BUFFER;
+
+CPooledParser::CPooledParser(CParser* parser)
+    : m_Parser(parser)
+{
+}
+CPooledParser::CPooledParser(CPooledParser&& other) noexcept
+    : m_Parser(other.m_Parser)
+{
+    other.m_Parser = nullptr;
+}
+CPooledParser::~CPooledParser()
+{
+    if (m_Parser)
+    {
+        CParserPool::Release(m_Parser);
+    }
+}
+
+CPooledParser CParserPool::Acquire()
+{
+    std::vector<CParser*>& parsers = t_IdleParsers.m_Parsers;
+    if (parsers.empty())
+    {
+        return CPooledParser(new CParser());
+    }
+    CParser* parser = parsers.back();
+    parsers.pop_back();
+    return CPooledParser(parser);
+}
+void CParserPool::Release(CParser* parser)
+{
+    std::vector<CParser*>& parsers = t_IdleParsers.m_Parsers;
+    if (parsers.size() >= MAX_IDLE_PARSERS)
+    {
+        delete parser;
+        return;
+    }
+    parser->SetStats(nullptr);
+    parser->SetAllocator(nullptr);
+    parser->SetCheckUTF8(true);
+    parser->ReleaseBuffers(MAX_KEPT_BUFFER);
+    if (parsers.capacity() == 0)
+    {
+        parsers.reserve(MAX_IDLE_PARSERS);
+    }
+    parsers.push_back(parser);
+}
+size_t CParserPool::IdleParsers()
+{
+    return t_IdleParsers.m_Parsers.size();
+}
+void CParserPool::Clear()
+{
+    t_IdleParsers.Clear();
+}
+
+} // minijson
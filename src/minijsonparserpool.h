@@ -0,0 +1,64 @@
+#ifndef MINIJSONPARSERPOOL_H
+#define MINIJSONPARSERPOOL_H
+#include "minijson.h"
+
+// optional add-on (requires C++11): per-thread pools of reusable parsers.
+
+namespace minijson {
+
+class CParserPool;
+
+/**
+ * Parser taken from the pool of the calling thread, returned to it by the destructor.
+ * Must be destroyed by the thread that acquired it.
+ **/
+class CPooledParser
+{
+public:
+    CPooledParser(CPooledParser&& other) noexcept;
+    ~CPooledParser();
+
+    CParser& operator*() const { return *m_Parser; }
+    CParser* operator->() const { return m_Parser; }
+
+private:
+    friend class CParserPool;
+    explicit CPooledParser(CParser* parser);
+    CPooledParser(const CPooledParser&);
+    CPooledParser& operator=(const CPooledParser&);
+
+    CParser* m_Parser;
+};
+
+/**
+ * Hands out warmed parsers (see CParser::ReleaseBuffers()), e.g. to request handlers that parse
+ * many small documents:
+ *
+ *   CPooledParser parser = CParserPool::Acquire();
+ *   CEntity* e = parser->Parse(request);
+ *
+ * Every thread has its own pool, so acquiring and returning a parser takes no lock. Returned
+ * parsers are reset to the defaults (no statistics, default allocator, UTF-8 check enabled),
+ * idle parsers are deleted at thread exit.
+ **/
+class CParserPool
+{
+public:
+    static CPooledParser Acquire();
+
+    // number of idle parsers of the calling thread
+    static size_t IdleParsers();
+    // deletes the idle parsers of the calling thread
+    static void Clear();
+
+    static const size_t MAX_IDLE_PARSERS = 8;      // per thread, further returned parsers are deleted
+    static const size_t MAX_KEPT_BUFFER = 64 * 1024; // larger buffers are freed when a parser is returned
+
+private:
+    friend class CPooledParser;
+    static void Release(CParser* parser);
+};
+
+} // minijson
+
+#endif
@@ -0,0 +1,847 @@
+#include "minijsonpatch.h"
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <algorithm>
+#include <map>
+
+namespace minijson {
+
+/**
+ * Splits a JSON Pointer into its (unescaped) reference tokens, "" has no tokens.
+ **/
+static void SplitPointer(const std::string& pointer, std::vector<std::string>& tokens)
+{
+    tokens.clear();
+    if (pointer.empty())
+    {
+        return;
+    }
+    if (pointer[0] != '/')
+    {
+        throw CException("invalid JSON Pointer '%s'", pointer.c_str());
+    }
+    tokens.push_back(std::string());
+    for (size_t i = 1; i < pointer.size(); i++)
+    {
+        char c = pointer[i];
+        if (c == '/')
+        {
+            tokens.push_back(std::string());
+        }
+        else if (c == '~')
+        {
+            char next = i + 1 < pointer.size() ? pointer[i + 1] : 0;
+            if (next != '0' && next != '1')
+            {
+                throw CException("invalid escape sequence in JSON Pointer '%s'", pointer.c_str());
+            }
+            tokens.back() += next == '0' ? '~' : '/';
+            i++;
+        }
+        else
+        {
+            tokens.back() += c;
+        }
+    }
+}
+
+/**
+ * Returns the array index of a reference token, -1 if token is not a valid index (digits
+ * without leading zeros).
+ **/
+static int ParseIndex(const std::string& token)
+{
+    if (token.empty() || token.size() > 9 || (token[0] == '0' && token.size() > 1))
+    {
+        return -1;
+    }
+    int index = 0;
+    for (size_t i = 0; i < token.size(); i++)
+    {
+        if (token[i] < '0' || token[i] > '9')
+        {
+            return -1;
+        }
+        index = index * 10 + (token[i] - '0');
+    }
+    return index;
+}
+
+static const CEntity* Child(const CEntity& container, const std::string& token)
+{
+    if (container.IsObject())
+    {
+        return container.Object().GetEntity(token);
+    }
+    if (container.IsArray())
+    {
+        int index = ParseIndex(token);
+        if (index < 0 || index >= container.Count())
+        {
+            return NULL;
+        }
+        return &container.Array().EntityAtIndex(index);
+    }
+    return NULL;
+}
+// Child() for modifications: shared children are replaced by unshared copies (see
+// CEntity::IsShared())
+static CEntity* MutableChild(CEntity& container, const std::string& token)
+{
+    if (container.IsObject())
+    {
+        return container.Object().MutableEntity(token);
+    }
+    if (container.IsArray())
+    {
+        int index = ParseIndex(token);
+        if (index < 0 || index >= container.Count())
+        {
+            return NULL;
+        }
+        return &container.Array().EntityAtIndex(index);
+    }
+    return NULL;
+}
+
+CEntity* ResolvePointer(CEntity& root, const std::string& pointer)
+{
+    std::vector<std::string> tokens;
+    SplitPointer(pointer, tokens);
+    CEntity* ent = &root;
+    for (size_t i = 0; i < tokens.size() && ent; i++)
+    {
+        ent = MutableChild(*ent, tokens[i]);
+    }
+    return ent;
+}
+const CEntity* ResolvePointer(const CEntity& root, const std::string& pointer)
+{
+    std::vector<std::string> tokens;
+    SplitPointer(pointer, tokens);
+    const CEntity* ent = &root;
+    for (size_t i = 0; i < tokens.size() && ent; i++)
+    {
+        ent = Child(*ent, tokens[i]);
+    }
+    return ent;
+}
+
+/**
+ * Applies the operations of a patch one by one and records how to undo them, see ApplyPatch().
+ **/
+class CPatchApplier
+{
+public:
+    explicit CPatchApplier(CEntity& target)
+        : m_Target(target), m_Operation(0)
+    {
+    }
+
+    void Apply(int index, const CEntity& operation);
+    // deletes the entities removed by the patch
+    void Commit();
+    // undoes all operations applied so far
+    void Rollback();
+
+private:
+    // a member of an object or an element of an array
+    struct SLocation
+    {
+        CEntity* m_Container;
+        std::string m_Key;
+        int m_Index;          // array: element index, object: position in the member order (-1: last)
+    };
+    enum EUndo
+    {
+        UNDO_INSERTED,
+        UNDO_REMOVED
+    };
+    struct SUndo
+    {
+        EUndo m_Type;
+        SLocation m_Location;
+        CEntity* m_Entity;
+        bool m_Owned;         // inserted: created by the patch, removed: not relinked by a move
+    };
+
+    const std::string& RequiredString(const CObject& operation, const char* name) const;
+    const CEntity& RequiredValue(const CObject& operation) const;
+    // container and last token of path, for insertion (array index "-" or Count(), new object
+    // member) or for an existing member/element
+    SLocation Locate(const std::string& path, bool insert) const;
+    // inserts ent at location, replacing an existing member of an object
+    void Insert(SLocation location, CEntity* ent, bool owned);
+    CEntity* Detach(SLocation location, bool owned);
+    void Copy(const SLocation& location, const CEntity& value);
+
+    CEntity& m_Target;
+    int m_Operation;
+    std::vector<SUndo> m_Undo;
+};
+
+const std::string& CPatchApplier::RequiredString(const CObject& operation, const char* name) const
+{
+    CEntity* ent = operation.GetEntity(name);
+    if (!ent || !ent->IsString())
+    {
+        throw CException("JSON Patch operation %d: missing string member '%s'", m_Operation, name);
+    }
+    return ent->StringValue();
+}
+const CEntity& CPatchApplier::RequiredValue(const CObject& operation) const
+{
+    CEntity* ent = operation.GetEntity("value");
+    if (!ent)
+    {
+        throw CException("JSON Patch operation %d: missing member 'value'", m_Operation);
+    }
+    return *ent;
+}
+
+CPatchApplier::SLocation CPatchApplier::Locate(const std::string& path, bool insert) const
+{
+    std::vector<std::string> tokens;
+    SplitPointer(path, tokens);
+    if (tokens.empty())
+    {
+        throw CException("JSON Patch operation %d: the root cannot be modified", m_Operation);
+    }
+    CEntity* container = &m_Target;
+    for (size_t i = 0; i + 1 < tokens.size() && container; i++)
+    {
+        container = MutableChild(*container, tokens[i]);
+    }
+    if (!container || (!container->IsObject() && !container->IsArray()))
+    {
+        throw CException("JSON Patch operation %d: path '%s' does not exist", m_Operation, path.c_str());
+    }
+    SLocation location;
+    location.m_Container = container;
+    location.m_Key = tokens.back();
+    location.m_Index = -1;
+    if (container->IsArray())
+    {
+        location.m_Index = insert && location.m_Key == "-" ? container->Count() : ParseIndex(location.m_Key);
+        if (location.m_Index < 0 || location.m_Index > container->Count() || (!insert && location.m_Index == container->Count()))
+        {
+            throw CException("JSON Patch operation %d: invalid array index in path '%s'", m_Operation, path.c_str());
+        }
+    }
+    else if (!insert && !container->Object().Contains(location.m_Key.c_str()))
+    {
+        throw CException("JSON Patch operation %d: path '%s' does not exist", m_Operation, path.c_str());
+    }
+    return location;
+}
+
+void CPatchApplier::Insert(SLocation location, CEntity* ent, bool owned)
+{
+    m_Undo.reserve(m_Undo.size() + 2);
+    if (location.m_Container->IsArray())
+    {
+        location.m_Container->Array().Insert(location.m_Index, ent);
+    }
+    else
+    {
+        CObject& obj = location.m_Container->Object();
+        if (obj.Contains(location.m_Key.c_str()))
+        {
+            // replaced members keep their position in the member order
+            CEntity* old = obj.Detach(location.m_Key.c_str(), &location.m_Index);
+            SUndo undo = { UNDO_REMOVED, location, old, true };
+            m_Undo.push_back(undo);
+        }
+        obj.Insert(location.m_Key.c_str(), ent, location.m_Index);
+    }
+    SUndo undo = { UNDO_INSERTED, location, ent, owned };
+    m_Undo.push_back(undo);
+}
+CEntity* CPatchApplier::Detach(SLocation location, bool owned)
+{
+    m_Undo.reserve(m_Undo.size() + 1);
+    CEntity* ent;
+    if (location.m_Container->IsArray())
+    {
+        ent = location.m_Container->Array().Detach(location.m_Index);
+    }
+    else
+    {
+        ent = location.m_Container->Object().Detach(location.m_Key.c_str(), &location.m_Index);
+    }
+    SUndo undo = { UNDO_REMOVED, location, ent, owned };
+    m_Undo.push_back(undo);
+    return ent;
+}
+void CPatchApplier::Copy(const SLocation& location, const CEntity& value)
+{
+    CEntity* copy;
+    if (location.m_Container->IsArray())
+    {
+        copy = value.Copy(location.m_Container->Array().Allocator());
+    }
+    else
+    {
+        copy = value.Copy(location.m_Container->Object().Allocator());
+    }
+    try
+    {
+        Insert(location, copy, true);
+    }
+    catch (...)
+    {
+        delete copy;
+        throw;
+    }
+}
+
+void CPatchApplier::Apply(int index, const CEntity& operation)
+{
+    m_Operation = index;
+    if (!operation.IsObject())
+    {
+        throw CException("JSON Patch operation %d is not an object", m_Operation);
+    }
+    const CObject& obj = operation.Object();
+    const std::string& op = RequiredString(obj, "op");
+    const std::string& path = RequiredString(obj, "path");
+    if (op == "add")
+    {
+        const CEntity& value = RequiredValue(obj);
+        Copy(Locate(path, true), value);
+    }
+    else if (op == "remove")
+    {
+        Detach(Locate(path, false), true);
+    }
+    else if (op == "replace")
+    {
+        const CEntity& value = RequiredValue(obj);
+        SLocation location = Locate(path, false);
+        if (location.m_Container->IsArray())
+        {
+            Detach(location, true);
+        }
+        Copy(location, value);
+    }
+    else if (op == "move")
+    {
+        const std::string& from = RequiredString(obj, "from");
+        SLocation source = Locate(from, false);
+        if (from == path)
+        {
+            return;
+        }
+        if (path.compare(0, from.size(), from) == 0 && path[from.size()] == '/')
+        {
+            throw CException("JSON Patch operation %d: cannot move '%s' into one of its children", m_Operation, from.c_str());
+        }
+        // relinks the entity, the target location is resolved after the removal (see RFC 6902)
+        CEntity* ent = Detach(source, false);
+        Insert(Locate(path, true), ent, false);
+    }
+    else if (op == "copy")
+    {
+        const std::string& from = RequiredString(obj, "from");
+        const CEntity* source = ResolvePointer(static_cast<const CEntity&>(m_Target), from);
+        if (!source)
+        {
+            throw CException("JSON Patch operation %d: path '%s' does not exist", m_Operation, from.c_str());
+        }
+        Copy(Locate(path, true), *source);
+    }
+    else if (op == "test")
+    {
+        const CEntity& value = RequiredValue(obj);
+        const CEntity* ent = ResolvePointer(static_cast<const CEntity&>(m_Target), path);
+        if (!ent)
+        {
+            throw CException("JSON Patch operation %d: path '%s' does not exist", m_Operation, path.c_str());
+        }
+        if (!ent->Equals(value))
+        {
+            throw CException("JSON Patch operation %d: test of path '%s' failed", m_Operation, path.c_str());
+        }
+    }
+    else
+    {
+        throw CException("JSON Patch operation %d: unknown operation '%s'", m_Operation, op.c_str());
+    }
+}
+
+void CPatchApplier::Commit()
+{
+    for (size_t i = 0; i < m_Undo.size(); i++)
+    {
+        if (m_Undo[i].m_Type == UNDO_REMOVED && m_Undo[i].m_Owned)
+        {
+            delete m_Undo[i].m_Entity;
+        }
+    }
+    m_Undo.clear();
+}
+void CPatchApplier::Rollback()
+{
+    while (!m_Undo.empty())
+    {
+        const SUndo& undo = m_Undo.back();
+        CEntity* container = undo.m_Location.m_Container;
+        if (undo.m_Type == UNDO_INSERTED)
+        {
+            if (container->IsArray())
+            {
+                container->Array().Detach(undo.m_Location.m_Index);
+            }
+            else
+            {
+                container->Object().Detach(undo.m_Location.m_Key.c_str());
+            }
+            if (undo.m_Owned)
+            {
+                delete undo.m_Entity;
+            }
+        }
+        else
+        {
+            if (container->IsArray())
+            {
+                container->Array().Insert(undo.m_Location.m_Index, undo.m_Entity);
+            }
+            else
+            {
+                container->Object().Insert(undo.m_Location.m_Key.c_str(), undo.m_Entity, undo.m_Location.m_Index);
+            }
+        }
+        m_Undo.pop_back();
+    }
+}
+
+void ApplyPatch(CEntity& target, const CArray& patch)
+{
+    CPatchApplier applier(target);
+    try
+    {
+        for (int i = 0; i < patch.Count(); i++)
+        {
+            applier.Apply(i, patch.EntityAtIndex(i));
+        }
+    }
+    catch (...)
+    {
+        applier.Rollback();
+        throw;
+    }
+    applier.Commit();
+}
+
+// appends the escaped reference token to a JSON Pointer
+static void AppendToken(std::string& path, const std::string& token)
+{
+    path += '/';
+    for (size_t i = 0; i < token.size(); i++)
+    {
+        if (token[i] == '~')
+        {
+            path += "~0";
+        }
+        else if (token[i] == '/')
+        {
+            path += "~1";
+        }
+        else
+        {
+            path += token[i];
+        }
+    }
+}
+static void AppendIndex(std::string& path, int index)
+{
+    char digits[16];
+    int count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + index % 10);
+        index /= 10;
+    } while (index > 0);
+    path += '/';
+    while (count > 0)
+    {
+        path += digits[--count];
+    }
+}
+
+/**
+ * Marks the elements of a longest strictly increasing subsequence of values (O(n log n)).
+ **/
+static void LongestIncreasingSubsequence(const std::vector<int>& values, std::vector<bool>& marked)
+{
+    std::vector<int> tails;       // tails[k]: index of the smallest last value of a subsequence of length k + 1
+    std::vector<int> previous(values.size(), -1);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        size_t low = 0;
+        size_t high = tails.size();
+        while (low < high)
+        {
+            size_t mid = (low + high) / 2;
+            if (values[tails[mid]] < values[i])
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        if (low > 0)
+        {
+            previous[i] = tails[low - 1];
+        }
+        if (low == tails.size())
+        {
+            tails.push_back((int)i);
+        }
+        else
+        {
+            tails[low] = (int)i;
+        }
+    }
+    marked.assign(values.size(), false);
+    for (int i = tails.empty() ? -1 : tails.back(); i >= 0; i = previous[i])
+    {
+        marked[i] = true;
+    }
+}
+
+CDiff::CDiff()
+    : m_Patch(NULL)
+{
+}
+
+void CDiff::Diff(const CEntity& a, const CEntity& b, CArray& patch)
+{
+    m_Patch = &patch;
+    std::string path;
+    if (a.Hash() != b.Hash())
+    {
+        DiffEntity(a, b, path);
+    }
+    m_Patch = NULL;
+}
+
+void CDiff::DiffEntity(const CEntity& a, const CEntity& b, std::string& path)
+{
+    if (a.IsObject() && b.IsObject())
+    {
+        DiffObject(a.Object(), b.Object(), path);
+    }
+    else if (a.IsArray() && b.IsArray())
+    {
+        DiffArray(a.Array(), b.Array(), path);
+    }
+    else
+    {
+        AddOperation("replace", path, &b);
+    }
+}
+
+void CDiff::DiffObject(const CObject& a, const CObject& b, std::string& path)
+{
+    size_t length = path.size();
+    std::vector<const std::string*> removed;
+    for (int i = 0; i < a.Count(); i++)
+    {
+        const std::string& name = a.MemberNameByIndex(i);
+        CEntity* other = b.GetEntity(name);
+        if (!other)
+        {
+            removed.push_back(&name);
+            continue;
+        }
+        const CEntity& value = *a.GetEntity(name);
+        if (value.Hash() != other->Hash())
+        {
+            AppendToken(path, name);
+            DiffEntity(value, *other, path);
+            path.resize(length);
+        }
+    }
+
+    // a removed member with the same value as an added one is moved (i.e. renamed)
+    std::multimap<uint64_t, size_t> removedByHash;
+    for (size_t j = 0; j < removed.size(); j++)
+    {
+        removedByHash.insert(std::make_pair(a.GetEntity(*removed[j])->Hash(), j));
+    }
+    for (int i = 0; i < b.Count(); i++)
+    {
+        const std::string& name = b.MemberNameByIndex(i);
+        if (a.GetEntity(name))
+        {
+            continue;
+        }
+        const CEntity& value = *b.GetEntity(name);
+        uint64_t hash = removedByHash.empty() ? 0 : value.Hash();
+        std::multimap<uint64_t, size_t>::iterator it = removedByHash.lower_bound(hash);
+        AppendToken(path, name);
+        if (it != removedByHash.end() && it->first == hash)
+        {
+            std::string from = path.substr(0, length);
+            AppendToken(from, *removed[it->second]);
+            AddOperation("move", path, NULL, &from);
+            removed[it->second] = NULL;
+            removedByHash.erase(it);
+        }
+        else
+        {
+            AddOperation("add", path, &value);
+        }
+        path.resize(length);
+    }
+    for (size_t i = 0; i < removed.size(); i++)
+    {
+        if (removed[i])
+        {
+            AppendToken(path, *removed[i]);
+            AddOperation("remove", path, NULL);
+            path.resize(length);
+        }
+    }
+}
+
+void CDiff::DiffArray(const CArray& a, const CArray& b, std::string& path)
+{
+    size_t length = path.size();
+    int countA = a.Count();
+    int countB = b.Count();
+    std::vector<uint64_t> hashA(countA);
+    std::vector<uint64_t> hashB(countB);
+    for (int i = 0; i < countA; i++)
+    {
+        hashA[i] = a[i].Hash();
+    }
+    for (int i = 0; i < countB; i++)
+    {
+        hashB[i] = b[i].Hash();
+    }
+
+    // unchanged prefix and suffix
+    int begin = 0;
+    while (begin < countA && begin < countB && hashA[begin] == hashB[begin])
+    {
+        begin++;
+    }
+    int endA = countA;
+    int endB = countB;
+    while (endA > begin && endB > begin && hashA[endA - 1] == hashB[endB - 1])
+    {
+        endA--;
+        endB--;
+    }
+
+    // match the remaining elements: by content, by key, then by position (relative to the
+    // previous element).
+    // matchA[i - begin]: index in b of a[i], matchB[j - begin]: index in a of b[j], -1 for none
+    std::vector<int> matchA(endA - begin, -1);
+    std::vector<int> matchB(endB - begin, -1);
+    // (hash, index) of the elements of a, sorted, and the number of matched elements of each
+    // run of equal hashes (the elements of a run are matched in order)
+    std::vector<std::pair<uint64_t, int> > byHash;
+    byHash.reserve(endA - begin);
+    for (int i = begin; i < endA; i++)
+    {
+        byHash.push_back(std::make_pair(hashA[i], i));
+    }
+    std::sort(byHash.begin(), byHash.end());
+    std::vector<int> used(byHash.size(), 0);
+    for (int j = begin; j < endB; j++)
+    {
+        size_t run = std::lower_bound(byHash.begin(), byHash.end(), std::make_pair(hashB[j], INT_MIN)) - byHash.begin();
+        size_t next = run + (run < used.size() ? used[run] : 0);
+        if (next < byHash.size() && byHash[next].first == hashB[j])
+        {
+            used[run]++;
+            matchB[j - begin] = byHash[next].second;
+            matchA[byHash[next].second - begin] = j;
+        }
+    }
+    std::vector<bool> keyedA(endA - begin, false);
+    std::vector<bool> keyedB(endB - begin, false);
+    if (!m_ArrayKey.empty())
+    {
+        std::map<std::string, int> byKey;
+        std::string key;
+        for (int i = begin; i < endA; i++)
+        {
+            keyedA[i - begin] = matchA[i - begin] < 0 && ElementKey(a[i], key);
+            if (keyedA[i - begin])
+            {
+                byKey.insert(std::make_pair(key, i));
+            }
+        }
+        for (int j = begin; j < endB; j++)
+        {
+            keyedB[j - begin] = matchB[j - begin] < 0 && ElementKey(b[j], key);
+            if (keyedB[j - begin])
+            {
+                std::map<std::string, int>::iterator it = byKey.find(key);
+                if (it != byKey.end())
+                {
+                    matchB[j - begin] = it->second;
+                    matchA[it->second - begin] = j;
+                    byKey.erase(it);
+                }
+            }
+        }
+    }
+    for (int j = begin; j < endB; j++)
+    {
+        // an element that follows the same element in a and b (or that is the first one of both)
+        int i = j == begin ? begin : (matchB[j - 1 - begin] >= 0 ? matchB[j - 1 - begin] + 1 : -1);
+        if (matchB[j - begin] >= 0 || keyedB[j - begin] || i < begin || i >= endA || matchA[i - begin] >= 0 || keyedA[i - begin])
+        {
+            continue;
+        }
+        matchB[j - begin] = i;
+        matchA[i - begin] = j;
+    }
+
+    // remove the unmatched elements of a, starting at the end (so the indices stay valid)
+    for (int i = endA - 1; i >= begin; i--)
+    {
+        if (matchA[i - begin] < 0)
+        {
+            AppendIndex(path, i);
+            AddOperation("remove", path, NULL);
+            path.resize(length);
+        }
+    }
+
+    // the remaining elements (identified by their index in b) in their current order. Elements
+    // that are part of a longest increasing subsequence of b indices stay in place, the others
+    // are moved behind their predecessor in b, new elements are added there.
+    std::vector<int> current;
+    for (int i = begin; i < endA; i++)
+    {
+        if (matchA[i - begin] >= 0)
+        {
+            current.push_back(matchA[i - begin]);
+        }
+    }
+    std::vector<bool> stays;
+    LongestIncreasingSubsequence(current, stays);
+    std::vector<bool> staysB(endB - begin, false);
+    for (size_t i = 0; i < current.size(); i++)
+    {
+        staysB[current[i] - begin] = stays[i];
+    }
+    for (int j = begin; j < endB; j++)
+    {
+        if (staysB[j - begin])
+        {
+            continue;
+        }
+        int target = 0;
+        if (j > begin)
+        {
+            target = (int)(std::find(current.begin(), current.end(), j - 1) - current.begin()) + 1;
+        }
+        if (matchB[j - begin] >= 0)
+        {
+            int from = (int)(std::find(current.begin(), current.end(), j) - current.begin());
+            current.erase(current.begin() + from);
+            if (from < target)
+            {
+                target--; // the path of a move is evaluated after the removal
+            }
+            current.insert(current.begin() + target, j);
+            if (from != target)
+            {
+                std::string fromPath = path;
+                AppendIndex(fromPath, begin + from);
+                AppendIndex(path, begin + target);
+                AddOperation("move", path, NULL, &fromPath);
+                path.resize(length);
+            }
+        }
+        else
+        {
+            current.insert(current.begin() + target, j);
+            AppendIndex(path, begin + target);
+            AddOperation("add", path, &b[j]);
+            path.resize(length);
+        }
+    }
+
+    // all elements are at their final position now, diff the changed ones
+    for (int j = begin; j < endB; j++)
+    {
+        int i = matchB[j - begin];
+        if (i >= 0 && hashA[i] != hashB[j])
+        {
+            AppendIndex(path, j);
+            DiffEntity(a[i], b[j], path);
+            path.resize(length);
+        }
+    }
+}
+
+bool CDiff::ElementKey(const CEntity& element, std::string& key) const
+{
+    if (!element.IsObject())
+    {
+        return false;
+    }
+    CEntity* ent = element.Object().GetEntity(m_ArrayKey);
+    if (!ent || (!ent->IsString() && !ent->IsNumber()))
+    {
+        return false;
+    }
+    // strings and numbers with the same text are different keys
+    key = ent->IsString() ? "s" : "n";
+    key += ent->IsString() ? ent->StringValue() : ent->Number().Value();
+    return true;
+}
+
+void CDiff::AddOperation(const char* op, const std::string& path, const CEntity* value, const std::string* from)
+{
+    CObject* operation = m_Patch->AddObject();
+    operation->AddString("op", op);
+    if (from)
+    {
+        operation->AddString("from", from->c_str());
+    }
+    operation->AddString("path", path.c_str());
+    if (value)
+    {
+        CEntity* copy = value->Copy(operation->Allocator());
+        try
+        {
+            operation->Insert("value", copy);
+        }
+        catch (...)
+        {
+            delete copy;
+            throw;
+        }
+    }
+}
+
+CArray* Diff(const CEntity& a, const CEntity& b)
+{
+    CArray* patch = new CArray();
+    try
+    {
+        CDiff diff;
+        diff.Diff(a, b, *patch);
+    }
+    catch (...)
+    {
+        delete patch;
+        throw;
+    }
+    return patch;
+}
+
+} // minijson
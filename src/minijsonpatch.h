@@ -0,0 +1,79 @@
+#ifndef MINIJSONPATCH_H
+#define MINIJSONPATCH_H
+#include "minijson.h"
+
+// optional add-on: JSON Patch (RFC 6902) and JSON Pointer (RFC 6901) on CEntity trees.
+
+namespace minijson {
+
+/**
+ * Applies the JSON Patch patch (an array of operation objects) to target in place.
+ *
+ * Operations: add, remove, replace, move, copy and test. Move relinks the moved entity (no
+ * copy), values of add/replace/copy are copied into the allocator of the target container.
+ * Patches are atomic: if an operation fails (invalid operation, path that does not exist,
+ * failed test, ...) all previous operations are undone and a CException is thrown, i.e. target
+ * is unchanged (including the member order of its objects). Entities removed or replaced by the
+ * patch are deleted when the whole patch has been applied.
+ *
+ * target itself cannot be replaced (or removed), operations on the path "" other than test
+ * fail.
+ **/
+void ApplyPatch(CEntity& target, const CArray& patch);
+
+/**
+ * Computes a JSON Patch that transforms one document into another (see ApplyPatch()):
+ *
+ *   CDiff diff;
+ *   diff.SetArrayKey("id");
+ *   diff.Diff(previous, current, patch);
+ *
+ * Subtrees are compared by their structural hashes (see CEntity::Hash()), identical subtrees are
+ * skipped. As the hashes are cached, diffing consecutive versions of a document only hashes the
+ * modified parts again. Object members are matched by name (a member that was renamed without
+ * change becomes a move), array elements by content (moved elements become moves), then by
+ * SetArrayKey() and finally by position (next to matched elements), matched elements are diffed
+ * recursively. The patch is small but not necessarily minimal.
+ *
+ * NOTE: subtrees with equal 64 bit hashes are considered equal, the patch is wrong in the
+ * (extremely unlikely) case of a hash collision.
+ **/
+class CDiff
+{
+public:
+    CDiff();
+
+    // member name that identifies objects in arrays, e.g. "id". Elements with the same key (a
+    // string or number) are diffed recursively even if they moved. Empty (default): none
+    void SetArrayKey(const std::string& key) { m_ArrayKey = key; }
+    const std::string& ArrayKey() const { return m_ArrayKey; }
+
+    // appends the operations that transform a into b to patch, the values of the operations are
+    // allocated from the allocator of patch. If a and b have different types the patch replaces
+    // the root (path ""), which ApplyPatch() does not support.
+    void Diff(const CEntity& a, const CEntity& b, CArray& patch);
+
+private:
+    void DiffEntity(const CEntity& a, const CEntity& b, std::string& path);
+    void DiffObject(const CObject& a, const CObject& b, std::string& path);
+    void DiffArray(const CArray& a, const CArray& b, std::string& path);
+    bool ElementKey(const CEntity& element, std::string& key) const;
+    void AddOperation(const char* op, const std::string& path, const CEntity* value, const std::string* from = NULL);
+
+    std::string m_ArrayKey;
+    CArray* m_Patch;
+};
+
+// JSON Patch that transforms a into b (see CDiff), heap allocated
+CArray* Diff(const CEntity& a, const CEntity& b);
+
+/**
+ * Resolves the JSON Pointer pointer (e.g. "/items/0/id") in root.
+ * Returns NULL if the pointer does not exist, throws a CException if it is invalid.
+ **/
+CEntity* ResolvePointer(CEntity& root, const std::string& pointer);
+const CEntity* ResolvePointer(const CEntity& root, const std::string& pointer);
+
+} // minijson
+
+#endif
@@ -0,0 +1,317 @@
+#include "minijsonslab.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace minijson {
+
+static const size_t SLAB_SIZE = 64 * 1024;
+static const size_t SMALL_GRANULARITY = 16;
+static const size_t MAX_POOLED_SIZE = 256;
+// number of entries moved between a thread cache and the shared pools at once
+static const size_t CACHE_BATCH = 32;
+
+struct SFreeEntry
+{
+    SFreeEntry* m_Next;
+};
+
+/**
+ * Pools shared by all threads (guarded by m_Mutex), kept alive by the allocator and by all
+ * thread caches that refer to it. The slabs are released with the allocator, the caches left
+ * behind only check m_Destroyed.
+ **/
+struct CSlabAllocator::SShared
+{
+    SShared(CAllocator& parent)
+        : m_Parent(parent),
+          m_BytesReserved(0),
+          m_Destroyed(false)
+    {
+        // exact pools for the entity types, size classes for everything else
+        std::vector<size_t> sizes;
+        sizes.push_back(CEntity::AllocationSize(sizeof(CNumber)));
+        sizes.push_back(CEntity::AllocationSize(sizeof(CString)));
+        sizes.push_back(CEntity::AllocationSize(sizeof(CBoolean)));
+        sizes.push_back(CEntity::AllocationSize(sizeof(CNull)));
+        sizes.push_back(CEntity::AllocationSize(sizeof(CObject)));
+        sizes.push_back(CEntity::AllocationSize(sizeof(CArray)));
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            sizes[i] = (sizes[i] + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+        }
+        for (size_t size = SMALL_GRANULARITY; size <= MAX_POOLED_SIZE; size += SMALL_GRANULARITY)
+        {
+            sizes.push_back(size);
+        }
+        std::sort(sizes.begin(), sizes.end());
+        sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+        while (sizes.back() > MAX_POOLED_SIZE)
+        {
+            sizes.pop_back();
+        }
+        m_EntrySizes = sizes;
+        m_FreeLists.resize(sizes.size(), NULL);
+
+        size_t pool = 0;
+        m_PoolBySize[0] = 0;
+        for (size_t size = 1; size <= MAX_POOLED_SIZE; size++)
+        {
+            if (size > m_EntrySizes[pool])
+            {
+                pool++;
+            }
+            m_PoolBySize[size] = (unsigned char)pool;
+        }
+    }
+    // returns the slabs to the parent, called by the allocator (the parent may be gone after it)
+    void Release()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Destroyed = true;
+        for (size_t i = 0; i < m_Slabs.size(); i++)
+        {
+            m_Parent.Free(m_Slabs[i], SLAB_SIZE);
+        }
+        m_Slabs.clear();
+        std::fill(m_FreeLists.begin(), m_FreeLists.end(), (SFreeEntry*)NULL);
+    }
+
+    // returns up to count entries of pool as a list, mutex must be held
+    SFreeEntry* Take(size_t pool, size_t count, size_t& taken)
+    {
+        if (!m_FreeLists[pool])
+        {
+            AddSlab(pool);
+        }
+        SFreeEntry* first = m_FreeLists[pool];
+        SFreeEntry* last = first;
+        taken = 1;
+        while (taken < count && last->m_Next)
+        {
+            last = last->m_Next;
+            taken++;
+        }
+        m_FreeLists[pool] = last->m_Next;
+        last->m_Next = NULL;
+        return first;
+    }
+    // adds the list first..last to the free entries of pool, mutex must be held
+    void Put(size_t pool, SFreeEntry* first, SFreeEntry* last)
+    {
+        last->m_Next = m_FreeLists[pool];
+        m_FreeLists[pool] = first;
+    }
+    void AddSlab(size_t pool)
+    {
+        m_Slabs.reserve(m_Slabs.size() + 1);
+        char* slab = (char*)m_Parent.Allocate(SLAB_SIZE);
+        m_Slabs.push_back(slab);
+        m_BytesReserved += SLAB_SIZE;
+        size_t entrySize = m_EntrySizes[pool];
+        for (size_t pos = 0; pos + entrySize <= SLAB_SIZE; pos += entrySize)
+        {
+            SFreeEntry* entry = (SFreeEntry*)(slab + pos);
+            entry->m_Next = m_FreeLists[pool];
+            m_FreeLists[pool] = entry;
+        }
+    }
+
+    CAllocator& m_Parent;
+    std::mutex m_Mutex;
+    unsigned char m_PoolBySize[MAX_POOLED_SIZE + 1];
+    std::vector<size_t> m_EntrySizes;
+    std::vector<SFreeEntry*> m_FreeLists;
+    std::vector<void*> m_Slabs;
+    std::atomic<size_t> m_BytesReserved;
+    std::atomic<bool> m_Destroyed; // the allocator and its slabs are gone, only thread caches refer to this
+};
+
+/**
+ * Free entries of one thread for one allocator.
+ **/
+struct CSlabAllocator::SThreadCache
+{
+    SThreadCache(const std::shared_ptr<SShared>& shared)
+        : m_Shared(shared),
+          m_Lists(shared->m_EntrySizes.size(), NULL),
+          m_Counts(shared->m_EntrySizes.size(), 0)
+    {
+    }
+    ~SThreadCache()
+    {
+        Flush();
+    }
+    void Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+        if (m_Shared->m_Destroyed)
+        {
+            // the entries point into released slabs, they are dropped without touching them
+            std::fill(m_Lists.begin(), m_Lists.end(), (SFreeEntry*)NULL);
+            std::fill(m_Counts.begin(), m_Counts.end(), 0);
+            return;
+        }
+        for (size_t pool = 0; pool < m_Lists.size(); pool++)
+        {
+            SFreeEntry* first = m_Lists[pool];
+            if (!first)
+            {
+                continue;
+            }
+            SFreeEntry* last = first;
+            while (last->m_Next)
+            {
+                last = last->m_Next;
+            }
+            m_Shared->Put(pool, first, last);
+            m_Lists[pool] = NULL;
+            m_Counts[pool] = 0;
+        }
+    }
+
+    std::shared_ptr<SShared> m_Shared;
+    std::vector<SFreeEntry*> m_Lists;
+    std::vector<size_t> m_Counts;
+};
+
+/**
+ * All thread caches of the current thread, returned to their allocators at thread exit.
+ **/
+struct SThreadCaches
+{
+    ~SThreadCaches()
+    {
+        for (size_t i = 0; i < m_Caches.size(); i++)
+        {
+            delete m_Caches[i];
+        }
+    }
+    std::vector<CSlabAllocator::SThreadCache*> m_Caches;
+};
+static thread_local SThreadCaches t_ThreadCaches;
+
+CSlabAllocator::CSlabAllocator(bool threadCaches, CAllocator& parent)
+    : m_Shared(std::make_shared<SShared>(parent)),
+      m_ThreadCaches(threadCaches)
+{
+}
+CSlabAllocator::~CSlabAllocator()
+{
+    // caches of other threads are dropped with their next cache miss or at thread exit, without
+    // touching their entries or the parent
+    m_Shared->Release();
+    std::vector<SThreadCache*>& caches = t_ThreadCaches.m_Caches;
+    for (size_t i = 0; i < caches.size(); i++)
+    {
+        if (caches[i]->m_Shared == m_Shared)
+        {
+            delete caches[i];
+            caches.erase(caches.begin() + i);
+            break;
+        }
+    }
+}
+CSlabAllocator::SThreadCache* CSlabAllocator::ThreadCache()
+{
+    std::vector<SThreadCache*>& caches = t_ThreadCaches.m_Caches;
+    for (size_t i = 0; i < caches.size(); i++)
+    {
+        if (caches[i]->m_Shared == m_Shared)
+        {
+            return caches[i];
+        }
+    }
+    // first use of this allocator by this thread: drop caches of destroyed allocators
+    for (size_t i = caches.size(); i > 0; i--)
+    {
+        if (caches[i - 1]->m_Shared->m_Destroyed)
+        {
+            delete caches[i - 1];
+            caches.erase(caches.begin() + (i - 1));
+        }
+    }
+    caches.reserve(caches.size() + 1);
+    SThreadCache* cache = new SThreadCache(m_Shared);
+    caches.push_back(cache);
+    return cache;
+}
+void* CSlabAllocator::Allocate(size_t size)
+{
+    if (size == 0 || size > MAX_POOLED_SIZE)
+    {
+        return m_Shared->m_Parent.Allocate(size);
+    }
+    size_t pool = m_Shared->m_PoolBySize[size];
+    if (!m_ThreadCaches)
+    {
+        std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+        size_t taken;
+        return m_Shared->Take(pool, 1, taken);
+    }
+    SThreadCache* cache = ThreadCache();
+    SFreeEntry* entry = cache->m_Lists[pool];
+    if (!entry)
+    {
+        std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+        entry = m_Shared->Take(pool, CACHE_BATCH, cache->m_Counts[pool]);
+    }
+    cache->m_Lists[pool] = entry->m_Next;
+    cache->m_Counts[pool]--;
+    return entry;
+}
+void CSlabAllocator::Free(void* ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (size == 0 || size > MAX_POOLED_SIZE)
+    {
+        m_Shared->m_Parent.Free(ptr, size);
+        return;
+    }
+    size_t pool = m_Shared->m_PoolBySize[size];
+    SFreeEntry* entry = (SFreeEntry*)ptr;
+    if (!m_ThreadCaches)
+    {
+        std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+        m_Shared->Put(pool, entry, entry);
+        return;
+    }
+    SThreadCache* cache = ThreadCache();
+    entry->m_Next = cache->m_Lists[pool];
+    cache->m_Lists[pool] = entry;
+    if (++cache->m_Counts[pool] > 2 * CACHE_BATCH)
+    {
+        // return a batch, the thread keeps enough entries for the next allocations
+        SFreeEntry* last = entry;
+        for (size_t i = 1; i < CACHE_BATCH; i++)
+        {
+            last = last->m_Next;
+        }
+        cache->m_Lists[pool] = last->m_Next;
+        cache->m_Counts[pool] -= CACHE_BATCH;
+        std::lock_guard<std::mutex> lock(m_Shared->m_Mutex);
+        m_Shared->Put(pool, entry, last);
+    }
+}
+void CSlabAllocator::FlushThreadCache()
+{
+    std::vector<SThreadCache*>& caches = t_ThreadCaches.m_Caches;
+    for (size_t i = 0; i < caches.size(); i++)
+    {
+        if (caches[i]->m_Shared == m_Shared)
+        {
+            caches[i]->Flush();
+            return;
+        }
+    }
+}
+size_t CSlabAllocator::BytesReserved() const
+{
+    return m_Shared->m_BytesReserved;
+}
+
+} // minijson
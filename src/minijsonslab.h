@@ -0,0 +1,54 @@
+#ifndef MINIJSONSLAB_H
+#define MINIJSONSLAB_H
+#include "minijson.h"
+#include <memory>
+
+// optional add-on (requires C++11): thread safe slab allocator for long-lived, mutable documents.
+
+namespace minijson {
+
+/**
+ * Allocator with fixed size slab pools for entities.
+ *
+ * There is one pool per entity type (CNumber, CString, CBoolean, CNull, CObject, CArray; types of
+ * the same size share a pool) and pools for small allocations in steps of 16 bytes (e.g. the
+ * nodes of object members and small arrays), larger allocations are passed to the parent.
+ * Each pool takes 64KB slabs from the parent and keeps freed entries in a free list, so
+ * add/remove heavy workloads reuse memory instead of fragmenting the heap. Slabs are returned to
+ * the parent when the allocator is destroyed, even if other threads still cache entries of it.
+ *
+ * The allocator is thread safe: every thread keeps a small cache of free entries per pool and
+ * exchanges batches of entries with the shared pools, i.e. the lock is taken for a fraction of
+ * allocations only. Memory may be freed by a different thread than the one that allocated it.
+ **/
+class CSlabAllocator : public CAllocator
+{
+public:
+    // threadCaches: false to always use the shared pools (less memory held by idle threads)
+    CSlabAllocator(bool threadCaches = true, CAllocator& parent = CAllocator::Default());
+    virtual ~CSlabAllocator();
+
+    virtual void* Allocate(size_t size) MINIJSON_OVERRIDE;
+    virtual void Free(void* ptr, size_t size) MINIJSON_OVERRIDE;
+
+    // moves the entries cached by the calling thread back to the shared pools
+    void FlushThreadCache();
+
+    size_t BytesReserved() const; // memory taken from the parent for slabs
+
+    struct SShared;
+    struct SThreadCache;
+
+private:
+    CSlabAllocator(const CSlabAllocator&);
+    CSlabAllocator& operator=(const CSlabAllocator&);
+
+    SThreadCache* ThreadCache();
+
+    std::shared_ptr<SShared> m_Shared;
+    bool m_ThreadCaches;
+};
+
+} // minijson
+
+#endif
@@ -0,0 +1,839 @@
+#include "minijsonsnapshot.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else // _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace minijson {
+
+static const char SNAPSHOT_MAGIC[6] = { 'M', 'J', 'S', 'N', 'A', 'P' };
+static const uint16_t SNAPSHOT_VERSION = 1;
+static const uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+static const size_t SNAPSHOT_HEADER_SIZE = 32;
+
+// header field offsets
+static const size_t HEADER_VERSION = 6;
+static const size_t HEADER_BYTE_ORDER_MARK = 8;
+static const size_t HEADER_SIZE = 12;
+static const size_t HEADER_ROOT = 16;
+static const size_t HEADER_CHECKSUM = 20;
+
+// value types, stored in the lowest 3 bits of a reference
+enum ESnapshotType
+{
+    SNAPSHOT_NULL = 0,
+    SNAPSHOT_FALSE = 1,
+    SNAPSHOT_TRUE = 2,
+    SNAPSHOT_NUMBER = 3,
+    SNAPSHOT_STRING = 4,
+    SNAPSHOT_ARRAY = 5,
+    SNAPSHOT_OBJECT = 6
+};
+
+static const uint32_t NUMBER_FLAG_INTEGER = 1;
+static const size_t NUMBER_NODE_SIZE = 24;
+
+// strings up to this length are deduplicated by CSnapshotWriter
+static const size_t MAX_SHARED_STRING_LENGTH = 64;
+
+static uint32_t ReadWord(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t Checksum(const uint8_t* data, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = SNAPSHOT_HEADER_SIZE; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// same ordering as std::string::compare()
+static int CompareKeys(const char* a, size_t aLength, const char* b, size_t bLength)
+{
+    int c = memcmp(a, b, std::min(aLength, bLength));
+    if (c != 0)
+    {
+        return c;
+    }
+    if (aLength == bLength)
+    {
+        return 0;
+    }
+    return aLength < bLength ? -1 : 1;
+}
+
+
+CSnapshotValue::CSnapshotValue()
+    : m_Snapshot(NULL),
+      m_Ref(SNAPSHOT_NULL)
+{
+}
+CSnapshotValue::CSnapshotValue(const CSnapshot* snapshot, uint32_t ref)
+    : m_Snapshot(snapshot),
+      m_Ref(ref)
+{
+}
+const uint8_t* CSnapshotValue::Node(size_t minSize) const
+{
+    size_t offset = m_Ref & ~7u;
+    if (!m_Snapshot || offset < SNAPSHOT_HEADER_SIZE || offset > m_Snapshot->m_Size || m_Snapshot->m_Size - offset < minSize)
+    {
+        throw CException("Corrupt snapshot: reference %u out of range", (unsigned int)m_Ref);
+    }
+    return m_Snapshot->m_Data + offset;
+}
+uint32_t CSnapshotValue::Word(const uint8_t* node, size_t index) const
+{
+    return ReadWord(node + 4 * index);
+}
+CSnapshotValue CSnapshotValue::Child(uint32_t ref) const
+{
+    // nodes are written bottom up, so children are always located before their parent.
+    // checking this prevents cycles in corrupt snapshots.
+    if ((ref & 7) >= SNAPSHOT_NUMBER && (ref & ~7u) >= (m_Ref & ~7u))
+    {
+        throw CException("Corrupt snapshot: invalid child reference %u", (unsigned int)ref);
+    }
+    return CSnapshotValue(m_Snapshot, ref);
+}
+
+bool CSnapshotValue::IsObject() const
+{
+    return (m_Ref & 7) == SNAPSHOT_OBJECT;
+}
+bool CSnapshotValue::IsArray() const
+{
+    return (m_Ref & 7) == SNAPSHOT_ARRAY;
+}
+bool CSnapshotValue::IsString() const
+{
+    return (m_Ref & 7) == SNAPSHOT_STRING;
+}
+bool CSnapshotValue::IsNumber() const
+{
+    return (m_Ref & 7) == SNAPSHOT_NUMBER;
+}
+bool CSnapshotValue::IsBoolean() const
+{
+    return (m_Ref & 7) == SNAPSHOT_TRUE || (m_Ref & 7) == SNAPSHOT_FALSE;
+}
+bool CSnapshotValue::IsNull() const
+{
+    return (m_Ref & 7) == SNAPSHOT_NULL;
+}
+
+int CSnapshotValue::Count() const
+{
+    if (!IsObject() && !IsArray())
+    {
+        throw CException("Count is not applicable for this type");
+    }
+    return (int)Word(Node(4), 0);
+}
+const char* CSnapshotValue::StringValue() const
+{
+    if (!IsString())
+    {
+        throw CException("Called StringValue for non string entity");
+    }
+    const uint8_t* node = Node(4);
+    Node(4 + (size_t)Word(node, 0) + 1);
+    return (const char*)node + 4;
+}
+size_t CSnapshotValue::StringLength() const
+{
+    if (!IsString())
+    {
+        throw CException("Called StringLength for non string entity");
+    }
+    return Word(Node(4), 0);
+}
+const char* CSnapshotValue::NumberText() const
+{
+    if (!IsNumber())
+    {
+        throw CException("Number() failed for non number entity");
+    }
+    const uint8_t* node = Node(NUMBER_NODE_SIZE);
+    return Child(Word(node, 5)).StringValue();
+}
+double CSnapshotValue::DoubleValue() const
+{
+    if (!IsNumber())
+    {
+        throw CException("Number() failed for non number entity");
+    }
+    double d;
+    memcpy(&d, Node(NUMBER_NODE_SIZE), sizeof(d));
+    return d;
+}
+float CSnapshotValue::FloatValue() const
+{
+    return (float)DoubleValue();
+}
+int64_t CSnapshotValue::Int64Value() const
+{
+    if (!IsNumber())
+    {
+        throw CException("Number() failed for non number entity");
+    }
+    const uint8_t* node = Node(NUMBER_NODE_SIZE);
+    if (Word(node, 4) & NUMBER_FLAG_INTEGER)
+    {
+        int64_t i;
+        memcpy(&i, node + 8, sizeof(i));
+        return i;
+    }
+    return (int64_t)DoubleValue();
+}
+int CSnapshotValue::IntValue() const
+{
+    return (int)Int64Value();
+}
+bool CSnapshotValue::BoolValue() const
+{
+    if (!IsBoolean())
+    {
+        throw CException("Boolean() failed for non boolean entity");
+    }
+    return (m_Ref & 7) == SNAPSHOT_TRUE;
+}
+
+int CSnapshotValue::FindIndex(const char* key, size_t length) const
+{
+    const uint8_t* node = Node(4);
+    uint32_t count = Word(node, 0);
+    node = Node(4 + (size_t)count * 12);
+    const uint8_t* sorted = node + 4 + (size_t)count * 8;
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t index = ReadWord(sorted + 4 * mid);
+        if (index >= count)
+        {
+            throw CException("Corrupt snapshot: invalid member index");
+        }
+        CSnapshotValue k = Child(Word(node, 1 + 2 * (size_t)index));
+        int c = CompareKeys(k.StringValue(), k.StringLength(), key, length);
+        if (c == 0)
+        {
+            return (int)index;
+        }
+        if (c < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+bool CSnapshotValue::Find(const char* key, CSnapshotValue& value) const
+{
+    if (!IsObject())
+    {
+        return false;
+    }
+    int index = FindIndex(key, strlen(key));
+    if (index < 0)
+    {
+        return false;
+    }
+    value = Child(Word(Node(4), 2 + 2 * (size_t)index));
+    return true;
+}
+bool CSnapshotValue::Contains(const char* name) const
+{
+    CSnapshotValue v;
+    return Find(name, v);
+}
+const char* CSnapshotValue::ObjectMemberNameByIndex(int index) const
+{
+    if (!IsObject())
+    {
+        throw CException("ObjectMemberNameByIndex() is only allowed for objects");
+    }
+    if (index < 0 || index >= Count())
+    {
+        throw CException("index %d out of bounds for MemberNameByIndex()", index);
+    }
+    const uint8_t* node = Node(4 + ((size_t)index + 1) * 8);
+    return Child(Word(node, 1 + 2 * (size_t)index)).StringValue();
+}
+
+CSnapshotValue CSnapshotValue::operator[] (int idx) const
+{
+    if (IsArray())
+    {
+        if (idx < 0 || idx >= Count())
+        {
+            throw CException("index %d out of bounds for EntityAtIndex()", idx);
+        }
+        const uint8_t* node = Node(4 + ((size_t)idx + 1) * 4);
+        return Child(Word(node, 1 + (size_t)idx));
+    }
+    else if (IsObject())
+    {
+        if (idx < 0 || idx >= Count())
+        {
+            throw CException("index %d out of bounds for EntityAtIndex()", idx);
+        }
+        const uint8_t* node = Node(4 + ((size_t)idx + 1) * 8);
+        return Child(Word(node, 2 + 2 * (size_t)idx));
+    }
+    else
+    {
+        throw CException("operator[](int) is only allowed for arrays and objects");
+    }
+}
+CSnapshotValue CSnapshotValue::operator[] (const char* key) const
+{
+    if (!IsObject())
+    {
+        throw CException("operator[](key) is only allowed for objects");
+    }
+    CSnapshotValue v;
+    if (!Find(key, v))
+    {
+        throw CException("key '%s' not found in operator[]", key);
+    }
+    return v;
+}
+CSnapshotValue CSnapshotValue::operator[] (const std::string& key) const
+{
+    if (!IsObject())
+    {
+        throw CException("operator[](key) is only allowed for objects");
+    }
+    int index = FindIndex(key.data(), key.size());
+    if (index < 0)
+    {
+        throw CException("key '%s' not found in operator[]", key.c_str());
+    }
+    return Child(Word(Node(4), 2 + 2 * (size_t)index));
+}
+
+const char* CSnapshotValue::GetString(const char* name, const char* defaultValue) const
+{
+    CSnapshotValue v;
+    if (!Find(name, v) || !v.IsString())
+    {
+        return defaultValue;
+    }
+    return v.StringValue();
+}
+int CSnapshotValue::GetInt(const char* name, int defaultValue) const
+{
+    CSnapshotValue v;
+    if (!Find(name, v) || !v.IsNumber())
+    {
+        return defaultValue;
+    }
+    return v.IntValue();
+}
+double CSnapshotValue::GetDouble(const char* name, double defaultValue) const
+{
+    CSnapshotValue v;
+    if (!Find(name, v) || !v.IsNumber())
+    {
+        return defaultValue;
+    }
+    return v.DoubleValue();
+}
+bool CSnapshotValue::GetBool(const char* name, bool defaultValue) const
+{
+    CSnapshotValue v;
+    if (!Find(name, v) || !v.IsBoolean())
+    {
+        return defaultValue;
+    }
+    return v.BoolValue();
+}
+
+void CSnapshotValue::Emit(CHandler& handler, bool sorted) const
+{
+    switch (m_Ref & 7)
+    {
+    case SNAPSHOT_NULL:
+        handler.Null();
+        break;
+    case SNAPSHOT_FALSE:
+        handler.Boolean(false);
+        break;
+    case SNAPSHOT_TRUE:
+        handler.Boolean(true);
+        break;
+    case SNAPSHOT_NUMBER:
+        {
+            CSnapshotValue text = Child(Word(Node(NUMBER_NODE_SIZE), 5));
+            handler.Number(text.StringValue(), text.StringLength());
+        }
+        break;
+    case SNAPSHOT_STRING:
+        handler.String(StringValue(), StringLength());
+        break;
+    case SNAPSHOT_ARRAY:
+        {
+            uint32_t count = (uint32_t)Count();
+            const uint8_t* node = Node(4 + (size_t)count * 4);
+            handler.StartArray((int)count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                Child(Word(node, 1 + i)).Emit(handler, sorted);
+            }
+            handler.EndArray();
+        }
+        break;
+    case SNAPSHOT_OBJECT:
+        {
+            uint32_t count = (uint32_t)Count();
+            const uint8_t* node = Node(4 + (size_t)count * 12);
+            handler.StartObject((int)count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t index = sorted ? Word(node, 1 + 2 * (size_t)count + i) : i;
+                if (index >= count)
+                {
+                    throw CException("Corrupt snapshot: invalid member index");
+                }
+                CSnapshotValue key = Child(Word(node, 1 + 2 * (size_t)index));
+                handler.Key(key.StringValue(), key.StringLength());
+                Child(Word(node, 2 + 2 * (size_t)index)).Emit(handler, sorted);
+            }
+            handler.EndObject();
+        }
+        break;
+    default:
+        throw CException("Corrupt snapshot: invalid value type %d", (int)(m_Ref & 7));
+    }
+}
+void CSnapshotValue::Accept(CHandler& handler) const
+{
+    Emit(handler, true);
+}
+CEntity* CSnapshotValue::ToEntity() const
+{
+    // member order, so that ObjectMemberNameByIndex() matches the original document
+    CDomBuilder builder;
+    Emit(builder, false);
+    return builder.Release();
+}
+
+
+CSnapshot::CSnapshot()
+    : m_Data(NULL),
+      m_Size(0),
+      m_Mapping(NULL),
+      m_MappingSize(0)
+#ifdef _WIN32
+      , m_FileHandle(NULL),
+      m_MappingHandle(NULL)
+#endif // _WIN32
+{
+}
+CSnapshot::~CSnapshot()
+{
+    Close();
+}
+void CSnapshot::Close()
+{
+    if (m_Mapping)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_Mapping);
+        CloseHandle((HANDLE)m_MappingHandle);
+        CloseHandle((HANDLE)m_FileHandle);
+        m_MappingHandle = NULL;
+        m_FileHandle = NULL;
+#else // _WIN32
+        munmap(m_Mapping, m_MappingSize);
+#endif // _WIN32
+    }
+    m_Mapping = NULL;
+    m_MappingSize = 0;
+    m_Data = NULL;
+    m_Size = 0;
+}
+void CSnapshot::Attach(const void* data, size_t size, bool verifyChecksum)
+{
+    const uint8_t* d = (const uint8_t*)data;
+    if (size < SNAPSHOT_HEADER_SIZE || memcmp(d, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        throw CException("Not a minijson snapshot");
+    }
+    uint16_t version;
+    memcpy(&version, d + HEADER_VERSION, sizeof(version));
+    if (version != SNAPSHOT_VERSION)
+    {
+        throw CException("Unsupported snapshot version %d", (int)version);
+    }
+    if (ReadWord(d + HEADER_BYTE_ORDER_MARK) != SNAPSHOT_BYTE_ORDER_MARK)
+    {
+        throw CException("Snapshot was created on a machine with a different byte order");
+    }
+    uint32_t snapshotSize = ReadWord(d + HEADER_SIZE);
+    if (snapshotSize < SNAPSHOT_HEADER_SIZE || snapshotSize > size)
+    {
+        throw CException("Truncated snapshot (expected %u bytes, got %u)", (unsigned int)snapshotSize, (unsigned int)size);
+    }
+    if (verifyChecksum && Checksum(d, snapshotSize) != ReadWord(d + HEADER_CHECKSUM))
+    {
+        throw CException("Snapshot checksum mismatch");
+    }
+    m_Data = d;
+    m_Size = snapshotSize;
+}
+void CSnapshot::Open(const char* path, bool verifyChecksum)
+{
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw CIOException("Failed to open file %s", path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        throw CIOException("Failed to map empty file %s", path);
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view)
+    {
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        throw CIOException("Failed to map file %s", path);
+    }
+    m_FileHandle = file;
+    m_MappingHandle = mapping;
+    m_Mapping = view;
+    m_MappingSize = (size_t)size.QuadPart;
+#else // _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        throw CIOException("Failed to open file %s", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        throw CIOException("Failed to map empty file %s", path);
+    }
+    void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file referenced
+    if (mapping == MAP_FAILED)
+    {
+        throw CIOException("Failed to map file %s", path);
+    }
+    m_Mapping = mapping;
+    m_MappingSize = (size_t)st.st_size;
+#endif // _WIN32
+    try
+    {
+        Attach(m_Mapping, m_MappingSize, verifyChecksum);
+    }
+    catch (...)
+    {
+        Close();
+        throw;
+    }
+}
+bool CSnapshot::VerifyChecksum() const
+{
+    if (!m_Data)
+    {
+        return false;
+    }
+    return Checksum(m_Data, m_Size) == ReadWord(m_Data + HEADER_CHECKSUM);
+}
+CSnapshotValue CSnapshot::Root() const
+{
+    if (!m_Data)
+    {
+        throw CException("No snapshot attached");
+    }
+    return CSnapshotValue(this, ReadWord(m_Data + HEADER_ROOT));
+}
+
+
+CSnapshotWriter::CSnapshotWriter()
+    : m_HasRoot(false),
+      m_Root(SNAPSHOT_NULL)
+{
+    m_Data.resize(SNAPSHOT_HEADER_SIZE);
+}
+size_t CSnapshotWriter::Allocate(size_t size)
+{
+    size_t offset = (m_Data.size() + 7) & ~(size_t)7;
+    if (offset + size > 0xfffffff8u)
+    {
+        throw CException("Snapshot too large (snapshots are limited to 4 GB)");
+    }
+    m_Data.resize(offset + size);
+    return offset;
+}
+uint32_t CSnapshotWriter::WriteString(const char* str, size_t length)
+{
+    std::string key;
+    if (length <= MAX_SHARED_STRING_LENGTH)
+    {
+        key.assign(str, length);
+        std::map<std::string, uint32_t>::const_iterator it = m_Strings.find(key);
+        if (it != m_Strings.end())
+        {
+            return it->second;
+        }
+    }
+    size_t offset = Allocate(4 + length + 1);
+    uint32_t l = (uint32_t)length;
+    memcpy(&m_Data[offset], &l, 4);
+    memcpy(&m_Data[offset + 4], str, length);
+    m_Data[offset + 4 + length] = 0;
+    uint32_t ref = (uint32_t)offset | SNAPSHOT_STRING;
+    if (length <= MAX_SHARED_STRING_LENGTH)
+    {
+        m_Strings[key] = ref;
+    }
+    return ref;
+}
+void CSnapshotWriter::AddValue(uint32_t ref)
+{
+    if (m_Stack.empty())
+    {
+        if (m_HasRoot)
+        {
+            throw CException("Multiple toplevel values");
+        }
+        m_HasRoot = true;
+        m_Root = ref;
+        return;
+    }
+    m_Pending.push_back(ref);
+}
+void CSnapshotWriter::StartObject(int sizeHint)
+{
+    (void)sizeHint;
+    SFrame frame;
+    frame.m_IsObject = true;
+    frame.m_First = m_Pending.size();
+    m_Stack.push_back(frame);
+}
+void CSnapshotWriter::Key(const char* str, size_t length)
+{
+    m_Pending.push_back(WriteString(str, length));
+}
+
+struct SSnapshotKeyLess
+{
+    const std::string* m_Data;
+    const uint32_t* m_Members;
+    bool operator()(uint32_t a, uint32_t b) const
+    {
+        const char* data = m_Data->data();
+        uint32_t keyA = m_Members[2 * a] & ~7u;
+        uint32_t keyB = m_Members[2 * b] & ~7u;
+        return CompareKeys(data + keyA + 4, ReadWord((const uint8_t*)data + keyA),
+                           data + keyB + 4, ReadWord((const uint8_t*)data + keyB)) < 0;
+    }
+};
+
+void CSnapshotWriter::EndObject()
+{
+    SFrame frame = m_Stack.back();
+    if (!frame.m_IsObject || (m_Pending.size() - frame.m_First) % 2 != 0)
+    {
+        throw CException("Unexpected end of object");
+    }
+    uint32_t count = (uint32_t)((m_Pending.size() - frame.m_First) / 2);
+    const uint32_t* members = count > 0 ? &m_Pending[frame.m_First] : NULL;
+
+    std::vector<uint32_t> sorted(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sorted[i] = i;
+    }
+    SSnapshotKeyLess less;
+    less.m_Data = &m_Data;
+    less.m_Members = members;
+    std::stable_sort(sorted.begin(), sorted.end(), less);
+
+    size_t offset = Allocate(4 + (size_t)count * 12);
+    char* node = &m_Data[offset];
+    memcpy(node, &count, 4);
+    if (count > 0)
+    {
+        memcpy(node + 4, members, (size_t)count * 8);
+        memcpy(node + 4 + (size_t)count * 8, &sorted[0], (size_t)count * 4);
+    }
+    m_Stack.pop_back();
+    m_Pending.resize(frame.m_First);
+    AddValue((uint32_t)offset | SNAPSHOT_OBJECT);
+}
+void CSnapshotWriter::StartArray(int sizeHint)
+{
+    (void)sizeHint;
+    SFrame frame;
+    frame.m_IsObject = false;
+    frame.m_First = m_Pending.size();
+    m_Stack.push_back(frame);
+}
+void CSnapshotWriter::EndArray()
+{
+    SFrame frame = m_Stack.back();
+    if (frame.m_IsObject)
+    {
+        throw CException("Unexpected end of array");
+    }
+    uint32_t count = (uint32_t)(m_Pending.size() - frame.m_First);
+    size_t offset = Allocate(4 + (size_t)count * 4);
+    char* node = &m_Data[offset];
+    memcpy(node, &count, 4);
+    if (count > 0)
+    {
+        memcpy(node + 4, &m_Pending[frame.m_First], (size_t)count * 4);
+    }
+    m_Stack.pop_back();
+    m_Pending.resize(frame.m_First);
+    AddValue((uint32_t)offset | SNAPSHOT_ARRAY);
+}
+void CSnapshotWriter::String(const char* str, size_t length)
+{
+    AddValue(WriteString(str, length));
+}
+void CSnapshotWriter::Number(const char* str, size_t length)
+{
+    uint32_t text = WriteString(str, length);
+    const char* t = &m_Data[(text & ~7u) + 4];
+
+    double d = strtod(t, NULL);
+    int64_t i = 0;
+    uint32_t flags = 0;
+    bool isInteger = length > 0 && length < 20;
+    for (size_t k = (length > 0 && t[0] == '-') ? 1 : 0; isInteger && k < length; k++)
+    {
+        isInteger = t[k] >= '0' && t[k] <= '9';
+    }
+    if (isInteger && !(length == 1 && t[0] == '-'))
+    {
+        i = strtoll(t, NULL, 10);
+        flags |= NUMBER_FLAG_INTEGER;
+    }
+
+    size_t offset = Allocate(NUMBER_NODE_SIZE);
+    char* node = &m_Data[offset];
+    memcpy(node, &d, 8);
+    memcpy(node + 8, &i, 8);
+    memcpy(node + 16, &flags, 4);
+    memcpy(node + 20, &text, 4);
+    AddValue((uint32_t)offset | SNAPSHOT_NUMBER);
+}
+void CSnapshotWriter::Boolean(bool b)
+{
+    AddValue(b ? SNAPSHOT_TRUE : SNAPSHOT_FALSE);
+}
+void CSnapshotWriter::Null()
+{
+    AddValue(SNAPSHOT_NULL);
+}
+const std::string& CSnapshotWriter::Finish()
+{
+    if (!m_HasRoot || !m_Stack.empty())
+    {
+        throw CException("Finish() called before a complete value was received");
+    }
+    m_Data.resize((m_Data.size() + 7) & ~(size_t)7);
+    uint8_t* d = (uint8_t*)&m_Data[0];
+    uint32_t size = (uint32_t)m_Data.size();
+    memcpy(d, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    memcpy(d + HEADER_VERSION, &SNAPSHOT_VERSION, 2);
+    memcpy(d + HEADER_BYTE_ORDER_MARK, &SNAPSHOT_BYTE_ORDER_MARK, 4);
+    memcpy(d + HEADER_SIZE, &size, 4);
+    memcpy(d + HEADER_ROOT, &m_Root, 4);
+    uint32_t checksum = Checksum(d, size);
+    memcpy(d + HEADER_CHECKSUM, &checksum, 4);
+    return m_Data;
+}
+// like CEntity::Accept(), but emits object members in member (index) order instead of sorted
+// order, so that ObjectMemberNameByIndex() of the snapshot matches the entity.
+static void AcceptInMemberOrder(const CEntity& ent, CHandler& handler)
+{
+    if (ent.IsObject())
+    {
+        const CObject& obj = ent.Object();
+        int count = obj.Count();
+        handler.StartObject(count);
+        for (int i = 0; i < count; i++)
+        {
+            const std::string& key = obj.MemberNameByIndex(i);
+            handler.Key(key.data(), key.size());
+            AcceptInMemberOrder(obj.EntityAtIndex(i), handler);
+        }
+        handler.EndObject();
+    }
+    else if (ent.IsArray())
+    {
+        const CArray& arr = ent.Array();
+        int count = arr.Count();
+        handler.StartArray(count);
+        for (int i = 0; i < count; i++)
+        {
+            AcceptInMemberOrder(arr.EntityAtIndex(i), handler);
+        }
+        handler.EndArray();
+    }
+    else
+    {
+        ent.Accept(handler);
+    }
+}
+
+std::string CSnapshotWriter::Compile(const CEntity& ent)
+{
+    CSnapshotWriter writer;
+    AcceptInMemberOrder(ent, writer);
+    return writer.Finish();
+}
+void CSnapshotWriter::CompileToFile(const char* path, const CEntity& ent)
+{
+    std::string data = Compile(ent);
+    FILE* f = fopen(path, "wb");
+    if (!f)
+    {
+        throw CIOException("Failed to open file %s for writing", path);
+    }
+    size_t wr = fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+    if (wr != data.size())
+    {
+        throw CIOException("Failed to write all bytes to file %s", path);
+    }
+}
+
+} // minijson
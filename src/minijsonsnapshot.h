@@ -0,0 +1,176 @@
+#ifndef MINIJSONSNAPSHOT_H
+#define MINIJSONSNAPSHOT_H
+#include "minijson.h"
+#include <stdint.h>
+
+// optional add-on: compact, position independent binary snapshots of json documents.
+//
+// A snapshot is written once (CSnapshotWriter) and can then be used in place, e.g. directly
+// from a memory mapped file (CSnapshot::Open()), without any parsing and without allocations.
+// All references inside a snapshot are offsets relative to the start of the snapshot.
+//
+// Layout (native byte order, checked through the header):
+//   header (32 bytes): magic "MJSNAP", version, byte order mark, size, root reference, checksum
+//   nodes (8 byte aligned):
+//     string: uint32 length, utf8 data, terminating 0
+//     number: double, int64, uint32 flags, uint32 reference to the string node of the json text
+//     array:  uint32 count, uint32 references[count]
+//     object: uint32 count, {uint32 key, uint32 value}[count] in member order,
+//             uint32 sorted[count] (member indices sorted by key, for binary search)
+//   a reference is a node offset with the value type in the lowest 3 bits, null/true/false do
+//   not have a node.
+
+namespace minijson {
+
+class CSnapshot;
+
+/**
+ * A value inside a snapshot. This is a lightweight handle (pointer and reference) that can be
+ * copied freely, it is valid as long as the snapshot data is valid.
+ *
+ * Accessors mirror the ones of CEntity, but strings are returned as pointers into the snapshot
+ * (always 0-terminated) instead of std::string references.
+ **/
+class CSnapshotValue
+{
+public:
+    CSnapshotValue();
+
+    bool IsObject() const;
+    bool IsArray() const;
+    bool IsString() const;
+    bool IsNumber() const;
+    bool IsBoolean() const;
+    bool IsNull() const;
+
+    int Count() const;
+    const char* StringValue() const;
+    size_t StringLength() const;
+    const char* NumberText() const; // json text of a number, as in CNumber::Value()
+    float FloatValue() const;
+    double DoubleValue() const;
+    int IntValue() const;
+    int64_t Int64Value() const;
+    bool BoolValue() const;
+
+    bool Contains(const char* name) const;
+    const char* ObjectMemberNameByIndex(int index) const;
+
+    CSnapshotValue operator[] (int idx) const;
+    CSnapshotValue operator[] (const char* key) const;
+    CSnapshotValue operator[] (const std::string& key) const;
+
+    // object member lookup without exceptions, returns false if there is no such member
+    bool Find(const char* key, CSnapshotValue& value) const;
+
+    const char* GetString(const char* name, const char* defaultValue = "") const;
+    int GetInt(const char* name, int defaultValue = 0) const;
+    double GetDouble(const char* name, double defaultValue = 0.0) const;
+    bool GetBool(const char* name, bool defaultValue = false) const;
+
+    // emit this value (and all children) as events, object members in the same (sorted) order
+    // as CEntity::Accept() uses.
+    void Accept(CHandler& handler) const;
+    // creates a (heap allocated) CEntity tree from this value
+    CEntity* ToEntity() const;
+
+private:
+    friend class CSnapshot;
+    CSnapshotValue(const CSnapshot* snapshot, uint32_t ref);
+
+    void Emit(CHandler& handler, bool sorted) const;
+    const uint8_t* Node(size_t minSize) const;
+    CSnapshotValue Child(uint32_t ref) const;
+    uint32_t Word(const uint8_t* node, size_t index) const;
+    int FindIndex(const char* key, size_t length) const;
+
+    const CSnapshot* m_Snapshot;
+    uint32_t m_Ref;
+};
+
+/**
+ * Read access to a snapshot, either on memory provided by the caller or on a memory mapped file.
+ **/
+class CSnapshot
+{
+public:
+    CSnapshot();
+    ~CSnapshot();
+
+    // uses the snapshot at data (not copied, must stay valid while this object is in use)
+    void Attach(const void* data, size_t size, bool verifyChecksum = false);
+    // memory maps the file at path (read only)
+    void Open(const char* path, bool verifyChecksum = false);
+    void Open(const std::string& path, bool verifyChecksum = false) { Open(path.c_str(), verifyChecksum); }
+    void Close();
+
+    // true if the checksum in the header matches the data (O(size))
+    bool VerifyChecksum() const;
+
+    CSnapshotValue Root() const;
+    const uint8_t* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+
+private:
+    friend class CSnapshotValue;
+    CSnapshot(const CSnapshot&);
+    CSnapshot& operator=(const CSnapshot&);
+
+    const uint8_t* m_Data;
+    size_t m_Size;
+    void* m_Mapping;
+    size_t m_MappingSize;
+#ifdef _WIN32
+    void* m_FileHandle;
+    void* m_MappingHandle;
+#endif // _WIN32
+};
+
+/**
+ * Handler creating a snapshot from events, e.g. from CEntity::Accept() or any reader.
+ * Identical strings of up to 64 bytes (in particular object keys) are stored once only, longer
+ * strings are stored at each occurrence.
+ **/
+class CSnapshotWriter : public CHandler
+{
+public:
+    CSnapshotWriter();
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void EndObject() MINIJSON_OVERRIDE;
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE;
+    virtual void EndArray() MINIJSON_OVERRIDE;
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE;
+    virtual void Null() MINIJSON_OVERRIDE;
+
+    // finishes the snapshot (writes the header) and returns it.
+    const std::string& Finish();
+
+    // static convenience functions
+    static std::string Compile(const CEntity& ent);
+    static void CompileToFile(const char* path, const CEntity& ent);
+
+private:
+    struct SFrame
+    {
+        bool m_IsObject;
+        size_t m_First; // index of the first pending reference of this container
+    };
+    void AddValue(uint32_t ref);
+    uint32_t WriteString(const char* str, size_t length);
+    size_t Allocate(size_t size);
+
+    std::string m_Data;
+    std::vector<SFrame> m_Stack;
+    std::vector<uint32_t> m_Pending; // keys and values of open containers
+    std::map<std::string, uint32_t> m_Strings;
+    bool m_HasRoot;
+    uint32_t m_Root;
+};
+
+} // minijson
+
+#endif
@@ -0,0 +1,259 @@
+#include "minijsontemplate.h"
+#include <string.h>
+
+namespace minijson {
+
+static const char* TypeName(ETemplateType type)
+{
+    switch (type)
+    {
+    case TEMPLATE_STRING: return "string";
+    case TEMPLATE_INT: return "int";
+    case TEMPLATE_DOUBLE: return "double";
+    case TEMPLATE_BOOL: return "bool";
+    case TEMPLATE_JSON: return "json";
+    }
+    return "?";
+}
+
+/**
+ * Splits a placeholder "{{name}}"/"{{name:type}}" into name and type, returns false for any
+ * other string. Throws a CException for an unknown type.
+ **/
+static bool ParsePlaceholder(const char* str, size_t length, std::string& name, ETemplateType& type)
+{
+    if (length < 4 || memcmp(str, "{{", 2) != 0 || memcmp(str + length - 2, "}}", 2) != 0)
+    {
+        return false;
+    }
+    std::string inner(str + 2, length - 4);
+    size_t colon = inner.rfind(':');
+    type = TEMPLATE_STRING;
+    if (colon == std::string::npos)
+    {
+        name = inner;
+        return true;
+    }
+    name = inner.substr(0, colon);
+    std::string typeName = inner.substr(colon + 1);
+    const ETemplateType types[] = { TEMPLATE_STRING, TEMPLATE_INT, TEMPLATE_DOUBLE, TEMPLATE_BOOL, TEMPLATE_JSON };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (typeName == TypeName(types[i]))
+        {
+            type = types[i];
+            return true;
+        }
+    }
+    throw CException("placeholder '%s' has the unknown type '%s'", name.c_str(), typeName.c_str());
+}
+
+/**
+ * Writes the template entity with a CStreamWriter and cuts the text at the placeholders, see
+ * CTemplate::CTemplate().
+ **/
+class CTemplateCompiler : public CHandler
+{
+public:
+    CTemplateCompiler(CTemplate& tmpl, bool prettyPrint, const std::string& indentation);
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE { m_Writer.StartObject(sizeHint); }
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE { m_Writer.Key(str, length); }
+    virtual void EndObject() MINIJSON_OVERRIDE { m_Writer.EndObject(); }
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE { m_Writer.StartArray(sizeHint); }
+    virtual void EndArray() MINIJSON_OVERRIDE { m_Writer.EndArray(); }
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE;
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE { m_Writer.Number(str, length); }
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE { m_Writer.Boolean(b); }
+    virtual void Null() MINIJSON_OVERRIDE { m_Writer.Null(); }
+
+private:
+    CTemplate& m_Template;
+    CStringOutputStream m_Stream;
+    CStreamWriter m_Writer;
+    std::string m_Name;
+};
+
+CTemplateCompiler::CTemplateCompiler(CTemplate& tmpl, bool prettyPrint, const std::string& indentation)
+    : m_Template(tmpl),
+      m_Stream(tmpl.m_Text),
+      m_Writer(m_Stream, prettyPrint, indentation)
+{
+}
+void CTemplateCompiler::String(const char* str, size_t length)
+{
+    ETemplateType type;
+    if (!ParsePlaceholder(str, length, m_Name, type))
+    {
+        m_Writer.String(str, length);
+        return;
+    }
+    int placeholder = m_Template.FindPlaceholder(m_Name);
+    if (placeholder < 0)
+    {
+        CTemplate::SPlaceholder p;
+        p.m_Name = m_Name;
+        p.m_Type = type;
+        m_Template.m_Placeholders.push_back(p);
+        placeholder = m_Template.PlaceholderCount() - 1;
+    }
+    else if (m_Template.PlaceholderType(placeholder) != type)
+    {
+        throw CException("placeholder '%s' is used as %s and as %s", m_Name.c_str(), TypeName(m_Template.PlaceholderType(placeholder)), TypeName(type));
+    }
+    // the writer adds the separator/indentation of the value, the value itself is cut off
+    m_Writer.Null();
+    m_Template.m_Text.resize(m_Template.m_Text.size() - 4);
+    CTemplate::SPart part;
+    part.m_End = m_Template.m_Text.size();
+    part.m_Placeholder = placeholder;
+    m_Template.m_Parts.push_back(part);
+}
+
+CTemplate::CTemplate(const CEntity& tmpl, bool prettyPrint, const std::string& indentation)
+{
+    CTemplateCompiler compiler(*this, prettyPrint, indentation);
+    tmpl.Accept(compiler);
+}
+
+int CTemplate::FindPlaceholder(const std::string& name) const
+{
+    for (size_t i = 0; i < m_Placeholders.size(); i++)
+    {
+        if (m_Placeholders[i].m_Name == name)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void CTemplate::CheckValues(const CTemplateValues& values) const
+{
+    if (&values.m_Template != this)
+    {
+        throw CException("the values belong to another template");
+    }
+    for (size_t i = 0; i < m_Placeholders.size(); i++)
+    {
+        if (!values.m_HasValue[i])
+        {
+            throw CException("placeholder '%s' has no value", m_Placeholders[i].m_Name.c_str());
+        }
+    }
+}
+void CTemplate::Render(const CTemplateValues& values, std::string& out) const
+{
+    CheckValues(values);
+    size_t length = m_Text.size();
+    for (size_t i = 0; i < m_Parts.size(); i++)
+    {
+        length += values.m_Values[m_Parts[i].m_Placeholder].size();
+    }
+    out.reserve(out.size() + length);
+    size_t start = 0;
+    for (size_t i = 0; i < m_Parts.size(); i++)
+    {
+        const SPart& part = m_Parts[i];
+        out.append(m_Text, start, part.m_End - start);
+        out += values.m_Values[part.m_Placeholder];
+        start = part.m_End;
+    }
+    out.append(m_Text, start, std::string::npos);
+}
+std::string CTemplate::Render(const CTemplateValues& values) const
+{
+    std::string out;
+    Render(values, out);
+    return out;
+}
+void CTemplate::Render(const CTemplateValues& values, COutputStream& stream) const
+{
+    CheckValues(values);
+    size_t start = 0;
+    for (size_t i = 0; i < m_Parts.size(); i++)
+    {
+        const SPart& part = m_Parts[i];
+        const std::string& value = values.m_Values[part.m_Placeholder];
+        stream.Write(m_Text.data() + start, part.m_End - start);
+        stream.Write(value.data(), value.size());
+        start = part.m_End;
+    }
+    stream.Write(m_Text.data() + start, m_Text.size() - start);
+}
+
+CTemplateValues::CTemplateValues(const CTemplate& tmpl)
+    : m_Template(tmpl),
+      m_Values(tmpl.PlaceholderCount()),
+      m_HasValue(tmpl.PlaceholderCount(), 0)
+{
+}
+
+std::string& CTemplateValues::Value(int placeholder, ETemplateType type)
+{
+    if (placeholder < 0 || placeholder >= m_Template.PlaceholderCount())
+    {
+        throw CException("placeholder %d does not exist", placeholder);
+    }
+    ETemplateType expected = m_Template.PlaceholderType(placeholder);
+    if (type != expected && !(type == TEMPLATE_INT && expected == TEMPLATE_DOUBLE))
+    {
+        throw CException("placeholder '%s' is %s, not %s", m_Template.PlaceholderName(placeholder).c_str(), TypeName(expected), TypeName(type));
+    }
+    m_HasValue[placeholder] = 1;
+    std::string& value = m_Values[placeholder];
+    value.clear();
+    return value;
+}
+void CTemplateValues::SetString(int placeholder, const char* str, size_t length)
+{
+    CStreamWriter::AppendString(Value(placeholder, TEMPLATE_STRING), str, length);
+}
+void CTemplateValues::SetString(int placeholder, const char* str)
+{
+    SetString(placeholder, str, strlen(str));
+}
+void CTemplateValues::SetInt(int placeholder, int64_t value)
+{
+    CStreamWriter::AppendInt64(Value(placeholder, TEMPLATE_INT), value);
+}
+void CTemplateValues::SetDouble(int placeholder, double value)
+{
+    std::string& text = Value(placeholder, TEMPLATE_DOUBLE);
+    try
+    {
+        CStreamWriter::AppendDouble(text, value);
+    }
+    catch (...)
+    {
+        m_HasValue[placeholder] = 0;
+        throw;
+    }
+}
+void CTemplateValues::SetBool(int placeholder, bool value)
+{
+    Value(placeholder, TEMPLATE_BOOL) = value ? "true" : "false";
+}
+void CTemplateValues::SetEntity(int placeholder, const CEntity& ent)
+{
+    std::string& text = Value(placeholder, TEMPLATE_JSON);
+    CStringOutputStream stream(text);
+    CStreamWriter writer(stream, false);
+    ent.Accept(writer);
+}
+void CTemplateValues::SetNull(int placeholder)
+{
+    // (the type check passes for any existing placeholder)
+    ETemplateType type = placeholder >= 0 && placeholder < m_Template.PlaceholderCount() ? m_Template.PlaceholderType(placeholder) : TEMPLATE_STRING;
+    Value(placeholder, type) = "null";
+}
+
+void CTemplateValues::Clear()
+{
+    for (size_t i = 0; i < m_HasValue.size(); i++)
+    {
+        m_HasValue[i] = 0;
+    }
+}
+
+} // minijson
@@ -0,0 +1,125 @@
+#ifndef MINIJSONTEMPLATE_H
+#define MINIJSONTEMPLATE_H
+#include "minijson.h"
+#include <stdint.h>
+#include <vector>
+
+// optional add-on: precompiled json output templates with typed placeholders.
+
+namespace minijson {
+
+enum ETemplateType
+{
+    TEMPLATE_STRING, // "{{name}}" or "{{name:string}}"
+    TEMPLATE_INT,    // "{{name:int}}", an int64_t
+    TEMPLATE_DOUBLE, // "{{name:double}}", any finite number
+    TEMPLATE_BOOL,   // "{{name:bool}}"
+    TEMPLATE_JSON    // "{{name:json}}", any entity (written without pretty printing)
+};
+
+class CTemplateValues;
+
+/**
+ * Json text with placeholders, compiled once and rendered many times, e.g.
+ *
+ *   // doc: {"id": "{{id:int}}", "name": "{{name}}", "ok": true}
+ *   CTemplate tmpl(*doc, false);
+ *   CTemplateValues values(tmpl);
+ *   values.SetInt(tmpl.FindPlaceholder("id"), 42);
+ *   values.SetString(tmpl.FindPlaceholder("name"), "x");
+ *   tmpl.Render(values, out);           // appends {"id":42,"name":"x","ok":true}
+ *
+ * String values of the template entity of the form "{{name}}" or "{{name:type}}" (type: string,
+ * int, double, bool or json) are placeholders, everything else is written like CStreamWriter
+ * does when the template is compiled. Rendering only copies these constant fragments and the
+ * values, which are formatted when they are set, i.e. it creates no entities and (once the
+ * output and value buffers have grown to their size) allocates nothing. A name may be used more
+ * than once (with the same type), all its placeholders get the same value.
+ *
+ * A compiled template is immutable and can be rendered by many threads at once (with one
+ * CTemplateValues per thread).
+ * NOTE: a string that looks like a placeholder cannot be part of the constant text, and
+ *       placeholders are not possible for object keys or within strings.
+ **/
+class CTemplate
+{
+public:
+    // throws a CException for placeholders with an unknown type, or a name used with two types
+    explicit CTemplate(const CEntity& tmpl, bool prettyPrint = true, const std::string& indentation = std::string("  "));
+
+    // the distinct placeholder names, in order of their first occurrence
+    int PlaceholderCount() const { return (int)m_Placeholders.size(); }
+    const std::string& PlaceholderName(int placeholder) const { return m_Placeholders[placeholder].m_Name; }
+    ETemplateType PlaceholderType(int placeholder) const { return m_Placeholders[placeholder].m_Type; }
+    // index of the placeholder name, -1 if there is none
+    int FindPlaceholder(const std::string& name) const;
+
+    // appends the json text to out. Throws a CException if a placeholder has no value or
+    // values belongs to another template.
+    void Render(const CTemplateValues& values, std::string& out) const;
+    std::string Render(const CTemplateValues& values) const;
+    void Render(const CTemplateValues& values, COutputStream& stream) const;
+
+private:
+    friend class CTemplateCompiler;
+
+    struct SPlaceholder
+    {
+        std::string m_Name;
+        ETemplateType m_Type;
+    };
+    struct SPart
+    {
+        size_t m_End;      // end of the constant text before the placeholder in m_Text
+        int m_Placeholder;
+    };
+
+    void CheckValues(const CTemplateValues& values) const;
+
+    std::string m_Text;               // the constant fragments, one after the other
+    std::vector<SPart> m_Parts;       // the placeholders, in output order
+    std::vector<SPlaceholder> m_Placeholders;
+};
+
+/**
+ * Values of the placeholders of a CTemplate for one (or more) Render() calls. The values are
+ * kept until they are replaced or Clear() is called, so values common to all renderings only
+ * have to be set once. The template must outlive its values.
+ **/
+class CTemplateValues
+{
+public:
+    explicit CTemplateValues(const CTemplate& tmpl);
+
+    // the setters throw a CException for a placeholder index out of range or a value of the
+    // wrong type. SetInt() is accepted for TEMPLATE_DOUBLE placeholders as well, SetNull() for
+    // all placeholders.
+    void SetString(int placeholder, const char* str, size_t length);
+    void SetString(int placeholder, const char* str);
+    void SetString(int placeholder, const std::string& str) { SetString(placeholder, str.data(), str.size()); }
+    void SetInt(int placeholder, int64_t value);
+    void SetDouble(int placeholder, double value);
+    void SetBool(int placeholder, bool value);
+    void SetEntity(int placeholder, const CEntity& ent);
+    void SetNull(int placeholder);
+
+    bool HasValue(int placeholder) const { return m_HasValue[placeholder] != 0; }
+    // removes all values
+    void Clear();
+
+    const CTemplate& Template() const { return m_Template; }
+
+private:
+    friend class CTemplate;
+
+    // the (cleared) text of the placeholder after checking its type
+    std::string& Value(int placeholder, ETemplateType type);
+
+    const CTemplate& m_Template;
+    std::vector<std::string> m_Values;  // json text of the value of each placeholder
+    std::vector<char> m_HasValue;
+};
+
+} // minijson
+
+#endif
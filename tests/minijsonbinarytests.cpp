@@ -0,0 +1,247 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonbinary.h>
+#include <memory>
+
+static std::string FromHex(const char* hex)
+{
+    std::string out;
+    for (size_t i = 0; hex[i] && hex[i + 1]; i += 2)
+    {
+        char buf[3] = { hex[i], hex[i + 1], 0 };
+        out += (char)strtol(buf, NULL, 16);
+    }
+    return out;
+}
+
+static std::string ToHex(const std::string& data)
+{
+    static const char* hex = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        out += hex[((unsigned char)data[i] >> 4) & 0xf];
+        out += hex[(unsigned char)data[i] & 0xf];
+    }
+    return out;
+}
+
+/**
+ * Struct for parameterized encoding tests, providing a json text and its expected binary
+ * encoding (as hex string).
+ **/
+struct MiniJSONBinaryTestParam
+{
+    MiniJSONBinaryTestParam(const char* json, const char* hex)
+        : m_Json(json), m_Hex(hex)
+    {
+    }
+    const char* m_Json;
+    const char* m_Hex;
+};
+
+class MiniJSONCborTest : public ::testing::TestWithParam<MiniJSONBinaryTestParam>
+{
+};
+TEST_P(MiniJSONCborTest, EncodeDecode)
+{
+    const MiniJSONBinaryTestParam& p = GetParam();
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(p.m_Json));
+    EXPECT_EQ(std::string(p.m_Hex), ToHex(minijson::CCborWriter::Encode(*e)));
+
+    std::unique_ptr<minijson::CEntity> decoded;
+    ASSERT_NO_THROW(decoded.reset(minijson::CCborReader::Decode(FromHex(p.m_Hex))));
+    EXPECT_EQ(e->ToString(false), decoded->ToString(false));
+}
+INSTANTIATE_TEST_CASE_P(
+        MiniJSONCborTest, // instantiation name
+        MiniJSONCborTest, // class name
+        // expected encodings, see RFC 8949 appendix A
+        ::testing::Values(
+            MiniJSONBinaryTestParam("[0]", "8100"),
+            MiniJSONBinaryTestParam("[23]", "8117"),
+            MiniJSONBinaryTestParam("[24]", "811818"),
+            MiniJSONBinaryTestParam("[1000]", "811903e8"),
+            MiniJSONBinaryTestParam("[1000000000000]", "811b000000e8d4a51000"),
+            MiniJSONBinaryTestParam("[18446744073709551615]", "811bffffffffffffffff"),
+            MiniJSONBinaryTestParam("[-1]", "8120"),
+            MiniJSONBinaryTestParam("[-1000]", "813903e7"),
+            MiniJSONBinaryTestParam("[1.5]", "81fa3fc00000"),
+            MiniJSONBinaryTestParam("[1.1]", "81fb3ff199999999999a"),
+            MiniJSONBinaryTestParam("[true, false, null]", "83f5f4f6"),
+            MiniJSONBinaryTestParam("[\"\", \"a\", \"\\u00fc\"]", "83606161"  "62c3bc"),
+            MiniJSONBinaryTestParam("{\"a\": 1, \"b\": [2, 3]}", "a26161016162820203"),
+            MiniJSONBinaryTestParam("[]", "80"),
+            MiniJSONBinaryTestParam("{}", "a0")
+        )
+);
+
+TEST(MiniJSONCborTest, DecodeSpecialItems)
+{
+    struct
+    {
+        const char* m_Hex;
+        const char* m_Json;
+    } cases[] = {
+        { "f93e00", "1.5" },                  // half precision float
+        { "f97c00", "null" },                 // infinity is not representable in json
+        { "9f0102ff", "[1,2]" },              // indefinite length array
+        { "bf6161f5ff", "{\"a\":true}" },     // indefinite length map
+        { "7f657374726561646d696e67ff", "\"streaming\"" }, // indefinite length string
+        { "c11a514b67b0", "1363896240" },     // tagged item
+        { "4401020304", "\"AQIDBA\"" },       // byte string as base64url
+        { "a1016161", "{\"1\":\"a\"}" },      // integer map key
+        { "3bffffffffffffffff", "-18446744073709551616" },
+        { "f7", "null" }                      // undefined
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        std::unique_ptr<minijson::CEntity> e;
+        ASSERT_NO_THROW(e.reset(minijson::CCborReader::Decode(FromHex(cases[i].m_Hex)))) << cases[i].m_Hex;
+        EXPECT_EQ(std::string(cases[i].m_Json), e->ToString(false)) << cases[i].m_Hex;
+    }
+}
+
+TEST(MiniJSONCborTest, DecodeInvalid)
+{
+    const char* cases[] = {
+        "",           // empty
+        "81",         // missing array element
+        "6261",       // truncated string
+        "1c",         // reserved additional information
+        "9f01",       // missing break
+        "0101",       // extra bytes
+        "a18101",     // array as map key
+        "9b7fffffffffffffff" // huge array length
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        EXPECT_THROW(delete minijson::CCborReader::Decode(FromHex(cases[i])), minijson::CParseErrorException) << cases[i];
+    }
+    std::string deep(1000, '\x81');
+    deep += '\x01';
+    EXPECT_THROW(delete minijson::CCborReader::Decode(deep), minijson::CParseErrorException);
+}
+
+TEST(MiniJSONCborTest, IndefiniteLengthFromEvents)
+{
+    std::string out;
+    minijson::CStringOutputStream stream(out);
+    minijson::CCborWriter writer(stream);
+    writer.StartObject(-1);
+    writer.Key("a", 1);
+    writer.StartArray(-1);
+    writer.Number("1", 1);
+    writer.EndArray();
+    writer.EndObject();
+    EXPECT_EQ(std::string("bf61619f01ffff"), ToHex(out));
+}
+
+TEST(MiniJSONBinaryTest, DoublesWithoutExponent)
+{
+    // float64 1e-7 and 1e20, the decoded text must be readable by the parser
+    const char* hex[] = { "82fb3e7ad7f29abcaf48fb4415af1d78b58c40", "92cb3e7ad7f29abcaf48cb4415af1d78b58c40" };
+    for (size_t i = 0; i < sizeof(hex) / sizeof(hex[0]); i++)
+    {
+        std::unique_ptr<minijson::CEntity> decoded(i == 0 ? minijson::CCborReader::Decode(FromHex(hex[i])) : minijson::CMsgPackReader::Decode(FromHex(hex[i])));
+        std::string text = decoded->ToString(false);
+        EXPECT_EQ("[0.0000001,100000000000000000000]", text);
+        std::unique_ptr<minijson::CEntity> reparsed;
+        ASSERT_NO_THROW(reparsed.reset(minijson::CParser::ParseString(text))) << text;
+        EXPECT_EQ(1e-7, (*reparsed)[0].DoubleValue());
+        EXPECT_EQ(1e20, (*reparsed)[1].DoubleValue());
+        EXPECT_EQ(hex[i], ToHex(i == 0 ? minijson::CCborWriter::Encode(*reparsed) : minijson::CMsgPackWriter::Encode(*reparsed)));
+    }
+}
+
+class MiniJSONMsgPackTest : public ::testing::TestWithParam<MiniJSONBinaryTestParam>
+{
+};
+TEST_P(MiniJSONMsgPackTest, EncodeDecode)
+{
+    const MiniJSONBinaryTestParam& p = GetParam();
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(p.m_Json));
+    EXPECT_EQ(std::string(p.m_Hex), ToHex(minijson::CMsgPackWriter::Encode(*e)));
+
+    std::unique_ptr<minijson::CEntity> decoded;
+    ASSERT_NO_THROW(decoded.reset(minijson::CMsgPackReader::Decode(FromHex(p.m_Hex))));
+    EXPECT_EQ(e->ToString(false), decoded->ToString(false));
+}
+INSTANTIATE_TEST_CASE_P(
+        MiniJSONMsgPackTest, // instantiation name
+        MiniJSONMsgPackTest, // class name
+        ::testing::Values(
+            MiniJSONBinaryTestParam("[0, 127, 128, 65535, 65536]", "95007fcc80cdffffce00010000"),
+            MiniJSONBinaryTestParam("[-1, -32, -33, -129, -32769]", "95ffe0d0dfd1ff7fd2ffff7fff"),
+            MiniJSONBinaryTestParam("[-9223372036854775808]", "91d38000000000000000"),
+            MiniJSONBinaryTestParam("[1.5, 1.1]", "92ca3fc00000cb3ff199999999999a"),
+            MiniJSONBinaryTestParam("[true, false, null]", "93c3c2c0"),
+            MiniJSONBinaryTestParam("{\"a\": 1, \"b\": [2, 3]}", "82a16101a162920203"),
+            MiniJSONBinaryTestParam("[\"\"]", "91a0"),
+            MiniJSONBinaryTestParam("[]", "90"),
+            MiniJSONBinaryTestParam("{}", "80")
+        )
+);
+
+TEST(MiniJSONMsgPackTest, LargeContainersAndStrings)
+{
+    minijson::CObject obj;
+    minijson::CArray* arr = obj.AddArray("a");
+    for (int i = 0; i < 70000; i++)
+    {
+        arr->AddInt(i);
+    }
+    obj.AddString("s", std::string(300, 'x').c_str());
+    std::string encoded = minijson::CMsgPackWriter::Encode(obj);
+    std::unique_ptr<minijson::CEntity> decoded(minijson::CMsgPackReader::Decode(encoded));
+    EXPECT_EQ(obj.ToString(false), decoded->ToString(false));
+}
+
+TEST(MiniJSONMsgPackTest, UnknownSizesAreBuffered)
+{
+    std::string out;
+    minijson::CStringOutputStream stream(out);
+    minijson::CMsgPackWriter writer(stream);
+    writer.StartObject(-1);
+    writer.Key("a", 1);
+    writer.StartArray(-1);
+    writer.Number("1", 1);
+    writer.String("x", 1);
+    writer.StartArray(0);
+    writer.EndArray();
+    writer.EndArray();
+    writer.Key("b", 1);
+    writer.Null();
+    writer.EndObject();
+    EXPECT_EQ(std::string("82a1619301a17890a162c0"), ToHex(out));
+}
+
+TEST(MiniJSONMsgPackTest, DecodeInvalid)
+{
+    const char* cases[] = {
+        "",           // empty
+        "c1",         // never used type byte
+        "92",         // missing array elements
+        "a361",       // truncated string
+        "0101",       // extra bytes
+        "819000",     // array as map key
+        "dd7fffffff"  // huge array length
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        EXPECT_THROW(delete minijson::CMsgPackReader::Decode(FromHex(cases[i])), minijson::CParseErrorException) << cases[i];
+    }
+}
+
+TEST(MiniJSONBinaryTest, CborToJsonWithoutDom)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString("{\"x\": [1, \"two\", {\"three\": 3.5}], \"y\": null}"));
+    std::string cbor = minijson::CCborWriter::Encode(*e);
+
+    std::string json;
+    minijson::CStringOutputStream stream(json);
+    minijson::CStreamWriter writer(stream, false);
+    minijson::CCborReader reader;
+    reader.Parse(cbor.data(), cbor.size(), writer);
+    EXPECT_EQ(e->ToString(false), json);
+}
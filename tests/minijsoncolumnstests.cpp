@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsoncolumns.h>
+#include <memory>
+#include <string.h>
+
+static const char* s_RecordsJSON =
+    "[{\"ts\": 1000, \"price\": 1.5, \"open\": true, \"symbol\": \"ABC\"},"
+    " {\"ts\": -9223372036854775808, \"price\": 2, \"symbol\": \"\\u00e4\", \"extra\": {\"x\": [1]}},"
+    " {\"ts\": null, \"price\": -0.25, \"open\": false, \"symbol\": null},"
+    " {}]";
+
+static void ExpectRecordColumns(const minijson::CColumnTable& table)
+{
+    ASSERT_EQ(4u, table.Rows());
+    const minijson::CColumn& ts = *table.Column("ts");
+    EXPECT_EQ(1000, ts.Int64s()[0]);
+    EXPECT_EQ(-9223372036854775807LL - 1, ts.Int64s()[1]);
+    EXPECT_EQ(0, ts.Int64s()[2]);
+    EXPECT_EQ(2u, ts.NullCount());
+    EXPECT_EQ(0x3, ts.Validity()[0]);
+
+    const minijson::CColumn& price = *table.Column("price");
+    EXPECT_EQ(1.5, price.Doubles()[0]);
+    EXPECT_EQ(2.0, price.Doubles()[1]);
+    EXPECT_EQ(-0.25, price.Doubles()[2]);
+    EXPECT_FALSE(price.IsValid(3));
+    EXPECT_EQ(1u, price.NullCount());
+
+    const minijson::CColumn& open = *table.Column("open");
+    EXPECT_EQ(1, open.Bools()[0]);
+    EXPECT_FALSE(open.IsValid(1));
+    EXPECT_TRUE(open.IsValid(2));
+    EXPECT_EQ(0, open.Bools()[2]);
+
+    const minijson::CColumn& symbol = *table.Column("symbol");
+    EXPECT_EQ("ABC", symbol.StringAt(0));
+    EXPECT_EQ("\xc3\xa4", symbol.StringAt(1));
+    EXPECT_EQ("", symbol.StringAt(2));
+    EXPECT_EQ(5u, symbol.Offsets()[4]);
+    EXPECT_EQ(0, memcmp("ABC\xc3\xa4", symbol.Chars(), 5));
+    EXPECT_EQ(0x3, symbol.Validity()[0]);
+}
+
+static void AddRecordColumns(minijson::CColumnTable& table)
+{
+    table.AddColumn("ts", minijson::COLUMN_INT64);
+    table.AddColumn("price", minijson::COLUMN_DOUBLE);
+    table.AddColumn("open", minijson::COLUMN_BOOL);
+    table.AddColumn("symbol", minijson::COLUMN_STRING);
+}
+
+TEST(MiniJSONColumnsTest, FromArray)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_RecordsJSON));
+    minijson::CColumnTable table;
+    AddRecordColumns(table);
+    table.Extract(doc->Array());
+    ExpectRecordColumns(table);
+}
+
+TEST(MiniJSONColumnsTest, FromText)
+{
+    minijson::CColumnTable table;
+    AddRecordColumns(table);
+    table.Extract(s_RecordsJSON, strlen(s_RecordsJSON));
+    ExpectRecordColumns(table);
+
+    // NDJSON, duplicate members: the last one wins
+    table.Clear();
+    const char* ndjson = "{\"ts\": 1, \"symbol\": \"a\", \"symbol\": \"bc\"}\n{\"ts\": 2, \"ts\": null}\n";
+    table.Extract(ndjson, strlen(ndjson));
+    ASSERT_EQ(2u, table.Rows());
+    EXPECT_EQ("bc", table.Column("symbol")->StringAt(0));
+    EXPECT_EQ(2u, table.Column("symbol")->Offsets()[2]);
+    EXPECT_TRUE(table.Column("ts")->IsValid(0));
+    EXPECT_FALSE(table.Column("ts")->IsValid(1));
+    EXPECT_EQ(0, table.Column("ts")->Int64s()[1]);
+}
+
+TEST(MiniJSONColumnsTest, Errors)
+{
+    static const char* invalid[] = {
+        "[{\"ts\": 1.5}]",
+        "[{\"ts\": 9223372036854775808}]",
+        "[{\"ts\": \"1\"}]",
+        "[{\"price\": true}]",
+        "[{\"symbol\": 1}]",
+        "[{\"symbol\": [\"a\"]}]",
+        "[{\"open\": {}}]",
+        "[1]",
+        "[[]]"
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        minijson::CColumnTable table;
+        AddRecordColumns(table);
+        table.Extract(s_RecordsJSON, strlen(s_RecordsJSON));
+        std::string text = std::string(invalid[i], strlen(invalid[i]) - 1) + ", {\"ts\": 5}]";
+        EXPECT_THROW(table.Extract(text.c_str(), text.size()), minijson::CException) << invalid[i];
+        ExpectRecordColumns(table);
+
+        std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(text));
+        EXPECT_THROW(table.Extract(doc->Array()), minijson::CException) << invalid[i];
+        ExpectRecordColumns(table);
+    }
+    minijson::CColumnTable table;
+    table.AddColumn("a", minijson::COLUMN_BOOL);
+    EXPECT_THROW(table.AddColumn("a", minijson::COLUMN_STRING), minijson::CException);
+}
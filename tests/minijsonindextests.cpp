@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonindex.h>
+#include <memory>
+
+static const char* s_RecordsJSON =
+    "[{\"id\": \"a\", \"n\": 1, \"address\": {\"zip\": \"10\"}},"
+    " {\"id\": \"b\", \"n\": 2.0, \"address\": {\"zip\": \"20\"}},"
+    " {\"id\": \"c\", \"n\": 3, \"address\": {\"zip\": \"10\"}},"
+    " {\"name\": \"no id\"},"
+    " 7]";
+
+TEST(MiniJSONIndexTest, Unique)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_RecordsJSON));
+    minijson::CArray& arr = doc->Array();
+    minijson::CIndex index(arr, "id");
+    EXPECT_EQ(3, index.Count());
+    EXPECT_EQ(&arr[1], index.Find("b"));
+    EXPECT_EQ((minijson::CEntity*)NULL, index.Find("d"));
+    EXPECT_EQ((minijson::CEntity*)NULL, index.Find(1));
+
+    // numbers match by value
+    minijson::CIndex byNumber(arr, "n");
+    EXPECT_EQ(&arr[1], byNumber.Find(2));
+    minijson::CNumber num;
+    num.SetString("3.00");
+    EXPECT_EQ(2, byNumber.FindPosition(num));
+
+    EXPECT_THROW(minijson::CIndex(arr, "address.zip"), minijson::CException);
+    EXPECT_THROW(minijson::CIndex(arr, "/a~2"), minijson::CException);
+}
+
+TEST(MiniJSONIndexTest, Multi)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_RecordsJSON));
+    minijson::CArray& arr = doc->Array();
+    minijson::CIndex index(arr, "/address/zip", minijson::INDEX_MULTI);
+    std::vector<minijson::CEntity*> elements;
+    index.FindAll("10", elements);
+    ASSERT_EQ(2u, elements.size());
+    EXPECT_EQ(&arr[0], elements[0]);
+    EXPECT_EQ(&arr[2], elements[1]);
+    EXPECT_EQ(&arr[0], index.Find("10"));
+    elements.clear();
+    index.FindAll("30", elements);
+    EXPECT_TRUE(elements.empty());
+
+    // the elements themselves
+    minijson::CIndex values(arr, "", minijson::INDEX_MULTI);
+    EXPECT_EQ(&arr[4], values.Find(7));
+    EXPECT_EQ(5, values.Count());
+}
+
+TEST(MiniJSONIndexTest, FollowsModifications)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_RecordsJSON));
+    minijson::CArray& arr = doc->Array();
+    minijson::CIndex index(arr, "id");
+
+    minijson::CObject* added = arr.AddObject();
+    added->AddString("id", "d");
+    EXPECT_EQ(added, index.Find("d"));
+    arr.Remove(0);
+    EXPECT_EQ((minijson::CEntity*)NULL, index.Find("a"));
+    EXPECT_EQ(&arr[0], index.Find("b"));
+    arr[0].Object().SetString("id", "x");
+    EXPECT_EQ(&arr[0], index.Find("x"));
+    EXPECT_EQ((minijson::CEntity*)NULL, index.Find("b"));
+    EXPECT_EQ(3, index.Count());
+
+    // duplicates are reported by the next lookup
+    arr[1].Object().SetString("id", "x");
+    EXPECT_THROW(index.Find("x"), minijson::CException);
+    EXPECT_EQ(0, index.Count());
+    std::unique_ptr<minijson::CEntity> key(minijson::CParser::ParseString("[\"c\"]"));
+    EXPECT_THROW(index.FindPosition((*key)[0]), minijson::CException);
+    std::vector<minijson::CEntity*> found;
+    EXPECT_THROW(index.FindAll("c", found), minijson::CException);
+    arr[1].Object().SetString("id", "c");
+    EXPECT_EQ(&arr[1], index.Find("c"));
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonparallel.h>
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static minijson::CEntity* CreateParallelTestDocument()
+{
+    minijson::CObject* root = new minijson::CObject();
+    minijson::CArray* items = root->AddArray("items");
+    for (int i = 0; i < 3000; i++)
+    {
+        minijson::CObject* item = items->AddObject();
+        item->AddInt("id", i);
+        item->AddString("name", ("item \"" + std::to_string(i) + "\"\n").c_str());
+        minijson::CArray* values = item->AddArray("values");
+        for (int j = 0; j < i % 5; j++)
+        {
+            values->AddDouble(j * 0.5);
+        }
+        if (i % 100 == 0)
+        {
+            item->AddObject("empty");
+            item->AddArray("none");
+            item->AddNull("nothing");
+        }
+    }
+    root->AddString("header", "h");
+    minijson::CObject* nested = root->AddObject("nested");
+    for (int i = 0; i < 500; i++)
+    {
+        nested->AddArray(("k" + std::to_string(i)).c_str())->AddBool(i % 2 == 0);
+    }
+    root->AddArray("zempty");
+    return root;
+}
+
+static std::string WriteParallel(minijson::CThreadPool& pool, const minijson::CEntity& e, bool prettyPrint, size_t chunkSize, int level = 0)
+{
+    std::string out;
+    minijson::CStringOutputStream stream(out);
+    minijson::CParallelWriter writer(pool, prettyPrint, "  ", level);
+    writer.SetChunkSize(chunkSize);
+    writer.Write(stream, e);
+    return out;
+}
+
+TEST(MiniJSONParallelTest, ThreadPool)
+{
+    minijson::CThreadPool pool(4);
+    EXPECT_EQ((size_t)4, pool.Threads());
+    std::vector<std::atomic<int> > counts(1000);
+    std::atomic<int> nested(0);
+    pool.Run(counts.size(), [&](size_t index, size_t thread) {
+        EXPECT_LT(thread, pool.Threads());
+        counts[index]++;
+        if (index % 100 == 0)
+        {
+            pool.Run(3, [&](size_t, size_t nestedThread) {
+                EXPECT_EQ(thread, nestedThread);
+                nested++;
+            });
+        }
+    });
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        EXPECT_EQ(1, counts[i]);
+    }
+    EXPECT_EQ(30, nested);
+
+    EXPECT_THROW(pool.Run(100, [](size_t index, size_t) {
+        if (index == 50)
+        {
+            throw minijson::CException("task %d failed", (int)index);
+        }
+    }), minijson::CException);
+
+    // the pool is still usable after an exception
+    std::atomic<int> sum(0);
+    pool.Run(10, [&](size_t index, size_t) { sum += (int)index; });
+    EXPECT_EQ(45, sum);
+}
+
+TEST(MiniJSONParallelTest, IdenticalOutput)
+{
+    std::unique_ptr<minijson::CEntity> e(CreateParallelTestDocument());
+    minijson::CThreadPool pool(4);
+    for (int pretty = 0; pretty < 2; pretty++)
+    {
+        std::string expected = e->ToString(pretty != 0);
+        const size_t chunkSizes[] = { 1, 7, 100, 4096, 1 << 20 };
+        for (size_t i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); i++)
+        {
+            EXPECT_EQ(expected, WriteParallel(pool, *e, pretty != 0, chunkSizes[i])) << pretty << " " << chunkSizes[i];
+        }
+        EXPECT_EQ(e->ToString(pretty != 0, "  ", 2), WriteParallel(pool, *e, pretty != 0, 100, 2));
+        minijson::CThreadPool single(1);
+        EXPECT_EQ(expected, WriteParallel(single, *e, pretty != 0, 100));
+    }
+}
+
+TEST(MiniJSONParallelTest, WriteToFile)
+{
+    std::unique_ptr<minijson::CEntity> e(CreateParallelTestDocument());
+    minijson::CThreadPool pool(3);
+    minijson::CParallelWriter writer(pool, false);
+    writer.SetChunkSize(1000);
+    const char* path = "minijsonparalleltest.tmp";
+    writer.WriteToFile(path, *e);
+    std::unique_ptr<minijson::CEntity> read(minijson::CParser::ParseFromFile(path));
+    remove(path);
+    EXPECT_EQ(e->ToString(false), read->ToString(false));
+}
+
+TEST(MiniJSONParallelTest, WorkStealing)
+{
+    // the tasks of thread 0 block until all other indices are done, i.e. they have to be stolen
+    minijson::CThreadPool pool(4);
+    std::atomic<int> done(0);
+    pool.Run(400, [&](size_t index, size_t) {
+        if (index == 0)
+        {
+            while (done < 399)
+            {
+                std::this_thread::yield();
+            }
+        }
+        done++;
+    });
+    EXPECT_EQ(400, done);
+}
+
+TEST(MiniJSONParallelTest, BatchParser)
+{
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 1000; i++)
+    {
+        if (i % 97 == 13)
+        {
+            inputs.push_back("{\"id\": " + std::to_string(i) + ", \"bad\": [1, 2}");
+        }
+        else
+        {
+            inputs.push_back("{\"id\": " + std::to_string(i) + ", \"name\": \"message number " + std::to_string(i) + "\"}");
+        }
+    }
+    minijson::CThreadPool pool(4);
+    minijson::CBatchParser batch(pool);
+    for (int round = 0; round < 3; round++)
+    {
+        batch.ParseBatch(inputs);
+        ASSERT_EQ(inputs.size(), batch.Count());
+        size_t errors = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            if (i % 97 == 13)
+            {
+                EXPECT_EQ((minijson::CEntity*)NULL, batch.Entity(i));
+                EXPECT_EQ(minijson::PARSE_ERROR_EXPECTED_ARRAY_END, batch.Result(i).Error());
+                EXPECT_EQ(1, batch.Result(i).Line());
+                errors++;
+            }
+            else
+            {
+                ASSERT_TRUE(batch.Entity(i) != NULL);
+                EXPECT_TRUE(batch.Result(i).Ok());
+                EXPECT_EQ((int)i, (*batch.Entity(i))["id"].IntValue());
+            }
+        }
+        EXPECT_EQ(errors, batch.Errors());
+    }
+    batch.Clear();
+    EXPECT_EQ((size_t)0, batch.Count());
+
+    // inputs are checked like CParser does
+    std::vector<std::string> latin1(1, "[\"\xe4\"]");
+    batch.ParseBatch(latin1);
+    EXPECT_EQ(minijson::PARSE_ERROR_INVALID_UTF8, batch.Result(0).Error());
+    batch.SetCheckUTF8(false);
+    batch.ParseBatch(latin1);
+    EXPECT_TRUE(batch.Result(0).Ok());
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonparserpool.h>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static const char* PARSER_POOL_TEST_JSON = "{\"id\": 17, \"name\": \"a rather long name that does not fit into small strings\", \"tags\": [\"x\", \"y\"]}";
+
+TEST(MiniJSONParserPoolTest, Reuse)
+{
+    minijson::CParserPool::Clear();
+    minijson::CParser* first = NULL;
+    {
+        minijson::CPooledParser parser = minijson::CParserPool::Acquire();
+        first = &*parser;
+        std::unique_ptr<minijson::CEntity> e(parser->Parse(PARSER_POOL_TEST_JSON));
+        EXPECT_EQ(17, (*e)["id"].IntValue());
+        EXPECT_EQ((size_t)0, minijson::CParserPool::IdleParsers());
+    }
+    EXPECT_EQ((size_t)1, minijson::CParserPool::IdleParsers());
+
+    minijson::CParseStats stats;
+    minijson::CCountingAllocator counting;
+    {
+        minijson::CPooledParser parser = minijson::CParserPool::Acquire();
+        EXPECT_EQ(first, &*parser);
+        parser->SetStats(&stats);
+        parser->SetAllocator(&counting);
+        parser->SetCheckUTF8(false);
+
+        // nested use (e.g. by a callee) gets a different parser
+        minijson::CPooledParser nested = minijson::CParserPool::Acquire();
+        EXPECT_NE(first, &*nested);
+        minijson::CPooledParser moved(std::move(nested));
+        parser->Delete(parser->Parse(PARSER_POOL_TEST_JSON));
+    }
+    EXPECT_EQ((size_t)2, minijson::CParserPool::IdleParsers());
+
+    // settings are reset when a parser is returned
+    minijson::CPooledParser parser = minijson::CParserPool::Acquire();
+    EXPECT_EQ((minijson::CParseStats*)NULL, parser->Stats());
+    EXPECT_EQ(&minijson::CAllocator::Default(), &parser->Allocator());
+    EXPECT_TRUE(parser->CheckUTF8());
+    minijson::CParserPool::Clear();
+    EXPECT_EQ((size_t)0, minijson::CParserPool::IdleParsers());
+}
+
+TEST(MiniJSONParserPoolTest, IdleLimit)
+{
+    minijson::CParserPool::Clear();
+    {
+        std::vector<minijson::CPooledParser> parsers;
+        for (size_t i = 0; i < minijson::CParserPool::MAX_IDLE_PARSERS + 4; i++)
+        {
+            parsers.push_back(minijson::CParserPool::Acquire());
+        }
+    }
+    EXPECT_EQ(minijson::CParserPool::MAX_IDLE_PARSERS, minijson::CParserPool::IdleParsers());
+    minijson::CParserPool::Clear();
+}
+
+TEST(MiniJSONParserPoolTest, Threads)
+{
+    std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString(PARSER_POOL_TEST_JSON));
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (size_t t = 0; t < failures.size(); t++)
+    {
+        threads.push_back(std::thread([&expected, &failures, t]() {
+            for (int i = 0; i < 1000; i++)
+            {
+                minijson::CPooledParser parser = minijson::CParserPool::Acquire();
+                std::unique_ptr<minijson::CEntity> e(parser->Parse(PARSER_POOL_TEST_JSON));
+                if (e->ToString() != expected->ToString())
+                {
+                    failures[t]++;
+                }
+            }
+            if (minijson::CParserPool::IdleParsers() != 1)
+            {
+                failures[t]++;
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        threads[t].join();
+        EXPECT_EQ(0, failures[t]);
+    }
+}
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonpatch.h>
+#include <memory>
+
+/**
+ * Struct for parameterized patch tests: a document, a patch and the expected result (compact
+ * json text), NULL if the patch has to fail (and leave the document unchanged).
+ **/
+struct MiniJSONPatchTestParam
+{
+    MiniJSONPatchTestParam(const char* doc, const char* patch, const char* expected)
+        : m_Doc(doc), m_Patch(patch), m_Expected(expected)
+    {
+    }
+    const char* m_Doc;
+    const char* m_Patch;
+    const char* m_Expected;
+};
+
+class MiniJSONPatchTest : public ::testing::TestWithParam<MiniJSONPatchTestParam>
+{
+};
+TEST_P(MiniJSONPatchTest, Apply)
+{
+    const MiniJSONPatchTestParam& p = GetParam();
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(p.m_Doc));
+    std::unique_ptr<minijson::CEntity> patch(minijson::CParser::ParseString(p.m_Patch));
+    std::string before = doc->ToString(false);
+    if (p.m_Expected)
+    {
+        ASSERT_NO_THROW(minijson::ApplyPatch(*doc, patch->Array()));
+        std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString(p.m_Expected));
+        EXPECT_EQ(expected->ToString(false), doc->ToString(false));
+    }
+    else
+    {
+        EXPECT_THROW(minijson::ApplyPatch(*doc, patch->Array()), minijson::CException);
+        EXPECT_EQ(before, doc->ToString(false));
+    }
+}
+INSTANTIATE_TEST_CASE_P(
+        MiniJSONPatchTest, // instantiation name
+        MiniJSONPatchTest, // class name
+        // mostly the examples of RFC 6902 appendix A
+        ::testing::Values(
+            MiniJSONPatchTestParam("{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/baz\", \"value\": \"qux\"}]", "{\"baz\": \"qux\", \"foo\": \"bar\"}"),
+            MiniJSONPatchTestParam("{\"foo\": [\"bar\", \"baz\"]}", "[{\"op\": \"add\", \"path\": \"/foo/1\", \"value\": \"qux\"}]", "{\"foo\": [\"bar\", \"qux\", \"baz\"]}"),
+            MiniJSONPatchTestParam("{\"foo\": [\"bar\"]}", "[{\"op\": \"add\", \"path\": \"/foo/-\", \"value\": [\"abc\", \"def\"]}]", "{\"foo\": [\"bar\", [\"abc\", \"def\"]]}"),
+            MiniJSONPatchTestParam("{\"baz\": \"qux\", \"foo\": \"bar\"}", "[{\"op\": \"remove\", \"path\": \"/baz\"}]", "{\"foo\": \"bar\"}"),
+            MiniJSONPatchTestParam("{\"foo\": [\"bar\", \"qux\", \"baz\"]}", "[{\"op\": \"remove\", \"path\": \"/foo/1\"}]", "{\"foo\": [\"bar\", \"baz\"]}"),
+            MiniJSONPatchTestParam("{\"baz\": \"qux\", \"foo\": \"bar\"}", "[{\"op\": \"replace\", \"path\": \"/baz\", \"value\": \"boo\"}]", "{\"baz\": \"boo\", \"foo\": \"bar\"}"),
+            MiniJSONPatchTestParam("{\"foo\": {\"bar\": \"baz\", \"waldo\": \"fred\"}, \"qux\": {\"corge\": \"grault\"}}",
+                                   "[{\"op\": \"move\", \"from\": \"/foo/waldo\", \"path\": \"/qux/thud\"}]",
+                                   "{\"foo\": {\"bar\": \"baz\"}, \"qux\": {\"corge\": \"grault\", \"thud\": \"fred\"}}"),
+            MiniJSONPatchTestParam("{\"foo\": [\"all\", \"grass\", \"cows\", \"eat\"]}", "[{\"op\": \"move\", \"from\": \"/foo/1\", \"path\": \"/foo/3\"}]", "{\"foo\": [\"all\", \"cows\", \"eat\", \"grass\"]}"),
+            MiniJSONPatchTestParam("{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}",
+                                   "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"qux\"}, {\"op\": \"test\", \"path\": \"/foo/1\", \"value\": 2.0}]",
+                                   "{\"baz\": \"qux\", \"foo\": [\"a\", 2, \"c\"]}"),
+            MiniJSONPatchTestParam("{\"baz\": \"qux\"}", "[{\"op\": \"test\", \"path\": \"/baz\", \"value\": \"bar\"}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/child\", \"value\": {\"grandchild\": {}}}]", "{\"foo\": \"bar\", \"child\": {\"grandchild\": {}}}"),
+            MiniJSONPatchTestParam("{\"foo\": \"bar\"}", "[{\"op\": \"add\", \"path\": \"/baz/bat\", \"value\": \"qux\"}]", NULL),
+            MiniJSONPatchTestParam("{\"/\": 9, \"~1\": 10}", "[{\"op\": \"test\", \"path\": \"/~01\", \"value\": 10}, {\"op\": \"copy\", \"from\": \"/~1\", \"path\": \"/x\"}]", "{\"/\": 9, \"~1\": 10, \"x\": 9}"),
+            MiniJSONPatchTestParam("{\"foo\": [\"bar\"]}", "[{\"op\": \"add\", \"path\": \"/foo/01\", \"value\": 1}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": [\"bar\"]}", "[{\"op\": \"add\", \"path\": \"/foo/2\", \"value\": 1}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": [\"bar\"]}", "[{\"op\": \"remove\", \"path\": \"/foo/-\"}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": {\"a\": 1}}", "[{\"op\": \"move\", \"from\": \"/foo\", \"path\": \"/foo/b\"}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": 1}", "[{\"op\": \"frobnicate\", \"path\": \"/foo\"}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": 1}", "[{\"op\": \"replace\", \"path\": \"\", \"value\": {}}]", NULL),
+            MiniJSONPatchTestParam("{\"foo\": 1}", "[{\"op\": \"add\", \"path\": \"/bar\"}]", NULL),
+            // all operations are undone if a later one fails
+            MiniJSONPatchTestParam("{\"a\": {\"b\": [1, 2, 3]}, \"c\": \"d\"}",
+                                   "[{\"op\": \"move\", \"from\": \"/a/b\", \"path\": \"/c\"},"
+                                   " {\"op\": \"remove\", \"path\": \"/c/0\"},"
+                                   " {\"op\": \"replace\", \"path\": \"/a\", \"value\": 5},"
+                                   " {\"op\": \"copy\", \"from\": \"/c\", \"path\": \"/e\"},"
+                                   " {\"op\": \"test\", \"path\": \"/e\", \"value\": [2]}]",
+                                   NULL)
+        ));
+
+TEST(MiniJSONPatchOperationsTest, MoveRelinks)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"a\": {\"big\": [1, 2, 3]}, \"b\": []}"));
+    std::unique_ptr<minijson::CEntity> patch(minijson::CParser::ParseString("[{\"op\": \"move\", \"from\": \"/a/big\", \"path\": \"/b/0\"}]"));
+    minijson::CEntity* moved = &(*doc)["a"]["big"];
+    minijson::ApplyPatch(*doc, patch->Array());
+    EXPECT_EQ(moved, &(*doc)["b"][0]);
+    EXPECT_EQ("{\"a\":{},\"b\":[[1,2,3]]}", doc->ToString(false));
+}
+
+TEST(MiniJSONPatchOperationsTest, RollbackKeepsMemberOrder)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"x\": 1, \"y\": 2, \"z\": 3}"));
+    std::unique_ptr<minijson::CEntity> patch(minijson::CParser::ParseString(
+        "[{\"op\": \"remove\", \"path\": \"/x\"}, {\"op\": \"replace\", \"path\": \"/y\", \"value\": 7}, {\"op\": \"add\", \"path\": \"/x\", \"value\": 0},"
+        " {\"op\": \"remove\", \"path\": \"/missing\"}]"));
+    minijson::CEntity* y = &(*doc)["y"];
+    EXPECT_THROW(minijson::ApplyPatch(*doc, patch->Array()), minijson::CException);
+    ASSERT_EQ(3, doc->Count());
+    EXPECT_EQ("x", doc->ObjectMemberNameByIndex(0));
+    EXPECT_EQ("y", doc->ObjectMemberNameByIndex(1));
+    EXPECT_EQ("z", doc->ObjectMemberNameByIndex(2));
+    EXPECT_EQ(y, &(*doc)["y"]);
+    EXPECT_EQ(2, (*doc)["y"].IntValue());
+
+    // a successful replace keeps the position of the member
+    patch.reset(minijson::CParser::ParseString("[{\"op\": \"replace\", \"path\": \"/x\", \"value\": \"one\"}]"));
+    minijson::ApplyPatch(*doc, patch->Array());
+    EXPECT_EQ("x", doc->ObjectMemberNameByIndex(0));
+    EXPECT_EQ("one", (*doc)["x"].StringValue());
+}
+
+TEST(MiniJSONPatchOperationsTest, SharedEntities)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"a\": {\"b\": [1, 2]}, \"c\": {\"b\": [1, 2]}}"));
+    doc->Deduplicate();
+    std::unique_ptr<minijson::CEntity> patch(minijson::CParser::ParseString(
+        "[{\"op\": \"add\", \"path\": \"/a/b/-\", \"value\": 3}, {\"op\": \"move\", \"from\": \"/c/b\", \"path\": \"/a/d\"}]"));
+    minijson::ApplyPatch(*doc, patch->Array());
+    EXPECT_EQ("{\"a\":{\"b\":[1,2,3],\"d\":[1,2]},\"c\":{}}", doc->ToString(false));
+}
+
+TEST(MiniJSONPatchOperationsTest, ResolvePointer)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"a\": [{\"b\": 1}], \"\": 2}"));
+    EXPECT_EQ(doc.get(), minijson::ResolvePointer(*doc, ""));
+    EXPECT_EQ(1, minijson::ResolvePointer(*doc, "/a/0/b")->IntValue());
+    EXPECT_EQ(2, minijson::ResolvePointer(*doc, "/")->IntValue());
+    EXPECT_EQ((minijson::CEntity*)NULL, minijson::ResolvePointer(*doc, "/a/1"));
+    EXPECT_EQ((minijson::CEntity*)NULL, minijson::ResolvePointer(*doc, "/a/0/b/c"));
+    EXPECT_THROW(minijson::ResolvePointer(*doc, "a"), minijson::CException);
+    EXPECT_THROW(minijson::ResolvePointer(*doc, "/a~2"), minijson::CException);
+}
+
+/**
+ * Struct for parameterized diff tests: two documents and the expected number of operations of
+ * their diff (-1: not checked).
+ **/
+struct MiniJSONDiffTestParam
+{
+    MiniJSONDiffTestParam(const char* a, const char* b, int operations)
+        : m_A(a), m_B(b), m_Operations(operations)
+    {
+    }
+    const char* m_A;
+    const char* m_B;
+    int m_Operations;
+};
+
+class MiniJSONDiffTest : public ::testing::TestWithParam<MiniJSONDiffTestParam>
+{
+};
+TEST_P(MiniJSONDiffTest, RoundTrip)
+{
+    const MiniJSONDiffTestParam& p = GetParam();
+    std::unique_ptr<minijson::CEntity> a(minijson::CParser::ParseString(p.m_A));
+    std::unique_ptr<minijson::CEntity> b(minijson::CParser::ParseString(p.m_B));
+    minijson::CDiff diff;
+    diff.SetArrayKey("id");
+    minijson::CArray patch;
+    diff.Diff(*a, *b, patch);
+    if (p.m_Operations >= 0)
+    {
+        EXPECT_EQ(p.m_Operations, patch.Count()) << patch.ToString(false);
+    }
+    ASSERT_NO_THROW(minijson::ApplyPatch(*a, patch)) << patch.ToString(false);
+    EXPECT_EQ(b->ToString(false), a->ToString(false)) << patch.ToString(false);
+}
+INSTANTIATE_TEST_CASE_P(
+        MiniJSONDiffTest, // instantiation name
+        MiniJSONDiffTest, // class name
+        ::testing::Values(
+            MiniJSONDiffTestParam("{\"a\": 1, \"b\": [1, 2]}", "{\"b\": [1, 2], \"a\": 1}", 0),
+            MiniJSONDiffTestParam("{\"a\": 1, \"b\": {\"c\": [true, null]}}", "{\"a\": 1, \"b\": {\"c\": [true, false]}}", 1),
+            MiniJSONDiffTestParam("{\"a\": 1, \"b\": 2}", "{\"a\": 1, \"c\": 3}", 2),
+            MiniJSONDiffTestParam("{\"old\": {\"x\": [1, 2, 3]}}", "{\"new\": {\"x\": [1, 2, 3]}}", 1),
+            MiniJSONDiffTestParam("{\"a/b\": 1, \"c~d\": [1]}", "{\"a/b\": 2, \"c~d\": [2]}", 2),
+            MiniJSONDiffTestParam("[\"x\", 1, 2, 3]", "[1, 2, 3, \"x\"]", 1),
+            MiniJSONDiffTestParam("[1, 2, 3, 4, 5]", "[1, 2, 9, 4, 5]", 1),
+            MiniJSONDiffTestParam("[1, 2, 3, 4, 5]", "[1, 2, 4, 5]", 1),
+            MiniJSONDiffTestParam("[1, 2, 3, 4, 5]", "[1, 2, 3, 3.5, 4, 5]", 1),
+            MiniJSONDiffTestParam("[1, 2, 3, 4, 5]", "[5, 4, 3, 2, 1]", 4),
+            MiniJSONDiffTestParam("[]", "[1, [2], {\"3\": 4}]", 3),
+            MiniJSONDiffTestParam("[1, [2], {\"3\": 4}]", "[]", 3),
+            MiniJSONDiffTestParam("[{\"id\": 1, \"v\": \"a\"}, {\"id\": 2, \"v\": \"b\"}, {\"id\": 3, \"v\": \"c\"}]",
+                                  "[{\"id\": 3, \"v\": \"C\"}, {\"id\": 1, \"v\": \"a\"}, {\"id\": 2, \"v\": \"b\"}]", 2),
+            MiniJSONDiffTestParam("[{\"id\": 1}, {\"id\": 2}]", "[{\"id\": 3}, {\"id\": 2}]", 2),
+            MiniJSONDiffTestParam("[{\"v\": 1}, \"s\", {\"v\": 2}]", "[{\"v\": 3}, {\"v\": 2}, \"t\"]", -1),
+            MiniJSONDiffTestParam("{\"a\": [1, {\"b\": [1, 2, {\"c\": 3}]}], \"d\": \"e\"}", "{\"a\": [{\"b\": [2, {\"c\": 4}, 1]}, 1], \"d\": [\"e\"]}", -1)
+        ));
+
+// random edits of a document are reproduced exactly by the diff
+TEST(MiniJSONPatchOperationsTest, DiffRandomEdits)
+{
+    unsigned int seed = 12345;
+    std::string json = "{\"items\": [";
+    for (int i = 0; i < 200; i++)
+    {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%s{\"id\": %d, \"name\": \"item%d\", \"tags\": [%d, %d], \"attrs\": {\"x\": %d}}", i ? "," : "", i, i, i % 7, i % 3, i % 5);
+        json += buf;
+    }
+    json += "], \"meta\": {\"count\": 200}}";
+    std::unique_ptr<minijson::CEntity> original(minijson::CParser::ParseString(json));
+    for (int round = 0; round < 20; round++)
+    {
+        std::unique_ptr<minijson::CEntity> edited(original->Copy());
+        minijson::CArray& items = (*edited)["items"].Array();
+        for (int edit = 0; edit < 10; edit++)
+        {
+            seed = seed * 1103515245 + 12345;
+            int index = (int)((seed >> 8) % (unsigned int)items.Count());
+            switch ((seed >> 4) % 5)
+            {
+            case 0:
+                items.Remove(index);
+                break;
+            case 1:
+                items.AddObject()->AddInt("id", 1000 + edit);
+                break;
+            case 2:
+                items[index]["attrs"].Object().SetInt("x", edit);
+                break;
+            case 3:
+                items.Insert((int)(seed >> 16) % items.Count(), items.Detach(index));
+                break;
+            default:
+                items[index]["tags"].Array().AddString("new");
+                break;
+            }
+        }
+        for (int withKey = 0; withKey < 2; withKey++)
+        {
+            minijson::CDiff diff;
+            diff.SetArrayKey(withKey ? "id" : "");
+            minijson::CArray patch;
+            diff.Diff(*original, *edited, patch);
+            std::unique_ptr<minijson::CEntity> patched(original->Copy());
+            ASSERT_NO_THROW(minijson::ApplyPatch(*patched, patch)) << patch.ToString(false);
+            ASSERT_EQ(edited->ToString(false), patched->ToString(false)) << patch.ToString(false);
+            EXPECT_LE(patch.Count(), 20); // at most two operations per edit
+        }
+    }
+}
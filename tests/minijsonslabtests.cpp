@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonslab.h>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const char* SLAB_TEST_JSON = "{\"a\": [1, 2.5, \"s\", false, null, {\"b\": []}], \"c\": {\"d\": \"e\"}}";
+
+TEST(MiniJSONSlabTest, ParseAndChurn)
+{
+    std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString(SLAB_TEST_JSON));
+    minijson::CCountingAllocator counting;
+    {
+        minijson::CSlabAllocator slab(true, counting);
+        minijson::CParser parser;
+        parser.SetAllocator(&slab);
+        minijson::CEntity* e = parser.Parse(SLAB_TEST_JSON);
+        EXPECT_EQ(expected->ToString(), e->ToString());
+
+        // add/remove churn on a live tree reuses the freed entries
+        minijson::CObject& obj = e->Object();
+        for (int i = 0; i < 10000; i++)
+        {
+            obj.SetInt("counter", i);
+            obj.SetString("state", i % 2 ? "odd" : "even");
+            obj.GetArray("a")->AddObject()->AddBoolean("x", true);
+            obj.GetArray("a")->Remove(6);
+            if (i % 3 == 0)
+            {
+                obj.Remove("state");
+            }
+        }
+        EXPECT_EQ(9999, obj.GetInt("counter"));
+        EXPECT_LE(slab.BytesReserved(), (size_t)20 * 64 * 1024);
+        EXPECT_EQ(slab.BytesReserved(), counting.BytesInUse());
+        delete e;
+    }
+    // all slabs are returned with the allocator
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+}
+
+TEST(MiniJSONSlabTest, LargeAllocationsUseParent)
+{
+    minijson::CCountingAllocator counting;
+    minijson::CSlabAllocator slab(false, counting);
+    void* p = slab.Allocate(4096);
+    EXPECT_EQ((size_t)4096, counting.BytesInUse());
+    slab.Free(p, 4096);
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+
+    p = slab.Allocate(24);
+    EXPECT_EQ((size_t)64 * 1024, counting.BytesInUse());
+    slab.Free(p, 24);
+}
+
+TEST(MiniJSONSlabTest, Threads)
+{
+    minijson::CCountingAllocator counting;
+    std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString(SLAB_TEST_JSON));
+    {
+        minijson::CSlabAllocator slab(true, counting);
+        const int threadCount = 4;
+        std::vector<std::vector<minijson::CEntity*> > parsed(threadCount);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; t++)
+        {
+            threads.push_back(std::thread([&slab, &parsed, t]() {
+                minijson::CParser parser;
+                parser.SetAllocator(&slab);
+                for (int i = 0; i < 500; i++)
+                {
+                    minijson::CEntity* e = parser.Parse(SLAB_TEST_JSON);
+                    if (i % 2)
+                    {
+                        delete e;
+                    }
+                    else
+                    {
+                        parsed[t].push_back(e);
+                    }
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            threads[t].join();
+        }
+        // entities are freed by a different thread than the one that allocated them
+        for (int t = 0; t < threadCount; t++)
+        {
+            for (size_t i = 0; i < parsed[t].size(); i++)
+            {
+                EXPECT_EQ(expected->ToString(), parsed[t][i]->ToString());
+                delete parsed[t][i];
+            }
+        }
+        slab.FlushThreadCache();
+    }
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+}
+
+TEST(MiniJSONSlabTest, ThreadOutlivesAllocator)
+{
+    std::unique_ptr<minijson::CCountingAllocator> counting(new minijson::CCountingAllocator());
+    std::unique_ptr<minijson::CSlabAllocator> slab(new minijson::CSlabAllocator(true, *counting));
+    std::promise<void> used;
+    std::promise<void> destroyed;
+    std::thread worker([&slab, &used, &destroyed]() {
+        minijson::CParser parser;
+        parser.SetAllocator(slab.get());
+        delete parser.Parse(SLAB_TEST_JSON); // the freed entries stay in the cache of this thread
+        used.set_value();
+        destroyed.get_future().wait();
+    });
+    used.get_future().wait();
+
+    // the slabs are returned with the allocator, the parent may go away before the thread exits
+    slab.reset();
+    EXPECT_EQ((size_t)0, counting->BytesInUse());
+    counting.reset();
+    destroyed.set_value();
+    worker.join();
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsonsnapshot.h>
+#include <memory>
+#include <stdio.h>
+
+static const char* SNAPSHOT_TEST_JSON =
+    "{\"name\": \"routes\", \"version\": 3, \"ratio\": 0.25, \"enabled\": true, \"disabled\": false,"
+    " \"nothing\": null, \"empty\": \"\", \"big\": -9007199254740993,"
+    " \"list\": [1, \"two\", {\"three\": 3}, [], {}],"
+    " \"zeta\": {\"name\": \"routes\", \"b\": 1, \"a\": 2}}";
+
+TEST(MiniJSONSnapshotTest, Accessors)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(SNAPSHOT_TEST_JSON));
+    std::string data = minijson::CSnapshotWriter::Compile(*e);
+
+    minijson::CSnapshot snapshot;
+    ASSERT_NO_THROW(snapshot.Attach(data.data(), data.size(), true));
+    minijson::CSnapshotValue root = snapshot.Root();
+    ASSERT_TRUE(root.IsObject());
+    EXPECT_EQ(e->Count(), root.Count());
+    EXPECT_STREQ("routes", root["name"].StringValue());
+    EXPECT_EQ(3, root["version"].IntValue());
+    EXPECT_DOUBLE_EQ(0.25, root["ratio"].DoubleValue());
+    EXPECT_TRUE(root["enabled"].BoolValue());
+    EXPECT_FALSE(root["disabled"].BoolValue());
+    EXPECT_TRUE(root["nothing"].IsNull());
+    EXPECT_STREQ("", root["empty"].StringValue());
+    EXPECT_EQ(-9007199254740993LL, root["big"].Int64Value());
+    EXPECT_STREQ("-9007199254740993", root["big"].NumberText());
+    EXPECT_EQ(5, root["list"].Count());
+    EXPECT_STREQ("two", root["list"][1].StringValue());
+    EXPECT_EQ(3, root["list"][2]["three"].IntValue());
+    EXPECT_EQ(2, root.GetInt("missing", 2));
+    EXPECT_STREQ("routes", root["zeta"].GetString("name"));
+    EXPECT_FALSE(root.Contains("missing"));
+    EXPECT_THROW(root["missing"], minijson::CException);
+    EXPECT_THROW(root["list"][5], minijson::CException);
+    EXPECT_THROW(root["name"].IntValue(), minijson::CException);
+
+    // member order is preserved
+    for (int i = 0; i < e->Count(); i++)
+    {
+        EXPECT_EQ(e->ObjectMemberNameByIndex(i), std::string(root.ObjectMemberNameByIndex(i)));
+    }
+    EXPECT_STREQ("b", root["zeta"].ObjectMemberNameByIndex(1));
+    EXPECT_EQ(1, root["zeta"][1].IntValue());
+}
+
+TEST(MiniJSONSnapshotTest, RoundTrip)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(SNAPSHOT_TEST_JSON));
+    std::string data = minijson::CSnapshotWriter::Compile(*e);
+    minijson::CSnapshot snapshot;
+    snapshot.Attach(data.data(), data.size());
+
+    std::unique_ptr<minijson::CEntity> copy(snapshot.Root().ToEntity());
+    EXPECT_EQ(e->ToString(), copy->ToString());
+    EXPECT_EQ(std::string("zeta"), copy->ObjectMemberNameByIndex(9));
+
+    std::string json;
+    minijson::CStringOutputStream stream(json);
+    minijson::CStreamWriter writer(stream);
+    snapshot.Root().Accept(writer);
+    EXPECT_EQ(e->ToString(), json);
+}
+
+TEST(MiniJSONSnapshotTest, StringsAreShared)
+{
+    minijson::CArray arr;
+    for (int i = 0; i < 1000; i++)
+    {
+        minijson::CObject* obj = arr.AddObject();
+        obj->AddString("country", "Germany");
+        obj->AddInt("id", i);
+    }
+    std::string data = minijson::CSnapshotWriter::Compile(arr);
+    // per element: object node (4 + 2 * 12 bytes), number node and number text
+    EXPECT_LT(data.size(), (size_t)1000 * 80);
+}
+
+TEST(MiniJSONSnapshotTest, InvalidSnapshots)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(SNAPSHOT_TEST_JSON));
+    std::string data = minijson::CSnapshotWriter::Compile(*e);
+    minijson::CSnapshot snapshot;
+
+    EXPECT_THROW(snapshot.Attach(data.data(), 16), minijson::CException);
+    EXPECT_THROW(snapshot.Attach(data.data(), data.size() - 8), minijson::CException);
+    std::string wrongMagic = data;
+    wrongMagic[0] = 'X';
+    EXPECT_THROW(snapshot.Attach(wrongMagic.data(), wrongMagic.size()), minijson::CException);
+    std::string modified = data;
+    modified[data.size() - 20] ^= 1;
+    EXPECT_THROW(snapshot.Attach(modified.data(), modified.size(), true), minijson::CException);
+    EXPECT_NO_THROW(snapshot.Attach(modified.data(), modified.size(), false));
+    EXPECT_FALSE(snapshot.VerifyChecksum());
+}
+
+TEST(MiniJSONSnapshotTest, OpenFile)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(SNAPSHOT_TEST_JSON));
+    char path[] = "minijsonsnapshottest.tmp";
+    minijson::CSnapshotWriter::CompileToFile(path, *e);
+    {
+        minijson::CSnapshot snapshot;
+        ASSERT_NO_THROW(snapshot.Open(path, true));
+        EXPECT_EQ(std::string("routes"), snapshot.Root().GetString("name"));
+        snapshot.Close();
+        EXPECT_THROW(snapshot.Root(), minijson::CException);
+    }
+    remove(path);
+    minijson::CSnapshot snapshot;
+    EXPECT_THROW(snapshot.Open(path), minijson::CIOException);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <minijson.h>
+#include <minijsontemplate.h>
+#include <memory>
+
+static const char* s_ResponseJSON =
+    "{\"id\": \"{{id:int}}\", \"name\": \"{{name}}\", \"score\": \"{{score:double}}\","
+    " \"active\": \"{{active:bool}}\", \"tags\": [\"a\", \"{{name}}\"], \"extra\": \"{{extra:json}}\","
+    " \"version\": 2, \"note\": \"{{x\", \"empty\": null}";
+
+TEST(MiniJSONTemplateTest, Render)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_ResponseJSON));
+    minijson::CTemplate tmpl(*doc, false);
+    ASSERT_EQ(5, tmpl.PlaceholderCount());
+    EXPECT_EQ("active", tmpl.PlaceholderName(0)); // members are written sorted
+    EXPECT_EQ(minijson::TEMPLATE_DOUBLE, tmpl.PlaceholderType(tmpl.FindPlaceholder("score")));
+    EXPECT_EQ(minijson::TEMPLATE_STRING, tmpl.PlaceholderType(tmpl.FindPlaceholder("name")));
+    EXPECT_EQ(-1, tmpl.FindPlaceholder("x"));
+
+    minijson::CTemplateValues values(tmpl);
+    values.SetInt(tmpl.FindPlaceholder("id"), -9223372036854775807LL - 1);
+    values.SetString(tmpl.FindPlaceholder("name"), "a \"b\"\n\\");
+    values.SetDouble(tmpl.FindPlaceholder("score"), 0.1);
+    values.SetBool(tmpl.FindPlaceholder("active"), true);
+    std::unique_ptr<minijson::CEntity> extra(minijson::CParser::ParseString("{\"b\": [1, {}], \"a\": \"\\u00e4\"}"));
+    values.SetEntity(tmpl.FindPlaceholder("extra"), *extra);
+
+    // the same text as the entity with the values
+    std::string out = tmpl.Render(values);
+    std::unique_ptr<minijson::CEntity> expected(doc->Copy());
+    expected->Object().SetString("name", "a \"b\"\n\\");
+    expected->Object().Remove("id");
+    expected->Object().Remove("score");
+    expected->Object().Remove("active");
+    expected->Object().Remove("extra");
+    std::unique_ptr<minijson::CEntity> rendered(minijson::CParser::ParseString(out));
+    EXPECT_EQ("-9223372036854775808", (*rendered)["id"].Number().Value());
+    EXPECT_EQ(0.1, (*rendered)["score"].DoubleValue());
+    EXPECT_TRUE((*rendered)["active"].BoolValue());
+    EXPECT_TRUE((*rendered)["extra"].Equals(*extra));
+    EXPECT_EQ("a \"b\"\n\\", (*rendered)["tags"][1].StringValue());
+    rendered->Object().Remove("id");
+    rendered->Object().Remove("score");
+    rendered->Object().Remove("active");
+    rendered->Object().Remove("extra");
+    (*expected)["tags"].Array().Remove(1);
+    (*expected)["tags"].Array().AddString("a \"b\"\n\\");
+    EXPECT_TRUE(rendered->Equals(*expected)) << out;
+
+    // appends, values are kept until replaced
+    values.SetNull(tmpl.FindPlaceholder("extra"));
+    values.SetInt(tmpl.FindPlaceholder("score"), 3);
+    std::string appended = "x";
+    tmpl.Render(values, appended);
+    EXPECT_EQ(0u, appended.find("x{\"active\":true,"));
+    EXPECT_NE(std::string::npos, appended.find("\"id\":-9223372036854775808,"));
+    EXPECT_NE(std::string::npos, appended.find("\"score\":3,"));
+    EXPECT_NE(std::string::npos, appended.find("\"extra\":null"));
+    EXPECT_NE(std::string::npos, appended.find("\"note\":\"{{x\""));
+
+    std::string streamed;
+    minijson::CStringOutputStream stream(streamed);
+    tmpl.Render(values, stream);
+    EXPECT_EQ(appended.substr(1), streamed);
+}
+
+TEST(MiniJSONTemplateTest, PrettyPrint)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"a\": [\"{{v:int}}\", {\"b\": \"{{s}}\"}], \"c\": \"{{s}}\"}"));
+    minijson::CTemplate tmpl(*doc);
+    minijson::CTemplateValues values(tmpl);
+    values.SetInt(0, 1);
+    values.SetString(1, "x");
+    std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString("{\"a\": [1, {\"b\": \"x\"}], \"c\": \"x\"}"));
+    EXPECT_EQ(expected->ToString(), tmpl.Render(values));
+
+    // the toplevel value can be a placeholder as well
+    minijson::CString str;
+    str.SetString("{{all:json}}");
+    minijson::CTemplate whole(str);
+    minijson::CTemplateValues wholeValues(whole);
+    wholeValues.SetEntity(0, *expected);
+    EXPECT_EQ(expected->ToString(false), whole.Render(wholeValues));
+}
+
+TEST(MiniJSONTemplateTest, Errors)
+{
+    std::unique_ptr<minijson::CEntity> unknown(minijson::CParser::ParseString("[\"{{a:date}}\"]"));
+    EXPECT_THROW(minijson::CTemplate tmpl(*unknown), minijson::CException);
+    std::unique_ptr<minijson::CEntity> twoTypes(minijson::CParser::ParseString("[\"{{a:int}}\", \"{{a}}\"]"));
+    EXPECT_THROW(minijson::CTemplate tmpl(*twoTypes), minijson::CException);
+
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("[\"{{i:int}}\", \"{{d:double}}\", \"{{s}}\"]"));
+    minijson::CTemplate tmpl(*doc, false);
+    minijson::CTemplateValues values(tmpl);
+    EXPECT_THROW(values.SetString(0, "1"), minijson::CException);
+    EXPECT_THROW(values.SetDouble(0, 1.5), minijson::CException);
+    EXPECT_THROW(values.SetInt(3, 1), minijson::CException);
+    EXPECT_THROW(values.SetNull(-1), minijson::CException);
+    EXPECT_THROW(values.SetDouble(1, 1.0 / 0.0), minijson::CException);
+    EXPECT_FALSE(values.HasValue(1));
+    values.SetInt(0, 1);
+    values.SetDouble(1, -2.5);
+    EXPECT_THROW(tmpl.Render(values), minijson::CException);
+    values.SetNull(2);
+    EXPECT_EQ("[1,-2.5,null]", tmpl.Render(values));
+
+    minijson::CTemplate other(*doc, false);
+    EXPECT_THROW(other.Render(values), minijson::CException);
+    values.Clear();
+    EXPECT_FALSE(values.HasValue(0));
+    EXPECT_THROW(tmpl.Render(values), minijson::CException);
+}
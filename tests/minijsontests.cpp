@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include <minijson.h>
+#include <algorithm>
 #include <memory>
+#include <stdio.h>
+#include <string.h>
 
 // NOTE: in recent version, a json text may consist entirely of a value only.
 //       see RFC 7158
@@ -277,3 +280,1194 @@ INSTANTIATE_TEST_CASE_P(
 
 
 // TODO: arrays
+
+TEST(MiniJSONWriterTest, StreamWriterMatchesToString)
+{
+    const char* txt = "{\"a\": [1, {\"b\": \"x\\ty\"}, [], {}], \"c\": {\"d\": true, \"e\": null}, \"f\": \"\\u0001/\"}";
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(txt));
+    for (int pretty = 0; pretty < 2; pretty++)
+    {
+        std::string out;
+        minijson::CStringOutputStream stream(out);
+        minijson::CWriter writer(pretty != 0);
+        writer.Write(stream, *e);
+        EXPECT_EQ(e->ToString(pretty != 0), out);
+    }
+    EXPECT_EQ(std::string("{\"a\":[1,{\"b\":\"x\\ty\"},[],{}],\"c\":{\"d\":true,\"e\":null},\"f\":\"\\u0001\\/\"}"), e->ToString(false));
+}
+
+TEST(MiniJSONWriterTest, DomBuilderFromEvents)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString("{\"a\": [1, 2.5, \"s\", false, null], \"b\": {}}"));
+    minijson::CDomBuilder builder;
+    e->Accept(builder);
+    ASSERT_TRUE(builder.IsComplete());
+    std::unique_ptr<minijson::CEntity> copy(builder.Release());
+    EXPECT_EQ(e->ToString(), copy->ToString());
+    EXPECT_EQ(2, copy->Object().Count());
+    EXPECT_EQ(std::string("b"), copy->Object().MemberNameByIndex(1));
+}
+
+TEST(MiniJSONHashTest, Equals)
+{
+    std::unique_ptr<minijson::CEntity> a(minijson::CParser::ParseString("{\"x\": [1, 2.50, \"s\", true, null], \"y\": {\"z\": -0}}"));
+    std::unique_ptr<minijson::CEntity> b(minijson::CParser::ParseString("{\"y\": {\"z\": 0.0}, \"x\": [1.0, 2.500, \"s\", true, null]}"));
+    EXPECT_TRUE(a->Equals(*b));
+    EXPECT_EQ(a->Hash(), b->Hash());
+    EXPECT_NE((*a)["x"].Hash(), (*a)["y"].Hash());
+    (*b)["x"][1].Number().SetString("25e-1");
+    EXPECT_TRUE(a->Equals(*b));
+    EXPECT_EQ(a->Hash(), b->Hash());
+
+    const char* different[] = {
+        "{\"x\": [1, 2.5, \"s\", true, null], \"y\": {\"z\": 1}}",
+        "{\"x\": [1, 2.5, \"s\", true], \"y\": {\"z\": 0}}",
+        "{\"x\": [2.5, 1, \"s\", true, null], \"y\": {\"z\": 0}}",
+        "{\"x\": [1, 2.5, \"S\", true, null], \"y\": {\"z\": 0}}",
+        "{\"x\": [1, 2.5, \"s\", false, null], \"y\": {\"z\": 0}}",
+        "{\"x\": [1, 2.5, \"s\", true, null], \"y\": {\"z\": \"0\"}}",
+        "{\"x\": [1, 2.5, \"s\", true, null], \"y\": {\"w\": 0}}",
+        "{\"x\": [1, 2.5, \"s\", true, null], \"y\": [0]}"
+    };
+    for (size_t i = 0; i < sizeof(different) / sizeof(different[0]); i++)
+    {
+        std::unique_ptr<minijson::CEntity> c(minijson::CParser::ParseString(different[i]));
+        EXPECT_FALSE(a->Equals(*c)) << different[i];
+        EXPECT_NE(a->Hash(), c->Hash()) << different[i];
+    }
+}
+
+TEST(MiniJSONHashTest, InvalidatedOnModification)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"a\": {\"b\": [1, {\"c\": \"d\"}]}, \"e\": [true]}"));
+    std::unique_ptr<minijson::CEntity> copy(doc->Copy());
+    uint64_t hash = doc->Hash();
+    uint64_t hashE = (*doc)["e"].Hash();
+    EXPECT_EQ(doc.get(), (*doc)["a"]["b"][1].Parent()->Parent()->Parent());
+    EXPECT_EQ(copy.get(), (*copy)["a"]["b"].Parent()->Parent());
+
+    // changes of a leaf reach the root through the parents
+    (*doc)["a"]["b"][1]["c"].String().SetString("x");
+    EXPECT_NE(hash, doc->Hash());
+    EXPECT_FALSE(doc->Equals(*copy));
+    EXPECT_EQ(hashE, (*doc)["e"].Hash());
+    (*doc)["a"]["b"][1]["c"].String().SetString("d");
+    EXPECT_EQ(hash, doc->Hash());
+    EXPECT_TRUE(doc->Equals(*copy));
+
+    (*doc)["e"].Array().AddNull();
+    EXPECT_NE(hash, doc->Hash());
+    (*doc)["e"].Array().Remove(1);
+    EXPECT_EQ(hash, doc->Hash());
+    doc->Object().SetInt("f", 1);
+    EXPECT_NE(hash, doc->Hash());
+    doc->Object().Remove("f");
+    EXPECT_EQ(hash, doc->Hash());
+
+    // relinked entities
+    minijson::CEntity* b = (*doc)["a"].Object().Detach("b");
+    EXPECT_EQ((minijson::CEntity*)NULL, b->Parent());
+    EXPECT_NE(hash, doc->Hash());
+    (*doc)["e"].Array().Insert(0, b);
+    EXPECT_EQ(&(*doc)["e"], b->Parent());
+    (*b)[0].Number().SetInt(2);
+    EXPECT_NE((*copy)["a"]["b"].Hash(), b->Hash());
+    (*b)[0].Number().SetInt(1);
+    (*doc)["a"].Object().Insert("b", (*doc)["e"].Array().Detach(0));
+    EXPECT_EQ(hash, doc->Hash());
+    EXPECT_TRUE(doc->Equals(*copy));
+}
+
+static const char* s_DuplicatesJSON =
+    "{\"people\": ["
+    "{\"name\": \"a\", \"address\": {\"city\": \"x\", \"zip\": [1, 2]}, \"tags\": [\"t\"]},"
+    "{\"name\": \"b\", \"address\": {\"city\": \"x\", \"zip\": [1, 2]}, \"tags\": [\"t\"]},"
+    "{\"name\": \"c\", \"address\": {\"city\": \"x\", \"zip\": [1, 2]}, \"tags\": [\"u\"]}],"
+    " \"defaults\": {\"city\": \"x\", \"zip\": [1, 2]},"
+    " \"other\": {\"zip\": [1, 2], \"city\": \"x\"},"
+    " \"numbers\": [[1], [1.0]]}";
+
+TEST(MiniJSONDeduplicateTest, Deduplicate)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_DuplicatesJSON));
+    std::string text = doc->ToString();
+    uint64_t hash = doc->Hash();
+    EXPECT_GT(doc->Deduplicate(), 0u);
+    EXPECT_EQ(text, doc->ToString());
+    EXPECT_EQ(hash, doc->Hash());
+
+    const minijson::CEntity& cdoc = *doc;
+    const minijson::CEntity* address = &cdoc["people"][0]["address"];
+    EXPECT_TRUE(address->IsShared());
+    EXPECT_EQ((minijson::CEntity*)NULL, address->Parent());
+    EXPECT_EQ(address, &cdoc["people"][1]["address"]);
+    EXPECT_EQ(address, &cdoc["people"][2]["address"]);
+    EXPECT_EQ(address, &cdoc["defaults"]);
+    EXPECT_EQ(&cdoc["people"][0]["tags"], &cdoc["people"][1]["tags"]);
+    // identical means same member order and number text
+    EXPECT_NE(address, &cdoc["other"]);
+    EXPECT_EQ(&(*address)["zip"], &cdoc["other"]["zip"]);
+    EXPECT_NE(&cdoc["numbers"][0], &cdoc["numbers"][1]);
+    // all objects/arrays below doc are interned
+    EXPECT_FALSE(doc->IsShared());
+    EXPECT_TRUE(cdoc["people"].IsShared());
+
+    // a second pass finds nothing new
+    EXPECT_EQ(0u, doc->Deduplicate());
+    EXPECT_EQ(text, doc->ToString());
+}
+
+TEST(MiniJSONDeduplicateTest, CopyOnWrite)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(s_DuplicatesJSON));
+    std::unique_ptr<minijson::CEntity> copy(doc->Copy());
+    doc->Deduplicate();
+    const minijson::CEntity& cdoc = *doc;
+    const minijson::CEntity* address = &cdoc["defaults"];
+
+    // shared entities are immutable
+    minijson::CObject* shared = doc->Object().GetObject("defaults");
+    EXPECT_THROW(shared->AddInt("n", 1), minijson::CException);
+    EXPECT_THROW(shared->GetArray("zip")->AddInt(3), minijson::CException);
+    EXPECT_THROW(shared->GetArray("zip")->GetNumber(0)->SetInt(3), minijson::CException);
+    EXPECT_TRUE(doc->Equals(*copy));
+
+    // modifications through the parents copy the shared path
+    (*doc)["people"][1]["address"]["zip"][0].Number().SetInt(3);
+    EXPECT_EQ("3", cdoc["people"][1]["address"]["zip"][0].Number().Value());
+    EXPECT_FALSE(cdoc["people"][1]["address"].IsShared());
+    EXPECT_EQ(&cdoc["people"][1], cdoc["people"][1]["address"].Parent());
+    EXPECT_EQ(&(*address)["city"], &cdoc["people"][1]["address"]["city"]);
+    EXPECT_EQ(address, &cdoc["people"][0]["address"]);
+    EXPECT_EQ("1", (*address)["zip"][0].Number().Value());
+    EXPECT_FALSE(doc->Equals(*copy));
+    (*doc)["people"][1]["address"]["zip"][0].Number().SetInt(1);
+    EXPECT_TRUE(doc->Equals(*copy));
+
+    doc->Object().SetString("defaults", "none");
+    (*doc)["other"].Object().Remove("zip");
+    (*doc)["people"][0].Object().SetBoolean("tags", true);
+    minijson::CEntity* detached = (*doc)["people"][2].Object().Detach("address");
+    EXPECT_FALSE(detached->IsShared());
+    detached->Object().AddNull("n");
+    delete detached;
+    EXPECT_EQ(address, &cdoc["people"][0]["address"]);
+    EXPECT_EQ("{\"city\":\"x\",\"zip\":[1,2]}", cdoc["people"][1]["address"].ToString(false));
+    (*doc)["people"].Array().Remove(1);
+    // the last reference
+    (*doc)["people"][0]["address"].Object().AddInt("n", 1);
+    EXPECT_EQ(address, &cdoc["people"][0]["address"]);
+    EXPECT_FALSE(address->IsShared());
+    EXPECT_EQ("{\"city\":\"x\",\"n\":1,\"zip\":[1,2]}", address->ToString(false));
+}
+
+TEST(MiniJSONDeduplicateTest, Parser)
+{
+    minijson::CParser parser;
+    minijson::CParseStats stats;
+    parser.SetStats(&stats);
+    parser.SetDeduplicate(true);
+    std::unique_ptr<minijson::CEntity> doc(parser.Parse(s_DuplicatesJSON));
+    std::unique_ptr<minijson::CEntity> plain(minijson::CParser::ParseString(s_DuplicatesJSON));
+    EXPECT_EQ(plain->ToString(), doc->ToString());
+    EXPECT_TRUE(plain->Equals(*doc));
+    // 3 addresses and their zip arrays, the tags and the zip array of "other"
+    EXPECT_EQ(8u, stats.m_SharedSubtrees);
+    EXPECT_GT(stats.m_DeduplicatedBytes, 0u);
+    const minijson::CEntity& cdoc = *doc;
+    EXPECT_EQ(&cdoc["defaults"], &cdoc["people"][0]["address"]);
+    EXPECT_FALSE(doc->IsShared());
+
+    // duplicate keys and failed parses release the shared entities
+    std::unique_ptr<minijson::CEntity> dup(parser.Parse("[{\"a\": [1], \"a\": [1]}, [1], {\"a\": [2]}]"));
+    EXPECT_EQ("[{\"a\":[1]},[1],{\"a\":[2]}]", dup->ToString(false));
+    minijson::CParseResult result;
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse("[[1], [1], [1]", result));
+    EXPECT_EQ(minijson::PARSE_ERROR_EXPECTED_ARRAY_END, result.Error());
+}
+
+TEST(MiniJSONPackedArrayTest, Parser)
+{
+    minijson::CParser parser;
+    minijson::CParseStats stats;
+    parser.SetStats(&stats);
+    parser.SetPackNumbers(true);
+    const char* json = "{\"ints\": [1, -2, 9223372036854775807], \"doubles\": [ 1.50, 2, -0.001 , 0.1],"
+                       " \"mixed\": [1, \"a\"], \"empty\": [], \"big\": [123456789012345678901234567890], \"odd\": [1.2.3],"
+                       " \"shortest\": [0.30000000000000004, 1], \"long\": [0.1000000000000000055511151231257827]}";
+    std::unique_ptr<minijson::CEntity> doc(parser.Parse(json));
+    std::unique_ptr<minijson::CEntity> plain(minijson::CParser::ParseString(json));
+    EXPECT_EQ(3u, stats.m_PackedArrays);
+    EXPECT_EQ(13u, stats.m_Numbers);
+    const minijson::CObject& obj = doc->Object();
+    const minijson::CArray& ints = *obj.GetArray("ints");
+    ASSERT_EQ(minijson::PACKED_INT64, ints.PackedType());
+    EXPECT_EQ(3, ints.Count());
+    EXPECT_EQ(9223372036854775807LL, ints.PackedInt64s()[2]);
+    EXPECT_EQ(NULL, ints.PackedDoubles());
+    const minijson::CArray& doubles = *obj.GetArray("doubles");
+    ASSERT_EQ(minijson::PACKED_DOUBLE, doubles.PackedType());
+    EXPECT_EQ(2.0, doubles.PackedDoubles()[1]);
+    EXPECT_EQ(-0.001, doubles.GetDouble(2));
+    EXPECT_EQ(-2, ints.GetInt(1));
+    EXPECT_EQ(1, doubles.GetInt(0));
+    EXPECT_EQ(0.1f, doubles.GetFloat(3));
+    EXPECT_EQ(7.0, doubles.GetDouble(4, 7.0));
+    EXPECT_FALSE(obj.GetArray("mixed")->IsPacked());
+    EXPECT_FALSE(obj.GetArray("empty")->IsPacked());
+    EXPECT_FALSE(obj.GetArray("big")->IsPacked());
+    EXPECT_FALSE(obj.GetArray("odd")->IsPacked());
+    // the same decimal value when written, as opposed to the 0.1 of the long one
+    EXPECT_TRUE(obj.GetArray("shortest")->IsPacked());
+    EXPECT_FALSE(obj.GetArray("long")->IsPacked());
+
+    // packed doubles are written in the shortest form, equal to the parsed values
+    EXPECT_EQ("[1,-2,9223372036854775807]", ints.ToString(false));
+    EXPECT_EQ("[1.5,2,-0.001,0.1]", doubles.ToString(false));
+    EXPECT_EQ(plain->Hash(), doc->Hash());
+    EXPECT_TRUE(plain->Equals(*doc));
+    EXPECT_TRUE(doc->Equals(*plain));
+    std::unique_ptr<minijson::CEntity> copy(doc->Copy());
+    EXPECT_TRUE(copy->Object().GetArray("doubles")->IsPacked());
+    EXPECT_TRUE(copy->Equals(*doc));
+    std::unique_ptr<minijson::CEntity> reparsed(parser.Parse(doc->ToString(false)));
+    EXPECT_TRUE(reparsed->Equals(*doc));
+
+    // element access unpacks
+    minijson::CArray& arr = (*doc)["doubles"].Array();
+    EXPECT_EQ("1.5", arr[0].Number().Value());
+    EXPECT_FALSE(arr.IsPacked());
+    EXPECT_EQ(4, arr.Count());
+    EXPECT_EQ(&arr, arr.EntityAtIndex(3).Parent());
+    EXPECT_EQ(plain->Hash(), doc->Hash());
+    arr.AddInt(5);
+    EXPECT_EQ("[1.5,2,-0.001,0.1,5]", arr.ToString(false));
+    EXPECT_TRUE(arr.Pack());
+    EXPECT_EQ(minijson::PACKED_DOUBLE, arr.PackedType());
+    EXPECT_FALSE(obj.GetArray("mixed")->Pack());
+
+    // integers that are no exact doubles keep an array with fractions unpacked
+    const char* large = "[[9223372036854775807, 2.5], [-9223372036854775808, 2.5], [2.5, 9007199254740993], [9007199254740992, 2.5]]";
+    std::unique_ptr<minijson::CEntity> packed(parser.Parse(large));
+    std::unique_ptr<minijson::CEntity> unpacked(minijson::CParser::ParseString(large));
+    EXPECT_FALSE(packed->Array().GetArray(0)->IsPacked());
+    EXPECT_FALSE(packed->Array().GetArray(1)->IsPacked());
+    EXPECT_FALSE(packed->Array().GetArray(2)->IsPacked());
+    EXPECT_TRUE(packed->Array().GetArray(3)->IsPacked());
+    EXPECT_EQ(unpacked->ToString(false), packed->ToString(false));
+    EXPECT_TRUE(packed->Equals(*unpacked));
+    EXPECT_EQ(unpacked->Hash(), packed->Hash());
+    for (int i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(i == 3, (*unpacked)[i].Array().Pack()) << i;
+    }
+    EXPECT_EQ(packed->ToString(false), unpacked->ToString(false));
+}
+
+TEST(MiniJSONPackedArrayTest, Bulk)
+{
+    minijson::CArray arr;
+    const int64_t ints[] = { 3, -4, 1LL << 60 };
+    arr.AssignInt64s(ints, 3);
+    EXPECT_EQ("[3,-4,1152921504606846976]", arr.ToString(false));
+    double doubles[3];
+    EXPECT_TRUE(arr.CopyTo(doubles));
+    EXPECT_EQ(-4.0, doubles[1]);
+    EXPECT_EQ(1152921504606846976.0, doubles[2]);
+
+    const double values[] = { 0.1, -0.0, 1e-7, 1.5e300, 123456.789, 1.0 / 3 };
+    arr.AssignDoubles(values, 6);
+    std::string text = arr.ToString(false);
+    EXPECT_EQ(0u, text.find("[0.1,-0,0.0000001,15"));
+    EXPECT_EQ(std::string::npos, text.find('e'));
+    std::unique_ptr<minijson::CEntity> parsed(minijson::CParser::ParseString(text));
+    double copied[6];
+    EXPECT_TRUE(parsed->Array().CopyTo(copied));
+    for (int i = 0; i < 6; i++)
+    {
+        EXPECT_EQ(values[i], copied[i]) << i;
+    }
+    EXPECT_TRUE(parsed->Equals(arr));
+    int64_t i64[6];
+    EXPECT_FALSE(arr.CopyTo(i64));
+    const double nan[] = { 1.0, 0.0 / 0.0 };
+    EXPECT_THROW(arr.AssignDoubles(nan, 2), minijson::CException);
+    EXPECT_EQ(6, arr.Count());
+
+    // unpacked arrays
+    minijson::CArray plain;
+    plain.AddInt(2);
+    plain.AddDouble(3.0);
+    plain.AddInt(-7);
+    EXPECT_TRUE(plain.CopyTo(i64));
+    EXPECT_EQ(3, i64[1]);
+    EXPECT_EQ(-7, i64[2]);
+    plain.AddString("x");
+    EXPECT_FALSE(plain.CopyTo(doubles));
+    plain.AssignInt64s(NULL, 0);
+    EXPECT_EQ(0, plain.Count());
+    EXPECT_FALSE(plain.IsPacked());
+
+    // written in chunks of many numbers (CHandler::Numbers()), handlers without an own
+    // implementation get the single numbers
+    std::vector<double> many;
+    for (int i = 0; i < 2000; i++)
+    {
+        many.push_back(i % 3 == 0 ? i : -i / 7.0);
+    }
+    minijson::CObject obj;
+    obj.AddArray("a")->AssignDoubles(&many[0], (int)many.size());
+    obj.AddArray("b")->AddInt(1);
+    std::string written;
+    minijson::CStringOutputStream stream(written);
+    minijson::CWriter(false).Write(stream, obj);
+    std::unique_ptr<minijson::CEntity> unpacked(obj.Copy());
+    (*unpacked)["a"][0];
+    EXPECT_FALSE(unpacked->Object().GetArray("a")->IsPacked());
+    EXPECT_EQ(unpacked->ToString(false), written);
+    EXPECT_EQ(unpacked->ToString(false), obj.ToString(false));
+    minijson::CDomBuilder builder;
+    obj.Accept(builder);
+    std::unique_ptr<minijson::CEntity> built(builder.Release());
+    EXPECT_EQ(2000, (*built)["a"].Count());
+    EXPECT_TRUE(built->Equals(obj));
+}
+
+TEST(MiniJSONPackedArrayTest, Shared)
+{
+    minijson::CParser parser;
+    parser.SetPackNumbers(true);
+    parser.SetDeduplicate(true);
+    std::unique_ptr<minijson::CEntity> doc(parser.Parse("[[1.5, 2], [1.5, 2], [1.50, 2], [1, 2]]"));
+    const minijson::CEntity& cdoc = *doc;
+    EXPECT_EQ(&cdoc[0], &cdoc[1]);
+    EXPECT_EQ(&cdoc[0], &cdoc[2]); // the same values, written the same way
+    EXPECT_NE(&cdoc[0], &cdoc[3]);
+    EXPECT_TRUE(cdoc[0].IsShared());
+
+    // unpacking a shared array keeps the elements immutable
+    const minijson::CEntity& element = cdoc[0][1];
+    EXPECT_TRUE(element.IsShared());
+    EXPECT_THROW(const_cast<minijson::CEntity&>(element).Number().SetInt(3), minijson::CException);
+    (*doc)[1][1].Number().SetInt(3);
+    EXPECT_EQ("[[1.5,2],[1.5,3],[1.5,2],[1,2]]", doc->ToString(false));
+}
+
+static bool IsString(const minijson::CEntity& e)
+{
+    return e.IsString();
+}
+
+TEST(MiniJSONIteratorTest, Object)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"b\": 1, \"a\": \"x\", \"c\": [true]}"));
+    minijson::CObject& obj = doc->Object();
+    const minijson::CObject& cobj = obj;
+
+    // in the order of the names, without the member order
+    std::string names;
+    for (minijson::CObject::const_iterator it = cobj.begin(); it != cobj.end(); ++it)
+    {
+        names += it->first;
+        EXPECT_EQ(cobj.GetEntity(it->first), it->second);
+    }
+    EXPECT_EQ("abc", names);
+    EXPECT_EQ("b", obj.MemberNameByIndex(0));
+    EXPECT_EQ(3, std::distance(cobj.begin(), cobj.end()));
+
+    for (const minijson::CObject::TMember& member : obj)
+    {
+        if (member.second->IsNumber())
+        {
+            member.second->Number().SetInt(2);
+        }
+    }
+    EXPECT_EQ(2, obj.GetInt("b"));
+    minijson::CObject::iterator it = std::find_if(obj.begin(), obj.end(), [](const minijson::CObject::TMember& m) { return m.second->IsArray(); });
+    ASSERT_TRUE(it != obj.end());
+    EXPECT_EQ("c", it->first);
+    minijson::CObject::const_iterator cit = it;
+    minijson::CObject::const_iterator third = cobj.begin();
+    std::advance(third, 2);
+    EXPECT_TRUE(cit == third);
+
+    minijson::CObject empty;
+    EXPECT_TRUE(empty.begin() == empty.end());
+}
+
+TEST(MiniJSONIteratorTest, Array)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("[1, \"a\", null, \"b\", {}]"));
+    minijson::CArray& arr = doc->Array();
+    const minijson::CArray& carr = arr;
+    EXPECT_EQ(2, std::count_if(carr.begin(), carr.end(), IsString));
+    int i = 0;
+    for (const minijson::CEntity& e : carr)
+    {
+        EXPECT_EQ(&carr.EntityAtIndex(i++), &e);
+    }
+    EXPECT_EQ(5, i);
+    for (minijson::CEntity& e : arr)
+    {
+        if (e.IsString())
+        {
+            e.String().SetString("s");
+        }
+    }
+    EXPECT_EQ("[1,\"s\",null,\"s\",{}]", doc->ToString(false));
+    EXPECT_TRUE(std::find_if(arr.begin(), arr.end(), IsString)->IsString());
+
+    // const iterators read packed arrays without unpacking them, non-const ones unpack
+    minijson::CParser parser;
+    parser.SetPackNumbers(true);
+    std::unique_ptr<minijson::CEntity> packed(parser.Parse("[3, 1.50, 2, -0.25]"));
+    const minijson::CArray& cpacked = packed->Array();
+    ASSERT_TRUE(cpacked.IsPacked());
+    std::string texts;
+    double sum = 0.0;
+    for (minijson::CArray::const_iterator it = cpacked.begin(); it != cpacked.end(); it++)
+    {
+        texts += it->Number().Value() + " ";
+        sum += it->Number().ValueDouble();
+        EXPECT_EQ(&*it, &*it);
+    }
+    EXPECT_EQ("3 1.5 2 -0.25 ", texts);
+    EXPECT_EQ(6.25, sum);
+    EXPECT_EQ(4, std::distance(cpacked.begin(), cpacked.end()));
+    minijson::CArray::const_iterator found = std::find_if(cpacked.begin(), cpacked.end(), [](const minijson::CEntity& e) { return e.Number().ValueDouble() == 2.0; });
+    ASSERT_TRUE(found != cpacked.end());
+    EXPECT_EQ("2", found->Number().Value());
+    minijson::CNumber two;
+    two.SetString("2");
+    EXPECT_EQ(two.Hash(), found->Hash());
+    EXPECT_TRUE(found->Equals(two));
+    EXPECT_EQ((minijson::CEntity*)NULL, found->Parent());
+    minijson::CArray::const_iterator copy = found;
+    EXPECT_TRUE(copy == found);
+    EXPECT_EQ("-0.25", (++copy)->Number().Value());
+    EXPECT_TRUE(cpacked.IsPacked());
+    minijson::CArray empty;
+    EXPECT_TRUE(static_cast<const minijson::CArray&>(empty).begin() == static_cast<const minijson::CArray&>(empty).end());
+
+    int count = 0;
+    for (minijson::CEntity& e : packed->Array())
+    {
+        EXPECT_EQ(packed.get(), e.Parent());
+        count++;
+    }
+    EXPECT_EQ(4, count);
+    EXPECT_FALSE(cpacked.IsPacked());
+}
+
+TEST(MiniJSONIteratorTest, Shared)
+{
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString("{\"a\": [[1], [1]], \"b\": {\"x\": [1]}, \"c\": {\"x\": [1]}}"));
+    doc->Deduplicate();
+    const minijson::CEntity& cdoc = *doc;
+    EXPECT_EQ(&cdoc["b"], &cdoc["c"]);
+
+    // const iteration keeps the members shared
+    for (const minijson::CObject::TMember& member : cdoc.Object())
+    {
+        EXPECT_EQ(cdoc.Object().GetEntity(member.first), member.second);
+        EXPECT_TRUE(member.second->IsShared());
+    }
+    for (const minijson::CEntity& e : cdoc["a"].Array())
+    {
+        EXPECT_TRUE(e.IsShared());
+    }
+
+    // non-const iteration copies on write
+    minijson::CArray& a = (*doc)["a"].Array();
+    for (minijson::CEntity& e : a)
+    {
+        EXPECT_FALSE(e.IsShared());
+        e.Array().AddInt(2);
+    }
+    minijson::CObject::iterator it = doc->Object().begin();
+    ++it;
+    it->second->Object().AddInt("y", 2);
+    EXPECT_EQ("{\"a\":[[1,2],[1,2]],\"b\":{\"x\":[1],\"y\":2},\"c\":{\"x\":[1]}}", doc->ToString(false));
+    EXPECT_EQ(&cdoc["b"]["x"], &cdoc["c"]["x"]);
+}
+
+TEST(MiniJSONCompressionTest, UncompressedPassThrough)
+{
+    const char* txt = "{\"a\": 1}";
+    minijson::CMemoryInputStream memory(txt, strlen(txt));
+    minijson::CDecompressingInputStream stream(memory);
+    char buf[64];
+    size_t rd = stream.Read(buf, sizeof(buf));
+    EXPECT_EQ(minijson::COMPRESSION_NONE, stream.Compression());
+    EXPECT_EQ(std::string(txt), std::string(buf, rd));
+    EXPECT_EQ((size_t)0, stream.Read(buf, sizeof(buf)));
+}
+
+TEST(MiniJSONCompressionTest, FromFileName)
+{
+    EXPECT_EQ(minijson::COMPRESSION_GZIP, minijson::CCompressingOutputStream::FromFileName("data.json.gz"));
+    EXPECT_EQ(minijson::COMPRESSION_ZSTD, minijson::CCompressingOutputStream::FromFileName("data.json.zst"));
+    EXPECT_EQ(minijson::COMPRESSION_NONE, minijson::CCompressingOutputStream::FromFileName("data.json"));
+    EXPECT_EQ(minijson::COMPRESSION_NONE, minijson::CCompressingOutputStream::FromFileName("gz"));
+}
+
+#ifdef MINIJSON_WITH_ZLIB
+static std::string GzipCompress(const std::string& data)
+{
+    std::string out;
+    minijson::CStringOutputStream stream(out);
+    minijson::CCompressingOutputStream gz(stream, minijson::COMPRESSION_GZIP);
+    gz.Write(data.data(), data.size());
+    gz.Finish();
+    return out;
+}
+
+static std::string Decompress(const std::string& data)
+{
+    minijson::CMemoryInputStream memory(data.data(), data.size());
+    minijson::CDecompressingInputStream stream(memory);
+    std::string out;
+    char buf[1000]; // small buffer, requires several calls per input chunk
+    size_t rd;
+    while ((rd = stream.Read(buf, sizeof(buf))) > 0)
+    {
+        out.append(buf, rd);
+    }
+    EXPECT_EQ(minijson::COMPRESSION_GZIP, stream.Compression());
+    return out;
+}
+
+TEST(MiniJSONCompressionTest, GzipRoundTrip)
+{
+    minijson::CArray arr;
+    for (int i = 0; i < 20000; i++)
+    {
+        arr.AddObject()->AddInt("id", i);
+    }
+    std::string json = arr.ToString(false);
+    std::string compressed = GzipCompress(json);
+    ASSERT_GT(compressed.size(), (size_t)2);
+    EXPECT_EQ('\x1f', compressed[0]);
+    EXPECT_EQ('\x8b', compressed[1]);
+    EXPECT_LT(compressed.size(), json.size());
+    EXPECT_EQ(json, Decompress(compressed));
+
+    // concatenated gzip members are one stream
+    EXPECT_EQ(std::string("[1][2]"), Decompress(GzipCompress("[1]") + GzipCompress("[2]")));
+}
+
+TEST(MiniJSONCompressionTest, GzipTruncated)
+{
+    std::string compressed = GzipCompress("{\"a\": [1, 2, 3]}");
+    compressed.resize(compressed.size() - 4);
+    EXPECT_THROW(Decompress(compressed), minijson::CIOException);
+}
+
+TEST(MiniJSONCompressionTest, GzipFiles)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString("{\"a\": [1, \"two\", {\"three\": 3}]}"));
+    const char* path = "minijsoncompressiontest.json.gz";
+    minijson::CWriter writer;
+    writer.WriteToFile(path, *e);
+
+    FILE* f = fopen(path, "rb");
+    ASSERT_NE((FILE*)NULL, f);
+    unsigned char magic[2] = { 0, 0 };
+    EXPECT_EQ((size_t)2, fread(magic, 1, 2, f));
+    fclose(f);
+    EXPECT_EQ(0x1f, magic[0]);
+    EXPECT_EQ(0x8b, magic[1]);
+
+    std::unique_ptr<minijson::CEntity> copy(minijson::CParser::ParseFromFile(path));
+    EXPECT_EQ(e->ToString(), copy->ToString());
+
+    // explicitly uncompressed
+    writer.SetCompression(minijson::COMPRESSION_NONE);
+    writer.WriteToFile(path, *e);
+    copy.reset(minijson::CParser::ParseFromFile(path));
+    EXPECT_EQ(e->ToString(), copy->ToString());
+
+    // compressed files are parsed while decompressing, without holding the text in memory
+    minijson::CArray big;
+    for (int i = 0; i < 20000; i++)
+    {
+        big.AddString("a long string value that compresses well");
+    }
+    writer.WriteToFile(path, big);
+    size_t textSize = big.ToString().size();
+    minijson::CCountingAllocator plainAllocator;
+    copy.reset(minijson::CParser::ParseFromFile(path, &plainAllocator));
+    EXPECT_TRUE(copy->Equals(big));
+    writer.SetCompression(minijson::COMPRESSION_GZIP);
+    writer.WriteToFile(path, big);
+    minijson::CCountingAllocator streamedAllocator;
+    copy.reset(minijson::CParser::ParseFromFile(path, &streamedAllocator));
+    EXPECT_TRUE(copy->Equals(big));
+    EXPECT_LT(streamedAllocator.PeakBytesInUse() + textSize / 2, plainAllocator.PeakBytesInUse());
+    copy.reset();
+
+    // errors are reported with the position in the decompressed text
+    FILE* invalid = fopen(path, "wb");
+    ASSERT_NE((FILE*)NULL, invalid);
+    std::string compressed = GzipCompress("{\"a\": [1, 2 x]}");
+    fwrite(compressed.data(), 1, compressed.size(), invalid);
+    fclose(invalid);
+    try
+    {
+        delete minijson::CParser::ParseFromFile(path);
+        ADD_FAILURE();
+    }
+    catch (const minijson::CParseErrorException& ex)
+    {
+        EXPECT_EQ(12, ex.Position());
+    }
+    remove(path);
+}
+#endif // MINIJSON_WITH_ZLIB
+
+TEST(MiniJSONParseStatsTest, Counts)
+{
+    const char* txt = "{\"a\": [1, 2.5, \"x\\ny\", true, null, []], \"b\": {\"c\": {\"d\": \"\"}}, \"e\": false}";
+    minijson::CParseStats stats;
+    minijson::CParser parser;
+    parser.SetStats(&stats);
+    minijson::CEntity* e = parser.Parse(txt);
+    parser.Delete(e);
+#ifndef MINIJSON_NO_PARSE_STATS
+    EXPECT_EQ(strlen(txt), stats.m_Bytes);
+    EXPECT_EQ((size_t)3, stats.m_Objects);
+    EXPECT_EQ((size_t)2, stats.m_Arrays);
+    EXPECT_EQ((size_t)2, stats.m_Strings);
+    EXPECT_EQ((size_t)5, stats.m_Keys);
+    EXPECT_EQ((size_t)2, stats.m_Numbers);
+    EXPECT_EQ((size_t)2, stats.m_Booleans);
+    EXPECT_EQ((size_t)1, stats.m_Nulls);
+    EXPECT_EQ(3, stats.m_MaxDepth);
+    EXPECT_EQ((size_t)8, stats.m_StringBytes); // "a", "x\ny", "b", "c", "d", "e"
+    EXPECT_EQ((size_t)1, stats.m_Escapes);
+    EXPECT_GE(stats.m_Allocations, (size_t)12);
+    EXPECT_GE(stats.m_ParseSeconds, 0.0);
+
+    // values accumulate
+    parser.Delete(parser.Parse("[1]"));
+    EXPECT_EQ((size_t)3, stats.m_Numbers);
+    EXPECT_EQ(3, stats.m_MaxDepth);
+    stats.Reset();
+    EXPECT_EQ((size_t)0, stats.m_Numbers);
+#endif // MINIJSON_NO_PARSE_STATS
+
+    // no statistics without a stats object
+    minijson::CParser plain;
+    EXPECT_EQ((minijson::CParseStats*)NULL, plain.Stats());
+    plain.Delete(plain.Parse("[1]"));
+}
+
+struct STryParseErrorParam
+{
+    const char* m_Txt;
+    minijson::EParseError m_Error;
+    int m_Position;
+};
+
+TEST(MiniJSONTryParseTest, ErrorCodes)
+{
+    const STryParseErrorParam params[] = {
+        { " \n ", minijson::PARSE_ERROR_EMPTY_INPUT, 3 },
+        { "\"a\"", minijson::PARSE_ERROR_SYNTAX, 0 },
+        { "[\"abc", minijson::PARSE_ERROR_UNTERMINATED_STRING, 2 },
+        { "[\"a\\u12", minijson::PARSE_ERROR_INVALID_ESCAPE, 3 },
+        { "[1, ,]", minijson::PARSE_ERROR_EXPECTED_VALUE, 4 },
+        { "{\"a\" 1}", minijson::PARSE_ERROR_EXPECTED_COLON, 5 },
+        { "[1 2]", minijson::PARSE_ERROR_EXPECTED_ARRAY_END, 3 },
+        { "{\"a\": 1 \"b\": 2}", minijson::PARSE_ERROR_EXPECTED_OBJECT_END, 8 },
+        { "{} []", minijson::PARSE_ERROR_EXTRA_BYTES, 3 },
+    };
+    minijson::CParser parser;
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++)
+    {
+        // (the const char* overload, i.e. result refers to the literal, not to a temporary)
+        minijson::CParseResult result;
+        EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(params[i].m_Txt, result)) << params[i].m_Txt;
+        EXPECT_FALSE(result.Ok()) << params[i].m_Txt;
+        EXPECT_EQ(params[i].m_Error, result.Error()) << params[i].m_Txt;
+        EXPECT_EQ(params[i].m_Position, result.Position()) << params[i].m_Txt;
+
+        // the throwing variant reports the same error
+        try
+        {
+            delete parser.Parse(params[i].m_Txt);
+            ADD_FAILURE() << params[i].m_Txt;
+        }
+        catch (const minijson::CParseErrorException& ex)
+        {
+            EXPECT_EQ(result.Message(), ex.Message());
+            EXPECT_EQ(result.Position(), ex.Position());
+            EXPECT_EQ(result.Line(), ex.Line());
+            EXPECT_EQ(result.Column(), ex.Column());
+            EXPECT_EQ(result.Surrounding(), ex.Surrounding());
+        }
+    }
+
+    minijson::CParseResult result;
+    minijson::CEntity* e = parser.TryParse("{\"a\": [1]}", result);
+    ASSERT_NE((minijson::CEntity*)NULL, e);
+    EXPECT_TRUE(result.Ok());
+    EXPECT_NO_THROW(result.Throw());
+    delete e;
+}
+
+TEST(MiniJSONTryParseTest, LazyLocation)
+{
+    std::string txt = "{\n  \"a\": 1,\n  \"b\" 2\n}";
+    minijson::CParseResult result;
+    minijson::CParser parser;
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(txt, result));
+    EXPECT_EQ(minijson::PARSE_ERROR_EXPECTED_COLON, result.Error());
+    EXPECT_EQ(3, result.Line());
+    EXPECT_EQ(7, result.Column());
+    EXPECT_EQ("Syntax error: Expected ':' at or after position 18", result.Message());
+    EXPECT_EQ("{\n  \"a\": 1,\n  \"b\" 2\n      ^\n}", result.Surrounding());
+    EXPECT_THROW(result.Throw(), minijson::CParseErrorException);
+
+    // the text does not need to be null-terminated
+    const char unterminated[] = { '[', '1', ' ', '2', 'x' };
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(unterminated, 4, result));
+    EXPECT_EQ(minijson::PARSE_ERROR_EXPECTED_ARRAY_END, result.Error());
+    EXPECT_EQ(1, result.Line());
+    EXPECT_EQ(4, result.Column());
+}
+
+TEST(MiniJSONTryParseTest, AllocationFailure)
+{
+    minijson::CCountingAllocator counting;
+    counting.SetLimit(256);
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    minijson::CParseResult result;
+    std::string txt = "[" + std::string(100, '[') + std::string(100, ']') + "]";
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(txt, result));
+    EXPECT_EQ(minijson::PARSE_ERROR_ALLOCATION_FAILED, result.Error());
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+
+    const char* invalid[] = { "[1, 2", "{\"a\": [1, {\"b\": x}]}", "{\"a\": 1} x", "[[[\"a\"]]", "{\"a\": [\"b\", \"c" };
+    counting.SetLimit(0);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(invalid[i], result)) << invalid[i];
+        EXPECT_EQ((size_t)0, counting.BytesInUse()) << invalid[i];
+    }
+}
+
+TEST(MiniJSONTryParseTest, MaxDepth)
+{
+    minijson::CCountingAllocator counting;
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    minijson::CParseResult result;
+    EXPECT_EQ(512, parser.MaxDepth());
+    std::string ok = std::string(511, '[') + "{\"a\": 1}" + std::string(511, ']');
+    std::string deep = std::string(511, '[') + "{\"a\": [1]}" + std::string(511, ']');
+    minijson::CEntity* e = parser.TryParse(ok, result);
+    ASSERT_NE((minijson::CEntity*)NULL, e);
+    delete e;
+    EXPECT_TRUE(parser.Validate(ok, result));
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(deep, result));
+    EXPECT_EQ(minijson::PARSE_ERROR_DEPTH_EXCEEDED, result.Error());
+    EXPECT_EQ(517, result.Position());
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+    EXPECT_FALSE(parser.Validate(deep, result));
+    EXPECT_EQ(minijson::PARSE_ERROR_DEPTH_EXCEEDED, result.Error());
+    EXPECT_EQ(517, result.Position());
+    EXPECT_THROW(delete parser.Parse(deep), minijson::CParseErrorException);
+
+    // packed arrays count as well
+    parser.SetMaxDepth(1);
+    parser.SetPackNumbers(true);
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse("{\"a\": [1, 2]}", result));
+    EXPECT_EQ(minijson::PARSE_ERROR_DEPTH_EXCEEDED, result.Error());
+    e = parser.TryParse("[1, 2]", result);
+    ASSERT_NE((minijson::CEntity*)NULL, e);
+    EXPECT_TRUE(e->Array().IsPacked());
+    delete e;
+
+    // the parser does not recurse, deeper input needs a larger limit only
+    parser.SetMaxDepth(20000);
+    std::string deeper = std::string(10000, '[') + "1, {\"b\": [true]}" + std::string(10000, ']');
+    e = parser.TryParse(deeper, result);
+    ASSERT_NE((minijson::CEntity*)NULL, e);
+    const minijson::CEntity* inner = e;
+    for (int i = 1; i < 10000; i++)
+    {
+        ASSERT_EQ(1, inner->Count());
+        inner = &(*inner)[0];
+    }
+    EXPECT_EQ("[1,{\"b\":[true]}]", inner->ToString(false));
+    delete e;
+    EXPECT_TRUE(parser.Validate(deeper, result));
+    deeper[deeper.size() / 2] = 'x';
+    EXPECT_EQ((minijson::CEntity*)NULL, parser.TryParse(deeper, result));
+    EXPECT_EQ(minijson::PARSE_ERROR_EXPECTED_VALUE, result.Error());
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+
+    // same limit for the stream parser
+    std::string out;
+    minijson::CStringOutputStream output(out);
+    minijson::CStreamWriter writer(output, false);
+    minijson::CMemoryInputStream input(deep.data(), deep.size());
+    minijson::CStreamParser streamParser;
+    EXPECT_EQ(512, streamParser.MaxDepth());
+    try
+    {
+        streamParser.Parse(input, writer);
+        ADD_FAILURE();
+    }
+    catch (const minijson::CParseErrorException& ex)
+    {
+        EXPECT_EQ(517, ex.Position());
+    }
+}
+
+TEST(MiniJSONValidateTest, MatchesParse)
+{
+    const char* texts[] = {
+        "{\"a\": [1, -2.5, \"s\\n\\u00e4\", true, false, null, {}, []], \"\": {\"b\": \"\"}}",
+        "[\"\\ud83d\\ude00\"]", " [ ] ", "[1, ,]", "{\"a\" 1}", "{a\": 1}", "[\"\\x\"]", "[\"\\ud83d\"]",
+        "[\"\\ude00\"]", "[\"\\u00g0\"]", "[\"\xc3\xa4\"]", "[\"\xc3\"]", "[\"\xed\xa0\x80\"]", "[1] x", "[\"abc",
+    };
+    minijson::CCountingAllocator counting;
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+    {
+        minijson::CParseResult parseResult;
+        minijson::CParseResult validateResult;
+        delete parser.TryParse(texts[i], (int)strlen(texts[i]), parseResult);
+        size_t allocations = counting.Allocations();
+        EXPECT_EQ(parseResult.Ok(), parser.Validate(texts[i], (int)strlen(texts[i]), validateResult)) << texts[i];
+        EXPECT_EQ(allocations, counting.Allocations()) << texts[i];
+        EXPECT_EQ(parseResult.Error(), validateResult.Error()) << texts[i];
+        EXPECT_EQ(parseResult.Position(), validateResult.Position()) << texts[i];
+    }
+}
+
+TEST(MiniJSONValidateTest, Errors)
+{
+    minijson::CParser parser;
+    minijson::CParseResult result;
+    EXPECT_FALSE(parser.Validate("[\"ok\", \"\xe0\x80\xaf\"]", result));
+    EXPECT_EQ(minijson::PARSE_ERROR_INVALID_UTF8, result.Error());
+    EXPECT_EQ(8, result.Position());
+    EXPECT_FALSE(parser.Validate("{a\": 1}", result));
+    EXPECT_EQ(minijson::PARSE_ERROR_EXPECTED_KEY, result.Error());
+    EXPECT_EQ(2, result.Column());
+    EXPECT_EQ(0u, result.Surrounding().find("{a\": 1}"));
+    EXPECT_FALSE(parser.Validate("[\"\\ud83d\\u0041\"]", result));
+    EXPECT_EQ(minijson::PARSE_ERROR_INVALID_ESCAPE, result.Error());
+    EXPECT_EQ(2, result.Position());
+
+    // legacy 8 bit input
+    parser.SetCheckUTF8(false);
+    EXPECT_TRUE(parser.Validate("[\"Gr\xfc\xdf" "e\"]", result));
+    std::unique_ptr<minijson::CEntity> e(parser.Parse("[\"Gr\xfc\xdf" "e\"]"));
+    EXPECT_EQ(std::string("Gr\xfc\xdf" "e"), (*e)[0].StringValue());
+}
+
+TEST(MiniJSONValidateTest, UTF8)
+{
+    const char* valid[] = { "", "ascii", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf" };
+    const char* invalid[] = { "\x80", "\xc0\x80", "\xc1\xbf", "\xc2", "\xe0\x9f\xbf", "\xed\xa0\x80", "\xe1\x80", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff", "\xc2\xc2\x80" };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++)
+    {
+        // at every offset of a longer text, to cover the block boundaries of the vectorized code
+        for (size_t offset = 0; offset < 40; offset++)
+        {
+            std::string txt = std::string(offset, 'x') + valid[i] + std::string(offset % 7, 'y');
+            EXPECT_TRUE(minijson::CParser::IsValidUTF8(txt.data(), txt.size())) << i << " " << offset;
+        }
+    }
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        for (size_t offset = 0; offset < 40; offset++)
+        {
+            std::string txt = std::string(offset, 'x') + invalid[i] + std::string(offset % 7, 'y');
+            size_t position = 0;
+            EXPECT_FALSE(minijson::CParser::IsValidUTF8(txt.data(), txt.size(), &position)) << i << " " << offset;
+            EXPECT_EQ(offset, position) << i;
+        }
+    }
+}
+
+TEST(MiniJSONValidateTest, SurrogatePairs)
+{
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString("[\"\\ud83d\\ude00\", \"\\u20AC\", \"\\u00e4\", \"\\u0041\"]"));
+    EXPECT_EQ(std::string("\xf0\x9f\x98\x80"), (*e)[0].StringValue());
+    EXPECT_EQ(std::string("\xe2\x82\xac"), (*e)[1].StringValue());
+    EXPECT_EQ(std::string("\xc3\xa4"), (*e)[2].StringValue());
+    EXPECT_EQ(std::string("A"), (*e)[3].StringValue());
+}
+
+// returns at most a few bytes per Read(), to cover tokens split between reads
+class CTrickleInputStream : public minijson::CInputStream
+{
+public:
+    CTrickleInputStream(const std::string& data, size_t maxRead) : m_Data(data), m_MaxRead(maxRead), m_Position(0) {}
+    virtual size_t Read(char* data, size_t length) MINIJSON_OVERRIDE
+    {
+        size_t rd = std::min(std::min(length, m_MaxRead), m_Data.size() - m_Position);
+        memcpy(data, m_Data.data() + m_Position, rd);
+        m_Position += rd;
+        return rd;
+    }
+
+private:
+    std::string m_Data;
+    size_t m_MaxRead;
+    size_t m_Position;
+};
+
+static std::string StreamReformat(const std::string& txt, bool prettyPrint, size_t bufferSize = 64, size_t maxRead = 3)
+{
+    std::string out;
+    minijson::CStringOutputStream output(out);
+    minijson::CStreamWriter writer(output, prettyPrint);
+    CTrickleInputStream input(txt, maxRead);
+    minijson::CStreamParser parser(bufferSize);
+    parser.Parse(input, writer);
+    EXPECT_EQ(txt.size(), parser.BytesRead());
+    return out;
+}
+
+TEST(MiniJSONStreamParserTest, MatchesParse)
+{
+    std::string longString(1000, 'x');
+    std::string escapes;
+    for (int i = 0; i < 200; i++)
+    {
+        escapes += "a\\n\\\"\\ud83d\\ude00\\u00e4";
+    }
+    const std::string texts[] = {
+        "{\"a\": [1, -2.5, \"s\\n\\u00e4\", true, false, null, {}, []], \"\": {\"b\": \"\"}}",
+        " [ ] ", "[1, 2, ]", "{\"a\": 1, }",
+        "[\"" + longString + "\", \"" + escapes + "\", 12345678901234567890123456789, {\"" + longString + "\": [[[]]]}]",
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+    {
+        std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString(texts[i]));
+        for (int pretty = 0; pretty < 2; pretty++)
+        {
+            const size_t bufferSizes[] = { 1, 100, 1 << 16 };
+            const size_t maxReads[] = { 1, 7, 1 << 16 };
+            for (size_t j = 0; j < 3; j++)
+            {
+                std::string out = StreamReformat(texts[i], pretty != 0, bufferSizes[j], maxReads[j]);
+                std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(out));
+                EXPECT_EQ(expected->ToString(), e->ToString()) << i;
+            }
+        }
+    }
+    // members are passed in input order
+    EXPECT_EQ("{\"b\":1,\"a\":[2,{\"d\":3,\"c\":4}],\"b\":5}", StreamReformat("{\"b\": 1, \"a\": [2, {\"d\": 3, \"c\": 4}], \"b\": 5}", false));
+    std::string sorted = "{\"a\": {\"b\": [1, {}], \"c\": \"d\"}, \"e\": []}";
+    std::unique_ptr<minijson::CEntity> e(minijson::CParser::ParseString(sorted));
+    EXPECT_EQ(e->ToString(true), StreamReformat(sorted, true));
+}
+
+TEST(MiniJSONStreamParserTest, Errors)
+{
+    const char* texts[] = {
+        " \n ", "\"a\"", "[\"abc", "[\"a\\u12", "[1, ,]", "{\"a\" 1}", "[1 2]", "{\"a\": 1 \"b\": 2}",
+        "{} []", "{a\": 1}", "[\"\\x\"]", "[\"\\ud83d\"]", "[\"\\ude00\"]", "[\"\xc3\xa4\", \"\xc3\"]", "[tru]", "[\"a\\",
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+    {
+        minijson::CParseResult result;
+        minijson::CParser parser;
+        delete parser.TryParse(texts[i], result);
+        ASSERT_FALSE(result.Ok()) << texts[i];
+        try
+        {
+            StreamReformat(texts[i], false);
+            ADD_FAILURE() << texts[i];
+        }
+        catch (const minijson::CParseErrorException& ex)
+        {
+            EXPECT_EQ(result.Position(), ex.Position()) << texts[i];
+            EXPECT_EQ(0u, ex.Message().find(minijson::CParseResult::ErrorString(result.Error()))) << texts[i] << ": " << ex.Message();
+            EXPECT_EQ(-1, ex.Line());
+        }
+    }
+
+    // legacy 8 bit input
+    std::string out;
+    minijson::CStringOutputStream output(out);
+    minijson::CStreamWriter writer(output, false);
+    minijson::CMemoryInputStream input("[\"Gr\xfc\xdf" "e\"]", 9);
+    minijson::CStreamParser parser;
+    parser.SetCheckUTF8(false);
+    parser.Parse(input, writer);
+    EXPECT_EQ(std::string("[\"Gr\xfc\xdf" "e\"]"), out);
+}
+
+TEST(MiniJSONStreamParserTest, DocumentSequence)
+{
+    std::string ndjson = "{\"a\": 1}\n[2, 3]\n\n  {\"b\": {}}\n";
+    std::string out;
+    minijson::CStringOutputStream output(out);
+    minijson::CStreamParser parser(64);
+    parser.SetDocumentSequence(true);
+    minijson::CStreamWriter first(output, false);
+    CTrickleInputStream input(ndjson, 5);
+    parser.Parse(input, first);
+    EXPECT_EQ("{\"a\":1}[2,3]{\"b\":{}}", out);
+
+    minijson::CMemoryInputStream empty(" \n", 2);
+    EXPECT_NO_THROW(parser.Parse(empty, first));
+    minijson::CMemoryInputStream scalar("{}\n1\n", 5);
+    EXPECT_THROW(parser.Parse(scalar, first), minijson::CParseErrorException);
+
+    // a single document is expected by default
+    parser.SetDocumentSequence(false);
+    CTrickleInputStream again(ndjson, 5);
+    EXPECT_THROW(parser.Parse(again, first), minijson::CParseErrorException);
+}
+
+TEST(MiniJSONAllocatorTest, CountingAllocator)
+{
+    const char* txt = "{\"a\": [1, 2, {\"b\": \"c\"}], \"d\": true, \"e\": null}";
+    minijson::CCountingAllocator counting;
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    minijson::CEntity* e = parser.Parse(txt);
+    EXPECT_GT(counting.BytesInUse(), (size_t)0);
+    EXPECT_GE(counting.Allocations(), (size_t)8); // one per entity at least
+
+    // copies use the default allocator unless specified (the parser allocates containers
+    // with their final size, like Copy())
+    size_t before = counting.BytesInUse();
+    std::unique_ptr<minijson::CEntity> copy(e->Copy());
+    EXPECT_EQ(before, counting.BytesInUse());
+    minijson::CEntity* copy2 = e->Copy(counting);
+    EXPECT_EQ(before * 2, counting.BytesInUse());
+    EXPECT_EQ(e->ToString(), copy2->ToString());
+    delete copy2;
+
+    // children added later use the allocator of their parent
+    before = counting.BytesInUse();
+    e->Object().GetArray("a")->AddObject()->AddString("x", "y");
+    e->Object().SetInt("f", 1);
+    EXPECT_GT(counting.BytesInUse(), before);
+
+    delete e;
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+    EXPECT_GT(counting.PeakBytesInUse(), (size_t)0);
+}
+
+TEST(MiniJSONAllocatorTest, Limit)
+{
+    minijson::CCountingAllocator counting;
+    counting.SetLimit(1024);
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    std::string txt = "[";
+    for (int i = 0; i < 100; i++)
+    {
+        txt += i == 0 ? "1" : ",1";
+    }
+    txt += "]";
+    EXPECT_THROW(delete parser.Parse(txt), minijson::CException);
+    counting.SetLimit(0);
+    delete parser.Parse(txt);
+}
+
+TEST(MiniJSONAllocatorTest, MergeAtLimit)
+{
+    minijson::CCountingAllocator counting;
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    std::unique_ptr<minijson::CEntity> e(parser.Parse("{\"a\": [1, 2], \"b\": true}"));
+    std::unique_ptr<minijson::CEntity> other(minijson::CParser::ParseString("{\"a\": {\"x\": 1}, \"c\": [3]}"));
+    std::string before = e->ToString();
+
+    // the copies fail, the object is left unmodified
+    counting.SetLimit(counting.BytesInUse());
+    EXPECT_THROW(e->Object().MergeFrom(other->Object(), true), minijson::CException);
+    EXPECT_EQ(before, e->ToString());
+    EXPECT_THROW(e->Object().MergeFrom(other->Object(), false), minijson::CException);
+    EXPECT_EQ(before, e->ToString());
+    EXPECT_EQ(2, e->Count());
+
+    counting.SetLimit(0);
+    e->Object().MergeFrom(other->Object(), true);
+    EXPECT_EQ("{\"a\":{\"x\":1},\"b\":true,\"c\":[3]}", e->ToString(false));
+    e.reset();
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+}
+
+TEST(MiniJSONAllocatorTest, ArenaAndPool)
+{
+    const char* txt = "{\"a\": [1, 2.5, \"s\", false, null, {\"b\": []}], \"c\": {}}";
+    std::unique_ptr<minijson::CEntity> expected(minijson::CParser::ParseString(txt));
+    {
+        minijson::CArenaAllocator arena(4096);
+        minijson::CParser parser;
+        parser.SetAllocator(&arena);
+        for (int i = 0; i < 100; i++)
+        {
+            minijson::CEntity* e = parser.Parse(txt);
+            EXPECT_EQ(expected->ToString(), e->ToString());
+            delete e;
+        }
+        EXPECT_GT(arena.BytesReserved(), (size_t)4096);
+
+        // rewinding keeps the blocks for the following allocations
+        size_t reserved = arena.BytesReserved();
+        for (int round = 0; round < 10; round++)
+        {
+            arena.Rewind();
+            for (int i = 0; i < 100; i++)
+            {
+                delete parser.Parse(txt);
+            }
+        }
+        EXPECT_EQ(reserved, arena.BytesReserved());
+        arena.Reset();
+        EXPECT_EQ((size_t)0, arena.BytesReserved());
+    }
+    {
+        minijson::CCountingAllocator counting;
+        minijson::CPoolAllocator pool(counting);
+        minijson::CObject* root = minijson::CObject::Create(pool);
+        for (int i = 0; i < 1000; i++)
+        {
+            root->AddInt("x", i);
+            root->Remove("x");
+        }
+        // freed entities are reused
+        EXPECT_EQ(pool.BytesReserved(), counting.BytesInUse());
+        EXPECT_LE(pool.BytesReserved(), (size_t)4 * 64 * 1024);
+        root->AddArray("y")->AddString("z");
+        EXPECT_EQ(std::string("{\"y\":[\"z\"]}"), root->ToString(false));
+        delete root;
+    }
+}
+
+TEST(MiniJSONAllocatorTest, NoLeaksOnParseErrors)
+{
+    const char* invalid[] = { "[1, 2", "{\"a\": [1, {\"b\": x}]}", "{\"a\": 1} x", "[[[\"a\"]]" };
+    minijson::CCountingAllocator counting;
+    minijson::CParser parser;
+    parser.SetAllocator(&counting);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        EXPECT_THROW(delete parser.Parse(invalid[i]), minijson::CParseErrorException) << invalid[i];
+        EXPECT_EQ((size_t)0, counting.BytesInUse()) << invalid[i];
+    }
+
+    // duplicate keys: last one wins
+    minijson::CEntity* e = parser.Parse("{\"a\": [1], \"b\": 2, \"a\": 3}");
+    EXPECT_EQ(2, e->Count());
+    EXPECT_EQ(3, (*e)["a"].IntValue());
+    EXPECT_EQ(std::string("b"), e->ObjectMemberNameByIndex(1));
+    delete e;
+    EXPECT_EQ((size_t)0, counting.BytesInUse());
+}
@@ -3,166 +3,219 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <memory>
+#include <string>
 
-static bool Beautify(const char* inputFileName, const char* outputFileName);
-static bool Beautify(const std::vector<char>& data, const char* inputFileName, const char* outputFileName);
+// reformats json text token by token (see CStreamParser), i.e. in bounded memory and keeping the
+// order of the object members. gzip/zstd compressed input is decompressed transparently, output
+// files named *.gz/*.zst are compressed.
 
-static bool Beautify(const char* inputFileName, const char* outputFileName)
+struct SOptions
 {
-    FILE* output = nullptr;
-    if (outputFileName)
+    bool m_Minify;
+    std::string m_Indentation;
+};
+
+static bool Beautify(FILE* input, const char* inputFileName, FILE* output, const char* outputFileName, const SOptions& options)
+{
+    try
     {
-        output = fopen(outputFileName, "r");
-        if (output)
+        minijson::CFileInputStream fileInput(input);
+        minijson::CDecompressingInputStream decompressed(fileInput);
+        minijson::CFileOutputStream fileOutput(output);
+        std::unique_ptr<minijson::CCompressingOutputStream> compressed;
+        minijson::COutputStream* stream = &fileOutput;
+        minijson::ECompression compression = outputFileName ? minijson::CCompressingOutputStream::FromFileName(outputFileName) : minijson::COMPRESSION_NONE;
+        if (compression != minijson::COMPRESSION_NONE)
         {
-            fclose(output);
-            fprintf(stderr, "ERROR: Output file '%s' already exists\n", outputFileName);
-            return 1;
+            compressed.reset(new minijson::CCompressingOutputStream(fileOutput, compression));
+            stream = compressed.get();
         }
+        minijson::CStreamWriter writer(*stream, !options.m_Minify, options.m_Indentation);
+        minijson::CStreamParser parser(1024 * 1024);
+        parser.Parse(decompressed, writer);
+        if (compressed)
+        {
+            compressed->Finish();
+        }
+        fileOutput.Flush();
     }
-    FILE* input = fopen(inputFileName, "r");
-    if (!input)
-    {
-        fprintf(stderr, "ERROR: Failed to open file %s for reading\n", inputFileName);
-        fflush(stderr);
-        return false;
-    }
-    fseek(input, 0, SEEK_END);
-    long size = ftell(input);
-    fseek(input, 0, SEEK_SET);
-    if (size <= 0)
+    catch (const minijson::CParseErrorException& ex)
     {
-        fprintf(stderr, "ERROR: Empty file %s\n", inputFileName);
+        fprintf(stderr, "ERROR: Parse error in file %s: %s\n", inputFileName, ex.Message().c_str());
         fflush(stderr);
-        fclose(input);
         return false;
     }
-    if (size > 1024 * 1024 * 20)
+    catch (const minijson::CException& ex)
     {
-        fprintf(stderr, "ERROR: File too large: %s\n", inputFileName);
+        fprintf(stderr, "ERROR: Failed to beautify file %s, exception: %s\n", inputFileName, ex.Message().c_str());
         fflush(stderr);
-        fclose(input);
         return false;
     }
-    std::vector<char> data((size_t)size + 1);
-    if (fread(data.data(), 1, (size_t)size, input) != (size_t)size)
+    if (ferror(output))
     {
-        fprintf(stderr, "ERROR: Failed to read %d bytes from file %s\n", (int)size, inputFileName);
+        fprintf(stderr, "ERROR: Failed to write %s\n", outputFileName ? outputFileName : "<stdout>");
         fflush(stderr);
-        fclose(input);
         return false;
     }
-    fclose(input);
-    input = NULL;
-    return Beautify(data, inputFileName, outputFileName);
+    return true;
 }
 
-static bool Beautify(const std::vector<char>& data, const char* inputFileName, const char* outputFileName)
+// inputFileName, outputFileName: NULL for stdin/stdout. inPlace: replace the input file (via a
+// temporary file next to it, so the input is not modified if it is invalid).
+static bool Beautify(const char* inputFileName, const char* outputFileName, bool inPlace, const SOptions& options)
 {
-    std::unique_ptr<minijson::CEntity> entity;
-    try
+    std::string tempFileName;
+    if (inPlace)
     {
-        minijson::CParser parser;
-        entity.reset(parser.Parse(data.data()));
+        tempFileName = std::string(inputFileName) + ".beautify.tmp";
+        outputFileName = tempFileName.c_str();
     }
-    catch (const minijson::CParseErrorException& ex)
+    else if (outputFileName)
     {
-        if (ex.Line() > 0)
+        FILE* existing = fopen(outputFileName, "r");
+        if (existing)
         {
-            fprintf(stderr, "ERROR: Parse error in file %s at or after line %d column %d (position %d in file):\n----------\n%s----------\nException: %s\n", inputFileName, ex.Line(), ex.Column(), ex.Position(), ex.Surrounding().c_str(), ex.Message().c_str());
+            fclose(existing);
+            fprintf(stderr, "ERROR: Output file '%s' already exists\n", outputFileName);
+            fflush(stderr);
+            return false;
         }
-        else
+    }
+
+    FILE* input = stdin;
+    if (inputFileName)
+    {
+        input = fopen(inputFileName, "rb");
+        if (!input)
         {
-            fprintf(stderr, "ERROR: Parse error in file %s at or after position %d, exception: %s\n", inputFileName, (int)ex.Position(), ex.Message().c_str());
+            fprintf(stderr, "ERROR: Failed to open file %s for reading\n", inputFileName);
+            fflush(stderr);
+            return false;
         }
-        fflush(stderr);
-        return false;
     }
-    catch (const minijson::CException& ex)
+    FILE* output = stdout;
+    if (outputFileName)
     {
-        fprintf(stderr, "ERROR: Failed to parse file %s, exception: %s\n", inputFileName, ex.Message().c_str());
-        fflush(stderr);
-        return false;
+        output = fopen(outputFileName, "wb");
+        if (!output)
+        {
+            fprintf(stderr, "ERROR: Failed to open file %s for writing\n", outputFileName);
+            fflush(stderr);
+            if (input != stdin)
+            {
+                fclose(input);
+            }
+            return false;
+        }
     }
-    minijson::CWriter writer;
-    if (outputFileName)
+
+    // NOTE: the compression of an in-place output is selected by the name of the input file
+    bool ok = Beautify(input, inputFileName ? inputFileName : "<stdin>", output, inPlace ? inputFileName : outputFileName, options);
+    if (input != stdin)
     {
-        writer.WriteToFile(outputFileName, *entity);
-        fprintf(stderr, "SUCCESSFULLY wrote %s to %s\n", inputFileName, outputFileName);
-        fflush(stderr);
+        fclose(input);
+    }
+    if (output != stdout)
+    {
+        if (fclose(output) != 0)
+        {
+            fprintf(stderr, "ERROR: Failed to write %s\n", outputFileName);
+            fflush(stderr);
+            ok = false;
+        }
+        if (!ok)
+        {
+            remove(outputFileName); // no partial output
+        }
     }
     else
     {
-        writer.WriteToFile(stdout, *entity);
         fflush(stdout);
     }
-    return true;
+    if (ok && inPlace && rename(tempFileName.c_str(), inputFileName) != 0)
+    {
+        fprintf(stderr, "ERROR: Failed to replace %s by %s\n", inputFileName, tempFileName.c_str());
+        fflush(stderr);
+        remove(tempFileName.c_str());
+        ok = false;
+    }
+    if (ok && outputFileName)
+    {
+        fprintf(stderr, "SUCCESSFULLY wrote %s to %s\n", inputFileName ? inputFileName : "<stdin>", inPlace ? inputFileName : outputFileName);
+        fflush(stderr);
+    }
+    return ok;
 }
 
 static void usage(const char* argv0)
 {
-    fprintf(stderr, "Usage: %s <input> [<output>]\n", argv0);
-    fprintf(stderr, "  This tool will attempt to file <input> and output it to <output>.\n");
-    fprintf(stderr, "  If <output> is omitted, stdout is used.\n");
+    fprintf(stderr, "Usage: %s [options] [<input> [<output>]]\n", argv0);
+    fprintf(stderr, "  This tool will attempt to reformat file <input> and output it to <output>.\n");
+    fprintf(stderr, "  If <input> is omitted or '-', stdin is used. If <output> is omitted, stdout is used.\n");
+    fprintf(stderr, "  The document is processed as a stream, files of any size are supported.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --minify            write compact json instead of pretty printing\n");
+    fprintf(stderr, "  --indent <n>        spaces per indentation level (default: 2)\n");
+    fprintf(stderr, "  --tabs              indent with tabs\n");
+    fprintf(stderr, "  --in-place          replace <input> by the reformatted json\n");
     fflush(stderr);
 }
 
 int main(int argc, char** argv)
 {
-    bool ok = true;
+    SOptions options;
+    options.m_Minify = false;
+    options.m_Indentation = "  ";
+    bool inPlace = false;
+    const char* files[2] = { nullptr, nullptr };
+    int fileCount = 0;
     for (int i = 1; i < argc; i++)
     {
+        bool hasValue = i + 1 < argc;
         if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
         {
             usage(argv[0]);
             return 0;
         }
-    }
-    if (argc > 1)
-    {
-        const char* input = argv[1];
-        const char* output = nullptr;
-        if (argc > 2)
+        else if (strcmp(argv[i], "--minify") == 0)
         {
-            output = argv[2];
+            options.m_Minify = true;
         }
-        if (!Beautify(input, output))
+        else if (strcmp(argv[i], "--indent") == 0 && hasValue)
         {
-            ok = false;
+            int spaces = atoi(argv[++i]);
+            options.m_Indentation = std::string(spaces > 0 ? (size_t)spaces : 0, ' ');
         }
-    }
-    else
-    {
-        // try reading from stdin
-        std::vector<char> data;
-        bool done = false;
-        while (!done)
+        else if (strcmp(argv[i], "--tabs") == 0)
         {
-            size_t offset = data.size();
-            data.resize(data.size() + 1024);
-            size_t s = fread(data.data() + offset, 1, 1024, stdin);
-            if (s < 1024)
-            {
-                done = true;
-                data.resize(offset + s);
-            }
+            options.m_Indentation = "\t";
         }
-
-        if (!data.empty())
+        else if (strcmp(argv[i], "--in-place") == 0)
+        {
+            inPlace = true;
+        }
+        else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && fileCount < 2)
         {
-            ok = Beautify(data, "<stdin>", nullptr);
+            files[fileCount++] = argv[i];
         }
         else
         {
-            fprintf(stderr, "ERROR: No data on stdin and no arguments provided\n");
             usage(argv[0]);
             return 1;
         }
     }
-    if (ok)
+    const char* input = files[0] && strcmp(files[0], "-") != 0 ? files[0] : nullptr;
+    const char* output = files[1];
+    if (inPlace && (!input || output))
+    {
+        fprintf(stderr, "ERROR: --in-place requires an input file and no output file\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if (!Beautify(input, output, inPlace, options))
     {
-        return 0;
+        return 1;
     }
-    return 1;
+    return 0;
 }
-
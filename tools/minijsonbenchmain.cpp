@@ -0,0 +1,1471 @@
+#include <minijson.h>
+#include <minijsonbinary.h>
+#include <minijsoncolumns.h>
+#include <minijsonindex.h>
+#include <minijsonparallel.h>
+#include <minijsonparserpool.h>
+#include <minijsonpatch.h>
+#include <minijsonslab.h>
+#include <minijsontemplate.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif // _WIN32
+
+// benchmark of minijson on deterministic synthetic corpora.
+//
+// The corpora only depend on the scale factor, i.e. results of different runs (and of different
+// minijson versions) are comparable. Results can be written as json (--output) and compared to a
+// previous run (--baseline).
+
+//
+// heap accounting: all allocations of this process go through these operators, so the heap
+// usage of the individual operations (e.g. the size of a parsed document) can be measured exactly.
+// The counters are atomic as some sections use worker threads, the peak is approximate then.
+//
+static std::atomic<size_t> g_HeapCurrent(0);
+static std::atomic<size_t> g_HeapPeak(0);
+static std::atomic<size_t> g_HeapAllocations(0);
+static std::atomic<size_t> g_HeapFrees(0);
+static const size_t HEAP_HEADER_SIZE = 16; // keeps the alignment guaranteed by malloc
+
+void* operator new(size_t size)
+{
+    char* p = (char*)malloc(size + HEAP_HEADER_SIZE);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    *(size_t*)p = size;
+    size_t current = g_HeapCurrent += size;
+    g_HeapAllocations++;
+    if (current > g_HeapPeak)
+    {
+        g_HeapPeak = current;
+    }
+    return p + HEAP_HEADER_SIZE;
+}
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+    char* p = (char*)ptr - HEAP_HEADER_SIZE;
+    g_HeapCurrent -= *(size_t*)p;
+    g_HeapFrees++;
+    free(p);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+/**
+ * Deterministic pseudo random numbers (64 bit LCG), independent of the C library.
+ **/
+class CRandom
+{
+public:
+    CRandom(uint64_t seed) : m_State(seed) {}
+
+    uint32_t Next()
+    {
+        m_State = m_State * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (uint32_t)(m_State >> 33);
+    }
+    // [0, n)
+    int Below(int n) { return (int)(Next() % (uint32_t)n); }
+    // [0, 1)
+    double Uniform() { return Next() / 2147483648.0; }
+
+private:
+    uint64_t m_State;
+};
+
+static void AppendDouble(std::string& out, double d, int precision)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", precision, d);
+    out += buf;
+}
+static void AppendInt(std::string& out, long long i)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld", i);
+    out += buf;
+}
+
+// number heavy: polygons with coordinate pairs (like canada.json)
+static std::string GenerateNumbers(size_t targetSize)
+{
+    CRandom rnd(1);
+    std::string out = "{\"type\":\"FeatureCollection\",\"features\":[";
+    for (int feature = 0; out.size() < targetSize; feature++)
+    {
+        if (feature > 0)
+        {
+            out += ',';
+        }
+        out += "{\"type\":\"Feature\",\"properties\":{\"name\":\"Region ";
+        AppendInt(out, feature);
+        out += "\"},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[";
+        double x = -140.0 + rnd.Uniform() * 80.0;
+        double y = 42.0 + rnd.Uniform() * 40.0;
+        for (int i = 0; i < 1000; i++)
+        {
+            x += rnd.Uniform() * 0.02 - 0.01;
+            y += rnd.Uniform() * 0.02 - 0.01;
+            if (i > 0)
+            {
+                out += ',';
+            }
+            out += '[';
+            AppendDouble(out, x, 15);
+            out += ',';
+            AppendDouble(out, y, 15);
+            out += ']';
+        }
+        out += "]]}}";
+    }
+    out += "]}";
+    return out;
+}
+
+// string heavy with escapes and non-ascii text: status messages (like twitter.json)
+static std::string GenerateStrings(size_t targetSize)
+{
+    static const char* words[] = {
+        "json", "parser", "minijson", "fast", "\\u00fcber", "caf\xc3\xa9", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",
+        "\\u041f\\u0440\\u0438\\u0432\\u0435\\u0442", "\xf0\x9f\x98\x80", "\\\"quoted\\\"", "line\\nbreak", "tab\\t",
+        "http:\\/\\/example.com\\/", "the", "a", "of", "benchmark", "\xce\xb1\xce\xb2\xce\xb3"
+    };
+    const int wordCount = (int)(sizeof(words) / sizeof(words[0]));
+    CRandom rnd(2);
+    std::string out = "{\"statuses\":[";
+    for (int status = 0; out.size() < targetSize; status++)
+    {
+        if (status > 0)
+        {
+            out += ',';
+        }
+        out += "{\"id\":";
+        AppendInt(out, 505874924095815681LL + status);
+        out += ",\"id_str\":\"";
+        AppendInt(out, 505874924095815681LL + status);
+        out += "\",\"text\":\"";
+        int len = 5 + rnd.Below(25);
+        for (int i = 0; i < len; i++)
+        {
+            if (i > 0)
+            {
+                out += ' ';
+            }
+            out += words[rnd.Below(wordCount)];
+        }
+        out += "\",\"user\":{\"id\":";
+        AppendInt(out, rnd.Below(1000000));
+        out += ",\"name\":\"";
+        out += words[rnd.Below(wordCount)];
+        out += "\",\"screen_name\":\"user";
+        AppendInt(out, rnd.Below(100000));
+        out += "\",\"followers_count\":";
+        AppendInt(out, rnd.Below(100000));
+        out += ",\"verified\":";
+        out += rnd.Below(10) == 0 ? "true" : "false";
+        out += ",\"url\":null},\"retweet_count\":";
+        AppendInt(out, rnd.Below(1000));
+        out += ",\"lang\":\"";
+        out += rnd.Below(2) ? "en" : "ja";
+        out += "\"}";
+    }
+    out += "]}";
+    return out;
+}
+
+// deeply nested objects and arrays
+static std::string GenerateDeep(size_t targetSize)
+{
+    CRandom rnd(3);
+    std::string out = "{\"trees\":[";
+    for (int tree = 0; out.size() < targetSize; tree++)
+    {
+        if (tree > 0)
+        {
+            out += ',';
+        }
+        int depth = 50 + rnd.Below(150);
+        for (int i = 0; i < depth; i++)
+        {
+            if (i % 2 == 0)
+            {
+                out += "{\"level\":";
+                AppendInt(out, i);
+                out += ",\"child\":";
+            }
+            else
+            {
+                out += "[true,null,";
+            }
+        }
+        out += "\"leaf\"";
+        for (int i = depth - 1; i >= 0; i--)
+        {
+            out += i % 2 == 0 ? '}' : ']';
+        }
+    }
+    out += "]}";
+    return out;
+}
+
+// one object with many members
+static std::string GenerateWideObject(size_t targetSize)
+{
+    CRandom rnd(4);
+    std::string out = "{";
+    for (int i = 0; out.size() < targetSize; i++)
+    {
+        if (i > 0)
+        {
+            out += ',';
+        }
+        out += "\"member_";
+        AppendInt(out, rnd.Next());
+        out += '_';
+        AppendInt(out, i);
+        out += "\":";
+        switch (i % 4)
+        {
+        case 0:
+            AppendInt(out, rnd.Below(1000000));
+            break;
+        case 1:
+            out += "\"value ";
+            AppendInt(out, i);
+            out += '"';
+            break;
+        case 2:
+            AppendDouble(out, rnd.Uniform() * 1000.0, 3);
+            break;
+        default:
+            out += rnd.Below(2) ? "true" : "false";
+            break;
+        }
+    }
+    out += "}";
+    return out;
+}
+
+// one big array of small integers
+static std::string GenerateBigArray(size_t targetSize)
+{
+    CRandom rnd(5);
+    std::string out = "[";
+    for (int i = 0; out.size() < targetSize; i++)
+    {
+        if (i > 0)
+        {
+            out += ',';
+        }
+        AppendInt(out, rnd.Below(2000000) - 1000000);
+    }
+    out += "]";
+    return out;
+}
+
+struct SCorpus
+{
+    const char* m_Name;
+    std::string (*m_Generate)(size_t targetSize);
+};
+static const SCorpus g_Corpora[] = {
+    { "numbers", GenerateNumbers },
+    { "strings", GenerateStrings },
+    { "deep", GenerateDeep },
+    { "wide", GenerateWideObject },
+    { "bigarray", GenerateBigArray }
+};
+
+// best (minimal) wall clock time of iterations runs of f, in seconds
+static double Measure(int iterations, const std::function<void()>& f)
+{
+    double best = 0.0;
+    for (int i = 0; i < iterations; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || t < best)
+        {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static double MBPerSecond(size_t bytes, double seconds)
+{
+    return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+// walks the tree with EntityAtIndex(), returns the number of visited values
+static size_t WalkByIndex(const minijson::CEntity& e)
+{
+    size_t count = 1;
+    if (e.IsObject())
+    {
+        const minijson::CObject& obj = e.Object();
+        for (int i = 0; i < obj.Count(); i++)
+        {
+            count += WalkByIndex(obj.EntityAtIndex(i));
+        }
+    }
+    else if (e.IsArray())
+    {
+        const minijson::CArray& arr = e.Array();
+        for (int i = 0; i < arr.Count(); i++)
+        {
+            count += WalkByIndex(arr.EntityAtIndex(i));
+        }
+    }
+    return count;
+}
+
+// walks the tree with the const iterators, returns the number of visited values
+static size_t WalkByIterator(const minijson::CEntity& e)
+{
+    size_t count = 1;
+    if (e.IsObject())
+    {
+        for (const minijson::CObject::TMember& member : e.Object())
+        {
+            count += WalkByIterator(*member.second);
+        }
+    }
+    else if (e.IsArray())
+    {
+        for (const minijson::CEntity& element : e.Array())
+        {
+            count += WalkByIterator(element);
+        }
+    }
+    return count;
+}
+
+// walks the tree with operator[] (member lookup by name), returns the number of visited values
+static size_t WalkByKey(const minijson::CEntity& e)
+{
+    size_t count = 1;
+    if (e.IsObject())
+    {
+        for (int i = 0; i < e.Count(); i++)
+        {
+            count += WalkByKey(e[e.ObjectMemberNameByIndex(i)]);
+        }
+    }
+    else if (e.IsArray())
+    {
+        for (int i = 0; i < e.Count(); i++)
+        {
+            count += WalkByKey(e[i]);
+        }
+    }
+    return count;
+}
+
+// calls GetInt() for all integer members/elements, returns the number of calls
+static size_t GetInts(const minijson::CEntity& e, long long& sum)
+{
+    size_t count = 0;
+    if (e.IsObject())
+    {
+        const minijson::CObject& obj = e.Object();
+        for (int i = 0; i < obj.Count(); i++)
+        {
+            const minijson::CEntity& child = obj.EntityAtIndex(i);
+            if (child.IsNumber())
+            {
+                sum += obj.GetInt(obj.MemberNameByIndex(i));
+                count++;
+            }
+            else
+            {
+                count += GetInts(child, sum);
+            }
+        }
+    }
+    else if (e.IsArray())
+    {
+        const minijson::CArray& arr = e.Array();
+        for (int i = 0; i < arr.Count(); i++)
+        {
+            const minijson::CEntity& child = arr.EntityAtIndex(i);
+            if (child.IsNumber())
+            {
+                sum += arr.GetInt(i);
+                count++;
+            }
+            else
+            {
+                count += GetInts(child, sum);
+            }
+        }
+    }
+    return count;
+}
+
+static void AddResult(minijson::CObject& results, const char* name, double value)
+{
+    results.AddDouble(name, value);
+    fprintf(stdout, "  %-24s %14.2f\n", name, value);
+}
+
+static void RunCorpus(const SCorpus& corpus, const std::string& json, int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "%s (%lu bytes)\n", corpus.m_Name, (unsigned long)json.size());
+    results.AddDouble("bytes", (double)json.size());
+
+    // parse: throughput, peak heap during parsing and size of the resulting tree
+    size_t heapBefore = g_HeapCurrent;
+    g_HeapPeak = g_HeapCurrent.load();
+    size_t allocationsBefore = g_HeapAllocations;
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(json));
+    size_t parsePeak = g_HeapPeak - heapBefore;
+    size_t domBytes = g_HeapCurrent - heapBefore;
+    size_t domAllocations = g_HeapAllocations - allocationsBefore;
+    double t = Measure(iterations, [&]() { delete minijson::CParser::ParseString(json); });
+    AddResult(results, "parse_mb_per_s", MBPerSecond(json.size(), t));
+    AddResult(results, "parse_peak_heap_bytes", (double)parsePeak);
+    AddResult(results, "dom_heap_bytes", (double)domBytes);
+    AddResult(results, "dom_allocations", (double)domAllocations);
+    // validate-only (no entities)
+    minijson::CParser validator;
+    minijson::CParseResult validateResult;
+    t = Measure(iterations, [&]() { validator.Validate(json, validateResult); });
+    AddResult(results, "validate_mb_per_s", MBPerSecond(json.size(), t));
+    // teardown (destruction of the tree)
+    t = 0.0;
+    for (int i = 0; i < iterations; i++)
+    {
+        minijson::CEntity* e = minijson::CParser::ParseString(json);
+        double teardown = Measure(1, [&]() { delete e; });
+        if (i == 0 || teardown < t)
+        {
+            t = teardown;
+        }
+    }
+    AddResult(results, "teardown_ms", t * 1000.0);
+
+    // serialization
+    std::string text = doc->ToString(false);
+    t = Measure(iterations, [&]() { text = doc->ToString(false); });
+    AddResult(results, "tostring_mb_per_s", MBPerSecond(text.size(), t));
+    t = Measure(iterations, [&]() { text = doc->ToString(true); });
+    AddResult(results, "tostring_pretty_mb_per_s", MBPerSecond(text.size(), t));
+    t = Measure(iterations, [&]() {
+        text.clear();
+        minijson::CStringOutputStream stream(text);
+        minijson::CWriter writer(false);
+        writer.Write(stream, *doc);
+    });
+    AddResult(results, "writer_mb_per_s", MBPerSecond(text.size(), t));
+
+    // accessors (million calls per second)
+    size_t visited = 0;
+    t = Measure(iterations, [&]() { visited = WalkByIndex(*doc); });
+    AddResult(results, "entityatindex_m_per_s", t > 0.0 ? visited / t / 1e6 : 0.0);
+    t = Measure(iterations, [&]() { visited = WalkByIterator(*doc); });
+    AddResult(results, "iterator_m_per_s", t > 0.0 ? visited / t / 1e6 : 0.0);
+    t = Measure(iterations, [&]() { visited = WalkByKey(*doc); });
+    AddResult(results, "operator_index_m_per_s", t > 0.0 ? visited / t / 1e6 : 0.0);
+    long long sum = 0;
+    t = Measure(iterations, [&]() { visited = GetInts(*doc, sum); });
+    AddResult(results, "getint_m_per_s", t > 0.0 && visited > 0 ? visited / t / 1e6 : 0.0);
+
+    // copies (ms per document)
+    t = Measure(iterations, [&]() { delete doc->Copy(); });
+    AddResult(results, "copy_ms", t * 1000.0);
+    if (doc->IsObject())
+    {
+        t = Measure(iterations, [&]() {
+            minijson::CObject target;
+            target.MergeFrom(doc->Object(), false);
+            target.MergeFrom(doc->Object(), true); // all members exist: replaces all values
+        });
+        AddResult(results, "mergefrom_ms", t * 1000.0);
+    }
+
+    // binary formats (see minijsonbinary.h): size relative to the json text and decode speed
+    std::string cbor = minijson::CCborWriter::Encode(*doc);
+    t = Measure(iterations, [&]() { cbor = minijson::CCborWriter::Encode(*doc); });
+    AddResult(results, "cbor_encode_mb_per_s", MBPerSecond(cbor.size(), t));
+    t = Measure(iterations, [&]() { delete minijson::CCborReader::Decode(cbor); });
+    AddResult(results, "cbor_decode_mb_per_s", MBPerSecond(cbor.size(), t));
+    AddResult(results, "cbor_size_percent", 100.0 * cbor.size() / json.size());
+    std::string msgpack = minijson::CMsgPackWriter::Encode(*doc);
+    t = Measure(iterations, [&]() { msgpack = minijson::CMsgPackWriter::Encode(*doc); });
+    AddResult(results, "msgpack_encode_mb_per_s", MBPerSecond(msgpack.size(), t));
+    t = Measure(iterations, [&]() { delete minijson::CMsgPackReader::Decode(msgpack); });
+    AddResult(results, "msgpack_decode_mb_per_s", MBPerSecond(msgpack.size(), t));
+    AddResult(results, "msgpack_size_percent", 100.0 * msgpack.size() / json.size());
+}
+
+// add/remove heavy updates of a live state tree created with allocator, returns the number of
+// operations
+static size_t Churn(minijson::CAllocator& allocator)
+{
+    const int items = 1000;
+    const int operations = 200000;
+    CRandom rnd(6);
+    std::unique_ptr<minijson::CObject> state(minijson::CObject::Create(allocator));
+    char name[32];
+    for (int i = 0; i < items; i++)
+    {
+        snprintf(name, sizeof(name), "item%d", i);
+        minijson::CObject* item = state->AddObject(name);
+        item->AddInt("id", i);
+        item->AddString("status", "new");
+        item->AddArray("history");
+    }
+    for (int i = 0; i < operations; i++)
+    {
+        snprintf(name, sizeof(name), "item%d", rnd.Below(items));
+        minijson::CObject* item = state->GetObject(name);
+        switch (rnd.Below(4))
+        {
+        case 0:
+            item->SetInt("count", i);
+            break;
+        case 1:
+            item->SetString("status", i % 2 ? "active" : "idle");
+            break;
+        case 2:
+        {
+            minijson::CArray* history = item->GetArray("history");
+            history->AddInt(i);
+            if (history->Count() > 8)
+            {
+                history->Remove(0);
+            }
+            break;
+        }
+        default:
+            // replace the whole item
+            state->Remove(name);
+            item = state->AddObject(name);
+            item->AddInt("id", i);
+            item->AddString("status", "new");
+            item->AddArray("history");
+            break;
+        }
+    }
+    return operations;
+}
+
+static void RunChurn(int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "churn (add/remove heavy updates of a live document)\n");
+    struct
+    {
+        const char* m_Name;
+        int m_Type;
+    } allocators[] = { { "default", 0 }, { "pool", 1 }, { "slab", 2 } };
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++)
+    {
+        size_t operations = 0;
+        size_t heapBefore = g_HeapCurrent;
+        g_HeapPeak = g_HeapCurrent.load();
+        double t = Measure(iterations, [&]() {
+            minijson::CPoolAllocator pool;
+            minijson::CSlabAllocator slab;
+            minijson::CAllocator* allocator = &minijson::CAllocator::Default();
+            if (allocators[i].m_Type == 1)
+            {
+                allocator = &pool;
+            }
+            else if (allocators[i].m_Type == 2)
+            {
+                allocator = &slab;
+            }
+            operations = Churn(*allocator);
+        });
+        std::string name = std::string(allocators[i].m_Name) + "_m_ops_per_s";
+        AddResult(results, name.c_str(), t > 0.0 ? operations / t / 1e6 : 0.0);
+        name = std::string(allocators[i].m_Name) + "_peak_heap_bytes";
+        AddResult(results, name.c_str(), (double)(g_HeapPeak - heapBefore));
+    }
+}
+
+// small messages, e.g. the requests of a service
+static std::vector<std::string> GenerateMessages(int count)
+{
+    CRandom random(11);
+    std::vector<std::string> messages;
+    for (int i = 0; i < count; i++)
+    {
+        std::string msg = "{\"id\": ";
+        AppendInt(msg, random.Below(1000000));
+        msg += ", \"method\": \"update_subscription_settings\", \"user\": {\"name\": \"user";
+        AppendInt(msg, random.Below(1000));
+        msg += "\", \"score\": ";
+        AppendDouble(msg, random.Uniform() * 100.0, 2);
+        msg += "}, \"tags\": [\"a\", \"b\"], \"active\": true}";
+        messages.push_back(msg);
+    }
+    return messages;
+}
+
+// many small messages (e.g. requests of a service): fresh parser per message vs. reused parser
+static void RunSmall(int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "small (parsing many small messages)\n");
+    std::vector<std::string> messages = GenerateMessages(10000);
+    size_t bytes = 0;
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+        bytes += messages[i].size();
+    }
+
+    double t = Measure(iterations, [&]() {
+        for (size_t i = 0; i < messages.size(); i++)
+        {
+            delete minijson::CParser::ParseString(messages[i]);
+        }
+    });
+    AddResult(results, "fresh_k_msgs_per_s", t > 0.0 ? messages.size() / t / 1e3 : 0.0);
+    t = Measure(iterations, [&]() {
+        minijson::CPooledParser parser = minijson::CParserPool::Acquire();
+        for (size_t i = 0; i < messages.size(); i++)
+        {
+            delete parser->Parse(messages[i]);
+        }
+    });
+    AddResult(results, "reused_k_msgs_per_s", t > 0.0 ? messages.size() / t / 1e3 : 0.0);
+    AddResult(results, "reused_mb_per_s", MBPerSecond(bytes, t));
+
+    // allocations that are not part of the result are freed again during Parse()
+    size_t temporary = 0;
+    minijson::CPooledParser parser = minijson::CParserPool::Acquire();
+    for (size_t i = 0; i < messages.size(); i++)
+    {
+        size_t freesBefore = g_HeapFrees;
+        minijson::CEntity* e = parser->Parse(messages[i]);
+        temporary += g_HeapFrees - freesBefore;
+        delete e;
+    }
+    AddResult(results, "reused_temp_allocations", (double)temporary);
+}
+
+// 99th percentile of the durations (in seconds)
+static double Percentile99(std::vector<double> durations)
+{
+    std::sort(durations.begin(), durations.end());
+    return durations.empty() ? 0.0 : durations[std::min(durations.size() - 1, durations.size() * 99 / 100)];
+}
+
+// batches of small messages: sequential CParser::ParseString() loop vs. CBatchParser on all cores
+static void RunBatch(int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "batch (parsing batches of small messages)\n");
+    std::vector<std::string> messages = GenerateMessages(10000);
+    int batches = 4 * iterations;
+    std::vector<double> sequential;
+    std::vector<double> parallel;
+    for (int i = 0; i < batches; i++)
+    {
+        sequential.push_back(Measure(1, [&]() {
+            for (size_t j = 0; j < messages.size(); j++)
+            {
+                delete minijson::CParser::ParseString(messages[j]);
+            }
+        }));
+    }
+    minijson::CThreadPool pool;
+    minijson::CBatchParser batch(pool);
+    for (int i = 0; i < batches; i++)
+    {
+        parallel.push_back(Measure(1, [&]() { batch.ParseBatch(messages); }));
+    }
+    batch.Clear();
+
+    double sequentialTotal = 0.0;
+    double parallelTotal = 0.0;
+    for (int i = 0; i < batches; i++)
+    {
+        sequentialTotal += sequential[i];
+        parallelTotal += parallel[i];
+    }
+    double count = (double)messages.size() * batches;
+    AddResult(results, "threads", (double)pool.Threads());
+    AddResult(results, "sequential_k_msgs_per_s", sequentialTotal > 0.0 ? count / sequentialTotal / 1e3 : 0.0);
+    AddResult(results, "sequential_p99_batch_ms", Percentile99(sequential) * 1e3);
+    AddResult(results, "batch_k_msgs_per_s", parallelTotal > 0.0 ? count / parallelTotal / 1e3 : 0.0);
+    AddResult(results, "batch_p99_batch_ms", Percentile99(parallel) * 1e3);
+}
+
+/**
+ * Output stream that only counts the written bytes.
+ **/
+class CCountingOutputStream : public minijson::COutputStream
+{
+public:
+    CCountingOutputStream() : m_Bytes(0) {}
+    virtual void Write(const char*, size_t length) MINIJSON_OVERRIDE { m_Bytes += length; }
+    size_t m_Bytes;
+};
+
+// serialization of a large document with CParallelWriter on 1, 2, 4, ... threads
+static void RunParallel(double scale, int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "parallel (serialization scaling)\n");
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(GenerateStrings((size_t)(scale * 1024 * 1024))));
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    for (int pretty = 0; pretty < 2; pretty++)
+    {
+        const char* mode = pretty ? "pretty" : "compact";
+        double single = 0.0;
+        for (size_t i = 0; i < threadCounts.size(); i++)
+        {
+            minijson::CThreadPool pool(threadCounts[i]);
+            minijson::CParallelWriter writer(pool, pretty != 0);
+            size_t bytes = 0;
+            double t = Measure(iterations, [&]() {
+                CCountingOutputStream stream;
+                writer.Write(stream, *doc);
+                bytes = stream.m_Bytes;
+            });
+            if (i == 0)
+            {
+                single = t;
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%s_%dt_mb_per_s", mode, (int)threadCounts[i]);
+            AddResult(results, name, MBPerSecond(bytes, t));
+            snprintf(name, sizeof(name), "%s_%dt_speedup", mode, (int)threadCounts[i]);
+            AddResult(results, name, t > 0.0 ? single / t : 0.0);
+        }
+    }
+}
+
+// diff of two versions of a large document with a few changes (--scale 100 for the 100MB case)
+static void RunDiff(double scale, int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "diff (snapshots of a large document with small changes)\n");
+    std::unique_ptr<minijson::CEntity> previous(minijson::CParser::ParseString(GenerateStrings((size_t)(scale * 1024 * 1024))));
+    std::unique_ptr<minijson::CEntity> current(previous->Copy());
+    minijson::CArray& statuses = (*current)["statuses"].Array();
+    int count = statuses.Count();
+    for (int i = 1; i <= 10; i++)
+    {
+        statuses[count * i / 11]["retweet_count"].Number().SetInt(-i);
+    }
+    statuses.Remove(count / 3);
+    statuses.AddObject()->AddString("id_str", "new");
+    statuses.Insert(0, statuses.Detach(count / 2));
+    std::unique_ptr<minijson::CEntity> unchanged(previous->Copy());
+
+    minijson::CDiff diff;
+    diff.SetArrayKey("id");
+    int operations = 0;
+    // the first diff computes the hashes of both documents, they are cached for the following ones
+    double t = Measure(1, [&]() {
+        minijson::CArray patch;
+        diff.Diff(*previous, *current, patch);
+    });
+    AddResult(results, "first_diff_ms", t * 1e3);
+    t = Measure(iterations, [&]() {
+        minijson::CArray patch;
+        diff.Diff(*previous, *current, patch);
+        operations = patch.Count();
+    });
+    AddResult(results, "diff_ms", t * 1e3);
+    AddResult(results, "operations", (double)operations);
+    t = Measure(iterations, [&]() {
+        minijson::CArray patch;
+        diff.Diff(*previous, *unchanged, patch);
+    });
+    AddResult(results, "unchanged_diff_ms", t * 1e3);
+    // what the diff replaces: comparing the serialized documents
+    t = Measure(iterations, [&]() {
+        if (previous->ToString(false) == current->ToString(false))
+        {
+            fprintf(stderr, "ERROR: documents are equal\n");
+        }
+    });
+    AddResult(results, "tostring_compare_ms", t * 1e3);
+
+    std::unique_ptr<minijson::CArray> patch(minijson::Diff(*previous, *current));
+    t = Measure(1, [&]() { minijson::ApplyPatch(*previous, *patch); });
+    AddResult(results, "apply_ms", t * 1e3);
+    if (previous->ToString(false) != current->ToString(false))
+    {
+        fprintf(stderr, "ERROR: patched document differs\n");
+    }
+}
+
+// records with repeated address blocks (one of 16) and identical default settings
+static std::string GenerateDuplicates(size_t targetSize)
+{
+    CRandom rnd(5);
+    std::string out = "{\"customers\":[";
+    for (int customer = 0; out.size() < targetSize; customer++)
+    {
+        if (customer > 0)
+        {
+            out += ',';
+        }
+        int address = rnd.Below(16);
+        out += "{\"id\":";
+        AppendInt(out, customer);
+        out += ",\"address\":{\"street\":\"Main Street ";
+        AppendInt(out, address);
+        out += "\",\"city\":\"Springfield\",\"zip\":\"";
+        AppendInt(out, 10000 + address);
+        out += "\",\"location\":[";
+        AppendInt(out, address * 3);
+        out += ',';
+        AppendInt(out, address * 7);
+        out += "]},\"settings\":{\"language\":\"en\",\"newsletter\":false,\"theme\":\"default\","
+               "\"notifications\":{\"email\":true,\"sms\":false,\"channels\":[\"mail\",\"push\"]}}}";
+    }
+    out += "]}";
+    return out;
+}
+
+// hash-consing of repeated subtrees: heap of the tree with and without sharing
+static void RunDeduplicate(double scale, int iterations, minijson::CObject& results)
+{
+    std::string json = GenerateDuplicates((size_t)(scale * 1024 * 1024));
+    fprintf(stdout, "dedup (%lu bytes)\n", (unsigned long)json.size());
+    size_t heapBefore = g_HeapCurrent;
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(json));
+    size_t plainBytes = g_HeapCurrent - heapBefore;
+    AddResult(results, "dom_heap_bytes", (double)plainBytes);
+    size_t saved = 0;
+    double t = Measure(1, [&]() { saved = doc->Deduplicate(); });
+    AddResult(results, "deduplicate_ms", t * 1e3);
+    AddResult(results, "reported_saved_bytes", (double)saved);
+    AddResult(results, "deduplicated_heap_bytes", (double)(g_HeapCurrent - heapBefore));
+    doc.reset();
+
+    minijson::CParser parser;
+    minijson::CParseStats stats;
+    parser.SetStats(&stats);
+    parser.SetDeduplicate(true);
+    heapBefore = g_HeapCurrent;
+    g_HeapPeak = g_HeapCurrent.load();
+    doc.reset(parser.Parse(json));
+    AddResult(results, "parse_dedup_heap_bytes", (double)(g_HeapCurrent - heapBefore));
+    AddResult(results, "parse_dedup_peak_heap_bytes", (double)(g_HeapPeak - heapBefore));
+    AddResult(results, "shared_subtrees", (double)stats.m_SharedSubtrees);
+    doc.reset();
+    t = Measure(iterations, [&]() { delete minijson::CParser::ParseString(json); });
+    AddResult(results, "parse_mb_per_s", MBPerSecond(json.size(), t));
+    parser.SetStats(NULL);
+    t = Measure(iterations, [&]() { delete parser.Parse(json); });
+    AddResult(results, "parse_dedup_mb_per_s", MBPerSecond(json.size(), t));
+}
+
+// lookups of records by id in an array of 100k objects: linear scan vs. CIndex
+static void RunIndex(int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "index (100000 records)\n");
+    const int count = 100000;
+    const int lookups = 1000;
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(GenerateDuplicates(count * 250)));
+    minijson::CArray& customers = (*doc)["customers"].Array();
+    while (customers.Count() > count)
+    {
+        customers.Remove(customers.Count() - 1);
+    }
+    CRandom rnd(6);
+    std::vector<int> ids;
+    for (int i = 0; i < lookups; i++)
+    {
+        ids.push_back(rnd.Below(count));
+    }
+
+    // (a few lookups only, the scan is slow)
+    const size_t scanLookups = 20;
+    int found = 0;
+    double t = Measure(iterations, [&]() {
+        found = 0;
+        const minijson::CArray& arr = customers;
+        for (size_t i = 0; i < scanLookups; i++)
+        {
+            for (int j = 0; j < arr.Count(); j++)
+            {
+                if (arr.GetObject(j)->GetInt("id") == ids[i])
+                {
+                    found++;
+                    break;
+                }
+            }
+        }
+    });
+    AddResult(results, "scan_lookups_per_s", t > 0.0 ? scanLookups / t : 0.0);
+    std::unique_ptr<minijson::CIndex> index;
+    t = Measure(1, [&]() { index.reset(new minijson::CIndex(customers, "id")); });
+    AddResult(results, "build_ms", t * 1e3);
+    t = Measure(iterations, [&]() {
+        found = 0;
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            found += index->Find(ids[i]) != NULL;
+        }
+    });
+    AddResult(results, "index_lookups_per_s", t > 0.0 ? ids.size() / t : 0.0);
+    if (found != lookups)
+    {
+        fprintf(stderr, "ERROR: %d of %d records found\n", found, lookups);
+    }
+    // the first lookup after a modification rebuilds the index
+    t = Measure(iterations, [&]() {
+        customers.AddObject()->AddInt("id", count);
+        index->Find(count);
+        customers.Remove(count);
+    });
+    AddResult(results, "lookup_after_add_ms", t * 1e3);
+}
+
+// flat records (ticks): per-cell DOM access vs. columnar extraction from the DOM and from text
+static std::string GenerateRecords(size_t targetSize)
+{
+    CRandom rnd(7);
+    static const char* symbols[] = { "ABC", "DEFG", "HI", "JKLMN" };
+    std::string out = "[";
+    for (int record = 0; out.size() < targetSize; record++)
+    {
+        if (record > 0)
+        {
+            out += ',';
+        }
+        out += "{\"ts\":";
+        AppendInt(out, 1600000000 + record);
+        out += ",\"symbol\":\"";
+        out += symbols[rnd.Below(4)];
+        out += "\",\"price\":";
+        AppendInt(out, rnd.Below(100000));
+        out += '.';
+        AppendInt(out, 10 + rnd.Below(90));
+        out += ",\"size\":";
+        AppendInt(out, rnd.Below(1000));
+        out += ",\"buy\":";
+        out += rnd.Below(2) ? "true" : "false";
+        out += ",\"venue\":\"X\"}";
+    }
+    out += ']';
+    return out;
+}
+
+static void RunColumns(double scale, int iterations, minijson::CObject& results)
+{
+    std::string json = GenerateRecords((size_t)(scale * 1024 * 1024));
+    fprintf(stdout, "columns (%lu bytes)\n", (unsigned long)json.size());
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(json));
+    const minijson::CArray& records = doc->Array();
+    double sum = 0.0;
+    double t = Measure(iterations, [&]() {
+        std::vector<double> prices;
+        std::vector<int64_t> sizes;
+        prices.reserve(records.Count());
+        sizes.reserve(records.Count());
+        for (int i = 0; i < records.Count(); i++)
+        {
+            const minijson::CObject* record = records.GetObject(i);
+            prices.push_back(record->GetDouble("price"));
+            sizes.push_back(record->GetInt("size"));
+        }
+        sum = prices.back() + (double)sizes.back();
+    });
+    AddResult(results, "dom_cells_mb_per_s", MBPerSecond(json.size(), t));
+    minijson::CColumnTable table;
+    table.AddColumn("price", minijson::COLUMN_DOUBLE);
+    table.AddColumn("size", minijson::COLUMN_INT64);
+    t = Measure(iterations, [&]() {
+        table.Clear();
+        table.Extract(records);
+    });
+    AddResult(results, "dom_columns_mb_per_s", MBPerSecond(json.size(), t));
+    doc.reset();
+    t = Measure(iterations, [&]() { delete minijson::CParser::ParseString(json); });
+    AddResult(results, "parse_mb_per_s", MBPerSecond(json.size(), t));
+    t = Measure(iterations, [&]() {
+        table.Clear();
+        table.Extract(json.data(), json.size());
+    });
+    AddResult(results, "text_columns_mb_per_s", MBPerSecond(json.size(), t));
+    if (table.Column("price")->Doubles()[table.Rows() - 1] + (double)table.Column("size")->Int64s()[table.Rows() - 1] != sum)
+    {
+        fprintf(stderr, "ERROR: columns differ from the document\n");
+    }
+}
+
+// metrics and tracks: arrays of numbers only (integer timestamps, values with 2 decimals,
+// coordinates with 6 decimals)
+static std::string GenerateSeries(size_t targetSize)
+{
+    CRandom rnd(8);
+    std::string out = "{\"series\":[";
+    for (int series = 0; out.size() < targetSize; series++)
+    {
+        if (series > 0)
+        {
+            out += ',';
+        }
+        out += "{\"name\":\"metric ";
+        AppendInt(out, series);
+        out += "\",\"timestamps\":[";
+        for (int i = 0; i < 500; i++)
+        {
+            out += i > 0 ? "," : "";
+            AppendInt(out, 1600000000 + i * 10);
+        }
+        out += "],\"values\":[";
+        for (int i = 0; i < 500; i++)
+        {
+            out += i > 0 ? "," : "";
+            AppendDouble(out, rnd.Uniform() * 100.0, 2);
+        }
+        out += "],\"track\":[";
+        double x = -140.0 + rnd.Uniform() * 80.0;
+        double y = 42.0 + rnd.Uniform() * 40.0;
+        for (int i = 0; i < 250; i++)
+        {
+            x += rnd.Uniform() * 0.02 - 0.01;
+            y += rnd.Uniform() * 0.02 - 0.01;
+            out += i > 0 ? ",[" : "[";
+            AppendDouble(out, x, 6);
+            out += ',';
+            AppendDouble(out, y, 6);
+            out += ']';
+        }
+        out += "]}";
+    }
+    out += "]}";
+    return out;
+}
+
+// sum of all numbers of the numbers only arrays, by GetDouble() or by CopyTo()
+static double SumSeries(const minijson::CArray& arr, bool copy, std::vector<double>& buffer)
+{
+    double sum = 0.0;
+    if (arr.Count() > 0 && arr.GetArray(0))
+    {
+        for (int i = 0; i < arr.Count(); i++)
+        {
+            sum += SumSeries(*arr.GetArray(i), copy, buffer);
+        }
+        return sum;
+    }
+    if (copy)
+    {
+        buffer.resize(arr.Count());
+        arr.CopyTo(buffer.data());
+        for (size_t i = 0; i < buffer.size(); i++)
+        {
+            sum += buffer[i];
+        }
+        return sum;
+    }
+    for (int i = 0; i < arr.Count(); i++)
+    {
+        sum += arr.GetDouble(i);
+    }
+    return sum;
+}
+
+// packed numeric arrays: heap, parse, bulk reads and output compared to CNumber elements
+static void RunPacked(double scale, int iterations, minijson::CObject& results)
+{
+    std::string json = GenerateSeries((size_t)(scale * 1024 * 1024));
+    fprintf(stdout, "packed (%lu bytes)\n", (unsigned long)json.size());
+    minijson::CParser parser;
+    parser.SetPackNumbers(true);
+    size_t heapBefore = g_HeapCurrent;
+    std::unique_ptr<minijson::CEntity> plain(minijson::CParser::ParseString(json));
+    AddResult(results, "dom_heap_bytes", (double)(g_HeapCurrent - heapBefore));
+    heapBefore = g_HeapCurrent;
+    std::unique_ptr<minijson::CEntity> packed(parser.Parse(json));
+    AddResult(results, "packed_heap_bytes", (double)(g_HeapCurrent - heapBefore));
+
+    double t = Measure(iterations, [&]() { delete minijson::CParser::ParseString(json); });
+    AddResult(results, "parse_mb_per_s", MBPerSecond(json.size(), t));
+    t = Measure(iterations, [&]() { delete parser.Parse(json); });
+    AddResult(results, "parse_packed_mb_per_s", MBPerSecond(json.size(), t));
+
+    const minijson::CArray& plainSeries = plain->Object().GetArray("series")[0];
+    const minijson::CArray& packedSeries = packed->Object().GetArray("series")[0];
+    std::vector<double> buffer;
+    double sums[3] = { 0.0, 0.0, 0.0 };
+    size_t numbers = 0;
+    for (int i = 0; i < plainSeries.Count(); i++)
+    {
+        const minijson::CObject& series = *plainSeries.GetObject(i);
+        numbers += series.GetArray("timestamps")->Count() + series.GetArray("values")->Count() + 2 * series.GetArray("track")->Count();
+    }
+    const char* names[] = { "timestamps", "values", "track" };
+    auto sum = [&](const minijson::CArray& all, bool copy, double* out) {
+        for (int n = 0; n < 3; n++)
+        {
+            out[n] = 0.0;
+            for (int i = 0; i < all.Count(); i++)
+            {
+                out[n] += SumSeries(*all.GetObject(i)->GetArray(names[n]), copy, buffer);
+            }
+        }
+    };
+    t = Measure(iterations, [&]() { sum(plainSeries, false, sums); });
+    AddResult(results, "getdouble_m_per_s", t > 0.0 ? numbers / t / 1e6 : 0.0);
+    double packedSums[3];
+    t = Measure(iterations, [&]() { sum(packedSeries, false, packedSums); });
+    AddResult(results, "packed_getdouble_m_per_s", t > 0.0 ? numbers / t / 1e6 : 0.0);
+    t = Measure(iterations, [&]() { sum(packedSeries, true, packedSums); });
+    AddResult(results, "packed_copyto_m_per_s", t > 0.0 ? numbers / t / 1e6 : 0.0);
+    if (memcmp(sums, packedSums, sizeof(sums)) != 0)
+    {
+        fprintf(stderr, "ERROR: packed values differ\n");
+    }
+
+    std::string text;
+    t = Measure(iterations, [&]() {
+        text.clear();
+        minijson::CStringOutputStream stream(text);
+        minijson::CWriter writer(false);
+        writer.Write(stream, *plain);
+    });
+    AddResult(results, "writer_mb_per_s", MBPerSecond(text.size(), t));
+    std::string packedText;
+    t = Measure(iterations, [&]() {
+        packedText.clear();
+        minijson::CStringOutputStream stream(packedText);
+        minijson::CWriter writer(false);
+        writer.Write(stream, *packed);
+    });
+    AddResult(results, "packed_writer_mb_per_s", MBPerSecond(packedText.size(), t));
+    // (numbers like 1.50 are written as 1.5)
+    std::unique_ptr<minijson::CEntity> reparsed(minijson::CParser::ParseString(packedText));
+    if (!reparsed->Equals(*plain))
+    {
+        fprintf(stderr, "ERROR: packed output differs\n");
+    }
+}
+
+// values of one generated api response
+struct SResponse
+{
+    int64_t m_Id;
+    std::string m_Name;
+    std::string m_Email;
+    double m_Score;
+    bool m_Active;
+};
+
+// many responses of the same shape: a CObject built and written per response vs. a precompiled
+// CTemplate rendered with the values
+static void RunTemplate(int iterations, minijson::CObject& results)
+{
+    fprintf(stdout, "template (rendering api responses)\n");
+    CRandom random(49);
+    std::vector<SResponse> responses(20000);
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        SResponse& r = responses[i];
+        r.m_Id = 1000000 + (int64_t)i * 7919;
+        r.m_Name = "user \"" + std::to_string(random.Below(100000)) + "\"";
+        r.m_Email = "u" + std::to_string(random.Below(100000)) + "@example.com";
+        r.m_Score = random.Below(1000000) / 100.0;
+        r.m_Active = random.Below(2) == 0;
+    }
+
+    // the constant part of the responses
+    auto build = [](const SResponse& r, minijson::CObject& obj) {
+        obj.AddInt("id", (int)r.m_Id);
+        minijson::CObject* user = obj.AddObject("user");
+        user->AddString("name", r.m_Name.c_str());
+        user->AddString("email", r.m_Email.c_str());
+        obj.AddDouble("score", r.m_Score);
+        obj.AddBoolean("active", r.m_Active);
+        minijson::CArray* tags = obj.AddArray("tags");
+        tags->AddString("api");
+        tags->AddString("v2");
+        obj.AddString("version", "1.4.2");
+        obj.AddString("status", "ok");
+    };
+    std::string out;
+    size_t bytes = 0;
+    double t = Measure(iterations, [&]() {
+        bytes = 0;
+        for (size_t i = 0; i < responses.size(); i++)
+        {
+            minijson::CObject obj;
+            build(responses[i], obj);
+            out = obj.ToString(false);
+            bytes += out.size();
+        }
+    });
+    AddResult(results, "dom_k_responses_per_s", t > 0.0 ? responses.size() / t / 1e3 : 0.0);
+    AddResult(results, "dom_mb_per_s", MBPerSecond(bytes, t));
+
+    std::unique_ptr<minijson::CEntity> doc(minijson::CParser::ParseString(
+        "{\"id\": \"{{id:int}}\", \"user\": {\"name\": \"{{name}}\", \"email\": \"{{email}}\"},"
+        " \"score\": \"{{score:double}}\", \"active\": \"{{active:bool}}\", \"tags\": [\"api\", \"v2\"],"
+        " \"version\": \"1.4.2\", \"status\": \"ok\"}"));
+    minijson::CTemplate tmpl(*doc, false);
+    minijson::CTemplateValues values(tmpl);
+    int id = tmpl.FindPlaceholder("id");
+    int name = tmpl.FindPlaceholder("name");
+    int email = tmpl.FindPlaceholder("email");
+    int score = tmpl.FindPlaceholder("score");
+    int active = tmpl.FindPlaceholder("active");
+    auto render = [&](const SResponse& r) {
+        values.SetInt(id, r.m_Id);
+        values.SetString(name, r.m_Name);
+        values.SetString(email, r.m_Email);
+        values.SetDouble(score, r.m_Score);
+        values.SetBool(active, r.m_Active);
+        out.clear();
+        tmpl.Render(values, out);
+    };
+    size_t allocationsBefore = 0;
+    t = Measure(iterations, [&]() {
+        allocationsBefore = g_HeapAllocations;
+        bytes = 0;
+        for (size_t i = 0; i < responses.size(); i++)
+        {
+            render(responses[i]);
+            bytes += out.size();
+        }
+    });
+    AddResult(results, "template_k_responses_per_s", t > 0.0 ? responses.size() / t / 1e3 : 0.0);
+    AddResult(results, "template_mb_per_s", MBPerSecond(bytes, t));
+    AddResult(results, "template_allocations", (double)(g_HeapAllocations - allocationsBefore));
+
+    // (CObject::AddDouble() writes 6 decimals, compared by value)
+    for (size_t i = 0; i < 100; i++)
+    {
+        minijson::CObject obj;
+        build(responses[i], obj);
+        render(responses[i]);
+        std::unique_ptr<minijson::CEntity> rendered(minijson::CParser::ParseString(out));
+        if (!rendered->Equals(obj))
+        {
+            fprintf(stderr, "ERROR: rendered response differs: %s\n", out.c_str());
+            break;
+        }
+    }
+}
+
+// prints the relative change of all results compared to a previous run
+static void Compare(const minijson::CObject& current, const minijson::CObject& baseline)
+{
+    fprintf(stdout, "\nComparison to baseline (current / baseline):\n");
+    for (int i = 0; i < current.Count(); i++)
+    {
+        const std::string& corpus = current.MemberNameByIndex(i);
+        const minijson::CObject* base = baseline.GetObject(corpus);
+        if (!current.EntityAtIndex(i).IsObject() || !base)
+        {
+            continue;
+        }
+        const minijson::CObject& cur = current.EntityAtIndex(i).Object();
+        fprintf(stdout, "%s\n", corpus.c_str());
+        for (int j = 0; j < cur.Count(); j++)
+        {
+            const std::string& name = cur.MemberNameByIndex(j);
+            double b = base->GetDouble(name, 0.0);
+            if (b != 0.0)
+            {
+                fprintf(stdout, "  %-24s %8.1f%%\n", name.c_str(), 100.0 * cur.GetDouble(name) / b);
+            }
+        }
+    }
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv0);
+    fprintf(stderr, "  --scale <mb>        approximate size of each corpus in MB (default: 4)\n");
+    fprintf(stderr, "  --iterations <n>    runs per measurement, the best run is reported (default: 5)\n");
+    fprintf(stderr, "  --corpus <name>     run the named corpus only (numbers, strings, deep, wide, bigarray, churn, small, batch, parallel, diff, dedup, index, columns, packed, template)\n");
+    fprintf(stderr, "  --output <file>     write the results as json\n");
+    fprintf(stderr, "  --baseline <file>   compare the results to a file written with --output\n");
+    fprintf(stderr, "  --dump <dir>        write the generated corpora to <dir>/<name>.json\n");
+    fflush(stderr);
+}
+
+int main(int argc, char** argv)
+{
+    double scale = 4.0;
+    int iterations = 5;
+    const char* corpusName = nullptr;
+    const char* outputFileName = nullptr;
+    const char* baselineFileName = nullptr;
+    const char* dumpDir = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "--scale") == 0 && hasValue)
+        {
+            scale = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && hasValue)
+        {
+            iterations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--corpus") == 0 && hasValue)
+        {
+            corpusName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--output") == 0 && hasValue)
+        {
+            outputFileName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+        {
+            baselineFileName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump") == 0 && hasValue)
+        {
+            dumpDir = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (scale <= 0.0 || iterations <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    minijson::CObject results;
+    try
+    {
+        results.AddString("version", "1");
+        results.AddDouble("scale_mb", scale);
+        results.AddInt("iterations", iterations);
+        for (size_t i = 0; i < sizeof(g_Corpora) / sizeof(g_Corpora[0]); i++)
+        {
+            const SCorpus& corpus = g_Corpora[i];
+            if (corpusName && strcmp(corpusName, corpus.m_Name) != 0)
+            {
+                continue;
+            }
+            std::string json = corpus.m_Generate((size_t)(scale * 1024 * 1024));
+            if (dumpDir)
+            {
+                std::string path = std::string(dumpDir) + "/" + corpus.m_Name + ".json";
+                FILE* f = fopen(path.c_str(), "wb");
+                if (!f || fwrite(json.data(), 1, json.size(), f) != json.size())
+                {
+                    fprintf(stderr, "ERROR: Failed to write %s\n", path.c_str());
+                }
+                if (f)
+                {
+                    fclose(f);
+                }
+            }
+            RunCorpus(corpus, json, iterations, *results.AddObject(corpus.m_Name));
+        }
+        if (!corpusName || strcmp(corpusName, "churn") == 0)
+        {
+            RunChurn(iterations, *results.AddObject("churn"));
+        }
+        if (!corpusName || strcmp(corpusName, "small") == 0)
+        {
+            RunSmall(iterations, *results.AddObject("small"));
+        }
+        if (!corpusName || strcmp(corpusName, "batch") == 0)
+        {
+            RunBatch(iterations, *results.AddObject("batch"));
+        }
+        if (!corpusName || strcmp(corpusName, "parallel") == 0)
+        {
+            RunParallel(scale, iterations, *results.AddObject("parallel"));
+        }
+        if (!corpusName || strcmp(corpusName, "diff") == 0)
+        {
+            RunDiff(scale, iterations, *results.AddObject("diff"));
+        }
+        if (!corpusName || strcmp(corpusName, "dedup") == 0)
+        {
+            RunDeduplicate(scale, iterations, *results.AddObject("dedup"));
+        }
+        if (!corpusName || strcmp(corpusName, "index") == 0)
+        {
+            RunIndex(iterations, *results.AddObject("index"));
+        }
+        if (!corpusName || strcmp(corpusName, "columns") == 0)
+        {
+            RunColumns(scale, iterations, *results.AddObject("columns"));
+        }
+        if (!corpusName || strcmp(corpusName, "packed") == 0)
+        {
+            RunPacked(scale, iterations, *results.AddObject("packed"));
+        }
+        if (!corpusName || strcmp(corpusName, "template") == 0)
+        {
+            RunTemplate(iterations, *results.AddObject("template"));
+        }
+#ifndef _WIN32
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            // NOTE: kilobytes on linux, bytes on osx
+            results.AddDouble("max_rss", (double)usage.ru_maxrss);
+            fprintf(stdout, "max_rss %ld\n", (long)usage.ru_maxrss);
+        }
+#endif // _WIN32
+
+        if (outputFileName)
+        {
+            minijson::CWriter writer;
+            writer.WriteToFile(outputFileName, results);
+        }
+        if (baselineFileName)
+        {
+            std::unique_ptr<minijson::CEntity> baseline(minijson::CParser::ParseFromFile(baselineFileName));
+            if (!baseline->IsObject())
+            {
+                throw minijson::CException("Baseline %s is not a json object", baselineFileName);
+            }
+            Compare(results, baseline->Object());
+        }
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: %s\n", ex.Message().c_str());
+        fflush(stderr);
+        return 1;
+    }
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,505 @@
+#include <minijson.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// extracts values by path from json or NDJSON text (see CStreamParser), without building a
+// document, i.e. in bounded memory. Paths are JSON Pointers ("/a/0/b") or dotted paths
+// ("a[0].b", "a.0.b"), both with "*" as wildcard for any member/element.
+
+/**
+ * One step of a path: member name or array index (numeric segments match both), or wildcard.
+ **/
+struct SPathSegment
+{
+    std::string m_Name;
+    long m_Index; // -1 if m_Name is not a number
+    bool m_Wildcard;
+};
+
+typedef std::vector<SPathSegment> TPath;
+
+static SPathSegment MakeSegment(const std::string& name, bool allowWildcard)
+{
+    SPathSegment segment;
+    segment.m_Name = name;
+    segment.m_Wildcard = allowWildcard && name == "*";
+    segment.m_Index = -1;
+    if (!name.empty() && name.size() < 10 && name.find_first_not_of("0123456789") == std::string::npos && (name == "0" || name[0] != '0'))
+    {
+        segment.m_Index = atol(name.c_str());
+    }
+    return segment;
+}
+
+// JSON Pointer (RFC 6901) if text starts with '/', dotted path otherwise. Throws CException for
+// invalid paths.
+static TPath ParsePath(const std::string& text)
+{
+    TPath path;
+    if (text.empty() || text == "." || text == "$" || text == "/")
+    {
+        if (text == "/")
+        {
+            path.push_back(MakeSegment("", false)); // member with an empty name
+        }
+        return path;
+    }
+    if (text[0] == '/')
+    {
+        size_t pos = 1;
+        while (true)
+        {
+            size_t end = text.find('/', pos);
+            std::string raw = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            std::string name;
+            for (size_t i = 0; i < raw.size(); i++)
+            {
+                if (raw[i] == '~' && i + 1 < raw.size() && (raw[i + 1] == '0' || raw[i + 1] == '1'))
+                {
+                    name += raw[i + 1] == '0' ? '~' : '/';
+                    i++;
+                }
+                else if (raw[i] == '~')
+                {
+                    throw minijson::CException("Invalid escape in JSON Pointer '%s'", text.c_str());
+                }
+                else
+                {
+                    name += raw[i];
+                }
+            }
+            path.push_back(MakeSegment(name, raw == "*"));
+            if (end == std::string::npos)
+            {
+                break;
+            }
+            pos = end + 1;
+        }
+        return path;
+    }
+
+    size_t pos = text[0] == '$' ? 1 : 0;
+    if (pos < text.size() && text[pos] == '.')
+    {
+        pos++;
+    }
+    while (pos < text.size())
+    {
+        if (text[pos] == '[')
+        {
+            size_t end = text.find(']', pos);
+            if (end == std::string::npos || end == pos + 1)
+            {
+                throw minijson::CException("Invalid index in path '%s'", text.c_str());
+            }
+            std::string name = text.substr(pos + 1, end - pos - 1);
+            if (name.size() >= 2 && name[0] == '"' && name[name.size() - 1] == '"')
+            {
+                path.push_back(MakeSegment(name.substr(1, name.size() - 2), false)); // ["any.name"]
+            }
+            else
+            {
+                path.push_back(MakeSegment(name, true));
+            }
+            pos = end + 1;
+            if (pos < text.size() && text[pos] == '.')
+            {
+                pos++;
+            }
+            continue;
+        }
+        size_t end = text.find_first_of(".[", pos);
+        std::string name = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        if (name.empty())
+        {
+            throw minijson::CException("Empty member name in path '%s'", text.c_str());
+        }
+        path.push_back(MakeSegment(name, true));
+        pos = end == std::string::npos ? text.size() : end;
+        if (pos < text.size() && text[pos] == '.')
+        {
+            pos++;
+        }
+    }
+    return path;
+}
+
+/**
+ * Handler that writes the values at the requested paths to an output stream.
+ **/
+class CQueryHandler : public minijson::CHandler
+{
+public:
+    CQueryHandler(const std::vector<TPath>& paths, minijson::COutputStream& output, bool raw, bool withPath)
+        : m_Paths(paths),
+          m_MaxPathLength(0),
+          m_Output(output),
+          m_Writer(output, false),
+          m_Raw(raw),
+          m_WithPath(withPath),
+          m_CaptureDepth(-1)
+    {
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            m_MaxPathLength = std::max(m_MaxPathLength, paths[i].size());
+        }
+    }
+
+    virtual void StartObject(int sizeHint) MINIJSON_OVERRIDE
+    {
+        BeginValue();
+        if (Capturing())
+        {
+            m_Writer.StartObject(sizeHint);
+        }
+        SFrame frame = { true, -1, std::string() };
+        m_Frames.push_back(frame);
+    }
+    virtual void Key(const char* str, size_t length) MINIJSON_OVERRIDE
+    {
+        if (Capturing())
+        {
+            m_Writer.Key(str, length);
+        }
+        else if (m_Frames.size() <= m_MaxPathLength)
+        {
+            m_Frames.back().m_Key.assign(str, length); // deeper keys can not match
+        }
+    }
+    virtual void EndObject() MINIJSON_OVERRIDE
+    {
+        m_Frames.pop_back();
+        if (Capturing())
+        {
+            m_Writer.EndObject();
+            EndValue();
+        }
+    }
+    virtual void StartArray(int sizeHint) MINIJSON_OVERRIDE
+    {
+        BeginValue();
+        if (Capturing())
+        {
+            m_Writer.StartArray(sizeHint);
+        }
+        SFrame frame = { false, -1, std::string() };
+        m_Frames.push_back(frame);
+    }
+    virtual void EndArray() MINIJSON_OVERRIDE
+    {
+        m_Frames.pop_back();
+        if (Capturing())
+        {
+            m_Writer.EndArray();
+            EndValue();
+        }
+    }
+    virtual void String(const char* str, size_t length) MINIJSON_OVERRIDE
+    {
+        BeginValue();
+        if (Capturing())
+        {
+            if (m_Raw && m_CaptureDepth == (int)m_Frames.size())
+            {
+                m_Output.Write(str, length); // toplevel string of a match: unquoted
+            }
+            else
+            {
+                m_Writer.String(str, length);
+            }
+            EndValue();
+        }
+    }
+    virtual void Number(const char* str, size_t length) MINIJSON_OVERRIDE
+    {
+        BeginValue();
+        if (Capturing())
+        {
+            m_Writer.Number(str, length);
+            EndValue();
+        }
+    }
+    virtual void Boolean(bool b) MINIJSON_OVERRIDE
+    {
+        BeginValue();
+        if (Capturing())
+        {
+            m_Writer.Boolean(b);
+            EndValue();
+        }
+    }
+    virtual void Null() MINIJSON_OVERRIDE
+    {
+        BeginValue();
+        if (Capturing())
+        {
+            m_Writer.Null();
+            EndValue();
+        }
+    }
+
+private:
+    struct SFrame
+    {
+        bool m_IsObject;
+        long m_Index;      // index of the current element (arrays)
+        std::string m_Key; // key of the current member (objects)
+    };
+
+    bool Capturing() const { return m_CaptureDepth >= 0; }
+
+    bool Matches(const TPath& path) const
+    {
+        if (path.size() != m_Frames.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            const SPathSegment& segment = path[i];
+            const SFrame& frame = m_Frames[i];
+            if (!segment.m_Wildcard && (frame.m_IsObject ? frame.m_Key != segment.m_Name : frame.m_Index != segment.m_Index))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // called before every value, starts capturing if the value is at one of the paths
+    void BeginValue()
+    {
+        if (Capturing())
+        {
+            return;
+        }
+        if (!m_Frames.empty() && !m_Frames.back().m_IsObject)
+        {
+            m_Frames.back().m_Index++;
+        }
+        if (m_Frames.size() > m_MaxPathLength)
+        {
+            return;
+        }
+        for (size_t i = 0; i < m_Paths.size(); i++)
+        {
+            if (Matches(m_Paths[i]))
+            {
+                m_CaptureDepth = (int)m_Frames.size();
+                if (m_WithPath)
+                {
+                    WritePath();
+                }
+                return;
+            }
+        }
+    }
+    // called after every complete value, ends capturing at the end of the matched value
+    void EndValue()
+    {
+        if (m_CaptureDepth != (int)m_Frames.size())
+        {
+            return;
+        }
+        m_CaptureDepth = -1;
+        if (m_WithPath && !m_Raw)
+        {
+            m_Output.Write("}", 1);
+        }
+        m_Output.Write("\n", 1);
+    }
+    // the JSON Pointer of the current value: "<pointer>\t" (raw) or {"path":"<pointer>","value":
+    void WritePath()
+    {
+        std::string pointer;
+        char buf[32];
+        for (size_t i = 0; i < m_Frames.size(); i++)
+        {
+            pointer += '/';
+            if (!m_Frames[i].m_IsObject)
+            {
+                snprintf(buf, sizeof(buf), "%ld", m_Frames[i].m_Index);
+                pointer += buf;
+                continue;
+            }
+            const std::string& key = m_Frames[i].m_Key;
+            for (size_t j = 0; j < key.size(); j++)
+            {
+                if (key[j] == '~')
+                {
+                    pointer += "~0";
+                }
+                else if (key[j] == '/')
+                {
+                    pointer += "~1";
+                }
+                else
+                {
+                    pointer += key[j];
+                }
+            }
+        }
+        if (m_Raw)
+        {
+            m_Output.Write(pointer.data(), pointer.size());
+            m_Output.Write("\t", 1);
+        }
+        else
+        {
+            m_Output.Write("{\"path\":", 8);
+            m_Writer.String(pointer.data(), pointer.size());
+            m_Output.Write(",\"value\":", 9);
+        }
+    }
+
+    const std::vector<TPath>& m_Paths;
+    size_t m_MaxPathLength;
+    minijson::COutputStream& m_Output;
+    minijson::CStreamWriter m_Writer; // writes the matched values, its stack is empty between values
+    bool m_Raw;
+    bool m_WithPath;
+    std::vector<SFrame> m_Frames; // open containers
+    int m_CaptureDepth;           // depth of the matched value that is written, -1 if none
+};
+
+static bool Query(const char* fileName, const std::vector<TPath>& paths, minijson::COutputStream& output, bool raw, bool withPath, bool sequence)
+{
+    FILE* input = stdin;
+    if (fileName)
+    {
+        input = fopen(fileName, "rb");
+        if (!input)
+        {
+            fprintf(stderr, "ERROR: Failed to open file %s for reading\n", fileName);
+            fflush(stderr);
+            return false;
+        }
+    }
+    bool ok = true;
+    try
+    {
+        minijson::CFileInputStream fileInput(input);
+        minijson::CDecompressingInputStream decompressed(fileInput);
+        CQueryHandler handler(paths, output, raw, withPath);
+        minijson::CStreamParser parser(1024 * 1024);
+        parser.SetDocumentSequence(sequence);
+        parser.Parse(decompressed, handler);
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: Failed to query %s: %s\n", fileName ? fileName : "<stdin>", ex.Message().c_str());
+        fflush(stderr);
+        ok = false;
+    }
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    return ok;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [options] <path> [<files>]\n", argv0);
+    fprintf(stderr, "       %s [options] -p <path> [-p <path> ...] [<files>]\n", argv0);
+    fprintf(stderr, "  Writes the values at <path> in the json (or NDJSON) <files> (or stdin) one per line.\n");
+    fprintf(stderr, "  The input is processed as a stream, files of any size are supported.\n");
+    fprintf(stderr, "  Paths are JSON Pointers (/a/0/b) or dotted paths (a[0].b, a.0.b, a[\"x.y\"]), \"*\"\n");
+    fprintf(stderr, "  matches any member or element (e.g. /items/*/id or items[*].id).\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -p <path>           value(s) to extract, can be repeated\n");
+    fprintf(stderr, "  --ndjson            write json values (strings quoted) instead of raw strings\n");
+    fprintf(stderr, "  --with-path         prefix every value by its JSON Pointer (raw: <pointer><TAB><value>,\n");
+    fprintf(stderr, "                      --ndjson: {\"path\":<pointer>,\"value\":<value>})\n");
+    fprintf(stderr, "  --single            the input is one json document (default: any number of documents,\n");
+    fprintf(stderr, "                      e.g. NDJSON)\n");
+    fflush(stderr);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> pathTexts;
+    std::vector<const char*> files;
+    bool raw = true;
+    bool withPath = false;
+    bool sequence = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+        {
+            pathTexts.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ndjson") == 0)
+        {
+            raw = false;
+        }
+        else if (strcmp(argv[i], "--with-path") == 0)
+        {
+            withPath = true;
+        }
+        else if (strcmp(argv[i], "--single") == 0)
+        {
+            sequence = false;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != 0 && argv[i][1] != '/' && argv[i][1] != '.')
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else if (pathTexts.empty() && files.empty())
+        {
+            pathTexts.push_back(argv[i]);
+        }
+        else
+        {
+            files.push_back(strcmp(argv[i], "-") == 0 ? nullptr : argv[i]);
+        }
+    }
+    if (pathTexts.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (files.empty())
+    {
+        files.push_back(nullptr);
+    }
+
+    std::vector<TPath> paths;
+    try
+    {
+        for (size_t i = 0; i < pathTexts.size(); i++)
+        {
+            paths.push_back(ParsePath(pathTexts[i]));
+        }
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: %s\n", ex.Message().c_str());
+        fflush(stderr);
+        return 1;
+    }
+
+    bool ok = true;
+    minijson::CFileOutputStream output(stdout);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!Query(files[i], paths, output, raw, withPath, sequence))
+        {
+            ok = false;
+        }
+        output.Flush();
+    }
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include <minijson.h>
+#include <minijsonsnapshot.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+
+static bool Compile(const char* inputFileName, const char* outputFileName)
+{
+    std::unique_ptr<minijson::CEntity> entity;
+    try
+    {
+        entity.reset(minijson::CParser::ParseFromFile(inputFileName));
+    }
+    catch (const minijson::CParseErrorException& ex)
+    {
+        if (ex.Line() > 0)
+        {
+            fprintf(stderr, "ERROR: Parse error in file %s at or after line %d column %d (position %d in file):\n----------\n%s----------\nException: %s\n", inputFileName, ex.Line(), ex.Column(), ex.Position(), ex.Surrounding().c_str(), ex.Message().c_str());
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Parse error in file %s at or after position %d, exception: %s\n", inputFileName, (int)ex.Position(), ex.Message().c_str());
+        }
+        fflush(stderr);
+        return false;
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: Failed to parse file %s, exception: %s\n", inputFileName, ex.Message().c_str());
+        fflush(stderr);
+        return false;
+    }
+    try
+    {
+        minijson::CSnapshotWriter::CompileToFile(outputFileName, *entity);
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: Failed to write snapshot %s, exception: %s\n", outputFileName, ex.Message().c_str());
+        fflush(stderr);
+        return false;
+    }
+    fprintf(stderr, "SUCCESSFULLY compiled %s to %s\n", inputFileName, outputFileName);
+    fflush(stderr);
+    return true;
+}
+
+static bool Decompile(const char* inputFileName, const char* outputFileName)
+{
+    FILE* output = stdout;
+    if (outputFileName)
+    {
+        output = fopen(outputFileName, "wb");
+        if (!output)
+        {
+            fprintf(stderr, "ERROR: Failed to open file %s for writing\n", outputFileName);
+            fflush(stderr);
+            return false;
+        }
+    }
+    bool ok = true;
+    try
+    {
+        minijson::CSnapshot snapshot;
+        snapshot.Open(inputFileName, true);
+        // streams directly from the mapped snapshot, no CEntity tree is created
+        minijson::CFileOutputStream stream(output);
+        minijson::CStreamWriter writer(stream);
+        snapshot.Root().Accept(writer);
+        stream.Write("\n", 1);
+        stream.Flush();
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: Failed to decompile snapshot %s, exception: %s\n", inputFileName, ex.Message().c_str());
+        fflush(stderr);
+        ok = false;
+    }
+    if (outputFileName)
+    {
+        fclose(output);
+    }
+    else
+    {
+        fflush(stdout);
+    }
+    return ok;
+}
+
+static bool Verify(const char* fileName)
+{
+    try
+    {
+        minijson::CSnapshot snapshot;
+        snapshot.Open(fileName, true);
+    }
+    catch (const minijson::CException& ex)
+    {
+        fprintf(stderr, "ERROR: Invalid snapshot %s: %s\n", fileName, ex.Message().c_str());
+        fflush(stderr);
+        return false;
+    }
+    fprintf(stdout, "SUCCESSFULLY verified %s\n", fileName);
+    fflush(stdout);
+    return true;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s compile <input.json> <output.snapshot>\n", argv0);
+    fprintf(stderr, "       %s decompile <input.snapshot> [<output.json>]\n", argv0);
+    fprintf(stderr, "       %s verify <files>\n", argv0);
+    fprintf(stderr, "  compile:   converts a json file into a binary snapshot that can be memory mapped and used without parsing.\n");
+    fprintf(stderr, "  decompile: converts a snapshot back into json. If <output.json> is omitted, stdout is used.\n");
+    fprintf(stderr, "  verify:    checks header and checksum of snapshot files.\n");
+    fflush(stderr);
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    if (strcmp(argv[1], "compile") == 0 && argc == 4)
+    {
+        ok = Compile(argv[2], argv[3]);
+    }
+    else if (strcmp(argv[1], "decompile") == 0 && argc <= 4)
+    {
+        ok = Decompile(argv[2], argc > 3 ? argv[3] : nullptr);
+    }
+    else if (strcmp(argv[1], "verify") == 0)
+    {
+        for (int i = 2; i < argc; i++)
+        {
+            if (!Verify(argv[i]))
+            {
+                ok = false;
+            }
+        }
+    }
+    else
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (ok)
+    {
+        return 0;
+    }
+    return 1;
+}
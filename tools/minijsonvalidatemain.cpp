@@ -1,106 +1,385 @@
 #include <minijson.h>
+#include <minijsonparallel.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <string>
+#include <vector>
 
-static bool Validate(const char* fileName);
+#ifdef _WIN32
+#include <windows.h>
+#else // _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
 
+// validates many files (and directories) concurrently: every file is memory mapped and validated
+// by one thread of a thread pool, the results are reported in the order of the files.
 
-static bool Validate(const char* fileName)
+/**
+ * Read only memory mapping of a file.
+ **/
+class CMappedFile
 {
-    FILE* f = fopen(fileName, "r");
-    if (!f)
+public:
+    CMappedFile() : m_Data(NULL), m_Size(0)
+#ifdef _WIN32
+        , m_File(INVALID_HANDLE_VALUE), m_Mapping(NULL)
+#endif // _WIN32
     {
-        fprintf(stderr, "ERROR: Failed to open file %s for reading\n", fileName);
-        fflush(stderr);
-        return false;
     }
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    if (size <= 0)
+    ~CMappedFile()
     {
-        fprintf(stderr, "ERROR: Empty file %s\n", fileName);
-        fflush(stderr);
-        fclose(f);
-        return false;
+#ifdef _WIN32
+        if (m_Data)
+        {
+            UnmapViewOfFile(m_Data);
+        }
+        if (m_Mapping)
+        {
+            CloseHandle(m_Mapping);
+        }
+        if (m_File != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_File);
+        }
+#else // _WIN32
+        if (m_Data)
+        {
+            munmap((void*)m_Data, m_Size);
+        }
+#endif // _WIN32
     }
-    if (size > 1024 * 1024 * 20)
+
+    // returns an error message, empty on success (empty files are not mapped)
+    std::string Open(const char* path)
+    {
+#ifdef _WIN32
+        m_File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_File == INVALID_HANDLE_VALUE)
+        {
+            return "Failed to open file for reading";
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_File, &size))
+        {
+            return "Failed to get the file size";
+        }
+        m_Size = (size_t)size.QuadPart;
+        if (m_Size == 0)
+        {
+            return std::string();
+        }
+        m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+        m_Data = m_Mapping ? (const char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else // _WIN32
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return "Failed to open file for reading";
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return "Failed to get the file size";
+        }
+        m_Size = (size_t)st.st_size;
+        if (m_Size == 0)
+        {
+            close(fd);
+            return std::string();
+        }
+        void* data = mmap(NULL, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping keeps the file referenced
+        m_Data = data != MAP_FAILED ? (const char*)data : NULL;
+#endif // _WIN32
+        if (!m_Data)
+        {
+            return "Failed to map file";
+        }
+        return std::string();
+    }
+
+    const char* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+
+private:
+    CMappedFile(const CMappedFile&);
+    CMappedFile& operator=(const CMappedFile&);
+
+    const char* m_Data;
+    size_t m_Size;
+#ifdef _WIN32
+    HANDLE m_File;
+    HANDLE m_Mapping;
+#endif // _WIN32
+};
+
+struct SFileResult
+{
+    SFileResult() : m_Ok(false), m_Bytes(0) {}
+
+    std::string m_Path;
+    bool m_Ok;
+    size_t m_Bytes;
+    std::string m_Error; // complete error report
+    minijson::CParseStats m_Stats;
+};
+
+static bool HasJsonExtension(const std::string& path)
+{
+    return path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+}
+
+// appends the *.json files in directory (recursively, in sorted order) to paths, returns false if
+// path is not a directory
+static bool CollectDirectory(const std::string& directory, std::vector<std::string>& paths)
+{
+    std::vector<std::string> files;
+    std::vector<std::string> subdirectories;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
     {
-        fprintf(stderr, "ERROR: File too large: %s\n", fileName);
-        fflush(stderr);
-        fclose(f);
         return false;
     }
-    char* data = (char*)malloc(size + 1);
-    if (fread(data, 1, size, f) != (size_t)size)
+    do
+    {
+        std::string name = data.cFileName;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            subdirectories.push_back(directory + "\\" + name);
+        }
+        else if (HasJsonExtension(name))
+        {
+            files.push_back(directory + "\\" + name);
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else // _WIN32
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
     {
-        fprintf(stderr, "ERROR: Failed to read %d bytes from file %s\n", (int)size, fileName);
-        fflush(stderr);
-        fclose(f);
-        free(data);
         return false;
     }
-    fclose(f);
-    f = NULL;
+    while (struct dirent* entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+        std::string path = directory + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+        {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode))
+        {
+            subdirectories.push_back(path);
+        }
+        else if (S_ISREG(st.st_mode) && HasJsonExtension(name))
+        {
+            files.push_back(path);
+        }
+    }
+    closedir(dir);
+#endif // _WIN32
+    std::sort(files.begin(), files.end());
+    std::sort(subdirectories.begin(), subdirectories.end());
+    paths.insert(paths.end(), files.begin(), files.end());
+    for (size_t i = 0; i < subdirectories.size(); i++)
+    {
+        CollectDirectory(subdirectories[i], paths);
+    }
+    return true;
+}
+
+static void PrintStats(const char* fileName, const minijson::CParseStats& stats)
+{
+    fprintf(stdout, "Statistics for %s:\n", fileName);
+    fprintf(stdout, "  bytes:          %lu\n", (unsigned long)stats.m_Bytes);
+    fprintf(stdout, "  objects:        %lu\n", (unsigned long)stats.m_Objects);
+    fprintf(stdout, "  arrays:         %lu\n", (unsigned long)stats.m_Arrays);
+    fprintf(stdout, "  strings:        %lu\n", (unsigned long)stats.m_Strings);
+    fprintf(stdout, "  keys:           %lu\n", (unsigned long)stats.m_Keys);
+    fprintf(stdout, "  numbers:        %lu\n", (unsigned long)stats.m_Numbers);
+    fprintf(stdout, "  booleans:       %lu\n", (unsigned long)stats.m_Booleans);
+    fprintf(stdout, "  nulls:          %lu\n", (unsigned long)stats.m_Nulls);
+    fprintf(stdout, "  max depth:      %d\n", stats.m_MaxDepth);
+    fprintf(stdout, "  string bytes:   %lu\n", (unsigned long)stats.m_StringBytes);
+    fprintf(stdout, "  escapes:        %lu\n", (unsigned long)stats.m_Escapes);
+    fprintf(stdout, "  allocations:    %lu\n", (unsigned long)stats.m_Allocations);
+    fprintf(stdout, "  parse time:     %.3f ms", stats.m_ParseSeconds * 1000.0);
+    if (stats.m_ParseSeconds > 0.0)
+    {
+        fprintf(stdout, " (%.1f MB/s)", stats.m_Bytes / (1024.0 * 1024.0) / stats.m_ParseSeconds);
+    }
+    fprintf(stdout, "\n");
+    fprintf(stdout, "  teardown time:  %.3f ms\n", stats.m_TeardownSeconds * 1000.0);
+}
+
+static void Validate(minijson::CParser& parser, SFileResult& result, bool printStats, bool buildDom)
+{
+    const char* fileName = result.m_Path.c_str();
+    CMappedFile file;
+    std::string error = file.Open(fileName);
+    if (error.empty() && file.Size() == 0)
+    {
+        error = "Empty file";
+    }
+    if (error.empty() && file.Size() > (size_t)INT_MAX)
+    {
+        error = "File too large";
+    }
+    if (!error.empty())
+    {
+        result.m_Error = "ERROR: " + error + ": " + result.m_Path + "\n";
+        return;
+    }
+    result.m_Bytes = file.Size();
+    parser.SetStats(printStats ? &result.m_Stats : NULL);
     try
     {
-        minijson::CParser parser;
-        minijson::CEntity* entity = parser.Parse(data);
-        delete entity;
+        if (buildDom)
+        {
+            minijson::CEntity* entity = parser.Parse(file.Data(), (int)file.Size());
+            parser.Delete(entity);
+        }
+        else
+        {
+            minijson::CParseResult parseResult;
+            parser.Validate(file.Data(), (int)file.Size(), parseResult);
+            parseResult.Throw();
+        }
+        result.m_Ok = true;
     }
     catch (const minijson::CParseErrorException& ex)
     {
+        char buf[512];
         if (ex.Line() > 0)
         {
-            fprintf(stderr, "ERROR: Parse error in file %s at or after line %d column %d (position %d in file):\n----------\n%s----------\nException: %s\n", fileName, ex.Line(), ex.Column(), ex.Position(), ex.Surrounding().c_str(), ex.Message().c_str());
+            snprintf(buf, sizeof(buf), "ERROR: Parse error in file %s at or after line %d column %d (position %d in file):\n", fileName, ex.Line(), ex.Column(), ex.Position());
+            result.m_Error = std::string(buf) + "----------\n" + ex.Surrounding() + "----------\nException: " + ex.Message() + "\n";
         }
         else
         {
-            fprintf(stderr, "ERROR: Parse error in file %s at or after position %d, exception: %s\n", fileName, (int)ex.Position(), ex.Message().c_str());
+            snprintf(buf, sizeof(buf), "ERROR: Parse error in file %s at or after position %d, exception: ", fileName, (int)ex.Position());
+            result.m_Error = std::string(buf) + ex.Message() + "\n";
         }
-        fflush(stderr);
-        free(data);
-        return false;
     }
     catch (const minijson::CException& ex)
     {
-        fprintf(stderr, "ERROR: Failed to parse file %s, exception: %s\n", fileName, ex.Message().c_str());
-        fflush(stderr);
-        free(data);
-        return false;
+        result.m_Error = "ERROR: Failed to parse file " + result.m_Path + ", exception: " + ex.Message() + "\n";
     }
-    free(data);
-    fprintf(stdout, "SUCCESSFULLY parsed %s\n", fileName);
+    parser.SetStats(NULL);
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stdout, "Usage: %s [options] <files or directories>\n", argv0);
+    fprintf(stdout, "  This tool will attempt to parse all specified JSON files (and all *.json files in the\n");
+    fprintf(stdout, "  specified directories, recursively) and report any parse errors. The exit code is the\n");
+    fprintf(stdout, "  number of invalid files (at most 125).\n");
+    fprintf(stdout, "  --stats: print parse statistics (node counts, depth, timing) of each file\n");
+    fprintf(stdout, "  --dom: build the complete document instead of validating only (e.g. to measure the parser)\n");
+    fprintf(stdout, "  --threads <n>: number of threads (default: number of cores)\n");
+    fprintf(stdout, "  --quiet: report invalid files and the summary only\n");
     fflush(stdout);
-    return true;
 }
 
 int main(int argc, char** argv)
 {
-    bool ok = true;
+    bool printStats = false;
+    bool buildDom = false;
+    bool quiet = false;
+    size_t threads = 0;
+    std::vector<std::string> paths;
     for (int i = 1; i < argc; i++)
     {
         if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
         {
-            fprintf(stdout, "Usage: %s <files>\n", argv[0]);
-            fprintf(stdout, "  This tool will attempt to parse all specified JSON files and report any parse errors\n");
-            fflush(stdout);
+            usage(argv[0]);
             return 0;
         }
-    }
-    for (int i = 1; i < argc; i++)
-    {
-        if (!Validate(argv[i]))
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            printStats = true;
+        }
+        else if (strcmp(argv[i], "--dom") == 0)
+        {
+            buildDom = true;
+        }
+        else if (strcmp(argv[i], "--quiet") == 0)
+        {
+            quiet = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
         {
-            ok = false;
+            int n = atoi(argv[++i]);
+            threads = n > 0 ? (size_t)n : 0;
+        }
+        else if (!CollectDirectory(argv[i], paths))
+        {
+            paths.push_back(argv[i]);
         }
     }
-    if (ok)
+    if (paths.empty())
     {
-        return 0;
+        usage(argv[0]);
+        return 1;
     }
-    return 1;
-}
 
+    std::vector<SFileResult> results(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        results[i].m_Path = paths[i];
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    minijson::CThreadPool pool(threads);
+    std::vector<minijson::CParser> parsers(pool.Threads());
+    pool.Run(results.size(), [&](size_t index, size_t thread) { Validate(parsers[thread], results[index], printStats, buildDom); });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failures = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const SFileResult& result = results[i];
+        bytes += result.m_Bytes;
+        if (!result.m_Ok)
+        {
+            failures++;
+            fflush(stdout);
+            fputs(result.m_Error.c_str(), stderr);
+            fflush(stderr);
+            continue;
+        }
+        if (!quiet)
+        {
+            fprintf(stdout, "SUCCESSFULLY parsed %s\n", result.m_Path.c_str());
+        }
+        if (printStats)
+        {
+            PrintStats(result.m_Path.c_str(), result.m_Stats);
+        }
+    }
+    fprintf(stdout, "Validated %lu files (%.1f MB) in %.3f s on %lu threads: %.1f MB/s, %lu valid, %lu invalid\n", (unsigned long)results.size(), bytes / (1024.0 * 1024.0), seconds,
+            (unsigned long)pool.Threads(), seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0, (unsigned long)(results.size() - failures), (unsigned long)failures);
+    fflush(stdout);
+    return (int)std::min(failures, (size_t)125);
+}